@@ -124,6 +124,15 @@ pub extern "C" fn mystruct_process(obj: *mut MyStruct) -> i32 {
     )
 }
 
+/// PATTERN: Generated wrapper (cimpl `macros` feature)
+///
+/// Writes the same cstr/deref/ok_or_return chain as the hand-written
+/// patterns above. cbindgen needs `[parse.expand]` (nightly) to see it.
+#[cimpl::export]
+fn mystruct_label(obj: &MyStruct, prefix: &str) -> Result<String, MyLibInternalError> {
+    Ok(format!("{prefix}{}", obj.inner.label()?))
+}
+
 /// PATTERN: Free/destructor
 #[no_mangle]
 pub extern "C" fn mystruct_free(obj: *mut MyStruct) -> i32 {
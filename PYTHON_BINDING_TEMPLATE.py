@@ -0,0 +1,258 @@
+"""
+# [Library Name] - Python Bindings (ctypes)
+
+Brief description of what these bindings wrap.
+
+## ZERO-COPY FIRST
+
+Bytes crossing the boundary should be copied at most once, by whoever owns
+the destination. Before writing a binding, check you are not using:
+- `ctypes.string_at(ptr, n)` in a callback → wrap the pointer with `_view()`
+- `ctypes.memmove(ptr, f.read(n), n)`      → `f.readinto(_view(...))`
+- `(c_uint8 * n)()` per call + `bytes(buf)` → `readinto(caller_buffer)`
+- `(c_uint8 * n).from_buffer_copy(data)`    → `_address(data)`
+
+Copy this file, replace `mylib` / `MyThing` with the real names, and delete
+the patterns you do not need. See stream-example/bindings/python for a
+complete, tested binding built this way.
+"""
+
+import ctypes
+import io
+import os
+import sys
+from ctypes import CFUNCTYPE, POINTER, c_int, c_int32, c_size_t, c_ssize_t, c_void_p
+from typing import Optional
+
+# ============================================================================
+# Library Loading
+# ============================================================================
+
+def _load_library():
+    """Load the shared library from the Cargo target directory."""
+    names = {'darwin': 'libmylib.dylib', 'win32': 'mylib.dll'}
+    name = names.get(sys.platform, 'libmylib.so')
+    here = os.path.dirname(os.path.abspath(__file__))
+    for profile in ('release', 'debug'):
+        path = os.path.join(here, '..', '..', 'target', profile, name)
+        if os.path.exists(path):
+            return ctypes.CDLL(path)
+    raise RuntimeError(f"Could not find {name}; run `cargo build --release` first")
+
+_lib = _load_library()
+
+# ============================================================================
+# Zero-Copy Buffer Helpers (copy verbatim)
+# ============================================================================
+
+_PyBUF_READ = 0x100
+_PyBUF_WRITE = 0x200
+
+try:
+    _memory_view = ctypes.pythonapi.PyMemoryView_FromMemory
+    _memory_view.argtypes = [c_void_p, c_ssize_t, c_int]
+    _memory_view.restype = ctypes.py_object
+
+    def _view(address: int, length: int, writable: bool) -> memoryview:
+        """Borrow `length` bytes at `address` as a memoryview (no copy)."""
+        return _memory_view(address, length, _PyBUF_WRITE if writable else _PyBUF_READ)
+except AttributeError:  # Not CPython: go through a ctypes array instead
+    def _view(address: int, length: int, writable: bool) -> memoryview:
+        """Borrow `length` bytes at `address` as a memoryview (no copy)."""
+        view = memoryview((ctypes.c_char * length).from_address(address)).cast('B')
+        return view if writable else view.toreadonly()
+
+
+def _address(buffer, writable: bool):
+    """Address and length of a bytes-like object, without copying it.
+
+    Returns (address, length, keepalive); keep `keepalive` referenced until the
+    address is no longer used.
+    """
+    if isinstance(buffer, bytes) and not writable:
+        return buffer, len(buffer), buffer  # ctypes passes bytes storage as-is
+    view = memoryview(buffer).cast('B')
+    if view.readonly:
+        if writable:
+            raise TypeError("a writable buffer is required")
+        data = view.tobytes()  # read-only and not bytes: one copy is unavoidable
+        return data, len(data), data
+    array = (ctypes.c_char * len(view)).from_buffer(view)
+    return ctypes.addressof(array), len(view), array
+
+# ============================================================================
+# Error Handling
+# ============================================================================
+
+_lib.mylib_error_code.argtypes = []
+_lib.mylib_error_code.restype = c_int32
+
+# Returned strings are owned by Rust: keep the raw pointer, free it with cimpl_free
+_lib.mylib_last_error.argtypes = []
+_lib.mylib_last_error.restype = c_void_p
+
+_lib.cimpl_free.argtypes = [c_void_p]
+_lib.cimpl_free.restype = c_int32
+
+
+class MyLibError(Exception):
+    """Base exception; `.code` is the cimpl error code."""
+
+    def __init__(self, message: str, code: int):
+        super().__init__(message)
+        self.code = code
+
+
+def _take_string(ptr) -> Optional[str]:
+    """Decode and free a Rust-owned C string."""
+    if not ptr:
+        return None
+    try:
+        return ctypes.string_at(ptr).decode('utf-8', 'replace')
+    finally:
+        _lib.cimpl_free(ptr)
+
+
+def _check(result, func_name: str):
+    """Raise MyLibError for NULL / negative results, otherwise return result."""
+    if result is None or (isinstance(result, int) and result < 0):
+        code = _lib.mylib_error_code()
+        message = _take_string(_lib.mylib_last_error()) or f"{func_name} failed"
+        raise MyLibError(message, code)
+    return result
+
+# ============================================================================
+# PATTERN: Rust calls back into Python with a buffer it owns
+# ============================================================================
+
+# Declare buffer arguments as c_void_p (an int address), not POINTER(c_uint8):
+# `_view()` wraps the address directly
+ReadCallback = CFUNCTYPE(c_ssize_t, c_void_p, c_void_p, c_size_t)
+WriteCallback = CFUNCTYPE(c_ssize_t, c_void_p, c_void_p, c_size_t)
+
+_lib.mything_new.argtypes = [c_void_p, ReadCallback, WriteCallback]
+_lib.mything_new.restype = c_void_p
+
+# ============================================================================
+# PATTERN: Python hands Rust a buffer it owns
+# ============================================================================
+
+_lib.mything_read.argtypes = [c_void_p, c_void_p, c_size_t]
+_lib.mything_read.restype = c_ssize_t
+
+_lib.mything_write.argtypes = [c_void_p, c_void_p, c_size_t]
+_lib.mything_write.restype = c_ssize_t
+
+
+class MyThing(io.RawIOBase):
+    """
+    Wraps a Python file-like object for [Library].
+
+    Subclassing io.RawIOBase gives readline(), iteration and
+    io.BufferedReader / io.BufferedWriter support for free.
+    """
+
+    def __init__(self, file_obj):
+        super().__init__()
+        self._file = file_obj
+        file_readinto = getattr(file_obj, 'readinto', None)
+
+        @ReadCallback
+        def read_cb(ctx, data, length):
+            try:
+                if file_readinto is None:
+                    chunk = file_obj.read(length)
+                    ctypes.memmove(data, chunk, len(chunk))
+                    return len(chunk)
+                # `with` releases the view before Rust reuses its buffer
+                with _view(data, length, True) as view:
+                    return file_readinto(view) or 0
+            except Exception as e:
+                print(f"Read callback error: {e}", file=sys.stderr)
+                return -1  # never let an exception unwind into Rust
+
+        @WriteCallback
+        def write_cb(ctx, data, length):
+            try:
+                with _view(data, length, False) as view:
+                    written = file_obj.write(view)
+                return length if written is None else written
+            except Exception as e:
+                print(f"Write callback error: {e}", file=sys.stderr)
+                return -1
+
+        # Keep the callbacks referenced for as long as Rust may call them
+        self._callbacks = (read_cb, write_cb)
+        self._handle = _check(_lib.mything_new(None, read_cb, write_cb), "mything_new")
+
+    def readinto(self, buffer) -> int:
+        """Read straight into a caller-owned writable buffer."""
+        self._check_open()
+        address, length, keepalive = _address(buffer, writable=True)
+        n = _lib.mything_read(self._handle, address, length)
+        del keepalive
+        return _check(n, "mything_read")
+
+    def write(self, data) -> int:
+        """Write any bytes-like object; bytes and writable buffers are not copied."""
+        self._check_open()
+        address, length, keepalive = _address(data, writable=False)
+        n = _lib.mything_write(self._handle, address, length)
+        del keepalive
+        return _check(n, "mything_write")
+
+    def readable(self) -> bool:
+        return True
+
+    def writable(self) -> bool:
+        return True
+
+    @property
+    def closed(self) -> bool:
+        return self._handle is None
+
+    def close(self) -> None:
+        """Free the Rust object (safe to call more than once)."""
+        if getattr(self, '_handle', None):
+            _lib.cimpl_free(self._handle)
+            self._handle = None
+
+    def _check_open(self):
+        if not self._handle:
+            raise MyLibError("MyThing is closed", 0)
+
+    def __del__(self):
+        self.close()
+
+# ============================================================================
+# PATTERN: Rust returns a tracked (data, len) view
+# ============================================================================
+
+class CimplBytesView(ctypes.Structure):
+    _fields_ = [('data', c_void_p), ('len', c_size_t)]  # private fields omitted
+
+
+_lib.mything_content_view.argtypes = [c_void_p]
+_lib.mything_content_view.restype = POINTER(CimplBytesView)
+
+
+def content(thing: MyThing) -> bytes:
+    """Copy a Rust-owned view out once, then release it."""
+    view = _check(_lib.mything_content_view(thing._handle), "mything_content_view")
+    try:
+        if not view.contents.len:
+            return b""
+        with _view(view.contents.data, view.contents.len, False) as mv:
+            return mv.tobytes()  # or process `mv` in place and skip the copy
+    finally:
+        _lib.cimpl_free(view)
+
+
+# Returned C strings follow the same rule: declare restype c_void_p, never
+# c_char_p, so the pointer can be passed back to cimpl_free
+_lib.mything_name.argtypes = [c_void_p]
+_lib.mything_name.restype = c_void_p
+
+
+def name(thing: MyThing) -> str:
+    return _take_string(_check(_lib.mything_name(thing._handle), "mything_name"))
@@ -0,0 +1,86 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! C string scanning benchmark
+//!
+//! Compares the `strnlen` nul search and vectorized ASCII-prefix UTF-8
+//! decoding in `cimpl::scan` against the `CStr::from_bytes_until_nul` +
+//! `to_string_lossy` path the `cstr_*` macros used before, for ASCII
+//! (JSON-like) and mixed UTF-8 strings from 16 bytes to 64KB.
+//!
+//! ```bash
+//! cargo bench --bench cstr_scan
+//! ```
+
+use std::ffi::CStr;
+
+use cimpl::macros::MAX_CSTRING_LEN;
+use cimpl::scan;
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+
+const SIZES: [usize; 6] = [16, 256, 1024, 4096, 16384, 65535];
+
+/// Nul-terminated buffer of `len` bytes built from `pattern`, padded to
+/// MAX_CSTRING_LEN so the baseline's bounded slice stays in bounds
+fn make_input(pattern: &str, len: usize) -> Vec<u8> {
+    let mut buf: Vec<u8> = pattern.bytes().cycle().take(len).collect();
+    // Don't split a multi-byte character at the end
+    while std::str::from_utf8(&buf).is_err() {
+        buf.pop();
+    }
+    buf.resize(len, b' ');
+    buf.resize(MAX_CSTRING_LEN, 0);
+    buf
+}
+
+fn bench_strings(c: &mut Criterion, group_name: &str, pattern: &str) {
+    let mut group = c.benchmark_group(group_name);
+    for len in SIZES {
+        let input = make_input(pattern, len);
+        group.throughput(Throughput::Bytes(len as u64));
+        group.bench_with_input(BenchmarkId::new("std", len), &input, |b, input| {
+            b.iter(|| {
+                let bytes = &black_box(input)[..MAX_CSTRING_LEN];
+                let cstr = CStr::from_bytes_until_nul(bytes).unwrap();
+                black_box(cstr.to_string_lossy().len())
+            })
+        });
+        group.bench_with_input(BenchmarkId::new("scan", len), &input, |b, input| {
+            b.iter(|| {
+                let ptr = black_box(input).as_ptr();
+                let bytes = unsafe { scan::cstr_bytes(ptr, MAX_CSTRING_LEN) }.unwrap();
+                black_box(scan::utf8_lossy(bytes).len())
+            })
+        });
+    }
+    group.finish();
+}
+
+fn bench_ascii(c: &mut Criterion) {
+    bench_strings(
+        c,
+        "cstr_scan_ascii",
+        r#"{"verify": {"verify_after_sign": true}}, "#,
+    );
+}
+
+fn bench_utf8(c: &mut Criterion) {
+    bench_strings(
+        c,
+        "cstr_scan_utf8",
+        "caf\u{e9} na\u{ef}ve r\u{e9}sum\u{e9} \u{1F600} ",
+    );
+}
+
+criterion_group!(benches, bench_ascii, bench_utf8);
+criterion_main!(benches);
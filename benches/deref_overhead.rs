@@ -0,0 +1,79 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Deref overhead benchmark
+//!
+//! Measures the cost of a registry-validated `deref_or_return_neg!` against
+//! `deref_trusted_or_return_neg!`, which only null-checks in release builds.
+//! Both read a field through every pointer in a pool of tracked objects, so
+//! the registry lookup runs against a realistically sized table.
+//!
+//! ```bash
+//! cargo bench --bench deref_overhead
+//! cargo bench --bench deref_overhead --features object-header
+//! ```
+//!
+//! With `object-header`, "checked" validates by the inline header instead.
+
+use cimpl::{box_tracked, cimpl_free, deref_or_return_neg, deref_trusted_or_return_neg};
+use criterion::{black_box, criterion_group, criterion_main, Criterion, Throughput};
+
+/// Tracked objects in the pool
+const OBJECTS: usize = 4096;
+
+struct Counter {
+    value: i32,
+}
+
+fn checked_get(ptr: *mut Counter) -> i32 {
+    deref_or_return_neg!(ptr, Counter).value
+}
+
+fn trusted_get(ptr: *mut Counter) -> i32 {
+    deref_trusted_or_return_neg!(ptr, Counter).value
+}
+
+fn bench_deref(c: &mut Criterion) {
+    let objects: Vec<*mut Counter> = (0..OBJECTS as i32)
+        .map(|value| box_tracked!(Counter { value }))
+        .collect();
+
+    let mut group = c.benchmark_group("deref_overhead");
+    group.throughput(Throughput::Elements(OBJECTS as u64));
+    group.bench_function("checked", |b| {
+        b.iter(|| {
+            let sum: i64 = objects
+                .iter()
+                .map(|&ptr| checked_get(black_box(ptr)) as i64)
+                .sum();
+            black_box(sum)
+        })
+    });
+    group.bench_function("trusted", |b| {
+        b.iter(|| {
+            let sum: i64 = objects
+                .iter()
+                .map(|&ptr| trusted_get(black_box(ptr)) as i64)
+                .sum();
+            black_box(sum)
+        })
+    });
+    group.finish();
+
+    for ptr in objects {
+        cimpl_free(ptr as *mut _);
+    }
+}
+
+criterion_group!(benches, bench_deref);
+criterion_main!(benches);
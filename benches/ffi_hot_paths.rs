@@ -0,0 +1,244 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! FFI hot path benchmarks
+//!
+//! Covers the calls every binding makes on each FFI crossing:
+//!
+//! - `box_tracked!` + `cimpl_free` round trips, and the same with `box_pooled!`
+//!   (run with `--features leak-trace` to measure allocation-site tracing)
+//! - `deref_or_return!` validation of live objects at 1, 8 and 32 threads
+//! - `cstr_or_return!` at several string lengths
+//! - `to_c_string` / `to_c_bytes` (including the matching `cimpl_free`)
+//! - setting the last error and reading it back
+//! - a column of strings mapped one call at a time vs. one `*_batch` call
+//!
+//! The configuration is fixed (sample size, warm-up and measurement time)
+//! so runs are comparable across commits:
+//!
+//! ```bash
+//! cargo bench --bench ffi_hot_paths -- --save-baseline main
+//! git checkout my-branch
+//! cargo bench --bench ffi_hot_paths -- --baseline main
+//! ```
+//!
+//! Stream I/O is measured in `stream-example/benches`, and the cost of real
+//! C-to-Rust calls by `make bench` in `stream-example`.
+
+use std::ffi::{c_char, c_void, CString};
+use std::sync::Barrier;
+use std::time::{Duration, Instant};
+
+use cimpl::{
+    batch_strings_or_return_null, box_pooled, box_tracked, cimpl_free, cimpl_last_error_view,
+    cstr_borrow_or_return_null, cstr_or_return_int, deref_or_return_neg, impl_pooled, to_c_bytes,
+    to_c_string, CimplBatch, CimplError,
+};
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+
+/// Tracked objects shared by the validating threads
+const OBJECTS: usize = 1024;
+
+struct Thing {
+    value: i32,
+}
+impl_pooled!(Thing);
+
+fn thing_value(ptr: *mut Thing) -> i32 {
+    deref_or_return_neg!(ptr, Thing).value
+}
+
+fn string_len(input: *const c_char) -> i32 {
+    cstr_or_return_int!(input).len() as i32
+}
+
+fn upper(input: *const c_char) -> *mut c_char {
+    to_c_string(cstr_borrow_or_return_null!(input).to_uppercase())
+}
+
+fn upper_batch(offsets: *const i64, data: *const u8, len: usize, count: usize) -> *mut CimplBatch {
+    batch_strings_or_return_null!(offsets, data, len, count, |s: &str| s.to_uppercase())
+}
+
+fn bench_lifecycle(c: &mut Criterion) {
+    let mut group = c.benchmark_group("tracked_lifecycle");
+    group.bench_function("box_tracked_free", |b| {
+        b.iter(|| {
+            let ptr = box_tracked!(Thing {
+                value: black_box(7)
+            });
+            black_box(cimpl_free(ptr as *mut c_void))
+        })
+    });
+    group.bench_function("box_pooled_free", |b| {
+        b.iter(|| {
+            let ptr = box_pooled!(Thing {
+                value: black_box(7)
+            });
+            black_box(cimpl_free(ptr as *mut c_void))
+        })
+    });
+    // box_tracked_free above already records sites; these add backtraces
+    #[cfg(feature = "leak-trace")]
+    for every in [1000u32, 1] {
+        cimpl::set_backtrace_sampling(every);
+        group.bench_function(format!("box_tracked_free_backtrace_1_in_{every}"), |b| {
+            b.iter(|| {
+                let ptr = box_tracked!(Thing {
+                    value: black_box(7)
+                });
+                black_box(cimpl_free(ptr as *mut c_void))
+            })
+        });
+        cimpl::set_backtrace_sampling(0);
+    }
+    group.finish();
+}
+
+/// Each of `threads` threads derefs every object `iters` times in total
+fn run_derefs(objects: &[usize], threads: usize, iters: u64) -> Duration {
+    let barrier = Barrier::new(threads + 1);
+    std::thread::scope(|scope| {
+        for thread in 0..threads {
+            let barrier = &barrier;
+            scope.spawn(move || {
+                barrier.wait();
+                for i in 0..iters as usize {
+                    let ptr = objects[(thread + i) % objects.len()] as *mut Thing;
+                    black_box(thing_value(black_box(ptr)));
+                }
+            });
+        }
+        barrier.wait();
+        Instant::now()
+    })
+    .elapsed()
+}
+
+fn bench_deref(c: &mut Criterion) {
+    let objects: Vec<usize> = (0..OBJECTS as i32)
+        .map(|value| box_tracked!(Thing { value }) as usize)
+        .collect();
+
+    let mut group = c.benchmark_group("deref_or_return");
+    for threads in [1usize, 8, 32] {
+        group.throughput(Throughput::Elements(threads as u64));
+        group.bench_with_input(
+            BenchmarkId::from_parameter(threads),
+            &threads,
+            |b, &threads| b.iter_custom(|iters| run_derefs(&objects, threads, iters)),
+        );
+    }
+    group.finish();
+
+    for ptr in objects {
+        cimpl_free(ptr as *mut c_void);
+    }
+}
+
+fn bench_cstr(c: &mut Criterion) {
+    let mut group = c.benchmark_group("cstr_or_return");
+    for len in [8usize, 64, 1024, 16 * 1024] {
+        let input = CString::new("a".repeat(len)).unwrap();
+        group.throughput(Throughput::Bytes(len as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(len), &input, |b, input| {
+            b.iter(|| string_len(black_box(input.as_ptr())))
+        });
+    }
+    group.finish();
+}
+
+fn bench_results(c: &mut Criterion) {
+    let mut group = c.benchmark_group("results");
+    for len in [16usize, 1024] {
+        let text = "r".repeat(len);
+        group.throughput(Throughput::Bytes(len as u64));
+        group.bench_with_input(BenchmarkId::new("to_c_string", len), &text, |b, text| {
+            b.iter(|| cimpl_free(to_c_string(black_box(text.clone())) as *mut c_void))
+        });
+        let bytes = vec![0x5Au8; len];
+        group.bench_with_input(BenchmarkId::new("to_c_bytes", len), &bytes, |b, bytes| {
+            b.iter(|| cimpl_free(to_c_bytes(black_box(bytes.clone())) as *mut c_void))
+        });
+    }
+    group.finish();
+}
+
+fn bench_errors(c: &mut Criterion) {
+    let mut group = c.benchmark_group("last_error");
+    group.bench_function("set_view", |b| {
+        b.iter(|| {
+            CimplError::other_static(black_box("Stream is read-only")).set_last();
+            let (mut msg, mut len, mut code) = (std::ptr::null(), 0usize, 0i32);
+            black_box(cimpl_last_error_view(&mut msg, &mut len, &mut code));
+            black_box((msg, len, code))
+        })
+    });
+    group.bench_function("set_message", |b| {
+        b.iter(|| {
+            CimplError::invalid_handle(black_box(0x1000)).set_last();
+            black_box(CimplError::last_message())
+        })
+    });
+    group.finish();
+}
+
+fn bench_batch(c: &mut Criterion) {
+    let mut group = c.benchmark_group("batch");
+    for count in [16usize, 1024] {
+        let items: Vec<CString> = (0..count)
+            .map(|i| CString::new(format!("item-{i}")).unwrap())
+            .collect();
+        let mut offsets = vec![0i64];
+        let mut data = Vec::new();
+        for item in &items {
+            data.extend_from_slice(item.as_bytes());
+            offsets.push(data.len() as i64);
+        }
+        group.throughput(Throughput::Elements(count as u64));
+        group.bench_with_input(BenchmarkId::new("per_call", count), &items, |b, items| {
+            b.iter(|| {
+                for item in items {
+                    cimpl_free(upper(black_box(item.as_ptr())) as *mut c_void);
+                }
+            })
+        });
+        group.bench_with_input(BenchmarkId::new("batched", count), &data, |b, data| {
+            b.iter(|| {
+                let out = upper_batch(
+                    offsets.as_ptr(),
+                    black_box(data.as_ptr()),
+                    data.len(),
+                    count,
+                );
+                cimpl_free(out as *mut c_void)
+            })
+        });
+    }
+    group.finish();
+}
+
+fn config() -> Criterion {
+    Criterion::default()
+        .sample_size(100)
+        .warm_up_time(Duration::from_secs(1))
+        .measurement_time(Duration::from_secs(3))
+        .configure_from_args()
+}
+
+criterion_group!(
+    name = benches;
+    config = config();
+    targets = bench_lifecycle, bench_deref, bench_cstr, bench_results, bench_errors, bench_batch
+);
+criterion_main!(benches);
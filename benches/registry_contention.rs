@@ -0,0 +1,116 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Registry contention benchmark
+//!
+//! Compares the sharded `PointerRegistry` against a single-shard registry,
+//! which is equivalent to the original one-mutex design. Every thread runs
+//! the typical FFI object lifecycle: track, validate a few times, free.
+//! A second group measures read-only validation of one shared pointer.
+//!
+//! ```bash
+//! cargo bench --bench registry_contention
+//! ```
+
+use std::any::TypeId;
+use std::sync::Barrier;
+use std::time::{Duration, Instant};
+
+use cimpl::utils::{PointerRegistry, REGISTRY_SHARDS};
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+
+/// Drop function for the fake addresses tracked below
+unsafe fn noop_drop(_ptr: usize, _len: usize) {}
+
+/// Validations per tracked object in each lifecycle
+const VALIDATIONS: usize = 8;
+
+/// Runs `iters` lifecycles on each of `threads` threads, returns the wall time
+fn run_lifecycles(registry: &PointerRegistry, threads: usize, iters: u64) -> Duration {
+    let barrier = Barrier::new(threads + 1);
+    std::thread::scope(|scope| {
+        for thread in 0..threads {
+            let barrier = &barrier;
+            scope.spawn(move || {
+                barrier.wait();
+                for i in 1..=iters as usize {
+                    // Fake, 16-byte aligned addresses unique per thread
+                    let ptr = (thread << 40 | i) * 16;
+                    registry.track(ptr, TypeId::of::<u64>(), noop_drop, 0);
+                    for _ in 0..VALIDATIONS {
+                        black_box(registry.validate(ptr, TypeId::of::<u64>()).is_ok());
+                    }
+                    registry.free(ptr).unwrap();
+                }
+            });
+        }
+        // Release the workers together; the scope joins them before returning
+        barrier.wait();
+        Instant::now()
+    })
+    .elapsed()
+}
+
+/// Each of `threads` threads validates one shared pointer `iters` times
+fn run_shared_validation(registry: &PointerRegistry, threads: usize, iters: u64) -> Duration {
+    let ptr = 0x1000usize;
+    registry.track(ptr, TypeId::of::<u64>(), noop_drop, 0);
+    let barrier = Barrier::new(threads + 1);
+    let elapsed = std::thread::scope(|scope| {
+        for _ in 0..threads {
+            let barrier = &barrier;
+            scope.spawn(move || {
+                barrier.wait();
+                for _ in 0..iters {
+                    black_box(registry.validate(ptr, TypeId::of::<u64>()).is_ok());
+                }
+            });
+        }
+        barrier.wait();
+        Instant::now()
+    })
+    .elapsed();
+    registry.free(ptr).unwrap();
+    elapsed
+}
+
+fn bench_contention(c: &mut Criterion) {
+    let mut group = c.benchmark_group("registry_contention");
+    for threads in [1usize, 8, 32] {
+        group.throughput(Throughput::Elements(threads as u64));
+        for (name, shards) in [("single_mutex", 1), ("sharded", REGISTRY_SHARDS)] {
+            let registry = PointerRegistry::with_shards(shards);
+            group.bench_with_input(BenchmarkId::new(name, threads), &threads, |b, &threads| {
+                b.iter_custom(|iters| run_lifecycles(&registry, threads, iters))
+            });
+        }
+    }
+    group.finish();
+}
+
+fn bench_shared_validation(c: &mut Criterion) {
+    let mut group = c.benchmark_group("registry_shared_validation");
+    let registry = PointerRegistry::new();
+    for threads in [1usize, 8, 32] {
+        group.throughput(Throughput::Elements(threads as u64));
+        group.bench_with_input(
+            BenchmarkId::from_parameter(threads),
+            &threads,
+            |b, &threads| b.iter_custom(|iters| run_shared_validation(&registry, threads, iters)),
+        );
+    }
+    group.finish();
+}
+
+criterion_group!(benches, bench_contention, bench_shared_validation);
+criterion_main!(benches);
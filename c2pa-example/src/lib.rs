@@ -13,12 +13,17 @@
 //!
 //! **When in doubt, check the macro documentation first!**
 
+use std::collections::{HashMap, VecDeque};
+use std::hash::{DefaultHasher, Hash, Hasher};
 use std::os::raw::c_char;
+use std::sync::{Arc, OnceLock, RwLock};
 
 use cimpl::{
-    box_tracked, cimpl_free, cstr_or_return, cstr_or_return_null,
+    box_tracked, cimpl_free, cstr_borrow_or_return, cstr_borrow_or_return_null, cstr_or_return,
+    cstr_or_return_null,
     deref_or_return_neg, deref_or_return_null, deref_mut_or_return_neg,
-    ok_or_return, ok_or_return_null, option_to_c_string, to_c_string, CimplError,
+    ok_or_return, ok_or_return_null, option_to_c_string, to_c_string, write_c_string_into,
+    CimplError,
 };
 
 // ============================================================================
@@ -86,19 +91,86 @@ impl From<C2paInternalError> for CimplError {
 // ============================================================================
 
 /// C2PA Context - wraps c2pa::Context with a stable pointer for FFI
-/// The pointer never changes, but the inner Context can be replaced to support builder patterns
+/// The pointer never changes, but the inner Context can be replaced to support builder patterns.
+/// The inner Context is immutable and may be shared with the settings cache and other handles.
 pub struct C2paContext {
-    inner: c2pa::Context,
+    inner: Arc<c2pa::Context>,
 }
 
 impl C2paContext {
     fn new() -> Self {
         Self {
-            inner: c2pa::Context::new(),
+            inner: Arc::new(c2pa::Context::new()),
         }
     }
 }
 
+// ============================================================================
+// Settings Cache (shared contexts for repeated configurations)
+// ============================================================================
+
+/// Most distinct settings strings kept; the oldest is evicted beyond this
+const SETTINGS_CACHE_CAPACITY: usize = 64;
+
+/// Contexts built from settings text, keyed by a hash of the text
+///
+/// Each entry keeps its text so a hash collision is detected rather than
+/// returning the wrong configuration; the colliding text is not cached.
+#[derive(Default)]
+struct SettingsCache {
+    entries: HashMap<u64, (Box<str>, Arc<c2pa::Context>)>,
+    order: VecDeque<u64>,
+}
+
+impl SettingsCache {
+    /// Caches `ctx` for `settings` under `key`, returning the Context to use
+    ///
+    /// If the text is already cached (a racing insert won), the cached Context
+    /// is returned and nothing is evicted.
+    fn insert(&mut self, key: u64, settings: &str, ctx: Arc<c2pa::Context>) -> Arc<c2pa::Context> {
+        match self.entries.get(&key) {
+            Some((text, cached)) if &**text == settings => return Arc::clone(cached),
+            // A different text with the same hash keeps its entry; don't cache this one
+            Some(_) => return ctx,
+            None => {}
+        }
+        if self.entries.len() >= SETTINGS_CACHE_CAPACITY {
+            if let Some(oldest) = self.order.pop_front() {
+                self.entries.remove(&oldest);
+            }
+        }
+        self.entries.insert(key, (settings.into(), Arc::clone(&ctx)));
+        self.order.push_back(key);
+        ctx
+    }
+}
+
+fn settings_cache() -> &'static RwLock<SettingsCache> {
+    static CACHE: OnceLock<RwLock<SettingsCache>> = OnceLock::new();
+    CACHE.get_or_init(Default::default)
+}
+
+fn settings_hash(settings: &str) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    settings.hash(&mut hasher);
+    hasher.finish()
+}
+
+/// Returns the shared Context for JSON or TOML settings text, parsing and
+/// building it only the first time the text is seen
+fn cached_context(settings: &str) -> Result<Arc<c2pa::Context>, C2paInternalError> {
+    let key = settings_hash(settings);
+    if let Some((text, ctx)) = settings_cache().read().unwrap().entries.get(&key) {
+        if &**text == settings {
+            return Ok(Arc::clone(ctx));
+        }
+    }
+
+    // Build outside the lock; a racing thread may build the same context
+    let ctx = Arc::new(c2pa::Context::new().with_settings(settings)?);
+    Ok(settings_cache().write().unwrap().insert(key, settings, ctx))
+}
+
 // ============================================================================
 // Context API
 // ============================================================================
@@ -144,14 +216,14 @@ pub extern "C" fn c2pa_context_with_settings(
     ctx: *mut C2paContext,
     settings_json: *const c_char,
 ) -> i32 {
-    let json = cstr_or_return!(settings_json, -1);
+    let json = cstr_borrow_or_return!(settings_json, -1);
     let ctx_ref = deref_mut_or_return_neg!(ctx, C2paContext);
     
     // Create new Context with settings and replace the inner one
     ok_or_return!(
-        c2pa::Context::new().with_settings(json).map_err(C2paInternalError::C2pa),
+        c2pa::Context::new().with_settings(json.as_ref()).map_err(C2paInternalError::C2pa),
         |new_ctx| {
-            ctx_ref.inner = new_ctx;
+            ctx_ref.inner = Arc::new(new_ctx);
             0
         },
         -1
@@ -176,13 +248,67 @@ pub extern "C" fn c2pa_context_with_settings_toml(
     ok_or_return!(
         c2pa::Context::new().with_settings(toml).map_err(C2paInternalError::C2pa),
         |new_ctx| {
-            ctx_ref.inner = new_ctx;
+            ctx_ref.inner = Arc::new(new_ctx);
+            0
+        },
+        -1
+    )
+}
+
+/// Configure Context from a shared cache of JSON or TOML settings
+///
+/// The first call with a given settings string parses it and builds a Context;
+/// later calls with the same string reuse that Context without parsing, so
+/// switching between a small set of configurations is O(1). Cached Contexts
+/// are immutable and shared by every C2paContext configured from them.
+/// Returns 0 on success, -1 on error.
+///
+/// # Example
+/// ```c
+/// // Per request: no parsing after the first request for each tenant
+/// if (c2pa_context_with_settings_cached(ctx, tenant_settings) != 0) {
+///     printf("Error: %s\n", c2pa_last_error());
+/// }
+/// ```
+#[no_mangle]
+pub extern "C" fn c2pa_context_with_settings_cached(
+    ctx: *mut C2paContext,
+    settings: *const c_char,
+) -> i32 {
+    let settings = cstr_borrow_or_return!(settings, -1);
+    let ctx_ref = deref_mut_or_return_neg!(ctx, C2paContext);
+
+    ok_or_return!(
+        cached_context(&settings),
+        |shared| {
+            ctx_ref.inner = shared;
             0
         },
         -1
     )
 }
 
+/// Create a Context from a shared cache of JSON or TOML settings
+///
+/// Equivalent to `c2pa_context_new()` followed by
+/// `c2pa_context_with_settings_cached()`. Returns NULL on error.
+#[no_mangle]
+pub extern "C" fn c2pa_context_new_cached(settings: *const c_char) -> *mut C2paContext {
+    let settings = cstr_borrow_or_return_null!(settings);
+    let inner = ok_or_return_null!(cached_context(&settings));
+    box_tracked!(C2paContext { inner })
+}
+
+/// Drop every cached settings Context
+///
+/// Contexts already configured from the cache keep working.
+#[no_mangle]
+pub extern "C" fn c2pa_settings_cache_clear() {
+    let mut cache = settings_cache().write().unwrap();
+    cache.entries.clear();
+    cache.order.clear();
+}
+
 /// Free a Context
 ///
 /// # Safety
@@ -197,16 +323,35 @@ pub extern "C" fn c2pa_context_free(ctx: *mut C2paContext) -> i32 {
 // ============================================================================
 
 /// C2PA Settings - wraps c2pa::settings::Settings with a stable pointer for FFI
+///
+/// Settings are immutable once created, so the Context built from them the
+/// first time they are applied is kept and shared by later applications.
 pub struct C2paSettings {
     inner: c2pa::settings::Settings,
+    context: OnceLock<Arc<c2pa::Context>>,
 }
 
 impl C2paSettings {
     fn new() -> Self {
+        Self::from_inner(c2pa::settings::Settings::default())
+    }
+
+    fn from_inner(inner: c2pa::settings::Settings) -> Self {
         Self {
-            inner: c2pa::settings::Settings::default(),
+            inner,
+            context: OnceLock::new(),
         }
     }
+
+    /// The shared Context for these settings, built on first use
+    fn context(&self) -> Result<Arc<c2pa::Context>, C2paInternalError> {
+        if let Some(ctx) = self.context.get() {
+            return Ok(Arc::clone(ctx));
+        }
+        let ctx = Arc::new(c2pa::Context::new().with_settings(self.inner.clone())?);
+        // A racing thread may have stored its own; either is equivalent
+        Ok(Arc::clone(self.context.get_or_init(|| ctx)))
+    }
 }
 
 // ============================================================================
@@ -240,7 +385,7 @@ pub extern "C" fn c2pa_settings_from_json(json: *const c_char) -> *mut C2paSetti
     let inner = ok_or_return_null!(
         serde_json::from_str(&json_str).map_err(C2paInternalError::Json)
     );
-    let settings = C2paSettings { inner };
+    let settings = C2paSettings::from_inner(inner);
     box_tracked!(settings)
 }
 
@@ -256,7 +401,7 @@ pub extern "C" fn c2pa_settings_from_toml(toml: *const c_char) -> *mut C2paSetti
     let inner = ok_or_return_null!(
         toml::from_str(&toml_str).map_err(|e| C2paInternalError::Other(format!("{}", e)))
     );
-    let settings = C2paSettings { inner };
+    let settings = C2paSettings::from_inner(inner);
     box_tracked!(settings)
 }
 
@@ -281,6 +426,33 @@ pub extern "C" fn c2pa_settings_to_json(settings: *mut C2paSettings) -> *mut c_c
     to_c_string(json)
 }
 
+/// Serialize Settings to JSON into a caller-provided buffer
+///
+/// Returns the JSON length in bytes; a value >= `cap` means the output was
+/// truncated and the call should be repeated with a buffer of length + 1.
+/// Returns -1 on error. Nothing needs to be freed.
+///
+/// # Example
+/// ```c
+/// char json[4096];
+/// intptr_t len = c2pa_settings_to_json_into(settings, json, sizeof json, NULL);
+/// ```
+#[no_mangle]
+pub extern "C" fn c2pa_settings_to_json_into(
+    settings: *mut C2paSettings,
+    buf: *mut c_char,
+    cap: usize,
+    out_len: *mut usize,
+) -> isize {
+    let settings_ref = deref_or_return_neg!(settings, C2paSettings);
+    let json = ok_or_return!(
+        serde_json::to_string_pretty(&settings_ref.inner).map_err(C2paInternalError::Json),
+        |json| json,
+        -1
+    );
+    unsafe { write_c_string_into(&json, buf, cap, out_len) }
+}
+
 /// Serialize Settings to TOML string
 ///
 /// Returns NULL on error. Caller must free with c2pa_free().
@@ -296,7 +468,9 @@ pub extern "C" fn c2pa_settings_to_toml(settings: *mut C2paSettings) -> *mut c_c
 
 /// Apply Settings to a Context (builder-style, mutates Context in place)
 ///
-/// This configures the Context with the given Settings.
+/// This configures the Context with the given Settings. The Context built
+/// from a Settings object is reused, so applying the same Settings to many
+/// Contexts only builds it once.
 /// Returns 0 on success, non-zero on error.
 ///
 /// # Parameters
@@ -311,11 +485,9 @@ pub extern "C" fn c2pa_context_with_settings_obj(
     let settings_ref = deref_or_return_neg!(settings, C2paSettings);
     
     ok_or_return!(
-        c2pa::Context::new()
-            .with_settings(settings_ref.inner.clone())
-            .map_err(C2paInternalError::C2pa),
-        |new_ctx| {
-            ctx_ref.inner = new_ctx;
+        settings_ref.context(),
+        |shared| {
+            ctx_ref.inner = shared;
             0
         },
         -1
@@ -356,3 +528,95 @@ pub extern "C" fn c2pa_last_error() -> *mut c_char {
 pub extern "C" fn c2pa_free(ptr: *mut c_char) -> i32 {
     cimpl_free(ptr as *mut std::ffi::c_void)
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::ffi::CString;
+    use std::sync::Mutex;
+
+    const SETTINGS: &str = r#"{"verify": {"verify_after_sign": true}}"#;
+
+    // Tests touching the global cache must not clear it under each other
+    static GLOBAL_CACHE: Mutex<()> = Mutex::new(());
+
+    fn new_context() -> Arc<c2pa::Context> {
+        Arc::new(c2pa::Context::new())
+    }
+
+    #[test]
+    fn cache_hit_returns_same_context() {
+        let _guard = GLOBAL_CACHE.lock().unwrap();
+        let first = cached_context(SETTINGS).unwrap();
+        let second = cached_context(SETTINGS).unwrap();
+        assert!(Arc::ptr_eq(&first, &second));
+    }
+
+    #[test]
+    fn cache_evicts_oldest_at_capacity() {
+        let mut cache = SettingsCache::default();
+        for i in 0..SETTINGS_CACHE_CAPACITY as u64 {
+            cache.insert(i, &i.to_string(), new_context());
+        }
+        assert_eq!(cache.entries.len(), SETTINGS_CACHE_CAPACITY);
+
+        let next = SETTINGS_CACHE_CAPACITY as u64;
+        cache.insert(next, &next.to_string(), new_context());
+        assert_eq!(cache.entries.len(), SETTINGS_CACHE_CAPACITY);
+        assert!(!cache.entries.contains_key(&0));
+        assert!(cache.entries.contains_key(&1));
+        assert!(cache.entries.contains_key(&next));
+        assert_eq!(cache.order.front(), Some(&1));
+        assert_eq!(cache.order.back(), Some(&next));
+    }
+
+    #[test]
+    fn racing_insert_keeps_other_entries() {
+        let mut cache = SettingsCache::default();
+        for i in 0..SETTINGS_CACHE_CAPACITY as u64 {
+            cache.insert(i, &i.to_string(), new_context());
+        }
+        let winner = Arc::clone(&cache.entries[&5].1);
+
+        // The losing thread built its own Context for text already cached
+        let shared = cache.insert(5, "5", new_context());
+        assert!(Arc::ptr_eq(&shared, &winner));
+        assert_eq!(cache.entries.len(), SETTINGS_CACHE_CAPACITY);
+        assert_eq!(cache.order.len(), SETTINGS_CACHE_CAPACITY);
+        assert!(cache.entries.contains_key(&0));
+    }
+
+    #[test]
+    fn hash_collision_is_not_cached() {
+        let mut cache = SettingsCache::default();
+        let cached = new_context();
+        cache.insert(7, "first", Arc::clone(&cached));
+
+        let colliding = new_context();
+        let returned = cache.insert(7, "second", Arc::clone(&colliding));
+        assert!(Arc::ptr_eq(&returned, &colliding));
+        assert!(Arc::ptr_eq(&cache.entries[&7].1, &cached));
+        assert_eq!(cache.order.len(), 1);
+    }
+
+    #[test]
+    fn cache_clear_keeps_configured_contexts() {
+        let _guard = GLOBAL_CACHE.lock().unwrap();
+        let settings = CString::new(SETTINGS).unwrap();
+        let ctx = c2pa_context_new();
+        assert!(!ctx.is_null());
+        assert_eq!(c2pa_context_with_settings_cached(ctx, settings.as_ptr()), 0);
+        let configured = Arc::clone(unsafe { &(*ctx).inner });
+
+        c2pa_settings_cache_clear();
+        assert!(settings_cache().read().unwrap().entries.is_empty());
+
+        // The handle keeps its Context after the cache drops it
+        assert!(Arc::ptr_eq(unsafe { &(*ctx).inner }, &configured));
+        let rebuilt = cached_context(SETTINGS).unwrap();
+        assert!(!Arc::ptr_eq(&rebuilt, &configured));
+        assert_eq!(c2pa_context_with_settings_cached(ctx, settings.as_ptr()), 0);
+        assert!(Arc::ptr_eq(unsafe { &(*ctx).inner }, &rebuilt));
+        assert_eq!(c2pa_context_free(ctx), 0);
+    }
+}
@@ -0,0 +1,965 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! # cimpl-macros
+//!
+//! The `#[cimpl::export]` attribute. Enable cimpl's `macros` feature and use
+//! it through `cimpl`; the generated code refers to `::cimpl` and does not
+//! work without it.
+//!
+//! It turns a plain Rust function into a `#[no_mangle] extern "C"` wrapper
+//! built from the same `cstr_*`, `deref_*` and `ok_or_return!` macros you
+//! would write by hand. The conversion for each parameter and return type is
+//! picked at compile time, so the wrapper does no more work than the
+//! hand-written version.
+//!
+//! ## Parameters
+//!
+//! | Rust parameter     | C parameter(s)                | Conversion                         |
+//! |--------------------|-------------------------------|------------------------------------|
+//! | `&str`             | `const char*`                 | `cstr_borrow_or_return!` (no copy) |
+//! | `String`           | `const char*`                 | `cstr_or_return!` (owned copy)     |
+//! | `Option<&str>`     | `const char*` (NULL = `None`) | borrowed, as for `&str`            |
+//! | `Option<String>`   | `const char*` (NULL = `None`) | owned, as for `String`             |
+//! | `&[u8]`            | `const uint8_t* p, size_t p_len` | bounds-checked slice, no copy   |
+//! | `&T`               | `T*`                          | `deref_or_return!`                 |
+//! | `&mut T`           | `T*`                          | `deref_mut_or_return!`             |
+//! | `Option<&T>`       | `T*` (NULL = `None`)          | `deref_or_return!` when not NULL   |
+//! | `Option<&mut T>`   | `T*` (NULL = `None`)          | `deref_mut_or_return!` when not NULL |
+//! | primitive, raw or function pointer, plain named type | unchanged | none  |
+//!
+//! Any other type, such as `Box<T>`, `Vec<T>` or one holding a reference, is a
+//! compile error: passing it through would trust an unchecked C value.
+//!
+//! ## Returns
+//!
+//! | Rust return               | C return   | On error       |
+//! |---------------------------|------------|----------------|
+//! | `()`                      | `void`     | -              |
+//! | signed integer            | unchanged  | `-1`           |
+//! | unsigned integer          | unchanged  | `0`            |
+//! | `f32` / `f64`             | unchanged  | NaN            |
+//! | `bool`                    | `bool`     | `false`        |
+//! | raw pointer               | unchanged  | NULL           |
+//! | `String`                  | `char*`    | NULL           |
+//! | `Option<String>`          | `char*`    | NULL           |
+//! | any other `T`             | `T*` (`box_tracked!`) | NULL |
+//! | `Option<T>`               | `T*`, NULL for `None` | NULL |
+//! | `Result<(), E>`           | `int32_t` 0 | `-1`          |
+//! | `Result<R, E>`            | as for `R` | as for `R`     |
+//!
+//! `E` needs `CimplError: From<E>`, exactly as for `ok_or_return!`. The
+//! error value is also returned when a parameter fails validation, with the
+//! last error set either way.
+//!
+//! `0` and `false` are valid successes too, so an unsigned integer or `bool`
+//! return is rejected unless `out` is given when the function returns a
+//! `Result` or has a parameter that is checked (any row of the table but the
+//! last); otherwise C could not tell an error from success.
+//!
+//! ## Options
+//!
+//! - `name = "c_name"`: export under another name and keep the Rust function
+//!   callable as written. Without it the Rust function is renamed and only
+//!   the C symbol keeps its name.
+//! - `trusted`: use `deref_trusted_*` for `&T`/`&mut T` (NULL check only in
+//!   release builds).
+//! - `out`: write the converted result through a trailing `out` parameter
+//!   and return `int32_t` 0 / -1, instead of allocating a boxed result.
+//! - `shared`: allocate boxed results with `arc_tracked!`, so C can
+//!   `cimpl_retain()` them.
+//! - `batch`: also export `<name>_batch` over packed strings (see the
+//!   `batch` module). Needs a single `&str` or `String` parameter and a
+//!   `String` or primitive result. A `Result` adds a per-item `codes` array.
+//!
+//! # Example
+//! ```rust,ignore
+//! /// Rot13-encodes a string
+//! #[cimpl::export(batch)]
+//! fn secret_rot13(text: &str) -> String {
+//!     rot13(text)
+//! }
+//!
+//! // Expands to (roughly):
+//! #[no_mangle]
+//! pub extern "C" fn secret_rot13(text: *const c_char) -> *mut c_char {
+//!     let text = cstr_borrow_or_return!(text, std::ptr::null_mut());
+//!     to_c_string(__cimpl_export_secret_rot13(&text))
+//! }
+//!
+//! #[no_mangle]
+//! pub extern "C" fn secret_rot13_batch(
+//!     offsets: *const i64, data: *const u8, data_len: usize, count: usize,
+//! ) -> *mut CimplBatch { /* batch_strings_or_return_null!(...) */ }
+//! ```
+//!
+//! cbindgen only sees the generated functions with `[parse.expand]`, which
+//! needs a nightly toolchain; otherwise declare them in the header by hand.
+
+use proc_macro::TokenStream;
+use proc_macro2::TokenStream as TokenStream2;
+use quote::{format_ident, quote};
+use syn::{
+    parse_macro_input, spanned::Spanned, FnArg, GenericArgument, GenericParam, Ident, ItemFn,
+    LitStr, Pat, PathArguments, ReturnType, Type,
+};
+
+/// Generates a C FFI wrapper for a plain Rust function
+///
+/// See the crate documentation for the type mappings and options.
+#[proc_macro_attribute]
+pub fn export(attr: TokenStream, item: TokenStream) -> TokenStream {
+    let options = match Options::parse(attr) {
+        Ok(options) => options,
+        Err(e) => return e.to_compile_error().into(),
+    };
+    let function = parse_macro_input!(item as ItemFn);
+    match expand(options, function) {
+        Ok(tokens) => tokens.into(),
+        Err(e) => e.to_compile_error().into(),
+    }
+}
+
+#[derive(Default)]
+struct Options {
+    name: Option<LitStr>,
+    trusted: bool,
+    out: bool,
+    shared: bool,
+    batch: bool,
+}
+
+impl Options {
+    fn parse(attr: TokenStream) -> syn::Result<Self> {
+        let mut options = Options::default();
+        let parser = syn::meta::parser(|meta| {
+            if meta.path.is_ident("name") {
+                options.name = Some(meta.value()?.parse()?);
+            } else if meta.path.is_ident("trusted") {
+                options.trusted = true;
+            } else if meta.path.is_ident("out") {
+                options.out = true;
+            } else if meta.path.is_ident("shared") {
+                options.shared = true;
+            } else if meta.path.is_ident("batch") {
+                options.batch = true;
+            } else {
+                return Err(meta.error(
+                    "unknown cimpl::export option; expected name, trusted, out, shared or batch",
+                ));
+            }
+            Ok(())
+        });
+        syn::parse::Parser::parse(parser, attr)?;
+        Ok(options)
+    }
+}
+
+/// How a Rust parameter crosses the boundary
+#[cfg_attr(test, derive(Debug, PartialEq))]
+enum Param {
+    Str,
+    String,
+    OptStr,
+    OptString,
+    Bytes,
+    Ref(Type),
+    RefMut(Type),
+    OptRef(Type),
+    OptRefMut(Type),
+    Value,
+}
+
+impl Param {
+    /// True if converting the C argument can fail and return the error value
+    fn validated(&self) -> bool {
+        !matches!(self, Param::Value)
+    }
+}
+
+/// Scalar return kinds, which decide the error value
+#[derive(Debug, Clone, Copy, PartialEq)]
+enum Prim {
+    Signed,
+    Unsigned,
+    Float,
+    Bool,
+}
+
+/// How a (successful) Rust return value crosses the boundary
+#[cfg_attr(test, derive(Debug, PartialEq))]
+enum Value {
+    Unit,
+    Prim(Prim, Type),
+    Raw(Type),
+    String,
+    OptString,
+    Boxed(Type),
+    OptBoxed(Type),
+}
+
+/// Looks through the invisible groups `macro_rules!` wraps types in
+fn strip(ty: &Type) -> &Type {
+    match ty {
+        Type::Group(group) => strip(&group.elem),
+        Type::Paren(paren) => strip(&paren.elem),
+        ty => ty,
+    }
+}
+
+/// Last path segment of a plain path type, if it has no qualified self
+fn last_segment(ty: &Type) -> Option<&syn::PathSegment> {
+    match strip(ty) {
+        Type::Path(path) if path.qself.is_none() => path.path.segments.last(),
+        _ => None,
+    }
+}
+
+/// True for a path type whose last segment is `name` with no arguments
+fn is_named(ty: &Type, name: &str) -> bool {
+    last_segment(ty).is_some_and(|seg| seg.ident == name && seg.arguments.is_empty())
+}
+
+/// The first type argument of `name<...>`, e.g. `T` in `Option<T>`
+fn generic_arg<'a>(ty: &'a Type, name: &str) -> Option<&'a Type> {
+    let seg = last_segment(ty).filter(|seg| seg.ident == name)?;
+    let PathArguments::AngleBracketed(args) = &seg.arguments else {
+        return None;
+    };
+    args.args.iter().find_map(|arg| match arg {
+        GenericArgument::Type(ty) => Some(ty),
+        _ => None,
+    })
+}
+
+fn is_str_ref(ty: &Type) -> bool {
+    matches!(strip(ty), Type::Reference(r) if r.mutability.is_none() && is_named(&r.elem, "str"))
+}
+
+fn is_unit(ty: &Type) -> bool {
+    matches!(strip(ty), Type::Tuple(tuple) if tuple.elems.is_empty())
+}
+
+fn prim_kind(ty: &Type) -> Option<Prim> {
+    let seg = last_segment(ty).filter(|seg| seg.arguments.is_empty())?;
+    let kind = match seg.ident.to_string().as_str() {
+        "i8" | "i16" | "i32" | "i64" | "i128" | "isize" | "c_schar" | "c_short" | "c_int"
+        | "c_long" | "c_longlong" => Prim::Signed,
+        "u8" | "u16" | "u32" | "u64" | "u128" | "usize" | "c_uchar" | "c_ushort" | "c_uint"
+        | "c_ulong" | "c_ulonglong" => Prim::Unsigned,
+        "f32" | "f64" | "c_float" | "c_double" => Prim::Float,
+        "bool" => Prim::Bool,
+        _ => return None,
+    };
+    Some(kind)
+}
+
+fn classify_param(ty: &Type) -> syn::Result<Param> {
+    if is_str_ref(ty) {
+        return Ok(Param::Str);
+    }
+    if is_named(ty, "String") {
+        return Ok(Param::String);
+    }
+    if let Some(inner) = generic_arg(ty, "Option") {
+        if is_str_ref(inner) {
+            return Ok(Param::OptStr);
+        }
+        if is_named(inner, "String") {
+            return Ok(Param::OptString);
+        }
+        if let Type::Reference(r) = strip(inner) {
+            if !matches!(strip(&r.elem), Type::Slice(_)) {
+                let elem = strip(&r.elem).clone();
+                return Ok(match r.mutability {
+                    Some(_) => Param::OptRefMut(elem),
+                    None => Param::OptRef(elem),
+                });
+            }
+        }
+    }
+    match strip(ty) {
+        Type::Reference(r) => match strip(&r.elem) {
+            Type::Slice(slice) if r.mutability.is_none() && is_named(&slice.elem, "u8") => {
+                Ok(Param::Bytes)
+            }
+            Type::Slice(_) => Err(unsupported_param(ty)),
+            elem if r.mutability.is_some() => Ok(Param::RefMut(elem.clone())),
+            elem => Ok(Param::Ref(elem.clone())),
+        },
+        _ if passes_through(ty) => Ok(Param::Value),
+        _ => Err(unsupported_param(ty)),
+    }
+}
+
+/// True for a type C can pass as is: a primitive, raw pointer, function
+/// pointer (or `Option` of one), or a plain named type such as a
+/// `#[repr(C)]` struct or enum
+///
+/// Anything holding a reference or an owning container (`Box`, `Vec`, ...)
+/// would turn an unchecked C value into a Rust borrow or ownership.
+fn passes_through(ty: &Type) -> bool {
+    match strip(ty) {
+        Type::Ptr(_) | Type::BareFn(_) => true,
+        Type::Path(path) if path.qself.is_none() => {
+            if let Some(inner) = generic_arg(ty, "Option") {
+                return matches!(strip(inner), Type::BareFn(_));
+            }
+            path.path
+                .segments
+                .iter()
+                .all(|seg| seg.arguments.is_empty())
+        }
+        _ => false,
+    }
+}
+
+fn unsupported_param(ty: &Type) -> syn::Error {
+    syn::Error::new(
+        ty.span(),
+        "cimpl::export: unsupported parameter type; use one from the table, \
+         a primitive, a raw or function pointer, or a plain #[repr(C)] type",
+    )
+}
+
+/// Splits off `Result<R, E>`, returning `R` and whether it was a `Result`
+fn unwrap_result(ty: &Type) -> (&Type, bool) {
+    match generic_arg(ty, "Result") {
+        Some(ok) => (ok, true),
+        None => (ty, false),
+    }
+}
+
+fn classify_value(ty: &Type) -> syn::Result<Value> {
+    if is_unit(ty) {
+        return Ok(Value::Unit);
+    }
+    if let Some(kind) = prim_kind(ty) {
+        return Ok(Value::Prim(kind, ty.clone()));
+    }
+    if is_named(ty, "String") {
+        return Ok(Value::String);
+    }
+    if let Some(inner) = generic_arg(ty, "Option") {
+        if is_named(inner, "String") {
+            return Ok(Value::OptString);
+        }
+        if let Value::Boxed(inner) = classify_value(inner)? {
+            return Ok(Value::OptBoxed(inner));
+        }
+        return Err(syn::Error::new(
+            ty.span(),
+            "cimpl::export: Option results must hold a String or a boxed type",
+        ));
+    }
+    match strip(ty) {
+        Type::Ptr(_) => Ok(Value::Raw(ty.clone())),
+        Type::Reference(_) => Err(syn::Error::new(
+            ty.span(),
+            "cimpl::export: cannot return a borrow across FFI; return an owned value \
+             (or a CimplBytesView from bytes_view())",
+        )),
+        Type::Path(_) => Ok(Value::Boxed(ty.clone())),
+        _ => Err(syn::Error::new(
+            ty.span(),
+            "cimpl::export: unsupported return type",
+        )),
+    }
+}
+
+impl Value {
+    /// C return type, or `None` for `void`
+    fn c_type(&self) -> Option<TokenStream2> {
+        match self {
+            Value::Unit => None,
+            Value::Prim(_, ty) | Value::Raw(ty) => Some(quote!(#ty)),
+            Value::String | Value::OptString => Some(quote!(*mut ::std::os::raw::c_char)),
+            Value::Boxed(ty) | Value::OptBoxed(ty) => Some(quote!(*mut #ty)),
+        }
+    }
+
+    /// Error value returned by a wrapper with this C return type
+    fn sentinel(&self) -> TokenStream2 {
+        match self {
+            Value::Unit => quote!(()),
+            Value::Prim(Prim::Signed, _) => quote!(-1),
+            Value::Prim(Prim::Unsigned, _) => quote!(0),
+            Value::Prim(Prim::Float, ty) => quote!(<#ty>::NAN),
+            Value::Prim(Prim::Bool, _) => quote!(false),
+            Value::Raw(Type::Ptr(ptr)) if ptr.mutability.is_none() => quote!(::std::ptr::null()),
+            _ => quote!(::std::ptr::null_mut()),
+        }
+    }
+
+    /// Converts the Rust value `value` into the C return value
+    fn convert(&self, value: &Ident, shared: bool) -> TokenStream2 {
+        let alloc = if shared {
+            quote!(::cimpl::arc_tracked!)
+        } else {
+            quote!(::cimpl::box_tracked!)
+        };
+        match self {
+            Value::Unit | Value::Prim(..) | Value::Raw(_) => quote!(#value),
+            Value::String => quote!(::cimpl::to_c_string(#value)),
+            Value::OptString => quote!(::cimpl::option_to_c_string!(#value)),
+            Value::Boxed(_) => quote!(#alloc(#value)),
+            Value::OptBoxed(_) => quote! {
+                match #value {
+                    Some(value) => #alloc(value),
+                    None => ::std::ptr::null_mut(),
+                }
+            },
+        }
+    }
+}
+
+/// Statements converting C parameter `name` to its Rust type, and the C
+/// parameter list it needs
+fn convert_param(
+    param: &Param,
+    name: &Ident,
+    ty: &Type,
+    err: &TokenStream2,
+    trusted: bool,
+) -> (TokenStream2, TokenStream2) {
+    let c_char = quote!(*const ::std::os::raw::c_char);
+    match param {
+        Param::Str => (
+            quote!(#name: #c_char),
+            quote! {
+                let #name = ::cimpl::cstr_borrow_or_return!(#name, #err);
+                let #name: &str = &#name;
+            },
+        ),
+        Param::String => (
+            quote!(#name: #c_char),
+            quote!(let #name = ::cimpl::cstr_or_return!(#name, #err);),
+        ),
+        Param::OptStr => (
+            quote!(#name: #c_char),
+            quote! {
+                let #name = if #name.is_null() {
+                    None
+                } else {
+                    Some(::cimpl::cstr_borrow_or_return!(#name, #err))
+                };
+                let #name: Option<&str> = #name.as_deref();
+            },
+        ),
+        Param::OptString => (
+            quote!(#name: #c_char),
+            quote! {
+                let #name = if #name.is_null() {
+                    None
+                } else {
+                    Some(::cimpl::cstr_or_return!(#name, #err))
+                };
+            },
+        ),
+        Param::Bytes => {
+            let len = format_ident!("{}_len", name);
+            (
+                quote!(#name: *const u8, #len: usize),
+                quote! {
+                    let #name: &[u8] = if #len == 0 {
+                        &[]
+                    } else {
+                        // SAFETY: C passes `len` readable bytes at `ptr`
+                        ::cimpl::ok_or_return!(
+                            unsafe { ::cimpl::safe_slice_from_raw_parts_static(#name, #len, stringify!(#name)) },
+                            |bytes| bytes,
+                            #err
+                        )
+                    };
+                },
+            )
+        }
+        Param::Ref(inner) => {
+            let deref = if trusted {
+                quote!(::cimpl::deref_trusted_or_return!)
+            } else {
+                quote!(::cimpl::deref_or_return!)
+            };
+            (
+                quote!(#name: *mut #inner),
+                quote!(let #name = #deref(#name, #inner, #err);),
+            )
+        }
+        Param::RefMut(inner) => {
+            let deref = if trusted {
+                quote!(::cimpl::deref_trusted_mut_or_return!)
+            } else {
+                quote!(::cimpl::deref_mut_or_return!)
+            };
+            (
+                quote!(#name: *mut #inner),
+                quote!(let #name = #deref(#name, #inner, #err);),
+            )
+        }
+        Param::OptRef(inner) => {
+            let deref = if trusted {
+                quote!(::cimpl::deref_trusted_or_return!)
+            } else {
+                quote!(::cimpl::deref_or_return!)
+            };
+            (
+                quote!(#name: *mut #inner),
+                quote! {
+                    let #name = if #name.is_null() {
+                        None
+                    } else {
+                        Some(#deref(#name, #inner, #err))
+                    };
+                },
+            )
+        }
+        Param::OptRefMut(inner) => {
+            let deref = if trusted {
+                quote!(::cimpl::deref_trusted_mut_or_return!)
+            } else {
+                quote!(::cimpl::deref_mut_or_return!)
+            };
+            (
+                quote!(#name: *mut #inner),
+                quote! {
+                    let #name = if #name.is_null() {
+                        None
+                    } else {
+                        Some(#deref(#name, #inner, #err))
+                    };
+                },
+            )
+        }
+        Param::Value => (quote!(#name: #ty), quote!()),
+    }
+}
+
+fn check_signature(function: &ItemFn) -> syn::Result<()> {
+    let sig = &function.sig;
+    let unsupported = if sig.asyncness.is_some() {
+        Some("async functions")
+    } else if sig.unsafety.is_some() {
+        Some("unsafe functions")
+    } else if sig.abi.is_some() {
+        Some("functions that already declare an ABI")
+    } else if sig.variadic.is_some() {
+        Some("variadic functions")
+    } else if sig
+        .generics
+        .params
+        .iter()
+        .any(|param| !matches!(param, GenericParam::Lifetime(_)))
+    {
+        Some("generic functions")
+    } else {
+        None
+    };
+    match unsupported {
+        Some(what) => Err(syn::Error::new(
+            sig.span(),
+            format!("cimpl::export does not support {what}"),
+        )),
+        None => Ok(()),
+    }
+}
+
+fn expand(options: Options, function: ItemFn) -> syn::Result<TokenStream2> {
+    check_signature(&function)?;
+
+    let rust_ret = match &function.sig.output {
+        ReturnType::Default => syn::parse_quote!(()),
+        ReturnType::Type(_, ty) => (**ty).clone(),
+    };
+    let (ok_ty, fallible) = unwrap_result(&rust_ret);
+    let value = classify_value(ok_ty)?;
+
+    let mut inputs = Vec::new();
+    for input in &function.sig.inputs {
+        let FnArg::Typed(typed) = input else {
+            return Err(syn::Error::new(
+                input.span(),
+                "cimpl::export works on free functions; `self` is not supported",
+            ));
+        };
+        let Pat::Ident(pat) = &*typed.pat else {
+            return Err(syn::Error::new(
+                typed.pat.span(),
+                "cimpl::export needs a plain name for each parameter",
+            ));
+        };
+        let name = pat.ident.clone();
+        if options.out && name == "out" {
+            return Err(syn::Error::new(
+                name.span(),
+                "cimpl::export(out) adds a parameter named `out`; rename this one",
+            ));
+        }
+        inputs.push((name, &*typed.ty, classify_param(&typed.ty)?));
+    }
+    let can_fail = fallible || inputs.iter().any(|(_, _, param)| param.validated());
+
+    // The C return type and error value of the main wrapper
+    let (c_ret, err) = if options.out {
+        if matches!(value, Value::Unit) {
+            return Err(syn::Error::new(
+                rust_ret.span(),
+                "cimpl::export(out) needs a return value to write",
+            ));
+        }
+        (Some(quote!(i32)), quote!(-1))
+    } else if fallible && matches!(value, Value::Unit) {
+        (Some(quote!(i32)), quote!(-1))
+    } else if can_fail && matches!(value, Value::Prim(Prim::Unsigned | Prim::Bool, _)) {
+        // 0 and false are also success values, so C could not see the error
+        return Err(syn::Error::new(
+            rust_ret.span(),
+            "cimpl::export: an unsigned or bool return has no distinct error value \
+             when the call or a parameter check can fail; use cimpl::export(out) \
+             or a signed return type",
+        ));
+    } else {
+        (value.c_type(), value.sentinel())
+    };
+
+    let mut params = Vec::new();
+    let mut c_params = Vec::new();
+    let mut conversions = Vec::new();
+    let mut args = Vec::new();
+    for (name, ty, param) in inputs {
+        let (c_param, conversion) = convert_param(&param, &name, ty, &err, options.trusted);
+        c_params.push(c_param);
+        conversions.push(conversion);
+        args.push(name);
+        params.push(param);
+    }
+
+    let vis_attrs: Vec<_> = function
+        .attrs
+        .iter()
+        .filter(|attr| attr.path().is_ident("doc") || attr.path().is_ident("cfg"))
+        .collect();
+    let cfg_attrs: Vec<_> = function
+        .attrs
+        .iter()
+        .filter(|attr| attr.path().is_ident("cfg"))
+        .collect();
+
+    // The Rust function the wrapper calls
+    let (extern_name, inner_name, inner) = match &options.name {
+        Some(name) => {
+            let extern_name = Ident::new(&name.value(), name.span());
+            let inner_name = function.sig.ident.clone();
+            (extern_name, inner_name, quote!(#function))
+        }
+        None => {
+            let extern_name = function.sig.ident.clone();
+            let inner_name = format_ident!("__cimpl_export_{}", extern_name);
+            let mut inner = function.clone();
+            inner.sig.ident = inner_name.clone();
+            inner.vis = syn::Visibility::Inherited;
+            inner.attrs.retain(|attr| !attr.path().is_ident("doc"));
+            (extern_name, inner_name, quote!(#[doc(hidden)] #inner))
+        }
+    };
+
+    let value_ident = format_ident!("value");
+    let call = quote!(#inner_name(#(#args),*));
+    let call = if fallible {
+        quote!(::cimpl::ok_or_return!(#call, |value| value, #err))
+    } else {
+        call
+    };
+    let converted = value.convert(&value_ident, options.shared);
+    let tail = if options.out {
+        let out_ty = value.c_type();
+        c_params.push(quote!(out: *mut #out_ty));
+        quote! {
+            let #value_ident = #call;
+            ::cimpl::write_out_or_return!(out, #converted, -1);
+            0
+        }
+    } else if matches!(value, Value::Unit) {
+        let status = fallible.then(|| quote!(0));
+        quote! {
+            #call;
+            #status
+        }
+    } else {
+        quote! {
+            let #value_ident = #call;
+            #converted
+        }
+    };
+    let ret_arrow = c_ret.as_ref().map(|ty| quote!(-> #ty));
+
+    let wrapper = quote! {
+        #(#vis_attrs)*
+        #[no_mangle]
+        #[allow(clippy::not_unsafe_ptr_arg_deref)]
+        pub extern "C" fn #extern_name(#(#c_params),*) #ret_arrow {
+            #(#conversions)*
+            #tail
+        }
+    };
+
+    let batch = if options.batch {
+        expand_batch(
+            &extern_name,
+            &inner_name,
+            &params,
+            &value,
+            fallible,
+            &cfg_attrs,
+            &function,
+        )?
+    } else {
+        quote!()
+    };
+
+    Ok(quote! {
+        #inner
+        #wrapper
+        #batch
+    })
+}
+
+/// The `<name>_batch` wrapper over packed strings
+fn expand_batch(
+    extern_name: &Ident,
+    inner_name: &Ident,
+    params: &[Param],
+    value: &Value,
+    fallible: bool,
+    cfg_attrs: &[&syn::Attribute],
+    function: &ItemFn,
+) -> syn::Result<TokenStream2> {
+    let batch_name = format_ident!("{}_batch", extern_name);
+    let closure = match params {
+        [Param::Str] => quote!(|item: &str| #inner_name(item)),
+        [Param::String] => quote!(|item: &str| #inner_name(item.to_owned())),
+        _ => {
+            return Err(syn::Error::new(
+                function.sig.inputs.span(),
+                "cimpl::export(batch) needs exactly one &str or String parameter",
+            ))
+        }
+    };
+    let doc = format!(" Batch form of `{extern_name}()` over packed strings");
+    let packed = quote!(offsets: *const i64, data: *const u8, data_len: usize, count: usize);
+    let body = match (value, fallible) {
+        (Value::String, false) => quote! {
+            pub extern "C" fn #batch_name(#packed) -> *mut ::cimpl::CimplBatch {
+                ::cimpl::batch_strings_or_return_null!(offsets, data, data_len, count, #closure)
+            }
+        },
+        (Value::String, true) => quote! {
+            pub extern "C" fn #batch_name(#packed, codes: *mut i32) -> *mut ::cimpl::CimplBatch {
+                ::cimpl::batch_try_strings_or_return_null!(
+                    offsets, data, data_len, count, codes, #closure
+                )
+            }
+        },
+        (Value::Prim(_, ty), false) => quote! {
+            pub extern "C" fn #batch_name(#packed, out: *mut #ty) -> i32 {
+                ::cimpl::batch_values_or_return_neg!(offsets, data, data_len, count, out, #closure);
+                0
+            }
+        },
+        (Value::Prim(_, ty), true) => quote! {
+            pub extern "C" fn #batch_name(#packed, out: *mut #ty, codes: *mut i32) -> isize {
+                ::cimpl::batch_try_values_or_return_neg!(
+                    offsets, data, data_len, count, out, codes, #closure
+                ) as isize
+            }
+        },
+        _ => {
+            return Err(syn::Error::new(
+                function.sig.output.span(),
+                "cimpl::export(batch) needs a String or primitive return type",
+            ))
+        }
+    };
+    Ok(quote! {
+        #(#cfg_attrs)*
+        #[doc = #doc]
+        #[no_mangle]
+        #[allow(clippy::not_unsafe_ptr_arg_deref)]
+        #body
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use syn::parse_quote;
+
+    use super::*;
+
+    #[test]
+    fn test_param_classification() {
+        let cases: [(Type, Param); 7] = [
+            (parse_quote!(&str), Param::Str),
+            (parse_quote!(&'a str), Param::Str),
+            (parse_quote!(String), Param::String),
+            (parse_quote!(Option<&str>), Param::OptStr),
+            (parse_quote!(Option<String>), Param::OptString),
+            (parse_quote!(&[u8]), Param::Bytes),
+            (parse_quote!(u32), Param::Value),
+        ];
+        for (ty, expected) in cases {
+            assert_eq!(classify_param(&ty).unwrap(), expected);
+        }
+        let param = |ty: Type| classify_param(&ty).unwrap();
+        assert_eq!(
+            param(parse_quote!(&mut Secret)),
+            Param::RefMut(parse_quote!(Secret))
+        );
+        assert_eq!(
+            param(parse_quote!(&Secret)),
+            Param::Ref(parse_quote!(Secret))
+        );
+        assert_eq!(
+            param(parse_quote!(Option<&Secret>)),
+            Param::OptRef(parse_quote!(Secret))
+        );
+        assert_eq!(
+            param(parse_quote!(Option<&mut Secret>)),
+            Param::OptRefMut(parse_quote!(Secret))
+        );
+        assert_eq!(param(parse_quote!(*const Secret)), Param::Value);
+        assert_eq!(
+            param(parse_quote!(Option<extern "C" fn(u32)>)),
+            Param::Value
+        );
+        for ty in [
+            parse_quote!(Box<Secret>),
+            parse_quote!(Vec<u8>),
+            parse_quote!(Option<Box<Secret>>),
+            parse_quote!(Option<&[u8]>),
+            parse_quote!(&[u32]),
+            parse_quote!((u8, u8)),
+        ] {
+            assert!(classify_param(&ty).is_err());
+        }
+    }
+
+    #[test]
+    fn test_option_ref_expansion() {
+        let expanded = expand(
+            Options::default(),
+            parse_quote!(
+                fn peek(secret: Option<&Secret>) -> i64 {
+                    0
+                }
+            ),
+        )
+        .unwrap()
+        .to_string();
+        assert!(expanded.contains("secret : * mut Secret"));
+        assert!(expanded.contains("if secret . is_null () { None }"));
+        assert!(expanded.contains(":: cimpl :: deref_or_return ! (secret , Secret , - 1)"));
+
+        let expanded = expand(
+            Options::default(),
+            parse_quote!(
+                fn poke(secret: Option<&mut Secret>) -> i64 {
+                    0
+                }
+            ),
+        )
+        .unwrap()
+        .to_string();
+        assert!(expanded.contains(":: cimpl :: deref_mut_or_return ! (secret , Secret , - 1)"));
+
+        let boxed = expand(
+            Options::default(),
+            parse_quote!(
+                fn take(secret: Box<Secret>) -> i64 {
+                    0
+                }
+            ),
+        );
+        assert!(boxed.is_err());
+    }
+
+    #[test]
+    fn test_return_classification() {
+        let value = |ty: Type| classify_value(unwrap_result(&ty).0).unwrap();
+        assert_eq!(value(parse_quote!(())), Value::Unit);
+        assert_eq!(value(parse_quote!(String)), Value::String);
+        assert_eq!(value(parse_quote!(Result<String, MyError>)), Value::String);
+        assert_eq!(value(parse_quote!(Option<String>)), Value::OptString);
+        assert_eq!(
+            value(parse_quote!(Option<Secret>)),
+            Value::OptBoxed(parse_quote!(Secret))
+        );
+        assert!(matches!(
+            value(parse_quote!(cimpl::Result<usize>)),
+            Value::Prim(Prim::Unsigned, _)
+        ));
+        assert!(classify_value(&parse_quote!(&str)).is_err());
+
+        assert_eq!(value(parse_quote!(i64)).sentinel().to_string(), "- 1");
+        assert_eq!(value(parse_quote!(u64)).sentinel().to_string(), "0");
+        assert_eq!(value(parse_quote!(bool)).sentinel().to_string(), "false");
+    }
+
+    #[test]
+    fn test_unsupported_signatures() {
+        let expand_str = |function: ItemFn| expand(Options::default(), function).map(|_| ());
+        assert!(expand_str(parse_quote!(
+            fn f<T>(t: T) {}
+        ))
+        .is_err());
+        assert!(expand_str(parse_quote!(
+            fn f(s: &str) -> Result<u32, E> {}
+        ))
+        .is_err());
+        // A parameter check can fail too, and 0 / false would hide it
+        assert!(expand_str(parse_quote!(
+            fn f(s: &str) -> usize {}
+        ))
+        .is_err());
+        assert!(expand_str(parse_quote!(
+            fn f(counter: &Counter) -> bool {}
+        ))
+        .is_err());
+        assert!(expand_str(parse_quote!(
+            fn f(a: u32, b: u32) -> u32 {}
+        ))
+        .is_ok());
+        assert!(expand(
+            Options {
+                out: true,
+                ..Options::default()
+            },
+            parse_quote!(
+                fn f(s: &str) -> Result<u32, E> {}
+            )
+        )
+        .is_ok());
+        assert!(expand_str(parse_quote!(
+            async fn f() {}
+        ))
+        .is_err());
+        assert!(expand_str(parse_quote!(
+            fn f((a, b): (u8, u8)) {}
+        ))
+        .is_err());
+        assert!(expand_str(parse_quote!(
+            fn f<'a>(text: &'a str) -> i64 {
+                text.len() as i64
+            }
+        ))
+        .is_ok());
+    }
+}
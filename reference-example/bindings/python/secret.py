@@ -54,6 +54,9 @@ lib.secret_remove_vowels.restype = ctypes.c_void_p
 lib.secret_uppercase.argtypes = [ctypes.c_char_p]
 lib.secret_uppercase.restype = ctypes.c_void_p
 
+lib.secret_uppercase_into.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_void_p]
+lib.secret_uppercase_into.restype = ctypes.c_ssize_t
+
 lib.secret_to_hex.argtypes = [ctypes.c_char_p]
 lib.secret_to_hex.restype = ctypes.c_void_p
 
@@ -77,12 +80,75 @@ lib.secret_count_chars.restype = ctypes.c_size_t
 lib.secret_count_vowels.argtypes = [ctypes.c_char_p]
 lib.secret_count_vowels.restype = ctypes.c_size_t
 
+lib.secret_count_vowels_len.argtypes = [ctypes.c_char_p, ctypes.c_size_t]
+lib.secret_count_vowels_len.restype = ctypes.c_size_t
+
 lib.secret_count_consonants.argtypes = [ctypes.c_char_p]
 lib.secret_count_consonants.restype = ctypes.c_size_t
 
 lib.secret_count_words.argtypes = [ctypes.c_char_p]
 lib.secret_count_words.restype = ctypes.c_size_t
 
+# Batched functions: count strings packed as int64 offsets + one data buffer
+class CimplBatch(ctypes.Structure):
+    _fields_ = [
+        ("count", ctypes.c_size_t),
+        ("offsets", ctypes.POINTER(ctypes.c_int64)),
+        ("data", ctypes.c_void_p),
+        ("data_len", ctypes.c_size_t),
+    ]
+
+_BATCH_ARGS = [ctypes.POINTER(ctypes.c_int64), ctypes.c_char_p, ctypes.c_size_t, ctypes.c_size_t]
+
+lib.secret_rot13_batch.argtypes = _BATCH_ARGS
+lib.secret_rot13_batch.restype = ctypes.POINTER(CimplBatch)
+
+lib.secret_from_hex_batch.argtypes = _BATCH_ARGS + [ctypes.POINTER(ctypes.c_int32)]
+lib.secret_from_hex_batch.restype = ctypes.POINTER(CimplBatch)
+
+lib.secret_count_words_batch.argtypes = _BATCH_ARGS + [ctypes.POINTER(ctypes.c_size_t)]
+lib.secret_count_words_batch.restype = ctypes.c_int32
+
+# Arrow C Data Interface structs (filled in by the library, released by us)
+class ArrowSchema(ctypes.Structure):
+    pass
+
+ArrowSchema._fields_ = [
+    ("format", ctypes.c_char_p),
+    ("name", ctypes.c_char_p),
+    ("metadata", ctypes.c_char_p),
+    ("flags", ctypes.c_int64),
+    ("n_children", ctypes.c_int64),
+    ("children", ctypes.POINTER(ctypes.POINTER(ArrowSchema))),
+    ("dictionary", ctypes.POINTER(ArrowSchema)),
+    ("release", ctypes.CFUNCTYPE(None, ctypes.POINTER(ArrowSchema))),
+    ("private_data", ctypes.c_void_p),
+]
+
+class ArrowArray(ctypes.Structure):
+    pass
+
+ArrowArray._fields_ = [
+    ("length", ctypes.c_int64),
+    ("null_count", ctypes.c_int64),
+    ("offset", ctypes.c_int64),
+    ("n_buffers", ctypes.c_int64),
+    ("n_children", ctypes.c_int64),
+    ("buffers", ctypes.POINTER(ctypes.c_void_p)),
+    ("children", ctypes.POINTER(ctypes.POINTER(ArrowArray))),
+    ("dictionary", ctypes.POINTER(ArrowArray)),
+    ("release", ctypes.CFUNCTYPE(None, ctypes.POINTER(ArrowArray))),
+    ("private_data", ctypes.c_void_p),
+]
+
+_ARROW_OUT = [ctypes.POINTER(ArrowArray), ctypes.POINTER(ArrowSchema)]
+
+lib.secret_split_words_arrow.argtypes = [ctypes.c_char_p] + _ARROW_OUT
+lib.secret_split_words_arrow.restype = ctypes.c_int32
+
+lib.secret_rot13_arrow.argtypes = _ARROW_OUT + _ARROW_OUT
+lib.secret_rot13_arrow.restype = ctypes.c_int32
+
 # Error handling
 lib.secret_error_code.argtypes = []
 lib.secret_error_code.restype = ctypes.c_int32
@@ -93,6 +159,13 @@ lib.secret_last_error.restype = ctypes.c_void_p
 lib.secret_clear_error.argtypes = []
 lib.secret_clear_error.restype = None
 
+lib.cimpl_last_error_view.argtypes = [
+    ctypes.POINTER(ctypes.c_char_p),
+    ctypes.POINTER(ctypes.c_size_t),
+    ctypes.POINTER(ctypes.c_int32),
+]
+lib.cimpl_last_error_view.restype = ctypes.c_bool
+
 # Memory management
 lib.secret_free.argtypes = [ctypes.c_void_p]
 lib.secret_free.restype = ctypes.c_bool
@@ -103,16 +176,14 @@ lib.secret_free.restype = ctypes.c_bool
 
 def _get_error():
     """Get the last error from the library"""
-    code = lib.secret_error_code()
-    if code == SECRET_ERROR_OK:
+    # Borrow the message in place rather than allocating a copy to free
+    msg = ctypes.c_char_p()
+    length = ctypes.c_size_t()
+    code = ctypes.c_int32()
+    if not lib.cimpl_last_error_view(ctypes.byref(msg), ctypes.byref(length), ctypes.byref(code)):
         return None
-    
-    msg_ptr = lib.secret_last_error()
-    if msg_ptr:
-        msg = ctypes.string_at(msg_ptr).decode('utf-8')
-        lib.secret_free(msg_ptr)
-        return SecretError(code, msg)
-    return SecretError(code, "Unknown error")
+    text = ctypes.string_at(msg, length.value).decode('utf-8', errors='replace')
+    return SecretError(code.value, text)
 
 def _call_string_fn(fn, *args):
     """Call a function that returns a string, handling errors"""
@@ -131,6 +202,41 @@ def _call_string_fn(fn, *args):
     lib.secret_free(result)
     return s
 
+def _call_string_into_fn(fn, text):
+    """Call a function that writes a string into a caller buffer (no free needed)"""
+    data = text.encode('utf-8')
+    buf = ctypes.create_string_buffer(len(data) + 1)
+    needed = fn(data, buf, len(buf), None)
+    if needed < 0:
+        raise _get_error()
+    if needed >= len(buf):
+        # Truncated: retry with the size the function asked for
+        buf = ctypes.create_string_buffer(needed + 1)
+        fn(data, buf, len(buf), None)
+    return buf.value.decode('utf-8')
+
+def _pack(texts):
+    """Pack strings as (offsets, data) for a *_batch function"""
+    encoded = [t.encode('utf-8') for t in texts]
+    offsets = (ctypes.c_int64 * (len(encoded) + 1))()
+    for i, item in enumerate(encoded):
+        offsets[i + 1] = offsets[i] + len(item)
+    return offsets, b''.join(encoded)
+
+def _call_batch_fn(fn, texts, *extra):
+    """Call a *_batch function that returns packed strings (one free for all)"""
+    offsets, data = _pack(texts)
+    result = fn(offsets, data, len(data), len(texts), *extra)
+    if not result:
+        raise _get_error()
+    batch = result.contents
+    try:
+        data = ctypes.string_at(batch.data, batch.data_len) if batch.data_len else b''
+        ends = batch.offsets
+        return [data[ends[i]:ends[i + 1]].decode('utf-8') for i in range(batch.count)]
+    finally:
+        lib.secret_free(result)
+
 # ============================================================================
 # Public API
 # ============================================================================
@@ -149,7 +255,7 @@ def remove_vowels(text: str) -> str:
 
 def uppercase(text: str) -> str:
     """Convert text to uppercase"""
-    return _call_string_fn(lib.secret_uppercase, text)
+    return _call_string_into_fn(lib.secret_uppercase_into, text)
 
 def to_hex(text: str) -> str:
     """Encode string to hex"""
@@ -182,7 +288,8 @@ def count_chars(text: str) -> int:
 
 def count_vowels(text: str) -> int:
     """Count vowels in string"""
-    return lib.secret_count_vowels(text.encode('utf-8'))
+    data = text.encode('utf-8')
+    return lib.secret_count_vowels_len(data, len(data))
 
 def count_consonants(text: str) -> int:
     """Count consonants in string"""
@@ -191,3 +298,54 @@ def count_consonants(text: str) -> int:
 def count_words(text: str) -> int:
     """Count words in string"""
     return lib.secret_count_words(text.encode('utf-8'))
+
+def rot13_batch(texts) -> list:
+    """Encode a list of strings with ROT13 in one call"""
+    return _call_batch_fn(lib.secret_rot13_batch, texts)
+
+def count_words_batch(texts) -> list:
+    """Count words in each of a list of strings in one call"""
+    offsets, data = _pack(texts)
+    out = (ctypes.c_size_t * len(texts))()
+    if lib.secret_count_words_batch(offsets, data, len(data), len(texts), out) != 0:
+        raise _get_error()
+    return list(out)
+
+def from_hex_batch(hex_strs) -> list:
+    """Decode a list of hex strings in one call
+
+    Items that fail to decode are returned as SecretError instances.
+    """
+    codes = (ctypes.c_int32 * len(hex_strs))()
+    decoded = _call_batch_fn(lib.secret_from_hex_batch, hex_strs, codes)
+    return [text if code == 0 else SecretError(code, f"item {i} failed")
+            for i, (text, code) in enumerate(zip(decoded, codes))]
+
+def split_words_arrow_raw(text: str):
+    """Split text into words as raw (ArrowArray, ArrowSchema) structs
+
+    The caller owns the structs and must call their release callbacks.
+    """
+    array, schema = ArrowArray(), ArrowSchema()
+    if lib.secret_split_words_arrow(text.encode('utf-8'), array, schema) != 0:
+        raise _get_error()
+    return array, schema
+
+def split_words_arrow(text: str):
+    """Split text into a pyarrow RecordBatch with word and length columns
+
+    The columns are imported zero-copy; pyarrow releases them when done.
+    """
+    import pyarrow as pa
+    array, schema = split_words_arrow_raw(text)
+    return pa.RecordBatch._import_from_c(ctypes.addressof(array), ctypes.addressof(schema))
+
+def rot13_arrow(column):
+    """ROT13-encode a pyarrow string array, returning a new pyarrow array"""
+    import pyarrow as pa
+    in_array, in_schema = ArrowArray(), ArrowSchema()
+    column._export_to_c(ctypes.addressof(in_array), ctypes.addressof(in_schema))
+    out_array, out_schema = ArrowArray(), ArrowSchema()
+    if lib.secret_rot13_arrow(in_array, in_schema, out_array, out_schema) != 0:
+        raise _get_error()
+    return pa.Array._import_from_c(ctypes.addressof(out_array), ctypes.addressof(out_schema))
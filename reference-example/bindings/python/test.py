@@ -3,6 +3,7 @@
 Test script for secret message processor Python bindings
 """
 
+import ctypes
 import secret
 
 def test_encoding():
@@ -111,6 +112,69 @@ def test_counting():
     
     print("✓ All counting tests passed\n")
 
+def test_batch():
+    print("=== Testing Batched Functions ===")
+    
+    texts = ["Hello", "", "Hello World", "héllo wörld"]
+    
+    encoded = secret.rot13_batch(texts)
+    print(f"rot13_batch({texts}) = {encoded}")
+    assert encoded == [secret.rot13(t) for t in texts]
+    assert secret.rot13_batch([]) == []
+    
+    words = secret.count_words_batch(texts)
+    print(f"count_words_batch({texts}) = {words}")
+    assert words == [1, 0, 2, 2]
+    
+    decoded = secret.from_hex_batch(["48656c6c6f", "xyz", "4869"])
+    print(f"from_hex_batch(...) = {decoded}")
+    assert decoded[0] == "Hello" and decoded[2] == "Hi"
+    assert isinstance(decoded[1], secret.SecretError)
+    assert decoded[1].code == secret.SECRET_ERROR_INVALID_HEX
+    
+    print("✓ All batch tests passed\n")
+
+def _arrow_strings(array):
+    """Read a large_utf8 ArrowArray with ctypes (for when pyarrow is missing)"""
+    offsets = ctypes.cast(array.buffers[1], ctypes.POINTER(ctypes.c_int64))
+    data = array.buffers[2]
+    return [ctypes.string_at(data + offsets[i], offsets[i + 1] - offsets[i]).decode('utf-8')
+            for i in range(array.length)]
+
+def test_arrow():
+    print("=== Testing Arrow Columns ===")
+    
+    array, schema = secret.split_words_arrow_raw("hello arrow world")
+    assert (array.length, array.n_children, schema.format) == (3, 2, b"+s")
+    words = array.children[0].contents
+    assert schema.children[0].contents.name == b"word"
+    assert _arrow_strings(words) == ["hello", "arrow", "world"]
+    lengths = ctypes.cast(array.children[1].contents.buffers[1], ctypes.POINTER(ctypes.c_uint64))
+    assert lengths[:3] == [5, 5, 5]
+    
+    # Hand the word column back: the library takes it over and releases it
+    out_array, out_schema = secret.ArrowArray(), secret.ArrowSchema()
+    child_array, child_schema = array.children[0], schema.children[0]
+    assert secret.lib.secret_rot13_arrow(child_array, child_schema, out_array, out_schema) == 0
+    assert not child_array.contents.release
+    assert _arrow_strings(out_array) == ["uryyb", "neebj", "jbeyq"]
+    print(f"rot13_arrow(split_words_arrow(...).word) = {_arrow_strings(out_array)}")
+    
+    for struct in (out_array, out_schema, array, schema):
+        struct.release(ctypes.byref(struct))
+        assert not struct.release
+    
+    try:
+        import pyarrow  # noqa: F401
+    except ImportError:
+        print("(pyarrow not installed; skipping pyarrow import)")
+    else:
+        batch = secret.split_words_arrow("hello arrow world")
+        assert batch.column(0).to_pylist() == ["hello", "arrow", "world"]
+        assert secret.rot13_arrow(batch.column(0)).to_pylist() == ["uryyb", "neebj", "jbeyq"]
+    
+    print("✓ All arrow tests passed\n")
+
 def main():
     print("Testing Secret Message Processor Python Bindings")
     print("=" * 50)
@@ -120,6 +184,8 @@ def main():
     test_hex()
     test_validation()
     test_counting()
+    test_batch()
+    test_arrow()
     
     print("=" * 50)
     print("✅ All tests passed!")
@@ -27,12 +27,17 @@
 
 use std::collections::HashMap;
 use std::os::raw::c_char;
+use std::sync::RwLock;
 
 use cimpl::{
-    box_tracked, cimpl_free, cstr_or_return_null,
-    deref_or_return_null, ok_or_return_false, ok_or_return_null, 
-    option_to_c_string, to_c_bytes, to_c_string, 
-    CimplError,
+    arc_tracked, arrow_export_or_return_neg, arrow_import_or_return,
+    batch_strings_or_return_null, batch_try_strings_or_return_null,
+    batch_values_or_return_neg, box_pooled, bytes_view_or_return_null, cimpl_free,
+    cstr_borrow_or_return_null, cstr_or_return_null,
+    deref_or_return_neg, deref_or_return_null, impl_pooled, ok_or_return_false,
+    ok_or_return_int, ok_or_return_null, option_to_c_string, to_c_bytes, to_c_string,
+    write_c_string_into, write_out_or_return_int, ArrowArray, ArrowColumn, ArrowSchema,
+    CimplBatch, CimplBytesView, CimplError,
 };
 
 // ============================================================================
@@ -91,10 +96,13 @@ impl From<ProcessError> for CimplError {
 // ============================================================================
 
 /// A secret message with metadata
+///
+/// Shared (`arc_tracked!`) so views and retained references can outlive C's
+/// pointer; only `metadata` changes after creation, behind a lock.
 pub struct SecretMessage {
     content: String,
     encoding: String,
-    metadata: HashMap<String, String>,
+    metadata: RwLock<HashMap<String, String>>,
 }
 
 /// Statistics about a message
@@ -106,6 +114,20 @@ pub struct MessageStats {
     pub consonant_count: usize,
 }
 
+// Returned on every message_get_stats() call, so recycle the allocations
+impl_pooled!(MessageStats);
+
+impl MessageStats {
+    fn of(content: &str) -> Self {
+        Self {
+            length: content.len(),
+            word_count: count_words(content),
+            vowel_count: count_vowels(content),
+            consonant_count: count_consonants(content),
+        }
+    }
+}
+
 // ============================================================================
 // Core Encoding/Decoding Logic (Pure Rust)
 // ============================================================================
@@ -197,66 +219,94 @@ fn count_words(input: &str) -> usize {
 // ============================================================================
 
 /// Encodes text using ROT13 cipher
-/// Tests: cstr_or_return_null!, to_c_string!
+/// Tests: cstr_borrow_or_return_null!, to_c_string!
 #[no_mangle]
 pub extern "C" fn secret_rot13(input: *const c_char) -> *mut c_char {
-    let text = cstr_or_return_null!(input);
+    let text = cstr_borrow_or_return_null!(input);
     to_c_string(rot13(&text))
 }
 
 /// Reverses the input string
-/// Tests: cstr_or_return_null!, to_c_string!
+/// Tests: cstr_borrow_or_return_null!, to_c_string!
 #[no_mangle]
 pub extern "C" fn secret_reverse(input: *const c_char) -> *mut c_char {
-    let text = cstr_or_return_null!(input);
+    let text = cstr_borrow_or_return_null!(input);
     to_c_string(text.chars().rev().collect::<String>())
 }
 
 /// Removes all vowels from text
-/// Tests: cstr_or_return_null!, to_c_string!
+/// Tests: cstr_borrow_or_return_null!, to_c_string!
 #[no_mangle]
 pub extern "C" fn secret_remove_vowels(input: *const c_char) -> *mut c_char {
-    let text = cstr_or_return_null!(input);
+    let text = cstr_borrow_or_return_null!(input);
     to_c_string(remove_vowels(&text))
 }
 
 /// Substitutes one character for another
-/// Tests: cstr_or_return_null!, to_c_string!
+/// Tests: cstr_borrow_or_return_null!, to_c_string!
 #[no_mangle]
 pub extern "C" fn secret_substitute(
     input: *const c_char,
     from: c_char,
     to: c_char,
 ) -> *mut c_char {
-    let text = cstr_or_return_null!(input);
+    let text = cstr_borrow_or_return_null!(input);
     to_c_string(substitute(&text, from as u8 as char, to as u8 as char))
 }
 
 /// Converts text to uppercase
-/// Tests: cstr_or_return_null!, to_c_string!
+/// Tests: cstr_borrow_or_return_null!, to_c_string!
 #[no_mangle]
 pub extern "C" fn secret_uppercase(input: *const c_char) -> *mut c_char {
-    let text = cstr_or_return_null!(input);
+    let text = cstr_borrow_or_return_null!(input);
     to_c_string(text.to_uppercase())
 }
 
+/// Converts text to uppercase, writing into a caller-provided buffer
+/// Returns the full result length (>= cap means truncated), or -1 on error
+/// Tests: cstr_borrow_or_return!, write_c_string_into (no allocation for ASCII)
+#[no_mangle]
+pub extern "C" fn secret_uppercase_into(
+    input: *const c_char,
+    buf: *mut c_char,
+    cap: usize,
+    out_len: *mut usize,
+) -> isize {
+    use cimpl::cstr_borrow_or_return;
+    let text = cstr_borrow_or_return!(input, -1);
+    if !text.is_ascii() {
+        return unsafe { write_c_string_into(&text.to_uppercase(), buf, cap, out_len) };
+    }
+
+    // ASCII uppercasing keeps the length, so convert in place in the buffer
+    let mut written = 0;
+    let len = unsafe { write_c_string_into(&text, buf, cap, &mut written) };
+    if len >= 0 && written > 0 {
+        unsafe { std::slice::from_raw_parts_mut(buf as *mut u8, written) }.make_ascii_uppercase();
+    }
+    if len >= 0 && !out_len.is_null() {
+        unsafe { *out_len = written; }
+    }
+    len
+}
+
 // ============================================================================
 // FFI Functions: String In → String Out (with Result/Error)
 // ============================================================================
 
 /// Encodes string to hex
-/// Tests: cstr_or_return_null!, to_c_string!
+/// Tests: cstr_borrow_or_return_null!, to_c_string!
 #[no_mangle]
 pub extern "C" fn secret_to_hex(input: *const c_char) -> *mut c_char {
-    let text = cstr_or_return_null!(input);
+    let text = cstr_borrow_or_return_null!(input);
     to_c_string(to_hex(&text))
 }
 
 /// Decodes hex string to text (can fail!)
-/// Tests: cstr_or_return_null!, ok_or_return_null! with automatic From conversion
+/// Tests: cstr_borrow_or_return_null!, ok_or_return_null! with automatic From conversion
 #[no_mangle]
 pub extern "C" fn secret_from_hex(hex: *const c_char) -> *mut c_char {
-    let hex_str = cstr_or_return_null!(hex);
+    let hex_str = cstr_borrow_or_return_null!(hex);
     let decoded = ok_or_return_null!(from_hex(&hex_str));
     to_c_string(decoded)
 }
@@ -266,34 +316,34 @@ pub extern "C" fn secret_from_hex(hex: *const c_char) -> *mut c_char {
 // ============================================================================
 
 /// Validates that message length is within bounds
-/// Tests: cstr_or_return! with false, ok_or_return_false! with SecretError
+/// Tests: cstr_borrow_or_return! with false, ok_or_return_false! with SecretError
 #[no_mangle]
 pub extern "C" fn secret_validate_length(
     input: *const c_char,
     min_len: usize,
     max_len: usize,
 ) -> bool {
-    use cimpl::cstr_or_return;
-    let text = cstr_or_return!(input, false);
+    use cimpl::cstr_borrow_or_return;
+    let text = cstr_borrow_or_return!(input, false);
     ok_or_return_false!(validate_length(&text, min_len, max_len));
     true
 }
 
 /// Checks if text contains only ASCII characters
-/// Tests: cstr_or_return! with false, simple validation
+/// Tests: cstr_borrow_or_return! with false, simple validation
 #[no_mangle]
 pub extern "C" fn secret_is_ascii(input: *const c_char) -> bool {
-    use cimpl::cstr_or_return;
-    let text = cstr_or_return!(input, false);
+    use cimpl::cstr_borrow_or_return;
+    let text = cstr_borrow_or_return!(input, false);
     text.is_ascii()
 }
 
 /// Checks if text is valid hex
-/// Tests: cstr_or_return! with false, validation logic
+/// Tests: cstr_borrow_or_return! with false, validation logic
 #[no_mangle]
 pub extern "C" fn secret_is_valid_hex(input: *const c_char) -> bool {
-    use cimpl::cstr_or_return;
-    let text = cstr_or_return!(input, false);
+    use cimpl::cstr_borrow_or_return;
+    let text = cstr_borrow_or_return!(input, false);
     text.len() % 2 == 0 && text.chars().all(|c| c.is_ascii_hexdigit())
 }
 
@@ -302,50 +352,155 @@ pub extern "C" fn secret_is_valid_hex(input: *const c_char) -> bool {
 // ============================================================================
 
 /// Counts characters in string
-/// Tests: cstr_or_return! with 0 on error
+/// Tests: cstr_borrow_or_return! with 0 on error
 #[no_mangle]
 pub extern "C" fn secret_count_chars(input: *const c_char) -> usize {
-    use cimpl::cstr_or_return;
-    let text = cstr_or_return!(input, 0);
+    use cimpl::cstr_borrow_or_return;
+    let text = cstr_borrow_or_return!(input, 0);
     text.chars().count()
 }
 
 /// Counts vowels in string
-/// Tests: cstr_or_return! with 0 on error
+/// Tests: cstr_borrow_or_return! with 0 on error
 #[no_mangle]
 pub extern "C" fn secret_count_vowels(input: *const c_char) -> usize {
-    use cimpl::cstr_or_return;
-    let text = cstr_or_return!(input, 0);
+    use cimpl::cstr_borrow_or_return;
+    let text = cstr_borrow_or_return!(input, 0);
+    count_vowels(&text)
+}
+
+/// Counts vowels in a string of known length (need not be nul-terminated)
+/// Tests: cstr_borrow_len_or_return! with 0 on error
+#[no_mangle]
+pub extern "C" fn secret_count_vowels_len(input: *const c_char, len: usize) -> usize {
+    use cimpl::cstr_borrow_len_or_return;
+    let text = cstr_borrow_len_or_return!(input, len, 0);
     count_vowels(&text)
 }
 
 /// Counts consonants in string
-/// Tests: cstr_or_return! with 0 on error
+/// Tests: cstr_borrow_or_return! with 0 on error
 #[no_mangle]
 pub extern "C" fn secret_count_consonants(input: *const c_char) -> usize {
-    use cimpl::cstr_or_return;
-    let text = cstr_or_return!(input, 0);
+    use cimpl::cstr_borrow_or_return;
+    let text = cstr_borrow_or_return!(input, 0);
     count_consonants(&text)
 }
 
 /// Counts words in string
-/// Tests: cstr_or_return! with 0 on error
+/// Tests: cstr_borrow_or_return! with 0 on error
 #[no_mangle]
 pub extern "C" fn secret_count_words(input: *const c_char) -> usize {
-    use cimpl::cstr_or_return;
-    let text = cstr_or_return!(input, 0);
+    use cimpl::cstr_borrow_or_return;
+    let text = cstr_borrow_or_return!(input, 0);
     count_words(&text)
 }
 
+// ============================================================================
+// FFI Functions: Batched Calls
+// ============================================================================
+
+/// Encodes `count` packed strings with ROT13 in one call
+/// String `i` is `data[offsets[i]..offsets[i + 1]]`; the result uses the same
+/// layout and is a single allocation freed with one `secret_free()`
+/// Tests: batch_strings_or_return_null!
+#[no_mangle]
+pub extern "C" fn secret_rot13_batch(
+    offsets: *const i64,
+    data: *const u8,
+    data_len: usize,
+    count: usize,
+) -> *mut CimplBatch {
+    batch_strings_or_return_null!(offsets, data, data_len, count, rot13)
+}
+
+/// Decodes `count` packed hex strings in one call
+/// `codes[i]` is set to 0, or to the error code if string `i` is not valid hex
+/// (its result is then empty); the first failure is also the last error
+/// Tests: batch_try_strings_or_return_null! (per-item error codes)
+#[no_mangle]
+pub extern "C" fn secret_from_hex_batch(
+    offsets: *const i64,
+    data: *const u8,
+    data_len: usize,
+    count: usize,
+    codes: *mut i32,
+) -> *mut CimplBatch {
+    batch_try_strings_or_return_null!(offsets, data, data_len, count, codes, from_hex)
+}
+
+/// Counts the words in each of `count` packed strings, writing them to `out`
+/// Returns 0 on success, -1 on error
+/// Tests: batch_values_or_return_neg! (no allocation)
+#[no_mangle]
+pub extern "C" fn secret_count_words_batch(
+    offsets: *const i64,
+    data: *const u8,
+    data_len: usize,
+    count: usize,
+    out: *mut usize,
+) -> i32 {
+    batch_values_or_return_neg!(offsets, data, data_len, count, out, count_words);
+    0
+}
+
+// ============================================================================
+// FFI Functions: Arrow Columns
+// ============================================================================
+
+/// Splits text into words, exported as an Arrow struct column (a record
+/// batch) with `word` and `length` fields
+/// Returns 0 on success, -1 on error; the caller releases the structs
+/// Tests: arrow_export_or_return_neg!
+#[no_mangle]
+pub extern "C" fn secret_split_words_arrow(
+    input: *const c_char,
+    out_array: *mut ArrowArray,
+    out_schema: *mut ArrowSchema,
+) -> i32 {
+    use cimpl::cstr_borrow_or_return;
+    let text = cstr_borrow_or_return!(input, -1);
+    let words: Vec<&str> = text.split_whitespace().collect();
+    let lengths = words.iter().map(|w| w.chars().count() as u64).collect();
+    let batch = ok_or_return_int!(ArrowColumn::struct_of(vec![
+        ("word", ArrowColumn::strings(&words)),
+        ("length", ArrowColumn::primitive::<u64>(lengths)),
+    ]));
+    arrow_export_or_return_neg!(batch, out_array, out_schema);
+    0
+}
+
+/// Encodes an Arrow string column with ROT13 into a new column
+/// The input column is taken over (and released) by this call
+/// Returns 0 on success, -1 on error
+/// Tests: arrow_import_or_return!, arrow_export_or_return_neg!
+#[no_mangle]
+pub extern "C" fn secret_rot13_arrow(
+    in_array: *mut ArrowArray,
+    in_schema: *mut ArrowSchema,
+    out_array: *mut ArrowArray,
+    out_schema: *mut ArrowSchema,
+) -> i32 {
+    let column = arrow_import_or_return!(in_array, in_schema, -1);
+    let input = column.view();
+    let mut encoded = Vec::with_capacity(input.len());
+    for index in 0..input.len() {
+        let text = ok_or_return_int!(input.string(index));
+        encoded.push(text.map(|t| rot13(&t)));
+    }
+    arrow_export_or_return_neg!(ArrowColumn::string_options(encoded), out_array, out_schema);
+    0
+}
+
 // ============================================================================
 // FFI Functions: Byte Array Operations
 // ============================================================================
 
 /// Converts string to byte array
-/// Tests: cstr_or_return_null!, to_c_bytes!, returning length via out parameter
+/// Tests: cstr_borrow_or_return_null!, to_c_bytes!, returning length via out parameter
 #[no_mangle]
 pub extern "C" fn secret_to_bytes(input: *const c_char, out_len: *mut usize) -> *const u8 {
-    let text = cstr_or_return_null!(input);
+    let text = cstr_borrow_or_return_null!(input);
     let bytes = text.as_bytes().to_vec();
     
     // Set output length if pointer provided
@@ -378,7 +533,7 @@ pub extern "C" fn secret_from_bytes(data: *const u8, len: usize) -> *mut c_char
 // ============================================================================
 
 /// Creates a new secret message
-/// Tests: cstr_or_return_null!, box_tracked!
+/// Tests: cstr_or_return_null!, arc_tracked!
 #[no_mangle]
 pub extern "C" fn message_new(content: *const c_char, encoding: *const c_char) -> *mut SecretMessage {
     let content_str = cstr_or_return_null!(content);
@@ -387,10 +542,11 @@ pub extern "C" fn message_new(content: *const c_char, encoding: *const c_char) -
     let msg = SecretMessage {
         content: content_str,
         encoding: encoding_str,
-        metadata: HashMap::new(),
+        metadata: RwLock::new(HashMap::new()),
     };
     
-    box_tracked!(msg)
+    // Shared, so content views can keep the message alive
+    arc_tracked!(msg)
 }
 
 /// Gets the content of a message
@@ -401,6 +557,14 @@ pub extern "C" fn message_get_content(msg: *mut SecretMessage) -> *mut c_char {
     to_c_string(message.content.clone())
 }
 
+/// Gets a zero-copy view of the message content
+/// The view stays valid after the message is freed; free it with secret_free()
+/// Tests: bytes_view_or_return_null!, CimplBytesView
+#[no_mangle]
+pub extern "C" fn message_content_view(msg: *mut SecretMessage) -> *mut CimplBytesView {
+    bytes_view_or_return_null!(msg, SecretMessage, |m: &SecretMessage| m.content.as_bytes())
+}
+
 /// Gets the encoding of a message
 /// Tests: deref_or_return_null!, to_c_string!
 #[no_mangle]
@@ -410,50 +574,62 @@ pub extern "C" fn message_get_encoding(msg: *mut SecretMessage) -> *mut c_char {
 }
 
 /// Sets metadata on a message
-/// Tests: deref_mut_or_return!, cstr_or_return! with false
+/// Tests: deref_or_return!, cstr_or_return! with false
 #[no_mangle]
 pub extern "C" fn message_set_metadata(
     msg: *mut SecretMessage,
     key: *const c_char,
     value: *const c_char,
 ) -> bool {
-    use cimpl::{cstr_or_return, deref_mut_or_return};
+    use cimpl::{cstr_or_return, deref_or_return};
     
-    let message = deref_mut_or_return!(msg, SecretMessage, false);
+    // Shared message: views and other threads may hold it, so no &mut
+    let message = deref_or_return!(msg, SecretMessage, false);
     let key_str = cstr_or_return!(key, false);
     let value_str = cstr_or_return!(value, false);
     
-    message.metadata.insert(key_str, value_str);
+    message
+        .metadata
+        .write()
+        .unwrap_or_else(std::sync::PoisonError::into_inner)
+        .insert(key_str, value_str);
     true
 }
 
 /// Gets metadata from a message (returns NULL if not found)
-/// Tests: deref_or_return_null!, cstr_or_return_null!, option_to_c_string!
+/// Tests: deref_or_return_null!, cstr_borrow_or_return_null!, option_to_c_string!
 #[no_mangle]
 pub extern "C" fn message_get_metadata(
     msg: *mut SecretMessage,
     key: *const c_char,
 ) -> *mut c_char {
     let message = deref_or_return_null!(msg, SecretMessage);
-    let key_str = cstr_or_return_null!(key);
+    let key_str = cstr_borrow_or_return_null!(key);
     
-    option_to_c_string!(message.metadata.get(&key_str).cloned())
+    let metadata = message
+        .metadata
+        .read()
+        .unwrap_or_else(std::sync::PoisonError::into_inner);
+    option_to_c_string!(metadata.get(key_str.as_ref()).cloned())
 }
 
 /// Gets statistics about the message
-/// Tests: deref_or_return_null!, struct return by value
+/// Caller must free the returned struct with secret_free()
+/// Tests: deref_or_return_null!, box_pooled!
 #[no_mangle]
 pub extern "C" fn message_get_stats(msg: *mut SecretMessage) -> *mut MessageStats {
     let message = deref_or_return_null!(msg, SecretMessage);
-    
-    let stats = MessageStats {
-        length: message.content.len(),
-        word_count: count_words(&message.content),
-        vowel_count: count_vowels(&message.content),
-        consonant_count: count_consonants(&message.content),
-    };
-    
-    box_tracked!(stats)
+    box_pooled!(MessageStats::of(&message.content))
+}
+
+/// Writes statistics about the message into caller-provided storage
+/// Returns 0 on success, -1 on error; nothing needs to be freed
+/// Tests: deref_or_return_neg!, write_out_or_return_int!
+#[no_mangle]
+pub extern "C" fn message_get_stats_into(msg: *mut SecretMessage, out: *mut MessageStats) -> i32 {
+    let message = deref_or_return_neg!(msg, SecretMessage);
+    write_out_or_return_int!(out, MessageStats::of(&message.content));
+    0
 }
 
 // ============================================================================
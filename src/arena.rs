@@ -0,0 +1,501 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Scoped Allocation Arenas
+//!
+//! An arena collects the short-lived results of a burst of FFI calls and
+//! releases them all at once. While an arena is the thread's *current* arena,
+//! `to_c_string`, `to_c_bytes` and `box_tracked!` bump-allocate into it instead
+//! of the global heap, and their results are indexed by the arena rather than
+//! the global `PointerRegistry`.
+//!
+//! `cimpl_arena_reset()` runs any destructors, forgets every object and
+//! rewinds the bump pointer, keeping the memory for the next request.
+//! Arena objects still validate with `deref_or_return!` and may still be
+//! freed individually with `cimpl_free()` (their memory is reclaimed at the
+//! next reset).
+//!
+//! # Example (C)
+//! ```c
+//! CimplArena* arena = cimpl_arena_new();
+//! cimpl_arena_set_current(arena);
+//! for (int i = 0; i < n; i++) {
+//!     char* s = thing_describe(things[i]); // allocated in the arena
+//!     emit(s);                             // no cimpl_free needed
+//! }
+//! cimpl_arena_reset(arena);                // release all results at once
+//! cimpl_arena_set_current(NULL);
+//! cimpl_arena_free(arena);
+//! ```
+
+use std::{
+    alloc::{self, Layout},
+    any::TypeId,
+    cell::RefCell,
+    collections::{BTreeMap, HashMap},
+    ffi::CString,
+    os::raw::{c_char, c_uchar},
+    sync::{Arc, Mutex, RwLock, Weak},
+};
+
+use crate::{
+    cimpl_error::CimplError,
+    utils::{get_registry, DropFn},
+};
+
+/// Size of each bump-allocation chunk
+const CHUNK_SIZE: usize = 16 * 1024;
+
+/// Alignment of each chunk; stricter alignments get a dedicated allocation
+const CHUNK_ALIGN: usize = 16;
+
+/// Runs the destructor of a `T` living in arena memory, without freeing it
+unsafe fn drop_in_arena<T>(ptr: usize, _len: usize) {
+    std::ptr::drop_in_place(ptr as *mut T);
+}
+
+/// An object allocated in an arena
+struct ArenaObject {
+    type_id: TypeId,
+    drop_fn: Option<DropFn>,
+}
+
+struct ArenaInner {
+    chunks: Vec<*mut u8>,
+    current: usize,
+    offset: usize,
+    large: Vec<(*mut u8, Layout)>,
+    objects: HashMap<usize, ArenaObject>,
+}
+
+// SAFETY: the raw chunk pointers are owned by the arena and only touched
+// while holding its mutex.
+unsafe impl Send for ArenaInner {}
+
+impl ArenaInner {
+    fn chunk_layout() -> Layout {
+        Layout::from_size_align(CHUNK_SIZE, CHUNK_ALIGN).unwrap()
+    }
+
+    /// Bump-allocates memory for `layout`
+    ///
+    /// New chunks and large allocations are added to the address index for
+    /// `owner`.
+    fn alloc(&mut self, layout: Layout, owner: &Weak<CimplArena>) -> *mut u8 {
+        let layout = Layout::from_size_align(layout.size().max(1), layout.align()).unwrap();
+        if layout.align() > CHUNK_ALIGN || layout.size() > CHUNK_SIZE / 4 {
+            let ptr = unsafe { alloc::alloc(layout) };
+            if ptr.is_null() {
+                alloc::handle_alloc_error(layout);
+            }
+            self.large.push((ptr, layout));
+            add_range(ptr, layout.size(), owner);
+            return ptr;
+        }
+
+        loop {
+            if let Some(&chunk) = self.chunks.get(self.current) {
+                let start = (self.offset + layout.align() - 1) & !(layout.align() - 1);
+                if start + layout.size() <= CHUNK_SIZE {
+                    self.offset = start + layout.size();
+                    return unsafe { chunk.add(start) };
+                }
+                self.current += 1;
+                self.offset = 0;
+            } else {
+                let chunk = unsafe { alloc::alloc(Self::chunk_layout()) };
+                if chunk.is_null() {
+                    alloc::handle_alloc_error(Self::chunk_layout());
+                }
+                self.chunks.push(chunk);
+                add_range(chunk, CHUNK_SIZE, owner);
+            }
+        }
+    }
+
+    /// Frees large allocations and rewinds the bump pointer, keeping the
+    /// chunks; the caller has already dropped every object
+    fn rewind(&mut self) {
+        let mut ranges = arena_ranges().write().unwrap();
+        for (ptr, layout) in self.large.drain(..) {
+            ranges.remove(&(ptr as usize));
+            unsafe { alloc::dealloc(ptr, layout) };
+        }
+        self.current = 0;
+        self.offset = 0;
+    }
+}
+
+/// Runs the destructors of objects taken out of an arena
+///
+/// Called with no locks held, so a destructor may free or validate other
+/// cimpl objects, including ones in the same arena.
+fn drop_objects(objects: HashMap<usize, ArenaObject>) {
+    for (ptr, object) in objects {
+        if let Some(drop_fn) = object.drop_fn {
+            unsafe { drop_fn(ptr, 0) };
+        }
+    }
+}
+
+/// A bump-allocation arena for FFI call results
+///
+/// Created with `cimpl_arena_new()`; the pointer handed to C is tracked like
+/// any other cimpl object.
+pub struct CimplArena {
+    inner: Mutex<ArenaInner>,
+    /// This arena, as recorded in the address index
+    this: Weak<CimplArena>,
+}
+
+impl CimplArena {
+    /// Creates an empty arena; its memory is indexed for pointer validation
+    /// as it is allocated
+    pub fn new() -> Arc<Self> {
+        Arc::new_cyclic(|this| Self {
+            inner: Mutex::new(ArenaInner {
+                chunks: Vec::new(),
+                current: 0,
+                offset: 0,
+                large: Vec::new(),
+                objects: HashMap::new(),
+            }),
+            this: this.clone(),
+        })
+    }
+
+    /// Moves `value` into the arena and returns its address
+    pub fn alloc_value<T: 'static>(&self, value: T) -> *mut T {
+        let mut inner = self.inner.lock().unwrap();
+        let ptr = inner.alloc(Layout::new::<T>(), &self.this) as *mut T;
+        unsafe { ptr.write(value) };
+        let drop_fn = std::mem::needs_drop::<T>().then_some(drop_in_arena::<T> as DropFn);
+        let object = ArenaObject {
+            type_id: TypeId::of::<T>(),
+            drop_fn,
+        };
+        inner.objects.insert(ptr as usize, object);
+        ptr
+    }
+
+    /// Copies `bytes` into the arena, returning the address of the copy
+    fn alloc_copy(&self, bytes: &[u8], terminate: bool, type_id: TypeId) -> *mut u8 {
+        let len = bytes.len() + terminate as usize;
+        let mut inner = self.inner.lock().unwrap();
+        let ptr = inner.alloc(Layout::array::<u8>(len).unwrap(), &self.this);
+        unsafe {
+            std::ptr::copy_nonoverlapping(bytes.as_ptr(), ptr, bytes.len());
+            if terminate {
+                *ptr.add(bytes.len()) = 0;
+            }
+        }
+        let object = ArenaObject {
+            type_id,
+            drop_fn: None,
+        };
+        inner.objects.insert(ptr as usize, object);
+        ptr
+    }
+
+    /// Copies a string into the arena as a NUL-terminated C string
+    ///
+    /// Returns null if the string contains an interior NUL byte.
+    pub fn alloc_c_string(&self, s: &str) -> *mut c_char {
+        if s.as_bytes().contains(&0) {
+            return std::ptr::null_mut();
+        }
+        self.alloc_copy(s.as_bytes(), true, TypeId::of::<CString>()) as *mut c_char
+    }
+
+    /// Copies a byte buffer into the arena
+    pub fn alloc_bytes(&self, bytes: &[u8]) -> *const c_uchar {
+        self.alloc_copy(bytes, false, TypeId::of::<Box<[u8]>>())
+    }
+
+    /// Releases every object in the arena at once
+    ///
+    /// Destructors run without the arena locked. Objects they allocate in
+    /// this arena are released too before the bump pointer is rewound.
+    pub fn reset(&self) {
+        loop {
+            let objects = {
+                let mut inner = self.inner.lock().unwrap();
+                if inner.objects.is_empty() {
+                    inner.rewind();
+                    return;
+                }
+                std::mem::take(&mut inner.objects)
+            };
+            drop_objects(objects);
+        }
+    }
+
+    /// Number of live objects in the arena
+    pub fn len(&self) -> usize {
+        self.inner.lock().unwrap().objects.len()
+    }
+
+    /// Returns true if the arena holds no live objects
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+impl Drop for CimplArena {
+    fn drop(&mut self) {
+        // No other reference exists, and lookups can no longer upgrade `this`
+        self.reset();
+        let inner = self.inner.get_mut().unwrap();
+        let mut ranges = arena_ranges().write().unwrap();
+        for &chunk in &inner.chunks {
+            ranges.remove(&(chunk as usize));
+            unsafe { alloc::dealloc(chunk, ArenaInner::chunk_layout()) };
+        }
+    }
+}
+
+/// Arena memory by start address: `(end, owning arena)`
+type Ranges = BTreeMap<usize, (usize, Weak<CimplArena>)>;
+
+/// Index of every chunk and large allocation of every arena
+fn arena_ranges() -> &'static RwLock<Ranges> {
+    static RANGES: RwLock<Ranges> = RwLock::new(BTreeMap::new());
+    &RANGES
+}
+
+fn add_range(start: *mut u8, len: usize, owner: &Weak<CimplArena>) {
+    let start = start as usize;
+    arena_ranges()
+        .write()
+        .unwrap()
+        .insert(start, (start + len, owner.clone()));
+}
+
+/// The live arena whose memory contains `ptr`
+fn owner(ptr: usize) -> Option<Arc<CimplArena>> {
+    let ranges = arena_ranges().read().unwrap();
+    let (_, (end, arena)) = ranges.range(..=ptr).next_back()?;
+    if ptr < *end {
+        arena.upgrade()
+    } else {
+        None
+    }
+}
+
+thread_local! {
+    static CURRENT: RefCell<Option<Arc<CimplArena>>> = const { RefCell::new(None) };
+}
+
+/// Makes `arena` the current thread's allocation arena (or clears it with `None`)
+///
+/// Returns the previously current arena.
+pub fn set_current_arena(arena: Option<Arc<CimplArena>>) -> Option<Arc<CimplArena>> {
+    CURRENT.with(|current| current.replace(arena))
+}
+
+/// Runs `f` with the current thread's arena, if one is set
+pub(crate) fn with_current<R>(f: impl FnOnce(&CimplArena) -> R) -> Option<R> {
+    CURRENT
+        .try_with(|current| current.borrow().as_deref().map(f))
+        .ok()
+        .flatten()
+}
+
+/// Validates a pointer owned by a live arena
+///
+/// Returns `None` if no arena owns the pointer.
+pub(crate) fn validate(ptr: usize, expected_type: TypeId) -> Option<Result<(), CimplError>> {
+    let arena = owner(ptr)?;
+    let inner = arena.inner.lock().unwrap();
+    let object = inner.objects.get(&ptr)?;
+    Some(if object.type_id == expected_type {
+        Ok(())
+    } else {
+        Err(CimplError::wrong_handle_type(ptr as u64))
+    })
+}
+
+/// Frees a single arena object early, running its destructor
+///
+/// The destructor runs after the arena is unlocked, while `arena` keeps its
+/// memory alive. Returns false if no arena owns the pointer.
+pub(crate) fn free(ptr: usize) -> bool {
+    let Some(arena) = owner(ptr) else {
+        return false;
+    };
+    let object = arena.inner.lock().unwrap().objects.remove(&ptr);
+    let Some(object) = object else {
+        return false;
+    };
+    if let Some(drop_fn) = object.drop_fn {
+        unsafe { drop_fn(ptr, 0) };
+    }
+    true
+}
+
+/// Resolves a tracked `CimplArena` pointer to a new strong reference
+///
+/// The reference is taken under the registry's shard lock, so a concurrent
+/// `cimpl_free()` cannot drop the arena between the check and the increment.
+fn arena_ref(arena: *mut CimplArena) -> Result<Arc<CimplArena>, CimplError> {
+    get_registry().retain(arena as usize, TypeId::of::<CimplArena>())?;
+    // SAFETY: the registry tracks this pointer as an Arc<CimplArena>, and
+    // `retain` added the strong count this Arc takes over
+    Ok(unsafe { Arc::from_raw(arena) })
+}
+
+/// Creates a new allocation arena
+///
+/// Free it with `cimpl_arena_free()` (or `cimpl_free()`).
+#[no_mangle]
+pub extern "C" fn cimpl_arena_new() -> *mut CimplArena {
+    let ptr = Arc::into_raw(CimplArena::new()) as *mut CimplArena;
+    crate::track_arc(ptr);
+    ptr
+}
+
+/// Sets the calling thread's current arena; NULL restores heap allocation
+///
+/// Returns 0 on success, -1 if the arena pointer is invalid.
+#[no_mangle]
+pub extern "C" fn cimpl_arena_set_current(arena: *mut CimplArena) -> i32 {
+    if arena.is_null() {
+        set_current_arena(None);
+        return 0;
+    }
+    crate::ok_or_return_int!(arena_ref(arena).map(|arena| {
+        set_current_arena(Some(arena));
+        0
+    }))
+}
+
+/// Releases every object allocated in the arena
+///
+/// All pointers obtained from the arena become invalid.
+/// Returns 0 on success, -1 if the arena pointer is invalid.
+#[no_mangle]
+pub extern "C" fn cimpl_arena_reset(arena: *mut CimplArena) -> i32 {
+    let arena = crate::deref_or_return_neg!(arena, CimplArena);
+    arena.reset();
+    0
+}
+
+/// Frees an arena and everything allocated in it
+///
+/// If the arena is current on the calling thread it stops being current.
+/// Returns 0 on success, -1 if the arena pointer is invalid.
+#[no_mangle]
+pub extern "C" fn cimpl_arena_free(arena: *mut CimplArena) -> i32 {
+    CURRENT.with(|current| {
+        let mut current = current.borrow_mut();
+        if current
+            .as_ref()
+            .is_some_and(|c| std::ptr::eq(Arc::as_ptr(c), arena))
+        {
+            *current = None;
+        }
+    });
+    crate::cimpl_free(arena as *mut std::ffi::c_void)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    #[test]
+    fn test_arena_results_validate_and_reset() {
+        static DROPS: AtomicUsize = AtomicUsize::new(0);
+        struct Stats(#[allow(dead_code)] u64);
+        impl Drop for Stats {
+            fn drop(&mut self) {
+                DROPS.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+
+        fn stats_value(ptr: *mut Stats) -> i64 {
+            crate::deref_or_return_neg!(ptr, Stats).0 as i64
+        }
+
+        let arena = cimpl_arena_new();
+        assert_eq!(cimpl_arena_set_current(arena), 0);
+        let s = crate::to_c_string("hello arena".to_string());
+        let bytes = crate::to_c_bytes(vec![1, 2, 3]);
+        let stats = crate::box_tracked!(Stats(7));
+        assert_eq!(cimpl_arena_set_current(std::ptr::null_mut()), 0);
+
+        let c_str = unsafe { std::ffi::CStr::from_ptr(s) };
+        assert_eq!(c_str.to_str().unwrap(), "hello arena");
+        assert_eq!(unsafe { std::slice::from_raw_parts(bytes, 3) }, &[1, 2, 3]);
+        assert_eq!(stats_value(stats), 7);
+        assert!(crate::validate_pointer(s as *mut CString).is_ok());
+        assert!(crate::validate_pointer(stats as *mut u64).is_err());
+
+        // Freeing one object early works exactly once
+        assert_eq!(crate::cimpl_free(bytes as *mut std::ffi::c_void), 0);
+        assert_eq!(crate::cimpl_free(bytes as *mut std::ffi::c_void), -1);
+
+        assert_eq!(cimpl_arena_reset(arena), 0);
+        assert_eq!(DROPS.load(Ordering::Relaxed), 1);
+        // unchecked-handles release derefs skip the lookup and would read it
+        #[cfg(not(feature = "unchecked-handles"))]
+        assert_eq!(stats_value(stats), -1);
+        assert!(crate::validate_pointer(stats).is_err());
+        assert!(crate::validate_pointer(s as *mut CString).is_err());
+        assert_eq!(cimpl_arena_free(arena), 0);
+    }
+
+    #[test]
+    fn test_arena_reuses_memory_after_reset() {
+        let arena = CimplArena::new();
+        let first = arena.alloc_c_string("abc");
+        arena.reset();
+        let second = arena.alloc_c_string("xyz");
+        assert_eq!(first, second);
+        assert_eq!(arena.len(), 1);
+
+        // Values larger than a chunk fraction get their own allocation
+        let big = arena.alloc_bytes(&[0u8; CHUNK_SIZE]);
+        assert!(!big.is_null());
+        assert_eq!(arena.len(), 2);
+        arena.reset();
+        assert!(arena.is_empty());
+    }
+
+    #[test]
+    fn test_destructors_may_use_the_arena() {
+        // Drops free a sibling and allocate, which would re-lock the arena
+        struct Chained(*mut std::ffi::c_void);
+        impl Drop for Chained {
+            fn drop(&mut self) {
+                crate::cimpl_free(self.0);
+                let _ = crate::to_c_string("from a destructor".to_string());
+            }
+        }
+
+        let arena = cimpl_arena_new();
+        assert_eq!(cimpl_arena_set_current(arena), 0);
+        let sibling = crate::box_tracked!(vec![1u8; 8]) as *mut std::ffi::c_void;
+        let early = crate::box_tracked!(Chained(sibling));
+        let chained = crate::box_tracked!(Chained(std::ptr::null_mut()));
+
+        assert_eq!(crate::cimpl_free(early as *mut std::ffi::c_void), 0);
+        assert!(crate::validate_pointer(sibling as *mut Vec<u8>).is_err());
+        assert_eq!(cimpl_arena_reset(arena), 0);
+        assert!(crate::validate_pointer(chained).is_err());
+        assert!(unsafe { &*arena }.is_empty());
+
+        assert_eq!(cimpl_arena_set_current(std::ptr::null_mut()), 0);
+        assert_eq!(cimpl_arena_free(arena), 0);
+    }
+}
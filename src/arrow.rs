@@ -0,0 +1,723 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Arrow C Data Interface
+//!
+//! Hands whole columns across the boundary as `ArrowArray` / `ArrowSchema`
+//! structs, the ABI defined by the Arrow C Data Interface and understood by
+//! pyarrow, arrow-java, arrow-go and nanoarrow. The consumer allocates the two
+//! structs and passes them as out-parameters; the producer fills them in and
+//! the consumer calls their `release` callback when it is done.
+//!
+//! - Export: build an `ArrowColumn` from owned values (`Vec<T>` moves in
+//!   without copying) and fill the consumer's structs with
+//!   `arrow_export_or_return!`. Buffer memory stays owned by Rust; each exported
+//!   array and schema is tracked in the registry until its `release` runs, so
+//!   columns a consumer never releases show up in the leak report and stats.
+//! - Import: take ownership of structs produced elsewhere with
+//!   `arrow_import_or_return!` and read them in place through an `ArrowView`.
+//!
+//! Supported types are the primitive numbers, UTF-8 strings (`u` and `U`)
+//! and structs of those (`+s`), which is how record batches are exchanged.
+//!
+//! # Example (Python)
+//! ```python
+//! import pyarrow as pa
+//! from pyarrow.cffi import ffi
+//! array, schema = ffi.new("struct ArrowArray*"), ffi.new("struct ArrowSchema*")
+//! lib.secret_split_words_arrow(b"hello arrow world", array, schema)
+//! words = pa.Array._import_from_c(int(ffi.cast("uintptr_t", array)),
+//!                                 int(ffi.cast("uintptr_t", schema)))
+//! ```
+
+use std::{
+    any::Any,
+    borrow::Cow,
+    ffi::{c_char, c_void, CStr, CString},
+    ptr,
+};
+
+use crate::{
+    cimpl_error::CimplError,
+    scan::utf8_lossy,
+    utils::{drop_box, get_registry},
+};
+
+/// Schema half of the Arrow C Data Interface
+#[repr(C)]
+pub struct ArrowSchema {
+    pub format: *const c_char,
+    pub name: *const c_char,
+    pub metadata: *const c_char,
+    pub flags: i64,
+    pub n_children: i64,
+    pub children: *mut *mut ArrowSchema,
+    pub dictionary: *mut ArrowSchema,
+    pub release: Option<unsafe extern "C" fn(*mut ArrowSchema)>,
+    pub private_data: *mut c_void,
+}
+
+/// Data half of the Arrow C Data Interface
+#[repr(C)]
+pub struct ArrowArray {
+    pub length: i64,
+    pub null_count: i64,
+    pub offset: i64,
+    pub n_buffers: i64,
+    pub n_children: i64,
+    pub buffers: *mut *const c_void,
+    pub children: *mut *mut ArrowArray,
+    pub dictionary: *mut ArrowArray,
+    pub release: Option<unsafe extern "C" fn(*mut ArrowArray)>,
+    pub private_data: *mut c_void,
+}
+
+/// `ArrowSchema.flags` bit marking a field that may contain nulls
+pub const ARROW_FLAG_NULLABLE: i64 = 2;
+
+/// A number type with a fixed-width Arrow layout
+pub trait ArrowPrimitive: Copy + Send + 'static {
+    /// Arrow format string
+    const FORMAT: &'static str;
+}
+
+macro_rules! arrow_primitive {
+    ($($type:ty => $format:literal),* $(,)?) => {
+        $(impl ArrowPrimitive for $type {
+            const FORMAT: &'static str = $format;
+        })*
+    };
+}
+
+arrow_primitive! {
+    i8 => "c", u8 => "C", i16 => "s", u16 => "S", i32 => "i", u32 => "I",
+    i64 => "l", u64 => "L", f32 => "f", f64 => "g",
+}
+
+/// An owned column ready to be exported
+///
+/// The buffers point into memory owned by the column, so exporting it moves
+/// that memory to the consumer without copying.
+pub struct ArrowColumn {
+    format: &'static str,
+    name: Option<CString>,
+    length: usize,
+    null_count: usize,
+    buffers: Vec<*const c_void>,
+    owner: Box<dyn Any + Send>,
+    children: Vec<ArrowColumn>,
+}
+
+// SAFETY: the buffer pointers only refer to memory in `owner`, which is Send
+unsafe impl Send for ArrowColumn {}
+
+/// Packs a validity bitmap, or `None` when every value is present
+fn validity(valid: &[bool]) -> (Option<Vec<u8>>, usize) {
+    let nulls = valid.iter().filter(|v| !**v).count();
+    if nulls == 0 {
+        return (None, 0);
+    }
+    let mut bits = vec![0u8; valid.len().div_ceil(8)];
+    for (index, _) in valid.iter().enumerate().filter(|(_, v)| **v) {
+        bits[index / 8] |= 1 << (index % 8);
+    }
+    (Some(bits), nulls)
+}
+
+fn buffer_ptr<T>(buffer: &Option<Vec<T>>) -> *const c_void {
+    buffer
+        .as_ref()
+        .map_or(ptr::null(), |b| b.as_ptr() as *const c_void)
+}
+
+impl ArrowColumn {
+    /// A column of numbers, taking ownership of `values` without copying
+    pub fn primitive<T: ArrowPrimitive>(values: Vec<T>) -> Self {
+        Self::primitive_parts(values, None, 0)
+    }
+
+    /// A column of numbers where `None` is null
+    pub fn primitive_options<T: ArrowPrimitive + Default>(
+        values: impl IntoIterator<Item = Option<T>>,
+    ) -> Self {
+        let (values, valid): (Vec<T>, Vec<bool>) = values
+            .into_iter()
+            .map(|value| (value.unwrap_or_default(), value.is_some()))
+            .unzip();
+        let (bitmap, nulls) = validity(&valid);
+        Self::primitive_parts(values, bitmap, nulls)
+    }
+
+    fn primitive_parts<T: ArrowPrimitive>(
+        values: Vec<T>,
+        bitmap: Option<Vec<u8>>,
+        null_count: usize,
+    ) -> Self {
+        let buffers = vec![buffer_ptr(&bitmap), values.as_ptr() as *const c_void];
+        Self {
+            format: T::FORMAT,
+            name: None,
+            length: values.len(),
+            null_count,
+            buffers,
+            owner: Box::new((values, bitmap)),
+            children: Vec::new(),
+        }
+    }
+
+    /// A column of strings (Arrow `large_utf8`)
+    pub fn strings<S: AsRef<str>>(values: impl IntoIterator<Item = S>) -> Self {
+        Self::string_options(values.into_iter().map(Some))
+    }
+
+    /// A column of strings where `None` is null
+    pub fn string_options<S: AsRef<str>>(values: impl IntoIterator<Item = Option<S>>) -> Self {
+        let mut offsets = vec![0i64];
+        let mut data = Vec::new();
+        let mut valid = Vec::new();
+        for value in values {
+            if let Some(s) = &value {
+                data.extend_from_slice(s.as_ref().as_bytes());
+            }
+            offsets.push(data.len() as i64);
+            valid.push(value.is_some());
+        }
+        let (bitmap, null_count) = validity(&valid);
+        let buffers = vec![
+            buffer_ptr(&bitmap),
+            offsets.as_ptr() as *const c_void,
+            data.as_ptr() as *const c_void,
+        ];
+        Self {
+            format: "U",
+            name: None,
+            length: valid.len(),
+            null_count,
+            buffers,
+            owner: Box::new((offsets, data, bitmap)),
+            children: Vec::new(),
+        }
+    }
+
+    /// A struct column (one row per index) of equally long named fields,
+    /// which is how Arrow exchanges a record batch
+    pub fn struct_of(fields: Vec<(&str, ArrowColumn)>) -> Result<Self, CimplError> {
+        let length = fields.first().map_or(0, |(_, column)| column.length);
+        let mut children = Vec::with_capacity(fields.len());
+        for (name, column) in fields {
+            if column.length != length {
+                return Err(CimplError::other(format!(
+                    "Arrow field {name} has {} rows, expected {length}",
+                    column.length
+                )));
+            }
+            children.push(column.with_name(name)?);
+        }
+        Ok(Self {
+            format: "+s",
+            name: None,
+            length,
+            null_count: 0,
+            buffers: vec![ptr::null()],
+            owner: Box::new(()),
+            children,
+        })
+    }
+
+    /// Sets the field name recorded in the schema
+    pub fn with_name(mut self, name: &str) -> Result<Self, CimplError> {
+        self.name =
+            Some(CString::new(name).map_err(|_| CimplError::other_static("Arrow name has a nul"))?);
+        Ok(self)
+    }
+
+    /// Number of rows
+    pub fn len(&self) -> usize {
+        self.length
+    }
+
+    /// Returns true if the column has no rows
+    pub fn is_empty(&self) -> bool {
+        self.length == 0
+    }
+
+    /// Fills the consumer's structs, moving the column's memory to them
+    ///
+    /// Use `arrow_export_or_return!` rather than calling this directly.
+    ///
+    /// # Safety
+    /// `array` and `schema` must be NULL or point to writable structs; any
+    /// previous contents are overwritten without being released.
+    pub unsafe fn export(
+        self,
+        array: *mut ArrowArray,
+        schema: *mut ArrowSchema,
+    ) -> Result<(), CimplError> {
+        if array.is_null() {
+            return Err(CimplError::null_parameter_static("array"));
+        }
+        if schema.is_null() {
+            return Err(CimplError::null_parameter_static("schema"));
+        }
+        let (exported_array, exported_schema) = self.into_c();
+        array.write(exported_array);
+        schema.write(exported_schema);
+        Ok(())
+    }
+
+    fn into_c(self) -> (ArrowArray, ArrowSchema) {
+        let (array_children, schema_children) = self.children.into_iter().map(Self::into_c).unzip();
+        let nullable = self.null_count > 0;
+        let mut private_array =
+            Box::new(ExportedArray::new(self.buffers, self.owner, array_children));
+        let mut private_schema =
+            Box::new(ExportedSchema::new(self.format, self.name, schema_children));
+
+        let mut array = ArrowArray {
+            length: self.length as i64,
+            null_count: self.null_count as i64,
+            offset: 0,
+            n_buffers: private_array.buffers.len() as i64,
+            n_children: private_array.child_ptrs.len() as i64,
+            buffers: private_array.buffers.as_mut_ptr(),
+            children: private_array.child_ptrs.as_mut_ptr(),
+            dictionary: ptr::null_mut(),
+            release: Some(release_array),
+            private_data: ptr::null_mut(),
+        };
+        let mut schema = ArrowSchema {
+            format: private_schema.format.as_ptr(),
+            name: private_schema
+                .name
+                .as_ref()
+                .map_or(ptr::null(), |n| n.as_ptr()),
+            metadata: ptr::null(),
+            flags: if nullable { ARROW_FLAG_NULLABLE } else { 0 },
+            n_children: private_schema.child_ptrs.len() as i64,
+            children: private_schema.child_ptrs.as_mut_ptr(),
+            dictionary: ptr::null_mut(),
+            release: Some(release_schema),
+            private_data: ptr::null_mut(),
+        };
+        // Moving the boxes into the registry leaves their contents in place
+        array.private_data = track(private_array);
+        schema.private_data = track(private_schema);
+        (array, schema)
+    }
+}
+
+/// Tracks the private data of an exported struct until its release runs
+fn track<T: 'static>(private: Box<T>) -> *mut c_void {
+    let ptr = Box::into_raw(private);
+    get_registry().track_as::<T>(ptr as usize, drop_box::<T>, 0);
+    ptr as *mut c_void
+}
+
+/// Memory behind an exported `ArrowArray`
+struct ExportedArray {
+    buffers: Vec<*const c_void>,
+    _owner: Box<dyn Any + Send>,
+    children: Vec<ArrowArray>,
+    child_ptrs: Vec<*mut ArrowArray>,
+}
+
+/// Memory behind an exported `ArrowSchema`
+struct ExportedSchema {
+    format: CString,
+    name: Option<CString>,
+    children: Vec<ArrowSchema>,
+    child_ptrs: Vec<*mut ArrowSchema>,
+}
+
+impl ExportedArray {
+    fn new(
+        buffers: Vec<*const c_void>,
+        owner: Box<dyn Any + Send>,
+        mut children: Vec<ArrowArray>,
+    ) -> Self {
+        let child_ptrs = children.iter_mut().map(|c| c as *mut _).collect();
+        Self {
+            buffers,
+            _owner: owner,
+            children,
+            child_ptrs,
+        }
+    }
+}
+
+impl ExportedSchema {
+    fn new(format: &str, name: Option<CString>, mut children: Vec<ArrowSchema>) -> Self {
+        let child_ptrs = children.iter_mut().map(|c| c as *mut _).collect();
+        Self {
+            // Format strings are literals without nuls
+            format: CString::new(format).unwrap(),
+            name,
+            children,
+            child_ptrs,
+        }
+    }
+}
+
+// Children the consumer moved out have already had `release` cleared
+impl Drop for ExportedArray {
+    fn drop(&mut self) {
+        for child in &mut self.children {
+            if let Some(release) = child.release {
+                unsafe { release(child) };
+            }
+        }
+    }
+}
+
+impl Drop for ExportedSchema {
+    fn drop(&mut self) {
+        for child in &mut self.children {
+            if let Some(release) = child.release {
+                unsafe { release(child) };
+            }
+        }
+    }
+}
+
+// SAFETY: the pointers refer to memory owned by the same struct, and the
+// spec allows release callbacks to run on any thread
+unsafe impl Send for ExportedArray {}
+unsafe impl Send for ExportedSchema {}
+
+unsafe extern "C" fn release_array(array: *mut ArrowArray) {
+    let array = &mut *array;
+    // Untracking drops the buffers and releases the children
+    let _ = get_registry().free(array.private_data as usize);
+    array.release = None;
+}
+
+unsafe extern "C" fn release_schema(schema: *mut ArrowSchema) {
+    let schema = &mut *schema;
+    let _ = get_registry().free(schema.private_data as usize);
+    schema.release = None;
+}
+
+/// An imported column, released when dropped
+pub struct ImportedColumn {
+    array: ArrowArray,
+    schema: ArrowSchema,
+}
+
+// SAFETY: the C Data Interface requires released data to be thread-agnostic
+unsafe impl Send for ImportedColumn {}
+
+impl ImportedColumn {
+    /// Takes ownership of a column produced elsewhere
+    ///
+    /// The source structs are marked released, as the spec's "move" requires,
+    /// so the caller must not release them itself.
+    ///
+    /// Use `arrow_import_or_return!` rather than calling this directly.
+    ///
+    /// # Safety
+    /// `array` and `schema` must be NULL or point to structs filled in by an
+    /// Arrow C Data Interface producer.
+    pub unsafe fn import(
+        array: *mut ArrowArray,
+        schema: *mut ArrowSchema,
+    ) -> Result<Self, CimplError> {
+        if array.is_null() {
+            return Err(CimplError::null_parameter_static("array"));
+        }
+        if schema.is_null() {
+            return Err(CimplError::null_parameter_static("schema"));
+        }
+        if (*array).release.is_none() {
+            return Err(CimplError::other_static("Arrow array already released"));
+        }
+        if (*schema).release.is_none() {
+            return Err(CimplError::other_static("Arrow schema already released"));
+        }
+        let column = Self {
+            array: ptr::read(array),
+            schema: ptr::read(schema),
+        };
+        (*array).release = None;
+        (*schema).release = None;
+        Ok(column)
+    }
+
+    /// Borrows the column for reading
+    pub fn view(&self) -> ArrowView<'_> {
+        ArrowView {
+            array: &self.array,
+            schema: &self.schema,
+        }
+    }
+}
+
+impl Drop for ImportedColumn {
+    fn drop(&mut self) {
+        if let Some(release) = self.array.release {
+            unsafe { release(&mut self.array) };
+        }
+        if let Some(release) = self.schema.release {
+            unsafe { release(&mut self.schema) };
+        }
+    }
+}
+
+/// Read-only view of an imported column or one of its children
+#[derive(Clone, Copy)]
+pub struct ArrowView<'a> {
+    array: &'a ArrowArray,
+    schema: &'a ArrowSchema,
+}
+
+impl<'a> ArrowView<'a> {
+    /// Arrow format string, e.g. `"l"` or `"U"`
+    pub fn format(&self) -> Cow<'a, str> {
+        // SAFETY: the producer sets a nul-terminated format string
+        unsafe { CStr::from_ptr(self.schema.format) }.to_string_lossy()
+    }
+
+    /// Field name, if the producer set one
+    pub fn name(&self) -> Option<Cow<'a, str>> {
+        // SAFETY: the producer sets NULL or a nul-terminated name
+        (!self.schema.name.is_null())
+            .then(|| unsafe { CStr::from_ptr(self.schema.name) }.to_string_lossy())
+    }
+
+    /// Number of rows
+    pub fn len(&self) -> usize {
+        self.array.length as usize
+    }
+
+    /// Returns true if the column has no rows
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Number of null rows
+    pub fn null_count(&self) -> usize {
+        self.array.null_count.max(0) as usize
+    }
+
+    fn buffer(&self, index: usize) -> *const c_void {
+        if (index as i64) < self.array.n_buffers {
+            // SAFETY: the producer provides n_buffers buffer pointers
+            unsafe { *self.array.buffers.add(index) }
+        } else {
+            ptr::null()
+        }
+    }
+
+    fn expect_format(&self, formats: &[&str]) -> Result<(), CimplError> {
+        let format = self.format();
+        if formats.contains(&&*format) {
+            Ok(())
+        } else {
+            Err(CimplError::other(format!(
+                "Arrow format is {format}, expected {}",
+                formats.join(" or ")
+            )))
+        }
+    }
+
+    /// Returns false if row `index` is null
+    pub fn is_valid(&self, index: usize) -> bool {
+        let bitmap = self.buffer(0) as *const u8;
+        if bitmap.is_null() || self.null_count() == 0 {
+            return true;
+        }
+        let bit = self.array.offset as usize + index;
+        // SAFETY: the bitmap covers offset + length bits
+        unsafe { *bitmap.add(bit / 8) & (1 << (bit % 8)) != 0 }
+    }
+
+    /// Borrows the values of a primitive column; null rows hold unspecified values
+    pub fn values<T: ArrowPrimitive>(&self) -> Result<&'a [T], CimplError> {
+        self.expect_format(&[T::FORMAT])?;
+        let values = self.buffer(1) as *const T;
+        if values.is_null() {
+            return Err(CimplError::null_parameter_static("values"));
+        }
+        // SAFETY: the producer provides offset + length values
+        Ok(unsafe {
+            std::slice::from_raw_parts(values.add(self.array.offset as usize), self.len())
+        })
+    }
+
+    /// Reads row `index` of a `utf8` (`u`) or `large_utf8` (`U`) column;
+    /// `None` for null rows
+    pub fn string(&self, index: usize) -> Result<Option<Cow<'a, str>>, CimplError> {
+        self.expect_format(&["u", "U"])?;
+        if index >= self.len() {
+            return Err(CimplError::other(format!("Arrow row {index} out of range")));
+        }
+        if !self.is_valid(index) {
+            return Ok(None);
+        }
+        let row = self.array.offset as usize + index;
+        // SAFETY: the producer provides offset + length + 1 offsets, all
+        // within the data buffer
+        let (start, end) = unsafe {
+            if *self.schema.format == b'U' as c_char {
+                let offsets = self.buffer(1) as *const i64;
+                (*offsets.add(row) as usize, *offsets.add(row + 1) as usize)
+            } else {
+                let offsets = self.buffer(1) as *const i32;
+                (*offsets.add(row) as usize, *offsets.add(row + 1) as usize)
+            }
+        };
+        let data = self.buffer(2) as *const u8;
+        let bytes = match end - start {
+            0 => &[][..],
+            len => unsafe { std::slice::from_raw_parts(data.add(start), len) },
+        };
+        Ok(Some(utf8_lossy(bytes)))
+    }
+
+    /// Number of child columns
+    pub fn num_children(&self) -> usize {
+        self.array.n_children.max(0) as usize
+    }
+
+    /// Borrows child column `index` (a field of a struct column)
+    pub fn child(&self, index: usize) -> Option<ArrowView<'a>> {
+        if index >= self.num_children() || index as i64 >= self.schema.n_children {
+            return None;
+        }
+        // SAFETY: the producer provides n_children child pointers
+        unsafe {
+            Some(ArrowView {
+                array: &**self.array.children.add(index),
+                schema: &**self.schema.children.add(index),
+            })
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::any::TypeId;
+
+    use super::*;
+
+    fn empty_array() -> ArrowArray {
+        unsafe { std::mem::zeroed() }
+    }
+
+    fn empty_schema() -> ArrowSchema {
+        unsafe { std::mem::zeroed() }
+    }
+
+    /// Whether the registry still tracks the memory behind an exported struct
+    fn tracked(array: &ArrowArray, schema: &ArrowSchema) -> (bool, bool) {
+        let registry = get_registry();
+        let array_id = TypeId::of::<ExportedArray>();
+        let schema_id = TypeId::of::<ExportedSchema>();
+        (
+            registry
+                .validate(array.private_data as usize, array_id)
+                .is_ok(),
+            registry
+                .validate(schema.private_data as usize, schema_id)
+                .is_ok(),
+        )
+    }
+
+    #[test]
+    fn test_export_import_roundtrip() {
+        let column = ArrowColumn::struct_of(vec![
+            (
+                "word",
+                ArrowColumn::string_options([Some("alpha"), None, Some("gamma")]),
+            ),
+            ("length", ArrowColumn::primitive(vec![5u64, 0, 5])),
+            (
+                "score",
+                ArrowColumn::primitive_options([Some(1.5f64), Some(2.0), None]),
+            ),
+        ])
+        .unwrap();
+        let (mut array, mut schema) = (empty_array(), empty_schema());
+        unsafe { column.export(&mut array, &mut schema).unwrap() };
+        // Keep copies of the structs to check their tracking after the move
+        let (array_copy, schema_copy) = unsafe { (ptr::read(&array), ptr::read(&schema)) };
+        let (child_array, child_schema) = unsafe { (&**array.children, &**schema.children) };
+        assert_eq!(tracked(&array_copy, &schema_copy), (true, true));
+        assert_eq!(tracked(child_array, child_schema), (true, true));
+
+        let imported = unsafe { ImportedColumn::import(&mut array, &mut schema) }.unwrap();
+        assert!(array.release.is_none() && schema.release.is_none());
+        let view = imported.view();
+        assert_eq!(
+            (&*view.format(), view.len(), view.num_children()),
+            ("+s", 3, 3)
+        );
+
+        let words = view.child(0).unwrap();
+        assert_eq!(words.name().as_deref(), Some("word"));
+        assert_eq!(words.null_count(), 1);
+        assert_eq!(words.string(0).unwrap().as_deref(), Some("alpha"));
+        assert_eq!(words.string(1).unwrap(), None);
+        assert_eq!(words.string(2).unwrap().as_deref(), Some("gamma"));
+        assert!(words.string(3).is_err());
+
+        let lengths = view.child(1).unwrap();
+        assert_eq!(lengths.values::<u64>().unwrap(), &[5, 0, 5]);
+        assert!(lengths.values::<i32>().is_err());
+        let scores = view.child(2).unwrap();
+        assert_eq!(scores.values::<f64>().unwrap()[..2], [1.5, 2.0]);
+        assert!(!scores.is_valid(2));
+        assert!(view.child(3).is_none());
+
+        // Releasing the parent releases every child it still owns
+        drop(imported);
+        assert_eq!(tracked(&array_copy, &schema_copy), (false, false));
+    }
+
+    #[test]
+    fn test_moved_child_is_released_separately() {
+        let column = ArrowColumn::struct_of(vec![
+            ("a", ArrowColumn::primitive(vec![1i32, 2])),
+            ("b", ArrowColumn::strings(["x", "y"])),
+        ])
+        .unwrap();
+        let (mut array, mut schema) = (empty_array(), empty_schema());
+        unsafe { column.export(&mut array, &mut schema).unwrap() };
+
+        // Move child 1 out, then release the parent; the child stays readable
+        let child = unsafe {
+            ImportedColumn::import(*array.children.add(1), *schema.children.add(1)).unwrap()
+        };
+        let (child_array, child_schema) =
+            unsafe { (ptr::read(&child.array), ptr::read(&child.schema)) };
+        unsafe {
+            (array.release.unwrap())(&mut array);
+            (schema.release.unwrap())(&mut schema);
+        }
+        assert!(array.release.is_none());
+        assert_eq!(tracked(&child_array, &child_schema), (true, true));
+        assert_eq!(child.view().string(1).unwrap().as_deref(), Some("y"));
+        drop(child);
+        assert_eq!(tracked(&child_array, &child_schema), (false, false));
+
+        let mismatched = ArrowColumn::struct_of(vec![
+            ("a", ArrowColumn::primitive(vec![1i32])),
+            ("b", ArrowColumn::primitive(vec![1i32, 2])),
+        ]);
+        assert!(mismatched.is_err());
+        let released = match unsafe { ImportedColumn::import(&mut array, &mut schema) } {
+            Err(e) => e,
+            Ok(_) => panic!("imported a released struct"),
+        };
+        assert_eq!(released.to_string(), "Other: Arrow array already released");
+    }
+}
@@ -0,0 +1,603 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Batched Strings
+//!
+//! Running a cheap function over a whole column of strings one FFI call at a
+//! time is dominated by the per-call overhead: the crossing, the nul scan and
+//! copy of each input, and one tracked allocation per result. The batch
+//! helpers move the whole column in one call using the Arrow "large string"
+//! layout: `count + 1` `int64` offsets into one data buffer, where string `i`
+//! is `data[offsets[i]..offsets[i + 1]]` (no nul terminators).
+//!
+//! String results come back in the same layout as a `CimplBatch`: one
+//! allocation holding the header, offsets and data, tracked by one registry
+//! entry and freed with a single `cimpl_free()`. Numeric results are written
+//! into a caller-provided array.
+//!
+//! Use `batch_strings_or_return!` and `batch_values_or_return!` in the body of
+//! a `*_batch` FFI function. The `batch_try_*` variants take a fallible
+//! function and report an error code per item in a caller-provided `int32`
+//! array (0 for success), since one last error cannot describe a batch.
+//!
+//! # Parallel execution
+//!
+//! With the `parallel` feature, batches of more than `PARALLEL_CHUNK` items
+//! are split into chunks run on the rayon pool, each writing straight into its
+//! own range of the output. The mapping functions must therefore be `Sync`.
+//! Worker threads never touch the thread-local last error: per-item failures
+//! are returned as codes, and the first failing item's error is set as the
+//! last error on the calling thread once the batch completes.
+//!
+//! # Example (C)
+//! ```c
+//! const int64_t offsets[] = {0, 5, 10};
+//! CimplBatch* out = secret_rot13_batch(offsets, (const uint8_t*)"helloworld", 10, 2);
+//! for (size_t i = 0; i < out->count; i++) {
+//!     printf("%.*s\n", (int)(out->offsets[i + 1] - out->offsets[i]),
+//!            out->data + out->offsets[i]);
+//! }
+//! cimpl_free(out);
+//! ```
+
+use std::{
+    mem::MaybeUninit,
+    sync::{
+        atomic::{AtomicI32, AtomicUsize, Ordering},
+        Mutex,
+    },
+};
+
+use crate::{cimpl_error::CimplError, scan::utf8_lossy, utils::get_registry};
+
+/// Packed strings returned from a `*_batch` function
+///
+/// Read string `i` as `data[offsets[i]..offsets[i + 1]]`. The header, offsets
+/// and data share one allocation; free it with `cimpl_free()`.
+#[repr(C)]
+pub struct CimplBatch {
+    /// Number of strings
+    pub count: usize,
+    /// `count + 1` offsets into `data`
+    pub offsets: *const i64,
+    /// String bytes, back to back
+    pub data: *const u8,
+    /// Total length of `data` in bytes
+    pub data_len: usize,
+}
+
+/// Words taken by the `CimplBatch` header at the start of the buffer
+const HEADER_WORDS: usize = std::mem::size_of::<CimplBatch>() / 8;
+
+/// Frees a `CimplBatch` buffer of `len` words
+unsafe fn drop_batch(ptr: usize, len: usize) {
+    drop(Box::from_raw(std::ptr::slice_from_raw_parts_mut(
+        ptr as *mut u64,
+        len,
+    )));
+}
+
+/// Borrowed packed strings passed in from C
+pub struct PackedStrings<'a> {
+    offsets: &'a [i64],
+    data: &'a [u8],
+}
+
+impl<'a> PackedStrings<'a> {
+    /// Borrows `count` packed strings, checking that the offsets are in bounds
+    ///
+    /// `data` may be NULL when `data_len` is 0.
+    ///
+    /// Use `batch_strings_or_return!` rather than calling this directly.
+    ///
+    /// # Safety
+    /// `offsets` must point to `count + 1` readable values and `data` to
+    /// `data_len` readable bytes, both outliving the returned value.
+    pub unsafe fn from_raw(
+        offsets: *const i64,
+        data: *const u8,
+        data_len: usize,
+        count: usize,
+    ) -> Result<Self, CimplError> {
+        if offsets.is_null() {
+            return Err(CimplError::null_parameter_static("offsets"));
+        }
+        // A batch of empty strings may have no data at all
+        let data = match data_len {
+            0 => &[],
+            _ => crate::safe_slice_from_raw_parts_static(data, data_len, "data")?,
+        };
+        // An overflowing count would panic across extern "C"
+        let slots = match count.checked_add(1) {
+            Some(slots) if slots <= isize::MAX as usize / std::mem::size_of::<i64>() => slots,
+            _ => return Err(CimplError::invalid_buffer_size("offsets", count)),
+        };
+        let offsets = std::slice::from_raw_parts(offsets, slots);
+        let in_bounds = offsets[0] >= 0
+            && offsets[count] as u64 <= data_len as u64
+            && offsets.windows(2).all(|pair| pair[0] <= pair[1]);
+        if !in_bounds {
+            return Err(CimplError::invalid_buffer_size("offsets", count));
+        }
+        Ok(Self { offsets, data })
+    }
+
+    /// Number of strings
+    pub fn len(&self) -> usize {
+        self.offsets.len() - 1
+    }
+
+    /// Returns true if there are no strings
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Bytes of string `index`
+    pub fn get(&self, index: usize) -> &'a [u8] {
+        &self.data[self.offsets[index] as usize..self.offsets[index + 1] as usize]
+    }
+
+    /// Bytes of each string in order
+    pub fn iter(&self) -> impl Iterator<Item = &'a [u8]> + '_ {
+        (0..self.len()).map(|index| self.get(index))
+    }
+}
+
+/// Builds a `CimplBatch` in a single buffer
+///
+/// The buffer is laid out as `[header][count + 1 offsets][data]`, in words so
+/// the offsets are aligned; the header is filled in by `finish()`.
+pub struct BatchBuilder {
+    words: Vec<u64>,
+    count: usize,
+    pushed: usize,
+    data_len: usize,
+}
+
+impl BatchBuilder {
+    /// Starts a batch of `count` strings, reserving `data_hint` bytes of data
+    pub fn new(count: usize, data_hint: usize) -> Self {
+        let offset_words = HEADER_WORDS + count + 1;
+        let mut words = Vec::with_capacity(offset_words + data_hint.div_ceil(8));
+        words.resize(offset_words, 0);
+        Self {
+            words,
+            count,
+            pushed: 0,
+            data_len: 0,
+        }
+    }
+
+    fn data_start(&self) -> usize {
+        (HEADER_WORDS + self.count + 1) * 8
+    }
+
+    /// Appends the next string
+    ///
+    /// # Panics
+    /// If more than `count` strings are pushed.
+    pub fn push(&mut self, bytes: &[u8]) {
+        assert!(self.pushed < self.count, "batch is full");
+        let end = self.data_start() + self.data_len + bytes.len();
+        let needed = end.div_ceil(8);
+        if needed > self.words.len() {
+            self.words.resize(needed.max(self.words.len() * 2), 0);
+        }
+        // SAFETY: the byte range was just made to fit inside `words`
+        unsafe {
+            let base = self.words.as_mut_ptr() as *mut u8;
+            let at = base.add(self.data_start() + self.data_len);
+            std::ptr::copy_nonoverlapping(bytes.as_ptr(), at, bytes.len());
+        }
+        self.data_len += bytes.len();
+        self.pushed += 1;
+        self.words[HEADER_WORDS + self.pushed] = self.data_len as u64;
+    }
+
+    /// Appends the next string, as `push()` does
+    pub fn push_str(&mut self, s: &str) {
+        self.push(s.as_bytes());
+    }
+
+    /// Finishes the batch and tracks it, returning the pointer to hand to C
+    ///
+    /// Strings that were never pushed are empty.
+    pub fn finish(mut self) -> *mut CimplBatch {
+        for index in self.pushed + 1..=self.count {
+            self.words[HEADER_WORDS + index] = self.data_len as u64;
+        }
+        let used = (self.data_start() + self.data_len).div_ceil(8);
+        self.words.truncate(used);
+        let mut words = self.words.into_boxed_slice();
+        let len = words.len();
+        let base = words.as_mut_ptr();
+        // SAFETY: the header words are reserved at the start of the buffer,
+        // which is 8-byte aligned like `CimplBatch`
+        unsafe {
+            let header = base as *mut CimplBatch;
+            header.write(CimplBatch {
+                count: self.count,
+                offsets: base.add(HEADER_WORDS) as *const i64,
+                data: (base as *const u8).add((HEADER_WORDS + self.count + 1) * 8),
+                data_len: self.data_len,
+            });
+        }
+        let ptr = Box::into_raw(words) as *mut u64 as usize;
+        get_registry().track_as::<CimplBatch>(ptr, drop_batch, len);
+        ptr as *mut CimplBatch
+    }
+}
+
+impl CimplBatch {
+    /// Bytes of string `index`
+    pub fn get(&self, index: usize) -> &[u8] {
+        assert!(index < self.count);
+        // SAFETY: a CimplBatch is only built by BatchBuilder, whose offsets
+        // are in bounds
+        unsafe {
+            let start = *self.offsets.add(index) as usize;
+            let end = *self.offsets.add(index + 1) as usize;
+            std::slice::from_raw_parts(self.data.add(start), end - start)
+        }
+    }
+}
+
+/// Smallest number of items handed to one parallel task
+#[cfg(feature = "parallel")]
+pub const PARALLEL_CHUNK: usize = 256;
+
+/// Runs `work(first_index, chunk)` over `slots`, in parallel chunks when the
+/// `parallel` feature is on and the batch is large enough
+fn for_each_chunk<S, W>(slots: &mut [S], work: W)
+where
+    S: Send,
+    W: Fn(usize, &mut [S]) + Sync,
+{
+    #[cfg(feature = "parallel")]
+    if slots.len() > PARALLEL_CHUNK {
+        // A few chunks per thread so uneven items still balance
+        let chunk = slots
+            .len()
+            .div_ceil(rayon::current_num_threads() * 4)
+            .max(PARALLEL_CHUNK);
+        let work = &work;
+        rayon::scope(|scope| {
+            for (index, slots) in slots.chunks_mut(chunk).enumerate() {
+                scope.spawn(move |_| work(index * chunk, slots));
+            }
+        });
+        return;
+    }
+    work(0, slots)
+}
+
+/// Per-item error codes and the first failure, shared by the batch workers
+struct Failures<'a> {
+    codes: &'a [AtomicI32],
+    first: Mutex<Option<(usize, CimplError)>>,
+    count: AtomicUsize,
+}
+
+impl<'a> Failures<'a> {
+    /// # Safety
+    /// `codes` must point to `count` writable `int32` values.
+    unsafe fn new(codes: *mut i32, count: usize) -> Self {
+        Self {
+            // SAFETY: AtomicI32 has the same layout as i32
+            codes: std::slice::from_raw_parts(codes as *const AtomicI32, count),
+            first: Mutex::new(None),
+            count: Default::default(),
+        }
+    }
+
+    fn record<T, E>(&self, index: usize, result: Result<T, E>) -> Option<T>
+    where
+        CimplError: From<E>,
+    {
+        match result {
+            Ok(value) => {
+                self.codes[index].store(0, Ordering::Relaxed);
+                Some(value)
+            }
+            Err(e) => {
+                let e = CimplError::from(e);
+                self.codes[index].store(e.code(), Ordering::Relaxed);
+                self.count.fetch_add(1, Ordering::Relaxed);
+                let mut first = self.first.lock().unwrap();
+                if first.as_ref().is_none_or(|(at, _)| index < *at) {
+                    *first = Some((index, e));
+                }
+                None
+            }
+        }
+    }
+
+    /// Sets the first failure as the last error and returns the failure count
+    fn finish(self) -> usize {
+        if let Some((_, e)) = self.first.into_inner().unwrap() {
+            e.set_last();
+        }
+        self.count.into_inner()
+    }
+}
+
+/// Packs mapped strings into a `CimplBatch`
+fn pack<S: AsRef<str>>(mapped: &[Option<S>]) -> *mut CimplBatch {
+    let data_len = mapped.iter().flatten().map(|s| s.as_ref().len()).sum();
+    let mut builder = BatchBuilder::new(mapped.len(), data_len);
+    for s in mapped {
+        builder.push_str(s.as_ref().map_or("", AsRef::as_ref));
+    }
+    builder.finish()
+}
+
+/// Maps each string through `f` into a new `CimplBatch`
+///
+/// Use `batch_strings_or_return!` rather than calling this directly.
+pub fn map_strings<F, S>(packed: &PackedStrings<'_>, f: F) -> *mut CimplBatch
+where
+    F: Fn(&str) -> S + Sync,
+    S: AsRef<str> + Send,
+{
+    let mut mapped: Vec<Option<S>> = (0..packed.len()).map(|_| None).collect();
+    for_each_chunk(&mut mapped, |first, slots| {
+        for (index, slot) in (first..).zip(slots) {
+            *slot = Some(f(&utf8_lossy(packed.get(index))));
+        }
+    });
+    pack(&mapped)
+}
+
+/// Maps each string through a fallible `f` into a new `CimplBatch`
+///
+/// Failed items are empty strings; their error codes are written to `codes`
+/// and the first failure becomes the last error. Returns the batch and the
+/// number of failed items.
+///
+/// Use `batch_try_strings_or_return!` rather than calling this directly.
+///
+/// # Safety
+/// `codes` must point to `packed.len()` writable `int32` values.
+pub unsafe fn try_map_strings<F, S, E>(
+    packed: &PackedStrings<'_>,
+    codes: *mut i32,
+    f: F,
+) -> (*mut CimplBatch, usize)
+where
+    F: Fn(&str) -> Result<S, E> + Sync,
+    S: AsRef<str> + Send,
+    CimplError: From<E>,
+{
+    let failures = Failures::new(codes, packed.len());
+    let mut mapped: Vec<Option<S>> = (0..packed.len()).map(|_| None).collect();
+    for_each_chunk(&mut mapped, |first, slots| {
+        for (index, slot) in (first..).zip(slots) {
+            *slot = failures.record(index, f(&utf8_lossy(packed.get(index))));
+        }
+    });
+    (pack(&mapped), failures.finish())
+}
+
+/// Maps each string through `f`, writing the results to `out`
+///
+/// Use `batch_values_or_return!` rather than calling this directly.
+pub fn map_values<F, T>(packed: &PackedStrings<'_>, out: &mut [MaybeUninit<T>], f: F)
+where
+    F: Fn(&str) -> T + Sync,
+    T: Send,
+{
+    for_each_chunk(&mut out[..packed.len()], |first, slots| {
+        for (index, slot) in (first..).zip(slots) {
+            slot.write(f(&utf8_lossy(packed.get(index))));
+        }
+    });
+}
+
+/// Maps each string through a fallible `f`, writing the results to `out`
+///
+/// The `out` slots of failed items are left unchanged; their error codes are
+/// written to `codes` and the first failure becomes the last error. Returns
+/// the number of failed items.
+///
+/// Use `batch_try_values_or_return!` rather than calling this directly.
+///
+/// # Safety
+/// `codes` must point to `packed.len()` writable `int32` values.
+pub unsafe fn try_map_values<F, T, E>(
+    packed: &PackedStrings<'_>,
+    out: &mut [MaybeUninit<T>],
+    codes: *mut i32,
+    f: F,
+) -> usize
+where
+    F: Fn(&str) -> Result<T, E> + Sync,
+    T: Send,
+    CimplError: From<E>,
+{
+    let failures = Failures::new(codes, packed.len());
+    for_each_chunk(&mut out[..packed.len()], |first, slots| {
+        for (index, slot) in (first..).zip(slots) {
+            if let Some(value) = failures.record(index, f(&utf8_lossy(packed.get(index)))) {
+                slot.write(value);
+            }
+        }
+    });
+    failures.finish()
+}
+
+// The builder assumes the header is a whole number of aligned words
+const _: () = assert!(std::mem::size_of::<CimplBatch>() == HEADER_WORDS * 8);
+const _: () = assert!(std::mem::align_of::<CimplBatch>() <= 8);
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::validate_pointer;
+
+    fn pack(strings: &[&str]) -> (Vec<i64>, Vec<u8>) {
+        let mut offsets = vec![0i64];
+        let mut data = Vec::new();
+        for s in strings {
+            data.extend_from_slice(s.as_bytes());
+            offsets.push(data.len() as i64);
+        }
+        (offsets, data)
+    }
+
+    fn upper_batch(
+        offsets: *const i64,
+        data: *const u8,
+        data_len: usize,
+        n: usize,
+    ) -> *mut CimplBatch {
+        crate::batch_strings_or_return_null!(offsets, data, data_len, n, |s: &str| s.to_uppercase())
+    }
+
+    #[test]
+    fn test_batch_roundtrip_is_one_object() {
+        let input = ["hello", "", "wörld", &"x".repeat(100)];
+        let (offsets, data) = pack(&input);
+        let out = upper_batch(offsets.as_ptr(), data.as_ptr(), data.len(), input.len());
+        assert!(validate_pointer(out).is_ok());
+
+        let batch = unsafe { &*out };
+        assert_eq!(batch.count, 4);
+        assert_eq!(batch.get(0), b"HELLO");
+        assert_eq!(batch.get(1), b"");
+        assert_eq!(batch.get(2), "WÖRLD".as_bytes());
+        assert_eq!(batch.get(3), "X".repeat(100).as_bytes());
+        assert_eq!(batch.offsets as usize % 8, 0);
+
+        // Offsets and data live in the batch's own allocation and are not
+        // tracked separately (checked per pointer, without global counts)
+        let offsets = out as usize + HEADER_WORDS * 8;
+        assert_eq!(batch.offsets as usize, offsets);
+        assert_eq!(batch.data as usize, offsets + (batch.count + 1) * 8);
+        for inner in [batch.offsets as usize, batch.data as usize] {
+            let result = get_registry().validate(inner, std::any::TypeId::of::<u8>());
+            assert_eq!(result.unwrap_err().code(), 3);
+        }
+        assert_eq!(crate::cimpl_free(out as *mut _), 0);
+    }
+
+    #[test]
+    fn test_batch_values_and_bad_offsets() {
+        fn lengths(
+            offsets: *const i64,
+            data: *const u8,
+            len: usize,
+            n: usize,
+            out: *mut usize,
+        ) -> i32 {
+            crate::batch_values_or_return_neg!(offsets, data, len, n, out, |s: &str| s.len());
+            0
+        }
+        let (offsets, data) = pack(&["ab", "cde"]);
+        let mut out = [0usize; 2];
+        assert_eq!(
+            lengths(
+                offsets.as_ptr(),
+                data.as_ptr(),
+                data.len(),
+                2,
+                out.as_mut_ptr()
+            ),
+            0
+        );
+        assert_eq!(out, [2, 3]);
+
+        let bad = [0i64, 4, 2];
+        assert_eq!(
+            lengths(bad.as_ptr(), data.as_ptr(), data.len(), 2, out.as_mut_ptr()),
+            -1
+        );
+        let past_end = [0i64, 2, 9];
+        assert!(upper_batch(past_end.as_ptr(), data.as_ptr(), data.len(), 2).is_null());
+        assert!(upper_batch(offsets.as_ptr(), data.as_ptr(), data.len(), usize::MAX).is_null());
+        assert_eq!(crate::CimplError::last_code(), 5);
+        assert_eq!(
+            lengths(
+                offsets.as_ptr(),
+                data.as_ptr(),
+                data.len(),
+                2,
+                std::ptr::null_mut()
+            ),
+            -1
+        );
+
+        let empty = upper_batch(offsets.as_ptr(), std::ptr::null(), 0, 0);
+        assert_eq!(unsafe { &*empty }.count, 0);
+        assert_eq!(crate::cimpl_free(empty as *mut _), 0);
+    }
+
+    #[test]
+    fn test_try_batch_reports_each_failure() {
+        fn parse(s: &str) -> Result<u32, CimplError> {
+            s.parse()
+                .map_err(|_| CimplError::new(100, format!("not a number: {s}")))
+        }
+        fn parse_batch(offsets: &[i64], data: &[u8], out: *mut u32, codes: *mut i32) -> i32 {
+            let (len, count) = (data.len(), offsets.len() - 1);
+            let (offsets, data) = (offsets.as_ptr(), data.as_ptr());
+            crate::batch_try_values_or_return_neg!(offsets, data, len, count, out, codes, parse)
+                as i32
+        }
+        // Large enough to be split into chunks with the `parallel` feature
+        let items: Vec<String> = (0..1000)
+            .map(|i| {
+                if i % 7 == 3 {
+                    format!("x{i}")
+                } else {
+                    i.to_string()
+                }
+            })
+            .collect();
+        let refs: Vec<&str> = items.iter().map(String::as_str).collect();
+        let (offsets, data) = pack(&refs);
+        let mut out = vec![0u32; items.len()];
+        let mut codes = vec![-1i32; items.len()];
+
+        CimplError::take_last();
+        let failed = parse_batch(&offsets, &data, out.as_mut_ptr(), codes.as_mut_ptr());
+        assert_eq!(failed as usize, (0..1000).filter(|i| i % 7 == 3).count());
+        for (i, (value, code)) in out.iter().zip(&codes).enumerate() {
+            if i % 7 == 3 {
+                assert_eq!((*value, *code), (0, 100));
+            } else {
+                assert_eq!((*value, *code), (i as u32, 0));
+            }
+        }
+        // The lowest failing index is reported on the calling thread
+        assert_eq!(CimplError::last_message().unwrap(), "not a number: x3");
+        assert_eq!(
+            parse_batch(&offsets, &data, out.as_mut_ptr(), std::ptr::null_mut()),
+            -1
+        );
+
+        let doubled = |codes: *mut i32| -> *mut CimplBatch {
+            let (o, d, len) = (offsets.as_ptr(), data.as_ptr(), data.len());
+            crate::batch_try_strings_or_return_null!(o, d, len, 1000, codes, |s: &str| {
+                parse(s).map(|n| (n * 2).to_string())
+            })
+        };
+        codes.fill(-1);
+        let batch = doubled(codes.as_mut_ptr());
+        let strings = unsafe { &*batch };
+        assert_eq!((strings.get(2), codes[2]), (&b"4"[..], 0));
+        assert_eq!((strings.get(3), codes[3]), (&b""[..], 100));
+        assert_eq!((strings.get(999), codes[999]), (&b"1998"[..], 0));
+        assert!(doubled(std::ptr::null_mut()).is_null());
+        assert_eq!(crate::cimpl_free(batch as *mut _), 0);
+    }
+}
@@ -11,13 +11,15 @@
 // specific language governing permissions and limitations under
 // each license.
 
-use std::cell::RefCell;
+use std::{borrow::Cow, cell::RefCell, io::Write, os::raw::c_char};
 
 pub type Result<T> = std::result::Result<T, CimplError>;
 
 // LAST_ERROR handling borrowed from Copyright (c) 2018 Michael Bryan
 thread_local! {
     static LAST_ERROR: RefCell<Option<CimplError>> = const { RefCell::new(None) };
+    /// Nul-terminated text of the last error, reused by `cimpl_last_error_view()`
+    static LAST_ERROR_TEXT: RefCell<Vec<u8>> = const { RefCell::new(Vec::new()) };
 }
 
 /// CimplError - holds an error code and message
@@ -66,41 +68,93 @@ thread_local! {
 /// let result = ok_or_return_null!(parse_something());
 /// ```
 ///
+/// # Allocation
+///
+/// Messages are `Cow<'static, str>`, and the infrastructure errors (1-99)
+/// keep their `"Kind: detail"` parts separate until the message is read. The
+/// `*_static` constructors store a `&'static str` as is, so creating and
+/// setting those errors, or ones with numeric details, never touches the
+/// heap. Only the message accessors format.
 #[derive(Debug, Clone)]
 pub struct CimplError {
     code: i32,
-    message: String,
+    /// Prefix written before `detail` as `"{kind}: "`, or empty
+    kind: &'static str,
+    detail: Detail,
+}
+
+#[derive(Debug, Clone)]
+enum Detail {
+    Text(Cow<'static, str>),
+    Id(u64),
 }
 
 impl CimplError {
     /// Creates a new error with the given code and message
     pub fn new<S: Into<String>>(code: i32, message: S) -> Self {
-        Self {
-            code,
-            message: message.into(),
-        }
+        Self::with_kind(code, "", Detail::Text(Cow::Owned(message.into())))
+    }
+
+    /// Like `new()`, but stores a `&'static str` message without allocating
+    pub const fn new_static(code: i32, message: &'static str) -> Self {
+        Self::with_kind(code, "", Detail::Text(Cow::Borrowed(message)))
     }
+
+    const fn with_kind(code: i32, kind: &'static str, detail: Detail) -> Self {
+        Self { code, kind, detail }
+    }
+
     pub fn null_parameter<S: Into<String>>(param: S) -> Self {
-        Self::new(1, format!("NullParameter: {}", param.into()))
+        Self::with_kind(1, "NullParameter", Detail::Text(Cow::Owned(param.into())))
+    }
+    pub const fn null_parameter_static(param: &'static str) -> Self {
+        Self::with_kind(1, "NullParameter", Detail::Text(Cow::Borrowed(param)))
     }
     pub fn string_too_long<S: Into<String>>(param: S) -> Self {
-        Self::new(2, format!("StringTooLong: {}", param.into()))
+        Self::with_kind(2, "StringTooLong", Detail::Text(Cow::Owned(param.into())))
+    }
+    pub const fn string_too_long_static(param: &'static str) -> Self {
+        Self::with_kind(2, "StringTooLong", Detail::Text(Cow::Borrowed(param)))
     }
     pub fn invalid_handle(id: u64) -> Self {
-        Self::new(3, format!("InvalidHandle: {}", id))
+        Self::with_kind(3, "InvalidHandle", Detail::Id(id))
     }
     pub fn wrong_handle_type(id: u64) -> Self {
-        Self::new(4, format!("WrongHandleType: {}", id))
+        Self::with_kind(4, "WrongHandleType", Detail::Id(id))
     }
     pub fn other<S: Into<String>>(msg: S) -> Self {
-        Self::new(5, format!("Other: {}", msg.into()))
+        Self::with_kind(5, "Other", Detail::Text(Cow::Owned(msg.into())))
+    }
+    pub const fn other_static(msg: &'static str) -> Self {
+        Self::with_kind(5, "Other", Detail::Text(Cow::Borrowed(msg)))
+    }
+    /// Code 5 error for a buffer whose size can't be valid
+    ///
+    /// Formats the length into the message; this is an error path.
+    pub(crate) fn invalid_buffer_size(param: &str, len: usize) -> Self {
+        Self::other(format!(
+            "Buffer size {len} is invalid for parameter '{param}'"
+        ))
+    }
+
+    /// The error code
+    pub fn code(&self) -> i32 {
+        self.code
+    }
+
+    /// The error message; borrowed when it was created from a single string
+    pub fn message(&self) -> Cow<'_, str> {
+        match (&self.detail, self.kind) {
+            (Detail::Text(text), "") => Cow::Borrowed(text),
+            _ => Cow::Owned(self.to_string()),
+        }
     }
 
     /// Peeks at the last error message without clearing it
     ///
     /// Returns None if no error is set. This does not clear the error.
     pub fn last_message() -> Option<String> {
-        LAST_ERROR.with(|prev| prev.borrow().as_ref().map(|e| e.message.clone()))
+        LAST_ERROR.with(|prev| prev.borrow().as_ref().map(|e| e.message().into_owned()))
     }
 
     /// Peeks at the last error code without clearing it
@@ -117,6 +171,8 @@ impl CimplError {
     }
 
     /// Sets this error as the last error
+    ///
+    /// Moves the error into the thread-local slot; nothing is copied.
     pub fn set_last(self) {
         LAST_ERROR.with(|prev| *prev.borrow_mut() = Some(self));
     }
@@ -130,10 +186,196 @@ impl CimplError {
     }
 }
 
+/// Formats the last error into the thread's text buffer
+///
+/// Calls `f` with the text (nul-terminated, truncated at any interior nul)
+/// and the error code, or with None if no error is set. The buffer keeps its
+/// capacity, so repeated queries stop allocating once it is large enough.
+fn with_last_text<R>(f: impl FnOnce(Option<(&[u8], i32)>) -> R) -> R {
+    LAST_ERROR.with(|last| {
+        let last = last.borrow();
+        let Some(error) = last.as_ref() else {
+            return f(None);
+        };
+        LAST_ERROR_TEXT.with(|text| {
+            let mut text = text.borrow_mut();
+            text.clear();
+            let _ = write!(text, "{error}");
+            if let Some(nul) = text.iter().position(|&b| b == 0) {
+                text.truncate(nul);
+            }
+            text.push(0);
+            f(Some((&text, error.code)))
+        })
+    })
+}
+
+/// Reads the last error without allocating or transferring ownership
+///
+/// Points `*msg` at the message text in thread-local storage. The text is
+/// nul-terminated and `*len` excludes the nul. It stays valid until the next
+/// cimpl call on this thread; do not free it. Any out-parameter may be NULL.
+///
+/// # Returns
+/// - `true` if an error is set
+/// - `false` if not; `*msg` is then NULL, `*len` 0 and `*code` 0
+///
+/// # Example (C)
+/// ```c
+/// const char* msg;
+/// size_t len;
+/// int32_t code;
+/// if (cimpl_last_error_view(&msg, &len, &code)) {
+///     fprintf(stderr, "Error %d: %.*s\n", code, (int)len, msg);
+/// }
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_last_error_view(
+    msg: *mut *const c_char,
+    len: *mut usize,
+    code: *mut i32,
+) -> bool {
+    with_last_text(|last| {
+        let (text, error_code) = last.unwrap_or((&[], 0));
+        // SAFETY: the caller passes NULL or valid out-parameters
+        unsafe {
+            if !msg.is_null() {
+                *msg = if last.is_some() {
+                    text.as_ptr() as *const c_char
+                } else {
+                    std::ptr::null()
+                };
+            }
+            if !len.is_null() {
+                *len = text.len().saturating_sub(1);
+            }
+            if !code.is_null() {
+                *code = error_code;
+            }
+        }
+        last.is_some()
+    })
+}
+
+/// Copies the last error message into a caller buffer with `snprintf` semantics
+///
+/// Writes at most `cap - 1` bytes plus a nul, never splitting a UTF-8
+/// character, and stores the error code in `*code` (0 if no error is set).
+/// `code` may be NULL. Does not change the last error.
+///
+/// # Returns
+/// - Length of the full message, excluding the nul (0 if no error is set).
+///   A value `>= cap` means the copy was truncated.
+/// - -1 if `buf` is NULL with a non-zero `cap`
+///
+/// # Example (C)
+/// ```c
+/// char msg[256];
+/// int32_t code;
+/// cimpl_last_error_copy(msg, sizeof msg, &code);
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_last_error_copy(buf: *mut c_char, cap: usize, code: *mut i32) -> isize {
+    if buf.is_null() && cap > 0 {
+        return -1;
+    }
+    with_last_text(|last| {
+        let (text, error_code) = last.unwrap_or((b"\0", 0));
+        // SAFETY: the text is `Display` output cut at a nul, so valid UTF-8
+        let text = unsafe { std::str::from_utf8_unchecked(&text[..text.len() - 1]) };
+        // SAFETY: the caller passes a buffer of `cap` bytes and NULL or a valid `code`
+        unsafe {
+            crate::utils::copy_c_string_into(text, buf, cap);
+            if !code.is_null() {
+                *code = error_code;
+            }
+        }
+        text.len() as isize
+    })
+}
+
 impl std::fmt::Display for CimplError {
     fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
-        write!(f, "{}", self.message)
+        if !self.kind.is_empty() {
+            write!(f, "{}: ", self.kind)?;
+        }
+        match &self.detail {
+            Detail::Text(text) => f.write_str(text),
+            Detail::Id(id) => write!(f, "{id}"),
+        }
     }
 }
 
 impl std::error::Error for CimplError {}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_messages_match_kind_prefix() {
+        assert_eq!(
+            CimplError::null_parameter("ptr").to_string(),
+            "NullParameter: ptr"
+        );
+        assert_eq!(
+            CimplError::invalid_handle(42).message(),
+            "InvalidHandle: 42"
+        );
+        assert_eq!(
+            CimplError::other(format!("bad {}", 1)).to_string(),
+            "Other: bad 1"
+        );
+        assert_eq!(
+            CimplError::invalid_buffer_size("data", 7).to_string(),
+            "Other: Buffer size 7 is invalid for parameter 'data'"
+        );
+        // Borrowed, non-static strings are accepted as before
+        let name = String::from("buf");
+        assert_eq!(
+            CimplError::null_parameter(name.as_str()).to_string(),
+            CimplError::null_parameter_static("buf").to_string()
+        );
+
+        let custom = CimplError::new(100, "ParseError: eof");
+        assert!(matches!(custom.message(), Cow::Borrowed("ParseError: eof")));
+        custom.set_last();
+        assert_eq!(
+            CimplError::last_message().as_deref(),
+            Some("ParseError: eof")
+        );
+        assert_eq!(CimplError::last_code(), 100);
+    }
+
+    #[test]
+    fn test_last_error_view_and_copy() {
+        CimplError::take_last();
+        let (mut msg, mut len, mut code) = (std::ptr::null(), 1, 1);
+        assert!(!cimpl_last_error_view(&mut msg, &mut len, &mut code));
+        assert!(msg.is_null());
+        assert_eq!((len, code), (0, 0));
+
+        CimplError::invalid_handle(12345).set_last();
+        assert!(cimpl_last_error_view(&mut msg, &mut len, &mut code));
+        let text = unsafe { std::ffi::CStr::from_ptr(msg) };
+        assert_eq!(text.to_bytes(), b"InvalidHandle: 12345");
+        assert_eq!((len, code), (20, 3));
+
+        // Truncation never splits a character, and the error stays set
+        CimplError::new(100, "caf\u{e9}").set_last();
+        let mut buf = [0x7F as c_char; 5];
+        let full = cimpl_last_error_copy(buf.as_mut_ptr(), buf.len(), &mut code);
+        assert_eq!((full, code), (5, 100));
+        let copied = unsafe { std::ffi::CStr::from_ptr(buf.as_ptr()) };
+        assert_eq!(copied.to_bytes(), b"caf");
+        assert_eq!(CimplError::last_code(), 100);
+        assert_eq!(
+            cimpl_last_error_copy(std::ptr::null_mut(), 0, std::ptr::null_mut()),
+            5
+        );
+        assert_eq!(
+            cimpl_last_error_copy(std::ptr::null_mut(), 1, std::ptr::null_mut()),
+            -1
+        );
+    }
+}
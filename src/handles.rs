@@ -0,0 +1,284 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Generational Handle Table
+//!
+//! An opt-in alternative to raw-pointer tracking. Objects are stored in a slab
+//! of slots and C receives an opaque `u64` handle instead of a pointer:
+//!
+//! ```text
+//! handle = (generation << 32) | slot index
+//! ```
+//!
+//! Validating a handle is an array index plus a generation and type compare,
+//! with no hashing and no per-object cleanup closure. Freeing a slot bumps its
+//! generation, so stale handles (use-after-free, double-free) are rejected even
+//! after the slot is reused. Handle `0` is never issued and acts as C's NULL.
+//!
+//! Use `box_handle!` to create handles and `deref_handle_or_return!` /
+//! `deref_handle_mut_or_return!` to use them; free with `cimpl_handle_free()`.
+
+use std::{any::TypeId, sync::RwLock};
+
+use crate::{
+    cimpl_error::CimplError,
+    utils::{drop_box, DropFn},
+};
+
+/// One slab slot; `drop_fn` is `None` while the slot is free
+struct Slot {
+    generation: u32,
+    type_id: TypeId,
+    ptr: usize,
+    drop_fn: Option<DropFn>,
+}
+
+#[derive(Default)]
+struct Slab {
+    slots: Vec<Slot>,
+    free: Vec<u32>,
+}
+
+/// Splits a handle into (slot index, generation)
+#[inline]
+fn split(handle: u64) -> (usize, u32) {
+    ((handle & 0xFFFF_FFFF) as usize, (handle >> 32) as u32)
+}
+
+#[inline]
+fn join(index: u32, generation: u32) -> u64 {
+    (generation as u64) << 32 | index as u64
+}
+
+/// Slab of generation-checked slots holding objects handed to C as `u64` handles
+pub struct HandleTable {
+    slab: RwLock<Slab>,
+}
+
+impl HandleTable {
+    /// Creates an empty handle table
+    pub fn new() -> Self {
+        Self {
+            slab: RwLock::new(Slab::default()),
+        }
+    }
+
+    /// Moves `value` into the table and returns its handle
+    pub fn insert_box<T: 'static>(&self, value: T) -> u64 {
+        let ptr = Box::into_raw(Box::new(value)) as usize;
+        let mut slab = self.slab.write().unwrap();
+        let type_id = TypeId::of::<T>();
+        let drop_fn = Some(drop_box::<T> as DropFn);
+        match slab.free.pop() {
+            Some(index) => {
+                let slot = &mut slab.slots[index as usize];
+                slot.type_id = type_id;
+                slot.ptr = ptr;
+                slot.drop_fn = drop_fn;
+                join(index, slot.generation)
+            }
+            None => {
+                let index = slab.slots.len() as u32;
+                slab.slots.push(Slot {
+                    generation: 1,
+                    type_id,
+                    ptr,
+                    drop_fn,
+                });
+                join(index, 1)
+            }
+        }
+    }
+
+    /// Resolves a handle to the object pointer if it is live and of type `T`
+    pub fn get<T: 'static>(&self, handle: u64) -> Result<*mut T, CimplError> {
+        if handle == 0 {
+            return Err(CimplError::null_parameter_static("handle"));
+        }
+
+        let (index, generation) = split(handle);
+        let slab = self.slab.read().unwrap();
+        match slab.slots.get(index) {
+            Some(slot) if slot.generation == generation && slot.drop_fn.is_some() => {
+                if slot.type_id == TypeId::of::<T>() {
+                    Ok(slot.ptr as *mut T)
+                } else {
+                    Err(CimplError::wrong_handle_type(handle))
+                }
+            }
+            _ => Err(CimplError::invalid_handle(handle)),
+        }
+    }
+
+    /// Frees the object behind a handle; stale or unknown handles are errors
+    pub fn remove(&self, handle: u64) -> Result<(), CimplError> {
+        if handle == 0 {
+            return Ok(()); // NULL is always safe
+        }
+
+        let (index, generation) = split(handle);
+        let (ptr, drop_fn) = {
+            let mut slab = self.slab.write().unwrap();
+            let slot = match slab.slots.get_mut(index) {
+                Some(slot) if slot.generation == generation && slot.drop_fn.is_some() => slot,
+                _ => return Err(CimplError::invalid_handle(handle)),
+            };
+            // Retire this generation; 0 is reserved so handles are never 0
+            slot.generation = slot.generation.wrapping_add(1).max(1);
+            let taken = (slot.ptr, slot.drop_fn.take());
+            slab.free.push(index as u32);
+            taken
+        }; // Release lock before running the destructor
+
+        if let Some(drop_fn) = drop_fn {
+            unsafe { drop_fn(ptr, 0) };
+        }
+        Ok(())
+    }
+
+    /// Number of live handles
+    pub fn len(&self) -> usize {
+        let slab = self.slab.read().unwrap();
+        slab.slots.len() - slab.free.len()
+    }
+
+    /// Returns true if no handles are live
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+impl Default for HandleTable {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Drop for HandleTable {
+    fn drop(&mut self) {
+        let leaked = self.len();
+        if leaked > 0 {
+            eprintln!(
+                "\n⚠️  WARNING: {} handle(s) were not freed at shutdown!",
+                leaked
+            );
+            eprintln!("Each handle should be freed exactly once with cimpl_handle_free().\n");
+        }
+    }
+}
+
+/// Get the global handle table
+pub(crate) fn get_handle_table() -> &'static HandleTable {
+    use std::sync::OnceLock;
+    static TABLE: OnceLock<HandleTable> = OnceLock::new();
+    TABLE.get_or_init(HandleTable::new)
+}
+
+/// Move a value into the global handle table and return its handle
+///
+/// Use `box_handle!` rather than calling this directly.
+pub fn track_handle<T: 'static>(value: T) -> u64 {
+    get_handle_table().insert_box(value)
+}
+
+/// Resolve a handle from the global table to a pointer of type `T`
+pub fn resolve_handle<T: 'static>(handle: u64) -> Result<*mut T, CimplError> {
+    get_handle_table().get::<T>(handle)
+}
+
+/// Universal free function for handles created with `box_handle!`
+///
+/// # Returns
+/// - 0 on success (or if handle is 0)
+/// - -1 if the handle is invalid, stale or already freed
+///
+/// # Example (C)
+/// ```c
+/// uint64_t thing = thing_new(42);
+/// thing_add(thing, 1);
+/// cimpl_handle_free(thing);
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_handle_free(handle: u64) -> i32 {
+    match get_handle_table().remove(handle) {
+        Ok(()) => 0,
+        Err(e) => {
+            e.set_last();
+            -1
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_handle_roundtrip() {
+        let table = HandleTable::new();
+        let handle = table.insert_box(String::from("hello"));
+        assert_ne!(handle, 0);
+
+        let ptr = table.get::<String>(handle).unwrap();
+        assert_eq!(unsafe { &*ptr }, "hello");
+        assert!(table.get::<u32>(handle).is_err());
+
+        assert!(table.remove(handle).is_ok());
+        assert!(table.remove(handle).is_err()); // double free detected
+        assert!(table.is_empty());
+    }
+
+    #[test]
+    fn test_stale_handle_rejected_after_slot_reuse() {
+        let table = HandleTable::new();
+        let first = table.insert_box(1u32);
+        table.remove(first).unwrap();
+
+        // Same slot, new generation
+        let second = table.insert_box(2u32);
+        assert_eq!(split(first).0, split(second).0);
+        assert_ne!(first, second);
+
+        assert_eq!(
+            table.get::<u32>(first).unwrap_err().to_string(),
+            format!("InvalidHandle: {first}")
+        );
+        assert_eq!(unsafe { *table.get::<u32>(second).unwrap() }, 2);
+        table.remove(second).unwrap();
+    }
+
+    #[test]
+    fn test_handle_macros() {
+        fn make(value: i32) -> u64 {
+            crate::box_handle!(value)
+        }
+        fn bump(handle: u64) -> i32 {
+            let value = crate::deref_handle_mut_or_return_neg!(handle, i32);
+            *value += 1;
+            *value
+        }
+        fn read(handle: u64) -> i32 {
+            *crate::deref_handle_or_return_neg!(handle, i32)
+        }
+
+        let handle = make(41);
+        assert_eq!(bump(handle), 42);
+        assert_eq!(read(handle), 42);
+        assert_eq!(read(0), -1);
+        assert_eq!(CimplError::last_code(), 1);
+        assert_eq!(cimpl_handle_free(handle), 0);
+        assert_eq!(read(handle), -1);
+        assert_eq!(CimplError::last_code(), 3);
+        assert_eq!(cimpl_handle_free(handle), -1);
+    }
+}
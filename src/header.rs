@@ -0,0 +1,477 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Object Headers
+//!
+//! With the `object-header` feature, `box_tracked!` and `arc_tracked!` place a
+//! header directly in front of each object:
+//!
+//! ```text
+//! [ refs: usize ][ magic: u32 | state: u32 | type hash: u64 ][ object ... ]
+//!                                                             ^ pointer handed to C
+//! ```
+//!
+//! `validate_pointer()` then checks the header, which shares a cache line with
+//! the data the caller is about to touch, instead of hashing the address into
+//! the global registry. Objects are still tracked, so `cimpl_free()` keeps
+//! rejecting double-frees and leaks are still reported; only validation skips
+//! the registry.
+//!
+//! Headered objects live in slots of 1MB chunks that are never handed back to
+//! the allocator; a freed slot is reused by a later object of the same size
+//! class. A chunk map, also never freed, records which chunks are ours, so the
+//! fast path only reads a header when the pointer lies in one of them: stale,
+//! stack, static and foreign pointers are rejected without touching their
+//! memory.
+//!
+//! A header that doesn't match (pointers from `to_c_string`, arenas, manual
+//! `track_box()` calls, objects too large for a slot, or bogus pointers) falls
+//! back to the registry, which produces the precise error.
+//! `cimpl_set_paranoid(true)` validates every pointer against the registry
+//! without reading the header.
+
+use std::{
+    alloc::{alloc_zeroed, dealloc, Layout},
+    any::TypeId,
+    hash::{Hash, Hasher},
+    mem::offset_of,
+    ptr::{addr_of, addr_of_mut},
+    sync::{
+        atomic::{fence, AtomicBool, AtomicPtr, AtomicU32, AtomicU64, AtomicUsize, Ordering},
+        Arc, Mutex, PoisonError,
+    },
+};
+
+/// First word of every header
+const MAGIC: u32 = 0xC1AB_0B1E;
+
+/// `state` of a boxed object that has not been freed
+const LIVE: u32 = 0x4C49_5645;
+
+/// `state` of a reference-counted object that has not been freed; it only
+/// validates for shared borrows
+const SHARED: u32 = 0x5348_5244;
+
+/// `state` written just before the object is dropped
+const FREED: u32 = 0xDEAD_F4EE;
+
+/// Pointers below this are never looked up
+const MIN_ADDRESS: usize = 4096;
+
+/// Chunks are aligned to their size, so `address >> CHUNK_SHIFT` names one
+const CHUNK_SHIFT: u32 = 20;
+const CHUNK_SIZE: usize = 1 << CHUNK_SHIFT;
+
+/// Slot sizes are powers of two from `MIN_SLOT` to `MAX_SLOT`; larger objects
+/// are allocated without a header
+const MIN_SLOT: usize = 32;
+const MAX_SLOT: usize = 4096;
+const CLASSES: usize = (MAX_SLOT / MIN_SLOT).trailing_zeros() as usize + 1;
+
+/// The chunk map covers 48-bit addresses in two levels
+const ADDRESS_BITS: u32 = 48;
+const LEAF_BITS: u32 = 14;
+const ROOT_BITS: u32 = ADDRESS_BITS - CHUNK_SHIFT - LEAF_BITS;
+
+static PARANOID: AtomicBool = AtomicBool::new(false);
+
+/// One bit per chunk: set once the chunk belongs to the slab
+struct Leaf([AtomicU64; 1 << (LEAF_BITS - 6)]);
+
+#[allow(clippy::declare_interior_mutable_const)]
+const NO_LEAF: AtomicPtr<Leaf> = AtomicPtr::new(std::ptr::null_mut());
+static CHUNK_MAP: [AtomicPtr<Leaf>; 1 << ROOT_BITS] = [NO_LEAF; 1 << ROOT_BITS];
+
+/// Free slots and the unused tail of the newest chunk of one size class
+struct Class {
+    free: Vec<usize>,
+    next: usize,
+    end: usize,
+}
+
+#[allow(clippy::declare_interior_mutable_const)]
+const EMPTY_CLASS: Mutex<Class> = Mutex::new(Class {
+    free: Vec::new(),
+    next: 0,
+    end: 0,
+});
+static SLAB: [Mutex<Class>; CLASSES] = [EMPTY_CLASS; CLASSES];
+
+#[repr(C)]
+struct ObjectHeader {
+    magic: AtomicU32,
+    state: AtomicU32,
+    type_hash: AtomicU64,
+}
+
+/// A tracked object and its header, in one slot
+#[repr(C)]
+struct Headered<T> {
+    /// References held by C and byte views; the slot is freed at zero
+    refs: AtomicUsize,
+    header: ObjectHeader,
+    value: T,
+}
+
+/// Folds a `TypeId` into a `u64` without the cost of SipHash
+#[derive(Default)]
+struct TypeHasher(u64);
+
+impl Hasher for TypeHasher {
+    fn write(&mut self, bytes: &[u8]) {
+        for &byte in bytes {
+            self.write_u64(byte as u64);
+        }
+    }
+
+    #[inline]
+    fn write_u64(&mut self, word: u64) {
+        self.0 = (self.0.rotate_left(5) ^ word).wrapping_mul(0x517C_C1B7_2722_0A95);
+    }
+
+    fn finish(&self) -> u64 {
+        self.0
+    }
+}
+
+#[inline]
+fn type_hash<T: 'static>() -> u64 {
+    let mut hasher = TypeHasher::default();
+    TypeId::of::<T>().hash(&mut hasher);
+    hasher.finish()
+}
+
+/// True if `address` lies in a chunk of the slab
+#[inline]
+fn in_slab(address: usize) -> bool {
+    let chunk = address >> CHUNK_SHIFT;
+    if chunk >> (ROOT_BITS + LEAF_BITS) != 0 {
+        return false;
+    }
+    let leaf = CHUNK_MAP[chunk >> LEAF_BITS].load(Ordering::Acquire);
+    if leaf.is_null() {
+        return false;
+    }
+    let bit = chunk & ((1 << LEAF_BITS) - 1);
+    // SAFETY: leaves are never freed once published
+    let word = unsafe { &(*leaf).0[bit >> 6] };
+    word.load(Ordering::Acquire) & (1 << (bit & 63)) != 0
+}
+
+/// Allocates a zeroed chunk, adds it to the chunk map and never frees it
+fn new_chunk() -> Option<usize> {
+    let layout = Layout::from_size_align(CHUNK_SIZE, CHUNK_SIZE).ok()?;
+    // SAFETY: the layout has a non-zero size
+    let chunk = unsafe { alloc_zeroed(layout) } as usize;
+    if chunk == 0 {
+        return None;
+    }
+    let index = chunk >> CHUNK_SHIFT;
+    if index >> (ROOT_BITS + LEAF_BITS) != 0 {
+        // Beyond the map: fall back to allocating without a header
+        unsafe { dealloc(chunk as *mut u8, layout) };
+        return None;
+    }
+
+    let root = &CHUNK_MAP[index >> LEAF_BITS];
+    let mut leaf = root.load(Ordering::Acquire);
+    if leaf.is_null() {
+        #[allow(clippy::declare_interior_mutable_const)]
+        const CLEAR: AtomicU64 = AtomicU64::new(0);
+        let fresh = Box::into_raw(Box::new(Leaf([CLEAR; 1 << (LEAF_BITS - 6)])));
+        leaf = match root.compare_exchange(
+            std::ptr::null_mut(),
+            fresh,
+            Ordering::AcqRel,
+            Ordering::Acquire,
+        ) {
+            Ok(_) => fresh,
+            Err(existing) => {
+                // SAFETY: never published
+                drop(unsafe { Box::from_raw(fresh) });
+                existing
+            }
+        };
+    }
+    let bit = index & ((1 << LEAF_BITS) - 1);
+    // Release: the zeroed chunk is visible to anyone who sees the bit
+    unsafe { &(*leaf).0[bit >> 6] }.fetch_or(1 << (bit & 63), Ordering::Release);
+    Some(chunk)
+}
+
+/// Size of the slot a `Headered<T>` needs, or None if it is too large
+#[inline]
+fn slot_size<T>() -> Option<usize> {
+    let layout = Layout::new::<Headered<T>>();
+    let size = layout
+        .size()
+        .max(layout.align())
+        .max(MIN_SLOT)
+        .next_power_of_two();
+    (size <= MAX_SLOT).then_some(size)
+}
+
+fn class(size: usize) -> &'static Mutex<Class> {
+    &SLAB[(size / MIN_SLOT).trailing_zeros() as usize]
+}
+
+fn alloc_slot(size: usize) -> Option<usize> {
+    let mut class = class(size).lock().unwrap_or_else(PoisonError::into_inner);
+    if let Some(slot) = class.free.pop() {
+        return Some(slot);
+    }
+    if class.next == class.end {
+        let chunk = new_chunk()?;
+        class.next = chunk;
+        class.end = chunk + CHUNK_SIZE;
+    }
+    let slot = class.next;
+    class.next += size;
+    Some(slot)
+}
+
+impl<T: 'static> Headered<T> {
+    /// Offset of the value from the start of the slot
+    const VALUE: usize = offset_of!(Self, value);
+
+    /// The slot that `ptr` (a pointer to `value`) lives in
+    #[inline]
+    fn from_value(ptr: usize) -> *mut Self {
+        (ptr - Self::VALUE) as *mut Self
+    }
+
+    /// Moves `value` into a new slot, or hands it back if there is none
+    ///
+    /// `state` is `LIVE` or `SHARED`.
+    fn alloc(value: T, state: u32) -> Result<*mut T, T> {
+        let Some(slot) = slot_size::<T>().and_then(alloc_slot) else {
+            return Err(value);
+        };
+        let this = slot as *mut Self;
+        // SAFETY: the slot is ours, large and aligned enough for Self, and no
+        // validator trusts it until `state` says it is live
+        unsafe {
+            addr_of_mut!((*this).value).write(value);
+            (*this).refs.store(1, Ordering::Relaxed);
+            let header = &(*this).header;
+            header.magic.store(MAGIC, Ordering::Relaxed);
+            header.type_hash.store(type_hash::<T>(), Ordering::Relaxed);
+            header.state.store(state, Ordering::Release);
+            Ok(addr_of_mut!((*this).value))
+        }
+    }
+}
+
+/// Marks the object freed so stale pointers to it stop matching
+unsafe fn retire<T: 'static>(ptr: usize) {
+    let headered = Headered::<T>::from_value(ptr);
+    (*headered).header.state.store(FREED, Ordering::Release);
+}
+
+/// Releases one reference, dropping the object and freeing its slot at zero
+unsafe fn release_arc<T: 'static>(ptr: usize, _len: usize) {
+    let headered = Headered::<T>::from_value(ptr);
+    if (*headered).refs.fetch_sub(1, Ordering::Release) != 1 {
+        return;
+    }
+    fence(Ordering::Acquire);
+    std::ptr::drop_in_place(addr_of_mut!((*headered).value));
+    if let Some(size) = slot_size::<T>() {
+        class(size)
+            .lock()
+            .unwrap_or_else(PoisonError::into_inner)
+            .free
+            .push(headered as usize);
+    }
+}
+
+/// Releases C's reference to an object allocated by `alloc_box()`/`alloc_arc()`
+///
+/// Other references (e.g. byte views) may keep the object alive, but C's
+/// pointer stops validating.
+unsafe fn drop_tracked<T: 'static>(ptr: usize, len: usize) {
+    retire::<T>(ptr);
+    release_arc::<T>(ptr, len);
+}
+
+/// Adds a reference to an object allocated by `alloc_arc()`
+unsafe fn retain_arc<T: 'static>(ptr: usize) {
+    (*Headered::<T>::from_value(ptr))
+        .refs
+        .fetch_add(1, Ordering::Relaxed);
+}
+
+/// Puts `value` in a headered slot and tracks it
+///
+/// Objects too large for a slot are boxed and tracked without a header.
+#[track_caller]
+pub(crate) fn alloc_box<T: 'static>(value: T) -> *mut T {
+    match Headered::alloc(value, LIVE) {
+        Ok(ptr) => {
+            crate::utils::get_registry().track_as::<T>(ptr as usize, drop_tracked::<T>, 0);
+            ptr
+        }
+        Err(value) => {
+            let ptr = Box::into_raw(Box::new(value));
+            crate::utils::track_box(ptr);
+            ptr
+        }
+    }
+}
+
+/// Puts a reference-counted `value` in a headered slot and tracks it
+///
+/// Objects too large for a slot go in an `Arc` without a header.
+#[track_caller]
+pub(crate) fn alloc_arc<T: 'static>(value: T) -> *mut T {
+    match Headered::alloc(value, SHARED) {
+        Ok(ptr) => {
+            crate::utils::get_registry().track_shared_with::<T>(
+                ptr as usize,
+                drop_tracked::<T>,
+                retain_arc::<T>,
+                release_arc::<T>,
+            );
+            ptr
+        }
+        Err(value) => {
+            let ptr = Arc::into_raw(Arc::new(value)) as *mut T;
+            crate::utils::track_arc(ptr);
+            ptr
+        }
+    }
+}
+
+/// Checks the header in front of `ptr` without touching the registry
+///
+/// Returns false if the header is missing, retired or for a different type,
+/// if `exclusive` is set and the object is shared, or if paranoid validation
+/// is on; the caller then asks the registry.
+#[inline]
+pub(crate) fn is_live<T: 'static>(ptr: usize, exclusive: bool) -> bool {
+    !PARANOID.load(Ordering::Relaxed) && has_live_header::<T>(ptr, exclusive)
+}
+
+/// True if `ptr` was allocated by `alloc_box()` (or, unless `exclusive`,
+/// `alloc_arc()`) and not freed
+#[inline]
+fn has_live_header<T: 'static>(ptr: usize, exclusive: bool) -> bool {
+    let Some(size) = slot_size::<T>() else {
+        return false;
+    };
+    if ptr < MIN_ADDRESS {
+        return false;
+    }
+    let slot = ptr - Headered::<T>::VALUE;
+    if slot & (size - 1) != 0 || !in_slab(slot) {
+        return false;
+    }
+    // SAFETY: slab memory is never freed, so any slot of it may be read; the
+    // header is only written through atomics
+    let header = unsafe { &*addr_of!((*(slot as *const Headered<T>)).header) };
+    let state = header.state.load(Ordering::Acquire);
+    header.magic.load(Ordering::Relaxed) == MAGIC
+        && (state == LIVE || (state == SHARED && !exclusive))
+        && header.type_hash.load(Ordering::Relaxed) == type_hash::<T>()
+}
+
+/// Turns paranoid validation on or off, returning the previous setting
+pub fn set_paranoid(enabled: bool) -> bool {
+    PARANOID.swap(enabled, Ordering::Relaxed)
+}
+
+/// Validate every pointer against the registry instead of its header
+///
+/// Use while debugging a host that may pass stack, static or foreign
+/// pointers; returns the previous setting.
+///
+/// # Example (C)
+/// ```c
+/// cimpl_set_paranoid(true);
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_set_paranoid(enabled: bool) -> bool {
+    set_paranoid(enabled)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::utils::{cimpl_free, validate_pointer};
+
+    #[repr(align(32))]
+    struct Wide([u8; 32]);
+
+    #[test]
+    fn test_header_validates_without_registry() {
+        let ptr = crate::box_tracked!(String::from("header"));
+        assert!(is_live::<String>(ptr as usize, false));
+        assert!(!is_live::<u64>(ptr as usize, false));
+        assert!(validate_pointer(ptr).is_ok());
+        assert!(validate_pointer(ptr as *mut u64).is_err());
+
+        let wide = crate::box_tracked!(Wide([7; 32]));
+        assert_eq!(wide as usize % 32, 0);
+        assert!(is_live::<Wide>(wide as usize, false));
+        assert_eq!(unsafe { &*wide }.0[31], 7);
+
+        assert_eq!(cimpl_free(ptr as *mut _), 0);
+        assert_eq!(cimpl_free(ptr as *mut _), -1); // registry still catches it
+        assert_eq!(cimpl_free(wide as *mut _), 0);
+    }
+
+    #[test]
+    fn test_shared_header_retired_on_free() {
+        let ptr = crate::arc_tracked!(vec![1u8, 2, 3]);
+        assert!(is_live::<Vec<u8>>(ptr as usize, false));
+        assert!(!is_live::<Vec<u8>>(ptr as usize, true));
+        let view = crate::bytes_view(ptr, |v: &Vec<u8>| v.as_slice()).unwrap();
+        assert_eq!(cimpl_free(ptr as *mut _), 0);
+
+        // The view keeps the object alive, but C's pointer no longer validates
+        assert!(!is_live::<Vec<u8>>(ptr as usize, false));
+        assert!(validate_pointer(ptr).is_err());
+        assert_eq!(unsafe { &*view }.as_slice(), &[1, 2, 3]);
+        assert_eq!(cimpl_free(view as *mut _), 0);
+    }
+
+    #[test]
+    fn test_header_never_reads_foreign_memory() {
+        // Freed slots stay mapped, so a stale pointer is rejected safely
+        let ptr = crate::box_tracked!(11u64);
+        assert_eq!(cimpl_free(ptr as *mut _), 0);
+        assert!(!is_live::<u64>(ptr as usize, false));
+        assert!(validate_pointer(ptr).is_err());
+
+        // Pointers outside the slab are never dereferenced
+        let untracked = 0u64;
+        assert!(!is_live::<u64>(&untracked as *const u64 as usize, false));
+        assert!(!is_live::<u64>(0xdead0, false));
+
+        // Objects too large for a slot are tracked without a header
+        let big = crate::box_tracked!([0u8; 2 * MAX_SLOT]);
+        assert!(!is_live::<[u8; 2 * MAX_SLOT]>(big as usize, false));
+        assert!(validate_pointer(big).is_ok());
+        assert_eq!(cimpl_free(big as *mut _), 0);
+    }
+
+    #[test]
+    fn test_paranoid_mode_uses_registry() {
+        let ptr = crate::box_tracked!(5u32);
+        let previous = set_paranoid(true);
+        assert!(!is_live::<u32>(ptr as usize, false));
+        assert!(validate_pointer(ptr).is_ok());
+        set_paranoid(previous);
+        assert_eq!(cimpl_free(ptr as *mut _), 0);
+    }
+}
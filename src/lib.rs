@@ -19,8 +19,27 @@
 //!
 //! - **Handle-based API**: Thread-safe handle management system for passing Rust objects to C
 //! - **Allocation tracking**: Prevents double-free of raw pointers with automatic leak detection
+//! - **Shared ownership**: `cimpl_retain()`/`cimpl_release()` reference-count `arc_tracked!` objects
+//! - **Generational handles**: Optional `u64` handle table with O(1) validation
+//! - **Pools**: `box_pooled!` recycles slots for small result types, bypassing the registry
+//! - **Arenas**: Scoped bump allocation for bursts of short-lived results
+//! - **Batched calls**: Packed offsets+data strings in, one `CimplBatch` allocation out, with
+//!   per-item error codes; the `parallel` feature spreads large batches over a rayon pool
+//! - **Registry statistics**: Cheap live/track/free/contention counters, exportable to Prometheus
+//! - **Live object dumps**: `cimpl_registry_dump()` lists live objects by type; the `leak-trace`
+//!   feature adds each object's allocation site and sampled backtraces
+//! - **Arrow columns**: Export and import `ArrowArray`/`ArrowSchema` (Arrow C Data Interface)
+//!   for zero-copy columnar results in pyarrow, Java or Go
+//! - **Byte views**: Zero-copy `(data, len)` views that keep their parent object alive
+//! - **Error views**: Read the last error in place with `cimpl_last_error_view()`
+//! - **Trusted derefs**: `deref_trusted_*` macros (or the `unchecked-handles` feature) skip
+//!   registry lookups in release builds
+//! - **Object headers**: Optional `object-header` feature validates `box_tracked!` objects by
+//!   an inline type tag instead of a registry lookup
 //! - **Buffer safety**: Validates buffer sizes and pointer arithmetic
 //! - **FFI macros**: Ergonomic macros for null checks, string conversion, and error handling
+//! - **Generated wrappers**: With the `macros` feature, `#[cimpl::export]` writes the
+//!   `extern "C"` wrapper for a plain Rust function, including optional `_batch` variants
 //!
 //! ## Example
 //!
@@ -40,25 +59,181 @@
 //! }
 //! ```
 
+// The C API is made of safe `extern "C"` functions taking raw pointers: the
+// macros reject NULL and stale handles, and C is responsible for the rest.
+#![allow(clippy::not_unsafe_ptr_arg_deref)]
+
+// Lets `#[cimpl::export]` output, which names `::cimpl`, build inside this crate
+extern crate self as cimpl;
+
 // Declare foundational modules first
+pub mod arena;
+pub mod arrow;
+pub mod batch;
 pub mod cimpl_error;
+pub mod handles;
+#[cfg(feature = "object-header")]
+pub mod header;
+pub mod pool;
+pub mod scan;
+pub mod stats;
+pub mod trace;
 pub mod utils;
+pub mod views;
 
 // Then macros that depend on them
 #[macro_use]
 pub mod macros;
 
 // Re-export main types and functions for convenience
-pub use cimpl_error::{CimplError, Result};
+pub use arena::{
+    cimpl_arena_free, cimpl_arena_new, cimpl_arena_reset, cimpl_arena_set_current, CimplArena,
+};
+pub use arrow::{ArrowArray, ArrowColumn, ArrowSchema, ArrowView, ImportedColumn};
+pub use batch::{BatchBuilder, CimplBatch, PackedStrings};
+pub use cimpl_error::{cimpl_last_error_copy, cimpl_last_error_view, CimplError, Result};
+pub use handles::{cimpl_handle_free, track_handle};
+#[cfg(feature = "object-header")]
+pub use header::{cimpl_set_paranoid, set_paranoid};
+pub use pool::{alloc_pooled, Pooled};
+pub use stats::{
+    cimpl_registry_stats, cimpl_registry_stats_prometheus, cimpl_registry_type_stats,
+    CimplRegistryStats,
+};
+#[cfg(feature = "leak-trace")]
+pub use trace::set_backtrace_sampling;
+pub use trace::{
+    cimpl_registry_dump, cimpl_trace_set_sampling, live_objects, CimplLiveObject, LiveObject,
+};
 pub use utils::{
-    cimpl_free, safe_slice_from_raw_parts, to_c_bytes, to_c_string, track_arc, track_arc_mutex,
-    track_box,
+    alloc_shared, alloc_tracked, cimpl_free, cimpl_free_many, cimpl_release, cimpl_retain,
+    safe_slice_from_raw_parts, to_c_bytes, to_c_string, to_c_strings, track_arc, track_arc_mutex,
+    track_box, track_many, write_c_string_into,
 };
+pub use views::{bytes_view, CimplBytesView};
+
+#[cfg(feature = "macros")]
+pub use cimpl_macros::export;
 
 // Re-export internal utilities (for macro use only - not part of public API)
 #[doc(hidden)]
-pub use utils::validate_pointer;
+pub use handles::resolve_handle;
+#[doc(hidden)]
+pub use utils::safe_slice_from_raw_parts_static;
+#[doc(hidden)]
+pub use utils::{validate_deref, validate_deref_mut, validate_trusted, validate_trusted_mut};
+#[doc(hidden)]
+pub use utils::{validate_pointer, validate_pointer_mut};
 
 // Re-export paste for use by our macros
 #[doc(hidden)]
 pub use paste;
+
+#[cfg(all(test, feature = "macros"))]
+mod export_tests {
+    use std::{
+        ffi::{CStr, CString},
+        os::raw::c_char,
+    };
+
+    use crate::{cimpl_free, CimplError};
+
+    struct Counter {
+        hits: u32,
+    }
+
+    #[crate::export]
+    fn export_counter_new(start: u32) -> Counter {
+        Counter { hits: start }
+    }
+
+    #[crate::export(out)]
+    fn export_counter_hit(counter: &mut Counter, by: u32) -> u32 {
+        counter.hits += by;
+        counter.hits
+    }
+
+    #[crate::export]
+    fn export_counter_peek(counter: Option<&Counter>) -> i64 {
+        counter.map_or(0, |counter| counter.hits as i64)
+    }
+
+    #[crate::export(batch)]
+    fn export_shout(text: &str) -> String {
+        text.to_uppercase()
+    }
+
+    #[crate::export(batch)]
+    fn export_parse(text: &str) -> Result<i64, CimplError> {
+        text.parse()
+            .map_err(|_| CimplError::new(100, format!("not a number: {text}")))
+    }
+
+    #[crate::export(out)]
+    fn export_sum(bytes: &[u8]) -> u64 {
+        bytes.iter().map(|&b| b as u64).sum()
+    }
+
+    #[crate::export(name = "export_greeting_ffi")]
+    fn greeting(name: Option<&str>) -> Option<String> {
+        name.map(|name| format!("hi {name}"))
+    }
+
+    fn take(ptr: *mut c_char) -> String {
+        let text = unsafe { CStr::from_ptr(ptr) }.to_str().unwrap().to_owned();
+        assert_eq!(cimpl_free(ptr as *mut _), 0);
+        text
+    }
+
+    #[test]
+    fn test_export_objects_and_strings() {
+        let counter = export_counter_new(5);
+        let mut hits = 0u32;
+        assert_eq!(export_counter_hit(counter, 2, &mut hits), 0);
+        assert_eq!(hits, 7);
+        assert_eq!(export_counter_hit(std::ptr::null_mut(), 1, &mut hits), -1);
+        assert_eq!(CimplError::last_code(), 1);
+        assert_eq!(export_counter_peek(counter), 7);
+        assert_eq!(export_counter_peek(std::ptr::null_mut()), 0);
+        #[cfg(not(feature = "unchecked-handles"))]
+        assert_eq!(export_counter_peek(0x1230 as *mut Counter), -1);
+        assert_eq!(cimpl_free(counter as *mut _), 0);
+
+        let input = CString::new("quiet").unwrap();
+        assert_eq!(take(export_shout(input.as_ptr())), "QUIET");
+        assert!(export_shout(std::ptr::null()).is_null());
+
+        // The Rust function stays callable when exported under another name
+        assert_eq!(greeting(Some("a")).as_deref(), Some("hi a"));
+        assert_eq!(take(export_greeting_ffi(input.as_ptr())), "hi quiet");
+        assert!(export_greeting_ffi(std::ptr::null()).is_null());
+    }
+
+    #[test]
+    fn test_export_out_params_and_batches() {
+        let mut sum = 0u64;
+        assert_eq!(export_sum([1u8, 2, 3].as_ptr(), 3, &mut sum), 0);
+        assert_eq!(sum, 6);
+        assert_eq!(export_sum(std::ptr::null(), 0, &mut sum), 0);
+        assert_eq!(sum, 0);
+        assert_eq!(export_sum(std::ptr::null(), 0, std::ptr::null_mut()), -1);
+
+        let offsets = [0i64, 2, 3];
+        let data = b"12x";
+        let batch = export_shout_batch(offsets.as_ptr(), data.as_ptr(), 3, 2);
+        assert_eq!(unsafe { &*batch }.get(1), b"X");
+        assert_eq!(cimpl_free(batch as *mut _), 0);
+
+        let (mut out, mut codes) = ([0i64; 2], [-1i32; 2]);
+        let failed = export_parse_batch(
+            offsets.as_ptr(),
+            data.as_ptr(),
+            3,
+            2,
+            out.as_mut_ptr(),
+            codes.as_mut_ptr(),
+        );
+        assert_eq!(failed, 1);
+        assert_eq!((out[0], codes), (12, [0, 100]));
+    }
+}
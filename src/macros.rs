@@ -58,12 +58,25 @@
 //! ## Input Validation (from C)
 //! - **Pointer from C**: `deref_or_return_null!(ptr, Type)` → validates & dereferences to `&Type`
 //! - **String from C**: `cstr_or_return_null!(c_str)` → converts C string to Rust `String`
+//! - **Borrowed string**: `cstr_borrow_or_return_null!(c_str)` → `Cow<str>` without copying
+//! - **String with length**: `cstr_borrow_len_or_return!(ptr, len, err)` → no nul scan
 //! - **Check not null**: `ptr_or_return_null!(ptr)` → just null check, no deref
+//! - **Handle from C**: `deref_handle_or_return_neg!(handle, Type)` → validates a `u64` handle
+//! - **Many strings from C**: `packed_strings_or_return!(offsets, data, len, count, err)` → one call
+//! - **Arrow column from C**: `arrow_import_or_return!(array, schema, err)` → `ImportedColumn`
 //!
 //! ## Output Creation (to C)
 //! - **Box a value**: `box_tracked!(value)` → heap allocate and return pointer
+//! - **Handle a value**: `box_handle!(value)` → store in handle table, return `u64` handle
+//! - **Small POD result**: `box_pooled!(value)` → recycled slot (type opts in with `impl_pooled!`)
+//! - **Result by value**: `write_out_or_return_int!(out, value)` → write to an out-parameter
+//! - **Batch of strings**: `batch_strings_or_return_null!(offsets, data, len, count, f)` → `CimplBatch`
+//! - **Batch of values**: `batch_values_or_return_neg!(offsets, data, len, count, out, f)` → fill array
+//! - **Fallible batch**: `batch_try_*!(..., codes, f)` → per-item error codes in `codes`
+//! - **Arrow column**: `arrow_export_or_return_neg!(column, out_array, out_schema)` → zero-copy
 //! - **Return string**: `to_c_string(rust_string)` → convert to C string
 //! - **Optional string**: `option_to_c_string!(opt)` → `None` becomes `NULL`
+//! - **Borrowed bytes**: `bytes_view_or_return_null!(ptr, Type, |obj| bytes)` → zero-copy view
 //!
 //! ## Error Handling
 //! - **External crate Result**: `ok_or_return_null!(result)` → uses From trait automatically
@@ -83,7 +96,9 @@
 //! | Rust Type              | C receives      | Macro to use                      | Example |
 //! |------------------------|-----------------|-----------------------------------|---------|
 //! | `*mut T` (from C)      | -               | `deref_or_return_null!(ptr, T)`   | Getting object from C |
+//! | `*mut T` (trusted C)   | -               | `deref_trusted_or_return_null!(ptr, T)` | Hot paths, trusted hosts |
 //! | `*const c_char` (from C)| -              | `cstr_or_return_null!(s)`         | Getting string from C |
+//! | `*const c_char` (borrowed)| -            | `cstr_borrow_or_return_null!(s)`  | Read-only string from C |
 //! | `Result<T, ExtErr>`    | pointer/int     | `ok_or_return_null!(r)`           | External crate errors (From trait) |
 //! | `Result<T, cimpl::Err>`| pointer/int     | `ok_or_return_null!(r)`           | Internal validation |
 //! | `Option<T>` validate   | pointer/int     | `some_or_return_other_null!(o, msg)` | Validation failures |
@@ -154,6 +169,21 @@
 //!     box_tracked!(new_date)
 //! }
 //! ```
+//!
+//! ## Pattern 5: String getter into a caller buffer (no allocation)
+//! ```rust,ignore
+//! /// Returns the name length; a result >= cap means the name was truncated
+//! #[no_mangle]
+//! pub extern "C" fn thing_name_into(
+//!     thing: *mut Thing,
+//!     buf: *mut c_char,
+//!     cap: usize,
+//!     out_len: *mut usize,
+//! ) -> isize {
+//!     let obj = deref_or_return_neg!(thing, Thing);
+//!     unsafe { write_c_string_into(obj.name(), buf, cap, out_len) }
+//! }
+//! ```
 
 // Re-export types/functions that macros need
 #[doc(hidden)]
@@ -186,7 +216,7 @@
 macro_rules! deref_or_return {
     ($ptr:expr, $type:ty, $err_val:expr) => {{
         $crate::ptr_or_return!($ptr, $err_val);
-        match $crate::validate_pointer::<$type>($ptr) {
+        match $crate::validate_deref::<$type>($ptr) {
             Ok(()) => unsafe { &*($ptr as *const $type) },
             Err(e) => {
                 e.set_last();
@@ -233,12 +263,13 @@ macro_rules! deref_or_return_false {
 }
 
 /// Validate pointer and dereference mutably, returning reference
-/// Returns early with custom value on error
+/// Returns early with custom value on error, including for shared
+/// (`arc_tracked!`) objects, which can only be borrowed immutably
 #[macro_export]
 macro_rules! deref_mut_or_return {
     ($ptr:expr, $type:ty, $err_val:expr) => {{
         $crate::ptr_or_return!($ptr, $err_val);
-        match $crate::validate_pointer::<$type>($ptr) {
+        match $crate::validate_deref_mut::<$type>($ptr) {
             Ok(()) => unsafe { &mut *($ptr as *mut $type) },
             Err(e) => {
                 e.set_last();
@@ -266,15 +297,93 @@ macro_rules! deref_mut_or_return_neg {
     }};
 }
 
+// ----------------------------------------------------------------------------
+// Trusted Deref Macros - Null check only in release builds
+// ----------------------------------------------------------------------------
+//
+// For call sites whose callers never pass foreign or stale pointers. Release
+// builds skip the registry lookup; debug builds still validate fully.
+// Building cimpl with the `unchecked-handles` feature makes every `deref_*`
+// macro behave this way.
+
+/// Dereference a pointer from a trusted caller, returning reference
+/// Returns early with custom value if NULL
+///
+/// The pointer must already be `*mut $type`; a pointer to another type is
+/// rejected at compile time:
+///
+/// ```compile_fail
+/// fn get(ptr: *mut u64) -> i32 {
+///     *cimpl::deref_trusted_or_return!(ptr, u32, -1) as i32
+/// }
+/// ```
+#[macro_export]
+macro_rules! deref_trusted_or_return {
+    ($ptr:expr, $type:ty, $err_val:expr) => {{
+        // No cast: a pointer to any other type must not compile
+        let ptr = $ptr;
+        match $crate::validate_trusted::<$type>(ptr) {
+            Ok(()) => unsafe { &*ptr },
+            Err(e) => {
+                e.set_last();
+                return $err_val;
+            }
+        }
+    }};
+}
+
+/// Dereference a pointer from a trusted caller, returning reference
+/// Returns NULL if NULL
+#[macro_export]
+macro_rules! deref_trusted_or_return_null {
+    ($ptr:expr, $type:ty) => {{
+        $crate::deref_trusted_or_return!($ptr, $type, std::ptr::null_mut())
+    }};
+}
+
+/// Dereference a pointer from a trusted caller, returning reference
+/// Returns -1 if NULL
+#[macro_export]
+macro_rules! deref_trusted_or_return_neg {
+    ($ptr:expr, $type:ty) => {{
+        $crate::deref_trusted_or_return!($ptr, $type, -1)
+    }};
+}
+
+/// Dereference a pointer from a trusted caller mutably, returning reference
+/// Returns early with custom value if NULL (or, in debug builds, if the
+/// pointer is invalid or shared)
+#[macro_export]
+macro_rules! deref_trusted_mut_or_return {
+    ($ptr:expr, $type:ty, $err_val:expr) => {{
+        // No cast: a pointer to any other type must not compile
+        let ptr = $ptr;
+        match $crate::validate_trusted_mut::<$type>(ptr) {
+            Ok(()) => unsafe { &mut *ptr },
+            Err(e) => {
+                e.set_last();
+                return $err_val;
+            }
+        }
+    }};
+}
+
+/// Dereference a pointer from a trusted caller mutably, returning reference
+/// Returns -1 if NULL
+#[macro_export]
+macro_rules! deref_trusted_mut_or_return_neg {
+    ($ptr:expr, $type:ty) => {{
+        $crate::deref_trusted_mut_or_return!($ptr, $type, -1)
+    }};
+}
+
 /// Create a Box-wrapped pointer and track it
+/// Allocates in the thread's current arena instead, if one is set
 /// Returns the raw pointer
 #[macro_export]
 macro_rules! box_tracked {
     ($expr:expr) => {{
-        let obj = $expr;
-        let ptr = Box::into_raw(Box::new(obj));
-        $crate::track_box(ptr);
-        ptr
+        $crate::alloc_tracked($expr)
     }};
 }
 
@@ -283,10 +392,336 @@ macro_rules! box_tracked {
 #[macro_export]
 macro_rules! arc_tracked {
     ($expr:expr) => {{
-        let obj = $expr;
-        let ptr = Arc::into_raw(Arc::new(obj)) as *mut _;
-        $crate::track_arc(ptr);
-        ptr
+        $crate::alloc_shared($expr)
+    }};
+}
+
+/// Allocate a value from its type's pool and return the raw pointer
+///
+/// The type must opt in with `impl_pooled!`. Free with `cimpl_free()` as usual;
+/// the slot is reused by the next `box_pooled!` of the same type.
+#[macro_export]
+macro_rules! box_pooled {
+    ($expr:expr) => {{
+        $crate::pool::alloc_pooled($expr)
+    }};
+}
+
+/// Give a type its own allocation pool so `box_pooled!` can allocate it
+#[macro_export]
+macro_rules! impl_pooled {
+    ($type:ty) => {
+        impl $crate::pool::Pooled for $type {
+            fn pool() -> &'static $crate::pool::Pool<Self> {
+                static POOL: $crate::pool::Pool<$type> = $crate::pool::Pool::new();
+                &POOL
+            }
+        }
+    };
+}
+
+/// Write a result through a C out-parameter or early-return with error value
+/// Returns early if the out-parameter is NULL
+#[macro_export]
+macro_rules! write_out_or_return {
+    ($out:expr, $value:expr, $err_val:expr) => {{
+        let out = $out;
+        if out.is_null() {
+            $crate::CimplError::null_parameter_static(stringify!($out)).set_last();
+            return $err_val;
+        }
+        let value = $value;
+        // SAFETY: C passes NULL or a pointer to writable storage for the type
+        unsafe { out.write(value) }
+    }};
+}
+
+/// Write a result through a C out-parameter, returning -1 if it is NULL
+#[macro_export]
+macro_rules! write_out_or_return_int {
+    ($out:expr, $value:expr) => {{
+        $crate::write_out_or_return!($out, $value, -1)
+    }};
+}
+
+/// Borrow `count` packed strings from C or early-return with error value
+/// Returns early if a buffer is NULL or the offsets are out of bounds
+#[macro_export]
+macro_rules! packed_strings_or_return {
+    ($offsets:expr, $data:expr, $data_len:expr, $count:expr, $err_val:expr) => {{
+        let (offsets, data) = ($offsets, $data);
+        let (data_len, count) = ($data_len as usize, $count as usize);
+        // SAFETY: C passes `count + 1` offsets and `data_len` bytes of data
+        match unsafe {
+            $crate::batch::PackedStrings::from_raw(offsets, data as *const u8, data_len, count)
+        } {
+            Ok(packed) => packed,
+            Err(e) => {
+                e.set_last();
+                return $err_val;
+            }
+        }
+    }};
+}
+
+/// Map packed strings from C to a packed `CimplBatch` or early-return with error value
+///
+/// `$f` takes each string as `&str` (invalid UTF-8 is replaced) and returns
+/// anything that is `AsRef<str>`. The whole result is one tracked allocation.
+///
+/// # Example
+/// ```rust,ignore
+/// #[no_mangle]
+/// pub extern "C" fn upper_batch(
+///     offsets: *const i64, data: *const u8, data_len: usize, count: usize,
+/// ) -> *mut CimplBatch {
+///     batch_strings_or_return_null!(offsets, data, data_len, count, |s: &str| s.to_uppercase())
+/// }
+/// ```
+#[macro_export]
+macro_rules! batch_strings_or_return {
+    ($offsets:expr, $data:expr, $data_len:expr, $count:expr, $f:expr, $err_val:expr) => {{
+        let packed =
+            $crate::packed_strings_or_return!($offsets, $data, $data_len, $count, $err_val);
+        $crate::batch::map_strings(&packed, $f)
+    }};
+}
+
+/// Map packed strings from C to a packed `CimplBatch`, returning NULL on error
+#[macro_export]
+macro_rules! batch_strings_or_return_null {
+    ($offsets:expr, $data:expr, $data_len:expr, $count:expr, $f:expr) => {{
+        $crate::batch_strings_or_return!(
+            $offsets,
+            $data,
+            $data_len,
+            $count,
+            $f,
+            std::ptr::null_mut()
+        )
+    }};
+}
+
+/// Map packed strings from C into a caller-provided array or early-return with error value
+///
+/// `$out` must have room for `count` results; nothing is allocated.
+#[macro_export]
+macro_rules! batch_values_or_return {
+    ($offsets:expr, $data:expr, $data_len:expr, $count:expr, $out:expr, $f:expr, $err_val:expr) => {{
+        let packed =
+            $crate::packed_strings_or_return!($offsets, $data, $data_len, $count, $err_val);
+        let out = $crate::batch_out_or_return!($out, packed.len(), $err_val);
+        $crate::batch::map_values(&packed, out, $f)
+    }};
+}
+
+/// Map packed strings from C into a caller-provided array, returning -1 on error
+#[macro_export]
+macro_rules! batch_values_or_return_neg {
+    ($offsets:expr, $data:expr, $data_len:expr, $count:expr, $out:expr, $f:expr) => {{
+        $crate::batch_values_or_return!($offsets, $data, $data_len, $count, $out, $f, -1)
+    }};
+}
+
+/// Borrow a caller-provided array of `$len` result slots or early-return with error value
+#[doc(hidden)]
+#[macro_export]
+macro_rules! batch_out_or_return {
+    ($out:expr, $len:expr, $err_val:expr) => {{
+        let out = $out;
+        if out.is_null() {
+            $crate::CimplError::null_parameter_static(stringify!($out)).set_last();
+            return $err_val;
+        }
+        let len = $len;
+        // SAFETY: C passes an array with room for `count` results
+        unsafe { std::slice::from_raw_parts_mut(out as *mut std::mem::MaybeUninit<_>, len) }
+    }};
+}
+
+/// Map packed strings from C through a fallible function to a `CimplBatch`,
+/// recording an error code per item, or early-return with error value
+///
+/// `$f` returns `Result<impl AsRef<str>, E>` where `CimplError: From<E>`.
+/// Failed items come back empty with their code in `$codes` (0 = success);
+/// the first failure is also set as the last error. Evaluates to the batch.
+///
+/// # Example
+/// ```rust,ignore
+/// #[no_mangle]
+/// pub extern "C" fn hex_decode_batch(
+///     offsets: *const i64, data: *const u8, data_len: usize, count: usize, codes: *mut i32,
+/// ) -> *mut CimplBatch {
+///     batch_try_strings_or_return_null!(offsets, data, data_len, count, codes, from_hex)
+/// }
+/// ```
+#[macro_export]
+macro_rules! batch_try_strings_or_return {
+    ($offsets:expr, $data:expr, $data_len:expr, $count:expr, $codes:expr, $f:expr, $err_val:expr) => {{
+        let packed =
+            $crate::packed_strings_or_return!($offsets, $data, $data_len, $count, $err_val);
+        let codes = $codes;
+        if codes.is_null() {
+            $crate::CimplError::null_parameter_static(stringify!($codes)).set_last();
+            return $err_val;
+        }
+        let f = $f;
+        // SAFETY: C passes an array with room for `count` error codes
+        unsafe { $crate::batch::try_map_strings(&packed, codes, f) }.0
+    }};
+}
+
+/// Map packed strings from C through a fallible function to a `CimplBatch`,
+/// returning NULL if the batch itself is invalid
+#[macro_export]
+macro_rules! batch_try_strings_or_return_null {
+    ($offsets:expr, $data:expr, $data_len:expr, $count:expr, $codes:expr, $f:expr) => {{
+        $crate::batch_try_strings_or_return!(
+            $offsets,
+            $data,
+            $data_len,
+            $count,
+            $codes,
+            $f,
+            std::ptr::null_mut()
+        )
+    }};
+}
+
+/// Map packed strings from C through a fallible function into a caller-provided
+/// array, recording an error code per item, or early-return with error value
+///
+/// The `$out` slots of failed items are left unchanged and their codes are
+/// written to `$codes` (0 = success); the first failure is also set as the
+/// last error. Evaluates to the number of failed items.
+#[macro_export]
+macro_rules! batch_try_values_or_return {
+    ($offsets:expr, $data:expr, $data_len:expr, $count:expr, $out:expr, $codes:expr, $f:expr, $err_val:expr) => {{
+        let packed =
+            $crate::packed_strings_or_return!($offsets, $data, $data_len, $count, $err_val);
+        let out = $crate::batch_out_or_return!($out, packed.len(), $err_val);
+        let codes = $codes;
+        if codes.is_null() {
+            $crate::CimplError::null_parameter_static(stringify!($codes)).set_last();
+            return $err_val;
+        }
+        let f = $f;
+        // SAFETY: C passes an array with room for `count` error codes
+        unsafe { $crate::batch::try_map_values(&packed, out, codes, f) }
+    }};
+}
+
+/// Map packed strings from C through a fallible function into a caller-provided
+/// array, returning -1 if the batch itself is invalid
+#[macro_export]
+macro_rules! batch_try_values_or_return_neg {
+    ($offsets:expr, $data:expr, $data_len:expr, $count:expr, $out:expr, $codes:expr, $f:expr) => {{
+        $crate::batch_try_values_or_return!(
+            $offsets, $data, $data_len, $count, $out, $codes, $f, -1
+        )
+    }};
+}
+
+/// Create a zero-copy byte view into an `arc_tracked!` object or early-return
+/// The closure selects bytes borrowed from the object; the view keeps the
+/// object alive until it is freed with `cimpl_free()`
+#[macro_export]
+macro_rules! bytes_view_or_return {
+    ($ptr:expr, $type:ty, $bytes:expr, $err_val:expr) => {{
+        match $crate::bytes_view::<$type>($ptr, $bytes) {
+            Ok(view) => view,
+            Err(e) => {
+                e.set_last();
+                return $err_val;
+            }
+        }
+    }};
+}
+
+/// Create a zero-copy byte view, returning NULL on error
+#[macro_export]
+macro_rules! bytes_view_or_return_null {
+    ($ptr:expr, $type:ty, $bytes:expr) => {{
+        $crate::bytes_view_or_return!($ptr, $type, $bytes, std::ptr::null_mut())
+    }};
+}
+
+// ----------------------------------------------------------------------------
+// Handle Macros - Generational u64 handles instead of raw pointers
+// ----------------------------------------------------------------------------
+
+/// Move a value into the handle table and return its `u64` handle
+/// Free the handle with `cimpl_handle_free()`
+#[macro_export]
+macro_rules! box_handle {
+    ($expr:expr) => {{
+        $crate::track_handle($expr)
+    }};
+}
+
+/// Validate handle and dereference immutably, returning reference
+/// Returns early with custom value on error
+#[macro_export]
+macro_rules! deref_handle_or_return {
+    ($handle:expr, $type:ty, $err_val:expr) => {{
+        match $crate::resolve_handle::<$type>($handle) {
+            Ok(ptr) => unsafe { &*(ptr as *const $type) },
+            Err(e) => {
+                e.set_last();
+                return $err_val;
+            }
+        }
+    }};
+}
+
+/// Validate handle and dereference immutably, returning reference
+/// Returns NULL on error
+#[macro_export]
+macro_rules! deref_handle_or_return_null {
+    ($handle:expr, $type:ty) => {{
+        $crate::deref_handle_or_return!($handle, $type, std::ptr::null_mut())
+    }};
+}
+
+/// Validate handle and dereference immutably, returning reference
+/// Returns -1 on error
+#[macro_export]
+macro_rules! deref_handle_or_return_neg {
+    ($handle:expr, $type:ty) => {{
+        $crate::deref_handle_or_return!($handle, $type, -1)
+    }};
+}
+
+/// Validate handle and dereference immutably, returning reference
+/// Returns 0 on error
+#[macro_export]
+macro_rules! deref_handle_or_return_zero {
+    ($handle:expr, $type:ty) => {{
+        $crate::deref_handle_or_return!($handle, $type, 0)
+    }};
+}
+
+/// Validate handle and dereference mutably, returning reference
+/// Returns early with custom value on error
+#[macro_export]
+macro_rules! deref_handle_mut_or_return {
+    ($handle:expr, $type:ty, $err_val:expr) => {{
+        match $crate::resolve_handle::<$type>($handle) {
+            Ok(ptr) => unsafe { &mut *ptr },
+            Err(e) => {
+                e.set_last();
+                return $err_val;
+            }
+        }
+    }};
+}
+
+/// Validate handle and dereference mutably, returning reference
+/// Returns -1 on error
+#[macro_export]
+macro_rules! deref_handle_mut_or_return_neg {
+    ($handle:expr, $type:ty) => {{
+        $crate::deref_handle_mut_or_return!($handle, $type, -1)
     }};
 }
 
@@ -298,7 +733,7 @@ pub const MAX_CSTRING_LEN: usize = 65536;
 macro_rules! ptr_or_return {
     ($ptr:expr, $err_val:expr) => {
         if $ptr.is_null() {
-            $crate::CimplError::null_parameter(stringify!($ptr).to_string()).set_last();
+            $crate::CimplError::null_parameter_static(stringify!($ptr)).set_last();
             return $err_val;
         }
     };
@@ -312,19 +747,18 @@ macro_rules! cstr_or_return {
     ($ptr:expr, $err_val:expr) => {{
         let ptr = $ptr;
         if ptr.is_null() {
-            $crate::CimplError::null_parameter(stringify!($ptr).to_string()).set_last();
+            $crate::CimplError::null_parameter_static(stringify!($ptr)).set_last();
             return $err_val;
         } else {
-            // SAFETY: We create a bounded slice up to MAX_CSTRING_LEN.
+            // SAFETY: We scan at most MAX_CSTRING_LEN bytes for the nul.
             // Caller must ensure ptr is valid for reading and points to a
             // null-terminated string within MAX_CSTRING_LEN bytes.
-            let bytes = unsafe {
-                std::slice::from_raw_parts(ptr as *const u8, $crate::macros::MAX_CSTRING_LEN)
-            };
-            match std::ffi::CStr::from_bytes_until_nul(bytes) {
-                Ok(cstr) => cstr.to_string_lossy().into_owned(),
-                Err(_) => {
-                    $crate::CimplError::string_too_long(stringify!($ptr).to_string()).set_last();
+            match unsafe {
+                $crate::scan::cstr_bytes(ptr as *const u8, $crate::macros::MAX_CSTRING_LEN)
+            } {
+                Some(bytes) => $crate::scan::utf8_lossy(bytes).into_owned(),
+                None => {
+                    $crate::CimplError::string_too_long_static(stringify!($ptr)).set_last();
                     return $err_val;
                 }
             }
@@ -340,17 +774,69 @@ macro_rules! cstr_or_return_with_limit {
         let ptr = $ptr;
         let max_len = $max_len;
         if ptr.is_null() {
-            $crate::CimplError::null_parameter(stringify!($ptr).to_string()).set_last();
+            $crate::CimplError::null_parameter_static(stringify!($ptr)).set_last();
             return $err_val;
         } else {
-            // SAFETY: We create a bounded slice up to max_len.
+            // SAFETY: We scan at most max_len bytes for the nul.
             // Caller must ensure ptr is valid for reading and points to a
             // null-terminated string within max_len bytes.
-            let bytes = unsafe { std::slice::from_raw_parts(ptr as *const u8, max_len) };
-            match std::ffi::CStr::from_bytes_until_nul(bytes) {
-                Ok(cstr) => cstr.to_string_lossy().into_owned(),
-                Err(_) => {
-                    $crate::CimplError::string_too_long(stringify!($ptr).to_string()).set_last();
+            match unsafe { $crate::scan::cstr_bytes(ptr as *const u8, max_len) } {
+                Some(bytes) => $crate::scan::utf8_lossy(bytes).into_owned(),
+                None => {
+                    $crate::CimplError::string_too_long_static(stringify!($ptr)).set_last();
+                    return $err_val;
+                }
+            }
+        }
+    }};
+}
+
+/// Borrow C string as `Cow<str>` with bounded length check or early-return with error value
+/// Like `cstr_or_return!` but does not copy: valid UTF-8 is returned as a
+/// borrowed `&str` into the caller's buffer. Only invalid UTF-8 allocates
+/// (to hold the lossy replacement). Use when the callee does not need ownership.
+/// The result must not outlive the FFI call that received `ptr`.
+#[macro_export]
+macro_rules! cstr_borrow_or_return {
+    ($ptr:expr, $err_val:expr) => {{
+        let ptr = $ptr;
+        if ptr.is_null() {
+            $crate::CimplError::null_parameter_static(stringify!($ptr)).set_last();
+            return $err_val;
+        } else {
+            // SAFETY: We scan at most MAX_CSTRING_LEN bytes for the nul.
+            // Caller must ensure ptr is valid for reading and points to a
+            // null-terminated string within MAX_CSTRING_LEN bytes.
+            match unsafe {
+                $crate::scan::cstr_bytes(ptr as *const u8, $crate::macros::MAX_CSTRING_LEN)
+            } {
+                Some(bytes) => $crate::scan::utf8_lossy(bytes),
+                None => {
+                    $crate::CimplError::string_too_long_static(stringify!($ptr)).set_last();
+                    return $err_val;
+                }
+            }
+        }
+    }};
+}
+
+/// Borrow a `(ptr, len)` string as `Cow<str>` or early-return with error value
+/// The length is trusted, so there is no nul scan and the string need not be
+/// nul-terminated. As with `cstr_borrow_or_return!`, only invalid UTF-8 allocates.
+/// A zero `len` is the empty string, whatever `ptr` is (including NULL).
+#[macro_export]
+macro_rules! cstr_borrow_len_or_return {
+    ($ptr:expr, $len:expr, $err_val:expr) => {{
+        let ptr = $ptr as *const u8;
+        let len: usize = $len;
+        if len == 0 {
+            std::borrow::Cow::Borrowed("")
+        } else {
+            // SAFETY: Caller must ensure ptr is valid for reading len bytes.
+            match unsafe { $crate::safe_slice_from_raw_parts_static(ptr, len, stringify!($ptr)) } {
+                Ok(bytes) => $crate::scan::utf8_lossy(bytes),
+                Err(e) => {
+                    e.set_last();
                     return $err_val;
                 }
             }
@@ -546,7 +1032,7 @@ macro_rules! some_or_return_false {
 #[macro_export]
 macro_rules! some_or_return_other_null {
     ($option:expr, $msg:expr) => {
-        $crate::some_or_return_null!($option, $crate::CimplError::other($msg.to_string()))
+        $crate::some_or_return_null!($option, $crate::CimplError::other($msg))
     };
 }
 
@@ -554,7 +1040,7 @@ macro_rules! some_or_return_other_null {
 #[macro_export]
 macro_rules! some_or_return_other_int {
     ($option:expr, $msg:expr) => {
-        $crate::some_or_return_int!($option, $crate::CimplError::other($msg.to_string()))
+        $crate::some_or_return_int!($option, $crate::CimplError::other($msg))
     };
 }
 
@@ -562,7 +1048,7 @@ macro_rules! some_or_return_other_int {
 #[macro_export]
 macro_rules! some_or_return_other_zero {
     ($option:expr, $msg:expr) => {
-        $crate::some_or_return_zero!($option, $crate::CimplError::other($msg.to_string()))
+        $crate::some_or_return_zero!($option, $crate::CimplError::other($msg))
     };
 }
 
@@ -570,7 +1056,7 @@ macro_rules! some_or_return_other_zero {
 #[macro_export]
 macro_rules! some_or_return_other_false {
     ($option:expr, $msg:expr) => {
-        $crate::some_or_return_false!($option, $crate::CimplError::other($msg.to_string()))
+        $crate::some_or_return_false!($option, $crate::CimplError::other($msg))
     };
 }
 
@@ -606,6 +1092,22 @@ macro_rules! cstr_or_return_int {
     };
 }
 
+/// Borrow a C string as `Cow<str>`, or set the last error and return std::ptr::null_mut().
+#[macro_export]
+macro_rules! cstr_borrow_or_return_null {
+    ($ptr : expr) => {
+        $crate::cstr_borrow_or_return!($ptr, std::ptr::null_mut())
+    };
+}
+
+/// Borrow a C string as `Cow<str>`, or set the last error and return -1.
+#[macro_export]
+macro_rules! cstr_borrow_or_return_int {
+    ($ptr : expr) => {
+        $crate::cstr_borrow_or_return!($ptr, -1)
+    };
+}
+
 // Internal routine to convert a *const c_char to Option<String>.
 #[macro_export]
 macro_rules! cstr_option {
@@ -614,16 +1116,15 @@ macro_rules! cstr_option {
         if ptr.is_null() {
             None
         } else {
-            // SAFETY: We create a bounded slice up to MAX_CSTRING_LEN.
+            // SAFETY: We scan at most MAX_CSTRING_LEN bytes for the nul.
             // Caller must ensure ptr is valid for reading and points to a
             // null-terminated string within MAX_CSTRING_LEN bytes.
-            let bytes = unsafe {
-                std::slice::from_raw_parts(ptr as *const u8, $crate::macros::MAX_CSTRING_LEN)
-            };
-            match std::ffi::CStr::from_bytes_until_nul(bytes) {
-                Ok(cstr) => Some(cstr.to_string_lossy().into_owned()),
-                Err(_) => {
-                    $crate::CimplError::string_too_long(stringify!($ptr).to_string()).set_last();
+            match unsafe {
+                $crate::scan::cstr_bytes(ptr as *const u8, $crate::macros::MAX_CSTRING_LEN)
+            } {
+                Some(bytes) => Some($crate::scan::utf8_lossy(bytes).into_owned()),
+                None => {
+                    $crate::CimplError::string_too_long_static(stringify!($ptr)).set_last();
                     None
                 }
             }
@@ -631,6 +1132,56 @@ macro_rules! cstr_option {
     }};
 }
 
+/// Export an `ArrowColumn` into C's `ArrowArray`/`ArrowSchema` out-parameters
+/// or early-return with error value
+///
+/// # Example
+/// ```rust,ignore
+/// #[no_mangle]
+/// pub extern "C" fn scores_arrow(out_array: *mut ArrowArray, out_schema: *mut ArrowSchema) -> i32 {
+///     arrow_export_or_return_neg!(ArrowColumn::primitive(vec![1.5f64, 2.5]), out_array, out_schema);
+///     0
+/// }
+/// ```
+#[macro_export]
+macro_rules! arrow_export_or_return {
+    ($column:expr, $array:expr, $schema:expr, $err_val:expr) => {{
+        let (column, array, schema) = ($column, $array, $schema);
+        // SAFETY: C passes NULL or pointers to ArrowArray/ArrowSchema structs
+        if let Err(e) = unsafe { column.export(array, schema) } {
+            e.set_last();
+            return $err_val;
+        }
+    }};
+}
+
+/// Export an `ArrowColumn` into C's out-parameters, returning -1 on error
+#[macro_export]
+macro_rules! arrow_export_or_return_neg {
+    ($column:expr, $array:expr, $schema:expr) => {{
+        $crate::arrow_export_or_return!($column, $array, $schema, -1)
+    }};
+}
+
+/// Take ownership of an `ArrowArray`/`ArrowSchema` pair from C or early-return
+/// with error value
+///
+/// Evaluates to an `ImportedColumn`, which releases the column when dropped.
+#[macro_export]
+macro_rules! arrow_import_or_return {
+    ($array:expr, $schema:expr, $err_val:expr) => {{
+        let (array, schema) = ($array, $schema);
+        // SAFETY: C passes NULL or structs filled in by an Arrow producer
+        match unsafe { $crate::arrow::ImportedColumn::import(array, schema) } {
+            Ok(column) => column,
+            Err(e) => {
+                e.set_last();
+                return $err_val;
+            }
+        }
+    }};
+}
+
 /// Converts an `Option<String>` to a C string pointer.
 /// Returns `null_mut()` if the Option is None.
 ///
@@ -0,0 +1,292 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Pooled Allocations
+//!
+//! Small result types that C reads and frees right away (stats structs,
+//! ranges, small `#[repr(C)]` PODs) can opt in to a per-type slab pool
+//! instead of `box_tracked!`. Freed slots go on the pool's free list and are
+//! reused by the next `box_pooled!`, so hot getters neither call the global
+//! allocator nor insert into the pointer registry.
+//!
+//! Pooled pointers are still freed with `cimpl_free()`, validate with
+//! `deref_or_return!`, and are checked for double-frees. Each pool keeps its
+//! memory for the life of the process.
+//!
+//! ```rust
+//! use cimpl::{box_pooled, impl_pooled};
+//!
+//! #[repr(C)]
+//! pub struct Range {
+//!     pub start: usize,
+//!     pub end: usize,
+//! }
+//! impl_pooled!(Range);
+//!
+//! #[no_mangle]
+//! pub extern "C" fn thing_range() -> *mut Range {
+//!     box_pooled!(Range { start: 0, end: 10 })
+//! }
+//! # assert_eq!(cimpl::cimpl_free(thing_range() as *mut _), 0);
+//! ```
+//!
+//! For results that fit in a register or two, returning them through an
+//! out-parameter with `write_out_or_return!` avoids the allocation entirely.
+
+use std::{
+    any::TypeId,
+    mem::MaybeUninit,
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        Mutex, RwLock,
+    },
+};
+
+use crate::cimpl_error::CimplError;
+
+/// Slots allocated at a time when a pool runs dry
+const CHUNK_SLOTS: usize = 64;
+
+/// Types that `box_pooled!` can allocate; implement with `impl_pooled!`
+pub trait Pooled: Sized + Send + 'static {
+    /// The type's process-wide pool
+    fn pool() -> &'static Pool<Self>;
+}
+
+/// One pool slot; `value` comes first so a slot's address is its object's
+#[repr(C)]
+struct Slot<T> {
+    value: MaybeUninit<T>,
+    live: bool,
+}
+
+struct PoolInner {
+    /// Addresses of free slots
+    free: Vec<usize>,
+    live: usize,
+}
+
+/// Free-list pool of fixed-size slots for one type
+pub struct Pool<T> {
+    inner: Mutex<PoolInner>,
+    _type: std::marker::PhantomData<fn() -> T>,
+}
+
+/// Type-erased access to a pool, for `cimpl_free()` and validation
+trait PoolOps: Sync {
+    fn validate(&self, ptr: usize, expected_type: TypeId) -> Result<(), CimplError>;
+    fn free(&self, ptr: usize) -> Result<(), CimplError>;
+}
+
+/// A chunk of slots and the pool it belongs to
+#[derive(Clone, Copy)]
+struct Chunk {
+    start: usize,
+    end: usize,
+    slot_size: usize,
+    pool: &'static dyn PoolOps,
+}
+
+/// Every pool chunk, sorted by address
+static CHUNKS: RwLock<Vec<Chunk>> = RwLock::new(Vec::new());
+
+/// Set once the first chunk exists, so programs without pools skip the lookup
+static ACTIVE: AtomicBool = AtomicBool::new(false);
+
+impl<T: Pooled> Pool<T> {
+    /// Creates an empty pool; used by `impl_pooled!`
+    #[allow(clippy::new_without_default)]
+    pub const fn new() -> Self {
+        Self {
+            inner: Mutex::new(PoolInner {
+                free: Vec::new(),
+                live: 0,
+            }),
+            _type: std::marker::PhantomData,
+        }
+    }
+
+    /// Moves `value` into a free slot and returns its address
+    pub fn alloc(&'static self, value: T) -> *mut T {
+        let mut inner = self.inner.lock().unwrap();
+        if inner.free.is_empty() {
+            self.grow(&mut inner);
+        }
+        let slot = inner.free.pop().unwrap() as *mut Slot<T>;
+        inner.live += 1;
+        // SAFETY: free slots are owned by the pool; the lock is held
+        unsafe {
+            (*slot).value.write(value);
+            (*slot).live = true;
+        }
+        slot as *mut T
+    }
+
+    /// Number of objects currently allocated from this pool
+    pub fn live(&self) -> usize {
+        self.inner.lock().unwrap().live
+    }
+
+    /// Adds a chunk of free slots
+    fn grow(&'static self, inner: &mut PoolInner) {
+        let chunk: Box<[Slot<T>]> = (0..CHUNK_SLOTS)
+            .map(|_| Slot {
+                value: MaybeUninit::uninit(),
+                live: false,
+            })
+            .collect();
+        let start = Box::into_raw(chunk) as *mut Slot<T> as usize;
+        let slot_size = std::mem::size_of::<Slot<T>>();
+        inner
+            .free
+            .extend((0..CHUNK_SLOTS).rev().map(|i| start + i * slot_size));
+
+        let mut chunks = CHUNKS.write().unwrap();
+        let index = chunks.partition_point(|chunk| chunk.start < start);
+        chunks.insert(
+            index,
+            Chunk {
+                start,
+                end: start + CHUNK_SLOTS * slot_size,
+                slot_size,
+                pool: self,
+            },
+        );
+        ACTIVE.store(true, Ordering::Release);
+    }
+}
+
+impl<T: Pooled> PoolOps for Pool<T> {
+    fn validate(&self, ptr: usize, expected_type: TypeId) -> Result<(), CimplError> {
+        let _inner = self.inner.lock().unwrap();
+        // SAFETY: `find()` only returns slot addresses inside this pool
+        match unsafe { (*(ptr as *const Slot<T>)).live } {
+            true if expected_type == TypeId::of::<T>() => Ok(()),
+            true => Err(CimplError::wrong_handle_type(ptr as u64)),
+            false => Err(CimplError::invalid_handle(ptr as u64)),
+        }
+    }
+
+    fn free(&self, ptr: usize) -> Result<(), CimplError> {
+        let value = {
+            let mut inner = self.inner.lock().unwrap();
+            let slot = ptr as *mut Slot<T>;
+            // SAFETY: as above; a live slot holds an initialized value
+            unsafe {
+                if !(*slot).live {
+                    return Err(CimplError::invalid_handle(ptr as u64));
+                }
+                (*slot).live = false;
+                let value = (*slot).value.assume_init_read();
+                inner.free.push(ptr);
+                inner.live -= 1;
+                value
+            }
+        }; // Release the lock before running the destructor
+        drop(value);
+        Ok(())
+    }
+}
+
+// SAFETY: slots are only touched with the pool's mutex held, and values
+// are `Send`, so they may be dropped on whichever thread frees them.
+unsafe impl<T: Send> Sync for Pool<T> {}
+
+/// Finds the pool slot at exactly `ptr`
+fn find(ptr: usize) -> Option<&'static dyn PoolOps> {
+    if !ACTIVE.load(Ordering::Acquire) || ptr == 0 {
+        return None;
+    }
+    let chunks = CHUNKS.read().unwrap();
+    let index = chunks
+        .partition_point(|chunk| chunk.start <= ptr)
+        .checked_sub(1)?;
+    let chunk = chunks[index];
+    (ptr < chunk.end && (ptr - chunk.start).is_multiple_of(chunk.slot_size)).then_some(chunk.pool)
+}
+
+/// Validates a pointer allocated by `box_pooled!`
+///
+/// Returns `None` if no pool owns the pointer.
+pub(crate) fn validate(ptr: usize, expected_type: TypeId) -> Option<Result<(), CimplError>> {
+    find(ptr).map(|pool| pool.validate(ptr, expected_type))
+}
+
+/// Returns a pointer allocated by `box_pooled!` to its pool
+///
+/// Returns `None` if no pool owns the pointer.
+pub(crate) fn free(ptr: usize) -> Option<Result<(), CimplError>> {
+    find(ptr).map(|pool| pool.free(ptr))
+}
+
+/// Allocate a value from its type's pool, as `box_pooled!` does
+pub fn alloc_pooled<T: Pooled>(value: T) -> *mut T {
+    T::pool().alloc(value)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{cimpl_free, validate_pointer};
+
+    #[test]
+    fn test_pooled_slots_are_reused() {
+        // Each test pools its own type, so no other test takes its slots
+        #[repr(C)]
+        struct Stats {
+            length: usize,
+            words: usize,
+        }
+        crate::impl_pooled!(Stats);
+
+        let first = crate::box_pooled!(Stats {
+            length: 5,
+            words: 1
+        });
+        assert!(validate_pointer(first).is_ok());
+        assert!(validate_pointer(first as *mut u64).is_err());
+        assert_eq!(unsafe { &*first }.length, 5);
+        assert_eq!(cimpl_free(first as *mut _), 0);
+        assert!(validate_pointer(first).is_err());
+        assert_eq!(cimpl_free(first as *mut _), -1); // double free detected
+
+        let second = crate::box_pooled!(Stats {
+            length: 9,
+            words: 2
+        });
+        assert_eq!(second, first);
+        assert_eq!(unsafe { &*second }.words, 2);
+        assert_eq!(cimpl_free(second as *mut _), 0);
+    }
+
+    #[test]
+    fn test_pool_grows_and_rejects_interior_pointers() {
+        #[repr(C)]
+        struct Counts(usize);
+        crate::impl_pooled!(Counts);
+
+        let ptrs: Vec<*mut Counts> = (0..CHUNK_SLOTS * 2 + 1)
+            .map(|i| crate::box_pooled!(Counts(i)))
+            .collect();
+        assert_eq!(Counts::pool().live(), ptrs.len());
+        assert_eq!(unsafe { &*ptrs[CHUNK_SLOTS * 2] }.0, CHUNK_SLOTS * 2);
+        let interior = (ptrs[3] as usize + 1) as *mut Counts;
+        assert!(free(interior as usize).is_none());
+
+        assert_eq!(
+            crate::cimpl_free_many(ptrs.as_ptr() as *const _, ptrs.len()),
+            0
+        );
+        assert!(ptrs.iter().all(|&p| validate_pointer(p).is_err()));
+    }
+}
@@ -0,0 +1,214 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! C String Scanning
+//!
+//! Used by the `cstr_*` macros to find the terminating nul and decode the
+//! string:
+//!
+//! - `bounded_strlen()` finds the nul within a limit with the C library's
+//!   `strnlen`, which is vectorized on common platforms. The length of the
+//!   string is unknown until the nul is found, so Rust code cannot load more
+//!   than one byte at a time without reading out of bounds; the scalar loop
+//!   runs under Miri and on targets without a C library.
+//! - `utf8_lossy()` skips the ASCII prefix of the string 16 or 32 bytes at a
+//!   time (SSE2 or AVX2 on x86_64, NEON on aarch64, scalar elsewhere) and
+//!   only runs full UTF-8 validation on what follows it, so ASCII input
+//!   (JSON, identifiers, paths) is accepted after a single scan. The length
+//!   is known by then, so every load stays inside the string.
+
+use std::borrow::Cow;
+
+#[cfg(all(target_arch = "x86_64", not(miri)))]
+use std::arch::x86_64::*;
+
+#[cfg(all(target_arch = "aarch64", not(miri)))]
+use std::arch::aarch64::*;
+
+/// Returns the length of the nul-terminated string at `ptr`, if the nul is
+/// among the first `max` bytes
+///
+/// # Safety
+/// `ptr` must be valid for reads up to its terminating nul or `max` bytes,
+/// whichever comes first.
+#[inline]
+pub unsafe fn bounded_strlen(ptr: *const u8, max: usize) -> Option<usize> {
+    #[cfg(all(any(unix, windows), not(miri)))]
+    {
+        let len = strnlen(ptr as *const std::os::raw::c_char, max);
+        (len < max).then_some(len)
+    }
+
+    #[cfg(not(all(any(unix, windows), not(miri))))]
+    {
+        (0..max).find(|&i| *ptr.add(i) == 0)
+    }
+}
+
+#[cfg(all(any(unix, windows), not(miri)))]
+extern "C" {
+    /// POSIX, and in the Windows CRT; reads no further than the nul or `max`
+    fn strnlen(s: *const std::os::raw::c_char, max: usize) -> usize;
+}
+
+/// Borrows the bytes of the nul-terminated string at `ptr` (without the nul),
+/// if it ends within `max` bytes
+///
+/// # Safety
+/// Same as `bounded_strlen()`; the memory must also outlive the returned slice.
+#[inline]
+pub unsafe fn cstr_bytes<'a>(ptr: *const u8, max: usize) -> Option<&'a [u8]> {
+    bounded_strlen(ptr, max).map(|len| std::slice::from_raw_parts(ptr, len))
+}
+
+/// Length of the leading run of ASCII bytes in `bytes`
+#[inline]
+pub fn ascii_prefix_len(bytes: &[u8]) -> usize {
+    #[cfg(all(target_arch = "x86_64", not(miri)))]
+    {
+        if is_x86_feature_detected!("avx2") {
+            return unsafe { ascii_prefix_avx2(bytes) };
+        }
+        unsafe { ascii_prefix_sse2(bytes) }
+    }
+
+    #[cfg(all(target_arch = "aarch64", not(miri)))]
+    {
+        unsafe { ascii_prefix_neon(bytes) }
+    }
+
+    #[cfg(any(miri, not(any(target_arch = "x86_64", target_arch = "aarch64"))))]
+    {
+        ascii_prefix_scalar(bytes, 0)
+    }
+}
+
+/// Decodes `bytes` as UTF-8, replacing invalid sequences like
+/// `String::from_utf8_lossy`
+///
+/// Valid input is borrowed. ASCII input is accepted after the vector scan for
+/// its ASCII prefix, without running the general UTF-8 validator.
+#[inline]
+pub fn utf8_lossy(bytes: &[u8]) -> Cow<'_, str> {
+    let ascii = ascii_prefix_len(bytes);
+    // An ASCII prefix always ends on a character boundary
+    match std::str::from_utf8(&bytes[ascii..]) {
+        // SAFETY: the prefix is ASCII and the remainder was just validated
+        Ok(_) => Cow::Borrowed(unsafe { std::str::from_utf8_unchecked(bytes) }),
+        Err(_) => String::from_utf8_lossy(bytes),
+    }
+}
+
+/// First non-ASCII byte at or after `start`, or `bytes.len()`
+fn ascii_prefix_scalar(bytes: &[u8], start: usize) -> usize {
+    bytes[start..]
+        .iter()
+        .position(|&b| b >= 0x80)
+        .map_or(bytes.len(), |i| start + i)
+}
+
+#[cfg(all(target_arch = "x86_64", not(miri)))]
+unsafe fn ascii_prefix_sse2(bytes: &[u8]) -> usize {
+    let mut i = 0;
+    while i + 16 <= bytes.len() {
+        let chunk = _mm_loadu_si128(bytes.as_ptr().add(i) as *const __m128i);
+        let high = _mm_movemask_epi8(chunk) as u32;
+        if high != 0 {
+            return i + high.trailing_zeros() as usize;
+        }
+        i += 16;
+    }
+    ascii_prefix_scalar(bytes, i)
+}
+
+#[cfg(all(target_arch = "x86_64", not(miri)))]
+#[target_feature(enable = "avx2")]
+unsafe fn ascii_prefix_avx2(bytes: &[u8]) -> usize {
+    let mut i = 0;
+    while i + 32 <= bytes.len() {
+        let chunk = _mm256_loadu_si256(bytes.as_ptr().add(i) as *const __m256i);
+        let high = _mm256_movemask_epi8(chunk) as u32;
+        if high != 0 {
+            return i + high.trailing_zeros() as usize;
+        }
+        i += 32;
+    }
+    ascii_prefix_scalar(bytes, i)
+}
+
+#[cfg(all(target_arch = "aarch64", not(miri)))]
+unsafe fn ascii_prefix_neon(bytes: &[u8]) -> usize {
+    let mut i = 0;
+    while i + 16 <= bytes.len() {
+        if vmaxvq_u8(vld1q_u8(bytes.as_ptr().add(i))) >= 0x80 {
+            break;
+        }
+        i += 16;
+    }
+    ascii_prefix_scalar(bytes, i)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_bounded_strlen() {
+        let mut buf = [b'a'; 128];
+        for len in [0usize, 1, 15, 16, 17, 31, 32, 33, 63, 64, 100] {
+            buf.fill(b'a');
+            buf[len] = 0;
+            for max in [0usize, 1, len, len + 1, 128] {
+                let expected = (len < max).then_some(len);
+                assert_eq!(
+                    unsafe { bounded_strlen(buf.as_ptr(), max) },
+                    expected,
+                    "len {len} max {max}"
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn test_ascii_prefix_len() {
+        let mut bytes = vec![b'x'; 100];
+        assert_eq!(ascii_prefix_len(&bytes), 100);
+        for pos in [0, 5, 16, 31, 32, 47, 99] {
+            bytes.fill(b'x');
+            bytes[pos] = 0xC3;
+            assert_eq!(ascii_prefix_len(&bytes), pos);
+            assert_eq!(ascii_prefix_scalar(&bytes, 0), pos);
+        }
+    }
+
+    #[test]
+    fn test_utf8_lossy_matches_std() {
+        let long = "settings".repeat(10);
+        let cases: [&[u8]; 6] = [
+            b"",
+            b"plain ascii",
+            long.as_bytes(),
+            "caf\u{e9} \u{1F600} and more text after it".as_bytes(),
+            b"bad \xFF byte",
+            b"truncated \xE2\x82",
+        ];
+        for bytes in cases {
+            let fast = utf8_lossy(bytes);
+            assert_eq!(fast, String::from_utf8_lossy(bytes));
+            assert_eq!(
+                matches!(fast, Cow::Borrowed(_)),
+                std::str::from_utf8(bytes).is_ok()
+            );
+        }
+    }
+}
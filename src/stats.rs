@@ -0,0 +1,304 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Registry Statistics
+//!
+//! Every registry shard keeps a few relaxed atomic counters next to its lock:
+//! objects tracked and freed, failed validations, frees of untracked
+//! pointers (double-frees), and how often and how long its lock was
+//! contended. Uncontended operations only pay for one relaxed add; the clock
+//! is read only when a lock is already held by another thread.
+//!
+//! C reads the totals with `cimpl_registry_stats()`, the live objects per
+//! type with `cimpl_registry_type_stats()`, or both in Prometheus text
+//! format with `cimpl_registry_stats_prometheus()`.
+
+use std::{
+    ffi::c_void,
+    fmt::Write,
+    os::raw::c_char,
+    sync::atomic::{AtomicU64, Ordering::Relaxed},
+    time::Instant,
+};
+
+use crate::utils::get_registry;
+
+/// Registry counters reported by `cimpl_registry_stats()`
+///
+/// All counts are totals since startup except `live`.
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct CimplRegistryStats {
+    /// Objects currently tracked
+    pub live: u64,
+    /// Objects ever tracked
+    pub tracked: u64,
+    /// Objects freed
+    pub freed: u64,
+    /// Validations that failed (unknown pointer or wrong type)
+    pub failed_validations: u64,
+    /// Frees of pointers that were not tracked, such as double-frees
+    pub invalid_frees: u64,
+    /// Lock acquisitions that had to wait for another thread
+    pub lock_contentions: u64,
+    /// Total time spent waiting for contended locks, in nanoseconds
+    pub lock_wait_ns: u64,
+}
+
+/// Counters kept by one registry shard
+#[derive(Default)]
+pub(crate) struct ShardStats {
+    tracked: AtomicU64,
+    freed: AtomicU64,
+    failed_validations: AtomicU64,
+    invalid_frees: AtomicU64,
+    lock_contentions: AtomicU64,
+    lock_wait_ns: AtomicU64,
+}
+
+impl ShardStats {
+    #[inline]
+    pub(crate) fn tracked(&self, n: u64) {
+        self.tracked.fetch_add(n, Relaxed);
+    }
+
+    #[inline]
+    pub(crate) fn freed(&self, n: u64) {
+        self.freed.fetch_add(n, Relaxed);
+    }
+
+    #[inline]
+    pub(crate) fn failed_validation(&self) {
+        self.failed_validations.fetch_add(1, Relaxed);
+    }
+
+    #[inline]
+    pub(crate) fn invalid_frees(&self, n: u64) {
+        self.invalid_frees.fetch_add(n, Relaxed);
+    }
+
+    /// Records a contended lock acquisition that started waiting at `start`
+    #[cold]
+    pub(crate) fn record_wait(&self, start: Instant) {
+        self.lock_contentions.fetch_add(1, Relaxed);
+        let waited = start.elapsed().as_nanos().min(u64::MAX as u128) as u64;
+        self.lock_wait_ns.fetch_add(waited, Relaxed);
+    }
+
+    pub(crate) fn add_to(&self, stats: &mut CimplRegistryStats) {
+        stats.tracked += self.tracked.load(Relaxed);
+        stats.freed += self.freed.load(Relaxed);
+        stats.failed_validations += self.failed_validations.load(Relaxed);
+        stats.invalid_frees += self.invalid_frees.load(Relaxed);
+        stats.lock_contentions += self.lock_contentions.load(Relaxed);
+        stats.lock_wait_ns += self.lock_wait_ns.load(Relaxed);
+    }
+}
+
+/// Counters of the global registry
+pub fn registry_stats() -> CimplRegistryStats {
+    get_registry().stats()
+}
+
+/// The global registry's counters in Prometheus text exposition format
+pub fn prometheus_text() -> String {
+    let stats = registry_stats();
+    let mut out = String::new();
+    let metrics = [
+        (
+            "live_objects",
+            "gauge",
+            "Objects currently tracked",
+            stats.live,
+        ),
+        (
+            "tracked_total",
+            "counter",
+            "Objects ever tracked",
+            stats.tracked,
+        ),
+        ("freed_total", "counter", "Objects freed", stats.freed),
+        (
+            "failed_validations_total",
+            "counter",
+            "Pointer validations that failed",
+            stats.failed_validations,
+        ),
+        (
+            "invalid_frees_total",
+            "counter",
+            "Frees of untracked pointers (double-frees)",
+            stats.invalid_frees,
+        ),
+        (
+            "lock_contentions_total",
+            "counter",
+            "Registry lock acquisitions that waited",
+            stats.lock_contentions,
+        ),
+        (
+            "lock_wait_nanoseconds_total",
+            "counter",
+            "Time spent waiting for registry locks",
+            stats.lock_wait_ns,
+        ),
+    ];
+    for (name, kind, help, value) in metrics {
+        let _ = writeln!(out, "# HELP cimpl_registry_{name} {help}");
+        let _ = writeln!(out, "# TYPE cimpl_registry_{name} {kind}");
+        let _ = writeln!(out, "cimpl_registry_{name} {value}");
+    }
+
+    out.push_str("# HELP cimpl_registry_live_objects_by_type Objects currently tracked, by type\n");
+    out.push_str("# TYPE cimpl_registry_live_objects_by_type gauge\n");
+    for (name, live) in get_registry().live_by_type() {
+        let name = name.replace('\\', "\\\\").replace('"', "\\\"");
+        let _ = writeln!(
+            out,
+            "cimpl_registry_live_objects_by_type{{type=\"{name}\"}} {live}"
+        );
+    }
+    out
+}
+
+/// Fills `out` with the global registry's counters
+///
+/// # Returns
+/// - 0 on success
+/// - -1 if `out` is NULL
+///
+/// # Example (C)
+/// ```c
+/// CimplRegistryStats stats;
+/// cimpl_registry_stats(&stats);
+/// printf("%llu live, %llu double-frees\n", stats.live, stats.invalid_frees);
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_registry_stats(out: *mut CimplRegistryStats) -> i32 {
+    crate::ptr_or_return_int!(out);
+    // SAFETY: checked for NULL above; the caller passes a writable struct
+    unsafe { *out = registry_stats() };
+    0
+}
+
+/// Callback receiving one type's live object count
+///
+/// `name` is the Rust type name; it is not nul-terminated, use `name_len`.
+pub type CimplTypeStatsCallback =
+    extern "C" fn(user: *mut c_void, name: *const c_char, name_len: usize, live: u64);
+
+/// Calls `callback` once per type with live objects, sorted by type name
+///
+/// # Returns
+/// - Number of types reported
+/// - -1 if `callback` is NULL
+#[no_mangle]
+pub extern "C" fn cimpl_registry_type_stats(
+    callback: Option<CimplTypeStatsCallback>,
+    user: *mut c_void,
+) -> isize {
+    let callback = crate::some_or_return_int!(
+        callback,
+        crate::CimplError::null_parameter_static("callback")
+    );
+    let counts = get_registry().live_by_type();
+    for (name, live) in &counts {
+        callback(user, name.as_ptr() as *const c_char, name.len(), *live);
+    }
+    counts.len() as isize
+}
+
+/// Returns the registry counters in Prometheus text exposition format
+///
+/// Includes a `cimpl_registry_live_objects_by_type` gauge per type. The
+/// returned string must be freed with `cimpl_free()`.
+#[no_mangle]
+pub extern "C" fn cimpl_registry_stats_prometheus() -> *mut c_char {
+    crate::to_c_string(prometheus_text())
+}
+
+#[cfg(test)]
+mod tests {
+    use std::any::TypeId;
+
+    use super::*;
+    use crate::{
+        arena::CimplArena,
+        utils::{drop_box, free_in, free_many_in, validate_in, PointerRegistry},
+    };
+
+    unsafe fn noop_drop(_ptr: usize, _len: usize) {}
+
+    #[test]
+    fn test_registry_counters() {
+        let registry = PointerRegistry::new();
+        let a = Box::into_raw(Box::new(1u32)) as usize;
+        let b = Box::into_raw(Box::new(2u64)) as usize;
+        registry.track_as::<u32>(a, drop_box::<u32>, 0);
+        registry.track_as::<u64>(b, drop_box::<u64>, 0);
+        registry.track(0x1000, TypeId::of::<u8>(), noop_drop, 0);
+
+        assert!(validate_in(&registry, a, TypeId::of::<u64>(), false).is_err());
+        assert!(validate_in(&registry, 0x2000, TypeId::of::<u64>(), false).is_err());
+        free_in(&registry, a, PointerRegistry::free).unwrap();
+        assert!(free_in(&registry, a, PointerRegistry::free).is_err());
+        assert_eq!(free_many_in(&registry, &[b, b, 0x3000]).len(), 2);
+
+        // Pointers owned by an arena are neither failed validations nor
+        // invalid frees, even though this registry doesn't know them
+        let arena = CimplArena::new();
+        let c = arena.alloc_value(3u32) as usize;
+        let d = arena.alloc_value(4u32) as usize;
+        assert!(validate_in(&registry, c, TypeId::of::<u32>(), false).is_ok());
+        free_in(&registry, c, PointerRegistry::free).unwrap();
+        assert!(free_many_in(&registry, &[d]).is_empty());
+
+        let stats = registry.stats();
+        assert_eq!(stats.live, 1);
+        assert_eq!(stats.tracked, 3);
+        assert_eq!(stats.freed, 2);
+        assert_eq!(stats.failed_validations, 2);
+        assert_eq!(stats.invalid_frees, 3);
+        assert_eq!(registry.live_by_type(), vec![("unknown", 1)]);
+        registry.free(0x1000).unwrap();
+    }
+
+    #[test]
+    fn test_prometheus_and_type_stats() {
+        let ptr = crate::box_tracked!(String::from("kept alive"));
+        let text = prometheus_text();
+        assert!(text.contains("# TYPE cimpl_registry_live_objects gauge\n"));
+        assert!(
+            text.contains("cimpl_registry_live_objects_by_type{type=\"alloc::string::String\"}")
+        );
+
+        extern "C" fn collect(user: *mut c_void, name: *const c_char, len: usize, live: u64) {
+            let found = unsafe { &mut *(user as *mut Vec<(String, u64)>) };
+            let name = unsafe { std::slice::from_raw_parts(name as *const u8, len) };
+            found.push((String::from_utf8_lossy(name).into_owned(), live));
+        }
+        let mut found: Vec<(String, u64)> = Vec::new();
+        let reported =
+            cimpl_registry_type_stats(Some(collect), &mut found as *mut _ as *mut c_void);
+        assert_eq!(reported as usize, found.len());
+        assert!(found
+            .iter()
+            .any(|(name, live)| name == "alloc::string::String" && *live >= 1));
+        assert_eq!(cimpl_registry_type_stats(None, std::ptr::null_mut()), -1);
+
+        let mut stats = CimplRegistryStats::default();
+        assert_eq!(cimpl_registry_stats(&mut stats), 0);
+        assert!(stats.live >= 1);
+        assert_eq!(crate::cimpl_free(ptr as *mut _), 0);
+    }
+}
@@ -0,0 +1,401 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Live Object Dumps and Allocation-Site Tracing
+//!
+//! The registry records the type name of every object it tracks, and
+//! `cimpl_registry_dump()` reports each live object to a C callback, so a
+//! running service can list what it is holding instead of learning only a
+//! count when the process exits.
+//!
+//! With the `leak-trace` feature, each entry also records where it was
+//! tracked: the `#[track_caller]` location of the `box_tracked!`,
+//! `to_c_string()` or `track_*()` call, which costs one pointer per entry.
+//! A full backtrace is captured for one in every N objects; set N with
+//! `set_backtrace_sampling()`, `cimpl_trace_set_sampling()` or the
+//! `CIMPL_TRACE_SAMPLE` environment variable. The default of 0 captures no
+//! backtraces.
+//!
+//! Arena and pool allocations are not in the registry and are not reported.
+//!
+//! # Example (C)
+//! ```c
+//! static void print_object(void* user, const CimplLiveObject* obj) {
+//!     fprintf(stderr, "%p %.*s at %.*s:%u\n", obj->ptr,
+//!             (int)obj->type_name_len, obj->type_name,
+//!             (int)obj->file_len, obj->file, obj->line);
+//! }
+//!
+//! cimpl_trace_set_sampling(1000);          // backtrace for 1 in 1000
+//! cimpl_registry_dump(print_object, NULL);
+//! ```
+
+use std::{
+    backtrace::Backtrace, collections::HashMap, ffi::c_void, os::raw::c_char, panic::Location,
+    sync::Arc,
+};
+#[cfg(feature = "leak-trace")]
+use std::{
+    cell::Cell,
+    sync::atomic::{AtomicU32, Ordering::Relaxed},
+};
+
+use crate::utils::get_registry;
+
+/// Where a registry entry was tracked
+///
+/// Without the `leak-trace` feature this is empty and records nothing.
+#[cfg(feature = "leak-trace")]
+pub(crate) struct Site {
+    location: &'static Location<'static>,
+    backtrace: Option<Arc<Backtrace>>,
+}
+
+/// Where a registry entry was tracked
+///
+/// Without the `leak-trace` feature this is empty and records nothing.
+#[cfg(not(feature = "leak-trace"))]
+pub(crate) struct Site;
+
+impl Site {
+    /// Records the caller's location, and a backtrace if this one is sampled
+    #[track_caller]
+    #[inline]
+    pub(crate) fn capture() -> Self {
+        #[cfg(feature = "leak-trace")]
+        {
+            Site {
+                location: Location::caller(),
+                backtrace: sample().then(|| Arc::new(Backtrace::force_capture())),
+            }
+        }
+
+        #[cfg(not(feature = "leak-trace"))]
+        {
+            Site
+        }
+    }
+
+    pub(crate) fn location(&self) -> Option<&'static Location<'static>> {
+        #[cfg(feature = "leak-trace")]
+        return Some(self.location);
+
+        #[cfg(not(feature = "leak-trace"))]
+        None
+    }
+
+    pub(crate) fn backtrace(&self) -> Option<Arc<Backtrace>> {
+        #[cfg(feature = "leak-trace")]
+        return self.backtrace.clone();
+
+        #[cfg(not(feature = "leak-trace"))]
+        None
+    }
+}
+
+/// Sampling period not yet read from `CIMPL_TRACE_SAMPLE`
+#[cfg(feature = "leak-trace")]
+const UNSET: u32 = u32::MAX;
+
+#[cfg(feature = "leak-trace")]
+static SAMPLE_EVERY: AtomicU32 = AtomicU32::new(UNSET);
+
+#[cfg(feature = "leak-trace")]
+thread_local! {
+    /// Objects this thread tracks before its next backtrace
+    static COUNTDOWN: Cell<u32> = const { Cell::new(0) };
+}
+
+#[cfg(all(feature = "leak-trace", test))]
+thread_local! {
+    /// Sampling period for the current test thread, so sampling tests never
+    /// change `SAMPLE_EVERY` under tests running in parallel
+    static TEST_SAMPLE_EVERY: Cell<Option<u32>> = const { Cell::new(None) };
+}
+
+#[cfg(feature = "leak-trace")]
+fn sample_every() -> u32 {
+    #[cfg(test)]
+    if let Some(every) = TEST_SAMPLE_EVERY.with(Cell::get) {
+        return every;
+    }
+    match SAMPLE_EVERY.load(Relaxed) {
+        UNSET => {
+            let every = std::env::var("CIMPL_TRACE_SAMPLE")
+                .ok()
+                .and_then(|value| value.trim().parse::<u32>().ok())
+                .unwrap_or(0)
+                .min(UNSET - 1);
+            // A concurrent set_backtrace_sampling() wins over the environment
+            let _ = SAMPLE_EVERY.compare_exchange(UNSET, every, Relaxed, Relaxed);
+            SAMPLE_EVERY.load(Relaxed)
+        }
+        every => every,
+    }
+}
+
+/// Returns true for one in every `sample_every()` calls on this thread
+///
+/// The countdown is per thread, so sampling never contends across threads.
+#[cfg(feature = "leak-trace")]
+#[inline]
+fn sample() -> bool {
+    let every = sample_every();
+    every != 0
+        && COUNTDOWN
+            .try_with(|countdown| {
+                let left = countdown.get().min(every);
+                countdown.set(if left <= 1 { every } else { left - 1 });
+                left <= 1
+            })
+            .unwrap_or(false)
+}
+
+/// Captures a backtrace for one in every `every` tracked objects
+///
+/// 1 captures one for every object; 0 turns backtraces off. Allocation
+/// locations are recorded either way.
+#[cfg(feature = "leak-trace")]
+pub fn set_backtrace_sampling(every: u32) {
+    SAMPLE_EVERY.store(every.min(UNSET - 1), Relaxed);
+}
+
+/// One live object in the registry, as reported by `live_objects()`
+#[derive(Debug, Clone)]
+pub struct LiveObject {
+    /// Address handed to C
+    pub ptr: usize,
+    /// `std::any::type_name` of the object, or "unknown" if tracked untyped
+    pub type_name: &'static str,
+    /// Where the object was tracked (`leak-trace` feature only)
+    pub location: Option<&'static Location<'static>>,
+    /// Backtrace of the tracking call, if it was sampled
+    pub backtrace: Option<Arc<Backtrace>>,
+}
+
+/// Every object currently tracked by the global registry
+///
+/// Walks every entry, so call it for reporting rather than per operation.
+pub fn live_objects() -> Vec<LiveObject> {
+    get_registry().live_objects()
+}
+
+/// (file, line, column) of an allocation site
+type SiteKey = (&'static str, u32, u32);
+
+/// Live objects grouped by type and allocation site, most numerous first
+///
+/// Each line reads `"<count> x <type>"`, followed by `" at <file:line:col>"`
+/// when the site is known. At most `limit` lines are returned.
+pub fn leak_summary(objects: &[LiveObject], limit: usize) -> Vec<String> {
+    let mut groups: HashMap<(&str, Option<SiteKey>), usize> = HashMap::new();
+    for object in objects {
+        let site = object
+            .location
+            .map(|location| (location.file(), location.line(), location.column()));
+        *groups.entry((object.type_name, site)).or_default() += 1;
+    }
+    let mut groups: Vec<_> = groups.into_iter().collect();
+    groups.sort_unstable_by(|a, b| b.1.cmp(&a.1).then_with(|| a.0.cmp(&b.0)));
+    groups
+        .into_iter()
+        .take(limit)
+        .map(|((type_name, site), count)| match site {
+            Some((file, line, column)) => {
+                format!("{count} x {type_name} at {file}:{line}:{column}")
+            }
+            None => format!("{count} x {type_name}"),
+        })
+        .collect()
+}
+
+/// One live object, as passed to a `cimpl_registry_dump()` callback
+///
+/// Strings are not nul-terminated; use the matching `_len` field. All
+/// pointers are only valid during the callback.
+#[repr(C)]
+pub struct CimplLiveObject {
+    /// Address handed to C
+    pub ptr: *const c_void,
+    /// Type name of the object ("unknown" if tracked untyped)
+    pub type_name: *const c_char,
+    pub type_name_len: usize,
+    /// Source file that tracked the object; NULL without `leak-trace`
+    pub file: *const c_char,
+    pub file_len: usize,
+    /// Line and column in `file`; 0 without `leak-trace`
+    pub line: u32,
+    pub column: u32,
+    /// Backtrace of the tracking call; NULL unless it was sampled
+    pub backtrace: *const c_char,
+    pub backtrace_len: usize,
+}
+
+pub type CimplRegistryDumpCallback =
+    extern "C" fn(user: *mut c_void, object: *const CimplLiveObject);
+
+/// Reports every live tracked object to `callback`
+///
+/// The registry is snapshotted first and no lock is held during the
+/// callbacks, so the callback may call back into the library, including
+/// `cimpl_free()`.
+///
+/// # Returns
+/// The number of objects reported, or -1 if `callback` is NULL.
+#[no_mangle]
+pub extern "C" fn cimpl_registry_dump(
+    callback: Option<CimplRegistryDumpCallback>,
+    user: *mut c_void,
+) -> isize {
+    let callback = crate::some_or_return_int!(
+        callback,
+        crate::CimplError::null_parameter_static("callback")
+    );
+    let objects = live_objects();
+    for object in &objects {
+        let (file, line, column) = match object.location {
+            Some(location) => (location.file(), location.line(), location.column()),
+            None => ("", 0, 0),
+        };
+        let backtrace = object
+            .backtrace
+            .as_ref()
+            .map(|backtrace| backtrace.to_string());
+        let (backtrace_ptr, backtrace_len) = match &backtrace {
+            Some(text) => (text.as_ptr() as *const c_char, text.len()),
+            None => (std::ptr::null(), 0),
+        };
+        let entry = CimplLiveObject {
+            ptr: object.ptr as *const c_void,
+            type_name: object.type_name.as_ptr() as *const c_char,
+            type_name_len: object.type_name.len(),
+            file: match object.location {
+                Some(_) => file.as_ptr() as *const c_char,
+                None => std::ptr::null(),
+            },
+            file_len: file.len(),
+            line,
+            column,
+            backtrace: backtrace_ptr,
+            backtrace_len,
+        };
+        callback(user, &entry);
+    }
+    objects.len() as isize
+}
+
+/// Sets the backtrace sampling period (see `set_backtrace_sampling()`)
+///
+/// # Returns
+/// 0 on success, or -1 if cimpl was built without the `leak-trace` feature.
+#[no_mangle]
+pub extern "C" fn cimpl_trace_set_sampling(every: u32) -> i32 {
+    #[cfg(feature = "leak-trace")]
+    {
+        set_backtrace_sampling(every);
+        0
+    }
+
+    #[cfg(not(feature = "leak-trace"))]
+    {
+        let _ = every;
+        crate::CimplError::other_static("cimpl was built without the leak-trace feature")
+            .set_last();
+        -1
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::utils::{drop_box, PointerRegistry};
+
+    struct DumpMarker(#[allow(dead_code)] u64);
+
+    extern "C" fn collect(user: *mut c_void, object: *const CimplLiveObject) {
+        let found = unsafe { &mut *(user as *mut Vec<(usize, String, Option<u32>)>) };
+        let object = unsafe { &*object };
+        let type_name = unsafe {
+            std::slice::from_raw_parts(object.type_name as *const u8, object.type_name_len)
+        };
+        let line = (!object.file.is_null()).then_some(object.line);
+        found.push((
+            object.ptr as usize,
+            String::from_utf8_lossy(type_name).into_owned(),
+            line,
+        ));
+    }
+
+    #[test]
+    fn test_dump_reports_type_and_site() {
+        let line = line!() + 1;
+        let ptr = crate::box_tracked!(DumpMarker(7));
+
+        let mut found: Vec<(usize, String, Option<u32>)> = Vec::new();
+        let reported = cimpl_registry_dump(Some(collect), &mut found as *mut _ as *mut c_void);
+        assert!(reported as usize >= 1);
+        let (_, type_name, site) = found.iter().find(|item| item.0 == ptr as usize).unwrap();
+        assert!(type_name.ends_with("DumpMarker"));
+        if cfg!(feature = "leak-trace") {
+            assert_eq!(*site, Some(line));
+        } else {
+            assert_eq!(*site, None);
+        }
+        assert_eq!(cimpl_registry_dump(None, std::ptr::null_mut()), -1);
+        assert_eq!(crate::cimpl_free(ptr as *mut _), 0);
+    }
+
+    #[test]
+    fn test_leak_summary_groups_sites() {
+        let registry = PointerRegistry::new();
+        let ptrs: Vec<usize> = (0..3)
+            .map(|i| Box::into_raw(Box::new(i as u32)) as usize)
+            .collect();
+        for &ptr in &ptrs {
+            registry.track_as::<u32>(ptr, drop_box::<u32>, 0);
+        }
+        let objects = registry.live_objects();
+        let summary = leak_summary(&objects, 10);
+        assert_eq!(summary.len(), 1);
+        assert!(summary[0].starts_with("3 x u32"));
+        assert_eq!(
+            summary[0].contains("trace.rs:"),
+            cfg!(feature = "leak-trace")
+        );
+        assert_eq!(registry.free_many(&ptrs).len(), 0);
+    }
+
+    #[cfg(feature = "leak-trace")]
+    #[test]
+    fn test_backtrace_sampling() {
+        let registry = PointerRegistry::new();
+        let sampled = Box::into_raw(Box::new(1u8)) as usize;
+        let plain = Box::into_raw(Box::new(2u8)) as usize;
+
+        TEST_SAMPLE_EVERY.with(|every| every.set(Some(1)));
+        registry.track_as::<u8>(sampled, drop_box::<u8>, 0);
+        TEST_SAMPLE_EVERY.with(|every| every.set(Some(0)));
+        registry.track_as::<u8>(plain, drop_box::<u8>, 0);
+        TEST_SAMPLE_EVERY.with(|every| every.set(None));
+
+        let objects = registry.live_objects();
+        let backtrace = |ptr| {
+            let object = objects.iter().find(|object| object.ptr == ptr).unwrap();
+            object.backtrace.is_some()
+        };
+        assert!(backtrace(sampled));
+        assert!(!backtrace(plain));
+        registry.free(sampled).unwrap();
+        registry.free(plain).unwrap();
+    }
+}
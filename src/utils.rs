@@ -22,81 +22,581 @@ use std::{
     any::TypeId,
     collections::HashMap,
     os::raw::c_uchar,
-    sync::{Arc, Mutex},
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Arc, Mutex, RwLock, RwLockReadGuard, RwLockWriteGuard,
+    },
+    time::Instant,
 };
 
-use crate::cimpl_error::CimplError;
+use crate::{
+    cimpl_error::CimplError,
+    stats::{CimplRegistryStats, ShardStats},
+    trace::{LiveObject, Site},
+};
 
 // ============================================================================
-// Pointer Registry - Tracks pointers with their cleanup functions
+// Pointer Registry - Tracks pointers with their drop functions
 // ============================================================================
 
-type CleanupFn = Box<dyn FnMut() + Send>;
+/// Type-erased drop function for a tracked pointer: `(address, length word)`
+///
+/// One of these is monomorphized per tracked type, so an entry only stores a
+/// plain function pointer instead of a boxed closure. The length word carries
+/// the element count for slices and is ignored by everything else.
+pub type DropFn = unsafe fn(usize, usize);
+
+/// Type-erased function that takes one more reference to a shared object
+///
+/// Only reference-counted entries (`track_arc()`) have one; it lets views
+/// and other dependents keep the object alive past its `cimpl_free()`.
+pub type RetainFn = unsafe fn(usize);
+
+/// Reference counting for an entry tracked with `track_shared()`
+struct Shared {
+    retain_fn: RetainFn,
+    /// Releases one reference without retiring the object
+    release_fn: DropFn,
+    /// References held by C (`cimpl_retain()` adds one); the entry is
+    /// removed, and `drop_fn` run, when the last of them is released
+    c_refs: AtomicUsize,
+}
+
+/// Registry entry for one tracked pointer
+struct Entry {
+    type_id: TypeId,
+    /// `std::any::type_name` of the type, or empty if tracked untyped
+    type_name: &'static str,
+    drop_fn: DropFn,
+    len: usize,
+    shared: Option<Shared>,
+    /// Where the entry was tracked (empty without the `leak-trace` feature)
+    site: Site,
+}
+
+impl Entry {
+    /// Type name as reported by statistics and dumps
+    fn display_name(&self) -> &'static str {
+        match self.type_name {
+            "" => "unknown",
+            name => name,
+        }
+    }
+
+    #[track_caller]
+    fn new(type_id: TypeId, type_name: &'static str, drop_fn: DropFn, len: usize) -> Self {
+        Self {
+            type_id,
+            type_name,
+            drop_fn,
+            len,
+            shared: None,
+            site: Site::capture(),
+        }
+    }
+}
+
+type ShardMap = HashMap<usize, Entry>;
+
+/// Drops a pointer created with `Box::into_raw()`
+pub(crate) unsafe fn drop_box<T>(ptr: usize, _len: usize) {
+    drop(Box::from_raw(ptr as *mut T));
+}
+
+/// Drops a pointer created with `Arc::into_raw()`
+pub(crate) unsafe fn drop_arc<T>(ptr: usize, _len: usize) {
+    drop(Arc::from_raw(ptr as *const T));
+}
+
+/// Adds a strong reference to a pointer created with `Arc::into_raw()`
+unsafe fn retain_arc<T>(ptr: usize) {
+    Arc::increment_strong_count(ptr as *const T);
+}
+
+/// Drops a pointer created with `CString::into_raw()`
+unsafe fn drop_c_string(ptr: usize, _len: usize) {
+    drop(std::ffi::CString::from_raw(
+        ptr as *mut std::os::raw::c_char,
+    ));
+}
+
+/// Drops a boxed byte slice of `len` bytes
+unsafe fn drop_bytes(ptr: usize, len: usize) {
+    drop(Box::from_raw(std::ptr::slice_from_raw_parts_mut(
+        ptr as *mut u8,
+        len,
+    )));
+}
+
+/// Default number of shards in the global registry (must be a power of two)
+pub const REGISTRY_SHARDS: usize = 64;
+
+/// One independently locked slice of the registry.
+///
+/// Aligned to a cache line so that threads hammering neighbouring shards
+/// don't false-share the lock word. Validation only needs a shared read lock,
+/// so concurrent getters on the same object don't serialize each other.
+#[repr(align(64))]
+struct Shard {
+    tracked: RwLock<ShardMap>,
+    stats: ShardStats,
+}
+
+impl Shard {
+    /// Takes the read lock, timing the wait only if it is contended
+    #[inline]
+    fn read(&self) -> RwLockReadGuard<'_, ShardMap> {
+        match self.tracked.try_read() {
+            Ok(guard) => guard,
+            Err(_) => {
+                let start = Instant::now();
+                let guard = self.tracked.read().unwrap();
+                self.stats.record_wait(start);
+                guard
+            }
+        }
+    }
+
+    /// Takes the write lock, timing the wait only if it is contended
+    #[inline]
+    fn write(&self) -> RwLockWriteGuard<'_, ShardMap> {
+        match self.tracked.try_write() {
+            Ok(guard) => guard,
+            Err(_) => {
+                let start = Instant::now();
+                let guard = self.tracked.write().unwrap();
+                self.stats.record_wait(start);
+                guard
+            }
+        }
+    }
+}
 
 /// Registry that tracks pointers allocated from Rust and passed to C.
-/// Each pointer is associated with its type and a cleanup function,
+/// Each pointer is associated with its type and a drop function,
 /// enabling type validation and universal freeing via `cimpl_free()`.
+///
+/// The registry is split into lock-striped shards keyed by a hash of the
+/// pointer address, so threads working on different objects rarely contend
+/// for the same lock. A registry with a single shard behaves exactly like
+/// one process-wide mutex.
 pub struct PointerRegistry {
-    tracked: Mutex<HashMap<usize, (TypeId, CleanupFn)>>,
+    shards: Box<[Shard]>,
+    mask: usize,
 }
 
 impl PointerRegistry {
-    fn new() -> Self {
+    /// Creates a registry with the default number of shards
+    pub fn new() -> Self {
+        Self::with_shards(REGISTRY_SHARDS)
+    }
+
+    /// Creates a registry with `count` shards (rounded up to a power of two)
+    pub fn with_shards(count: usize) -> Self {
+        let count = count.max(1).next_power_of_two();
+        let shards = (0..count)
+            .map(|_| Shard {
+                tracked: RwLock::new(HashMap::new()),
+                stats: ShardStats::default(),
+            })
+            .collect();
         Self {
-            tracked: Mutex::new(HashMap::new()),
+            shards,
+            mask: count - 1,
         }
     }
 
-    /// Track a pointer with its type and cleanup function
-    fn track(&self, ptr: usize, type_id: TypeId, cleanup: CleanupFn) {
+    /// Select the shard owning a pointer.
+    ///
+    /// Allocations are aligned, so the low address bits carry little entropy;
+    /// a Fibonacci multiply spreads the high bits across the shard index.
+    #[inline]
+    fn shard_index(&self, ptr: usize) -> usize {
+        let hash = (ptr as u64).wrapping_mul(0x9E37_79B9_7F4A_7C15) >> 32;
+        hash as usize & self.mask
+    }
+
+    #[inline]
+    fn shard(&self, ptr: usize) -> &Shard {
+        &self.shards[self.shard_index(ptr)]
+    }
+
+    fn insert(&self, ptr: usize, entry: Entry) {
         if ptr != 0 {
-            self.tracked.lock().unwrap().insert(ptr, (type_id, cleanup));
+            let shard = self.shard(ptr);
+            shard.write().insert(ptr, entry);
+            shard.stats.tracked(1);
         }
     }
 
+    /// Track a pointer with its type, drop function and length word
+    ///
+    /// `drop_fn` is called with `(ptr, len)` when the pointer is freed.
+    /// Prefer `track_as()`, which also records the type name for `stats()`.
+    #[track_caller]
+    pub fn track(&self, ptr: usize, type_id: TypeId, drop_fn: DropFn, len: usize) {
+        self.insert(ptr, Entry::new(type_id, "", drop_fn, len));
+    }
+
+    /// Track a pointer to a `T`, as `track()` does, recording `T`'s name
+    #[track_caller]
+    pub fn track_as<T: 'static>(&self, ptr: usize, drop_fn: DropFn, len: usize) {
+        let entry = Entry::new(TypeId::of::<T>(), std::any::type_name::<T>(), drop_fn, len);
+        self.insert(ptr, entry);
+    }
+
+    /// Track a reference-counted `T` that `retain()` can add references to
+    ///
+    /// `drop_fn` releases one reference; `retain_fn` adds one.
+    #[track_caller]
+    pub fn track_shared<T: 'static>(&self, ptr: usize, drop_fn: DropFn, retain_fn: RetainFn) {
+        self.track_shared_with::<T>(ptr, drop_fn, retain_fn, drop_fn);
+    }
+
+    /// Track a reference-counted `T` whose last C reference needs its own
+    /// drop function
+    ///
+    /// `drop_fn` releases C's last reference; `release_fn` releases any other.
+    #[track_caller]
+    pub(crate) fn track_shared_with<T: 'static>(
+        &self,
+        ptr: usize,
+        drop_fn: DropFn,
+        retain_fn: RetainFn,
+        release_fn: DropFn,
+    ) {
+        let mut entry = Entry::new(TypeId::of::<T>(), std::any::type_name::<T>(), drop_fn, 0);
+        entry.shared = Some(Shared {
+            retain_fn,
+            release_fn,
+            c_refs: AtomicUsize::new(1),
+        });
+        self.insert(ptr, entry);
+    }
+
     /// Validate that a pointer is tracked and has the expected type
     pub fn validate(&self, ptr: usize, expected_type: TypeId) -> Result<(), CimplError> {
+        self.check(ptr, expected_type, false)
+    }
+
+    /// Validate a pointer that is about to be borrowed mutably
+    ///
+    /// Like `validate()`, but also fails for reference-counted entries
+    /// (`track_arc()`, `arc_tracked!`): views, `cimpl_retain()` holders and
+    /// other threads may be reading them, so they can only be borrowed
+    /// immutably.
+    pub fn validate_exclusive(&self, ptr: usize, expected_type: TypeId) -> Result<(), CimplError> {
+        self.check(ptr, expected_type, true)
+    }
+
+    /// Failures are not counted here: arenas and pools may still own `ptr`,
+    /// so `validate_pointer()` counts them once every owner has said no.
+    fn check(&self, ptr: usize, expected_type: TypeId, exclusive: bool) -> Result<(), CimplError> {
+        if ptr == 0 {
+            return Err(CimplError::null_parameter_static("pointer"));
+        }
+
+        match self.shard(ptr).read().get(&ptr) {
+            Some(entry) if entry.type_id == expected_type => {
+                if !exclusive || entry.shared.is_none() {
+                    return Ok(());
+                }
+                Err(CimplError::other(format!(
+                    "Handle {ptr:#x} is shared and cannot be borrowed mutably"
+                )))
+            }
+            Some(_) => Err(CimplError::wrong_handle_type(ptr as u64)),
+            None => Err(CimplError::invalid_handle(ptr as u64)),
+        }
+    }
+
+    /// Validate a pointer and take one more Rust-side reference to it
+    ///
+    /// The reference is taken under the shard lock, so a concurrent `free()`
+    /// cannot release the object in between. Returns the function that
+    /// releases the new reference. Fails for pointers that are not
+    /// reference counted (e.g. `Box`-tracked objects).
+    pub fn retain(&self, ptr: usize, expected_type: TypeId) -> Result<DropFn, CimplError> {
         if ptr == 0 {
-            return Err(CimplError::null_parameter("pointer".to_string()));
+            return Err(CimplError::null_parameter_static("pointer"));
         }
 
-        let tracked = self.tracked.lock().unwrap();
-        match tracked.get(&ptr) {
-            Some((actual_type, _)) if *actual_type == expected_type => Ok(()),
+        let shard = self.shard(ptr);
+        let result = match shard.read().get(&ptr) {
+            Some(entry) if entry.type_id == expected_type => match &entry.shared {
+                Some(shared) => {
+                    unsafe { (shared.retain_fn)(ptr) };
+                    return Ok(shared.release_fn);
+                }
+                None => Err(CimplError::other_static("Pointer is not reference counted")),
+            },
             Some(_) => Err(CimplError::wrong_handle_type(ptr as u64)),
             None => Err(CimplError::invalid_handle(ptr as u64)),
+        };
+        shard.stats.failed_validation();
+        result
+    }
+
+    /// Add a C reference to a tracked shared pointer
+    ///
+    /// Only takes the shard's read lock, so many threads can share one object
+    /// without serializing on the registry. The pointer then needs one more
+    /// `free()` or `release()` before it is dropped.
+    pub fn share(&self, ptr: usize) -> Result<(), CimplError> {
+        if ptr == 0 {
+            return Err(CimplError::null_parameter_static("pointer"));
+        }
+
+        let shard = self.shard(ptr);
+        let result = match shard.read().get(&ptr) {
+            Some(Entry {
+                shared: Some(shared),
+                ..
+            }) => {
+                shared.c_refs.fetch_add(1, Ordering::Relaxed);
+                unsafe { (shared.retain_fn)(ptr) };
+                return Ok(());
+            }
+            Some(_) => Err(CimplError::other_static("Pointer is not reference counted")),
+            None => Err(CimplError::invalid_handle(ptr as u64)),
+        };
+        shard.stats.failed_validation();
+        result
+    }
+
+    /// Release one C reference to a tracked pointer
+    ///
+    /// Same as `free()`, except that dropping one of several references to a
+    /// shared pointer only takes the shard's read lock.
+    pub fn release(&self, ptr: usize) -> Result<(), CimplError> {
+        let shard = self.shard(ptr);
+        let release_fn = match shard.read().get(&ptr) {
+            Some(Entry {
+                shared: Some(shared),
+                ..
+            }) => shared
+                .c_refs
+                .fetch_update(Ordering::AcqRel, Ordering::Acquire, |n| {
+                    (n > 1).then(|| n - 1)
+                })
+                .ok()
+                .map(|_| shared.release_fn),
+            _ => None,
+        };
+        match release_fn {
+            Some(release_fn) => {
+                unsafe { release_fn(ptr, 0) };
+                Ok(())
+            }
+            None => self.free(ptr),
         }
     }
 
-    /// Free a tracked pointer by calling its cleanup function
+    /// Free a tracked pointer by calling its drop function
     pub fn free(&self, ptr: usize) -> Result<(), CimplError> {
         if ptr == 0 {
             return Ok(()); // NULL is always safe
         }
 
-        let mut cleanup = {
-            let mut tracked = self.tracked.lock().unwrap();
-            match tracked.remove(&ptr) {
-                Some((_, cleanup)) => cleanup,
-                None => return Err(CimplError::invalid_handle(ptr as u64)),
+        let shard = self.shard(ptr);
+        let removed = {
+            let mut tracked = shard.write();
+            match tracked.get(&ptr).and_then(|entry| entry.shared.as_ref()) {
+                // Other C references remain; the entry stays
+                Some(shared) if shared.c_refs.load(Ordering::Acquire) > 1 => {
+                    shared.c_refs.fetch_sub(1, Ordering::AcqRel);
+                    let release_fn = shared.release_fn;
+                    drop(tracked);
+                    unsafe { release_fn(ptr, 0) };
+                    return Ok(());
+                }
+                _ => tracked.remove(&ptr),
             }
-        }; // Release lock before cleanup
+        }; // Lock released here
+
+        // Not counted as an invalid free yet: an arena may own the pointer
+        let Some(entry) = removed else {
+            return Err(CimplError::invalid_handle(ptr as u64));
+        };
+        shard.stats.freed(1);
 
-        cleanup(); // Run the cleanup function
+        unsafe { (entry.drop_fn)(ptr, entry.len) };
         Ok(())
     }
+
+    /// Track a batch of pointers to `T`, locking each shard at most once
+    ///
+    /// Each item is `(ptr, drop_fn, len)` as for `track_as()`.
+    /// NULL pointers are skipped.
+    #[track_caller]
+    pub fn track_many<T: 'static, I>(&self, items: I)
+    where
+        I: IntoIterator<Item = (usize, DropFn, usize)>,
+    {
+        let (type_id, type_name) = (TypeId::of::<T>(), std::any::type_name::<T>());
+        let items = items.into_iter();
+        let mut batch: Vec<(usize, usize, Entry)> = Vec::with_capacity(items.size_hint().0);
+        // A loop rather than map() so Entry::new() sees our caller's location
+        for (ptr, drop_fn, len) in items.filter(|item| item.0 != 0) {
+            let entry = Entry::new(type_id, type_name, drop_fn, len);
+            batch.push((self.shard_index(ptr), ptr, entry));
+        }
+        batch.sort_unstable_by_key(|item| item.0);
+
+        let mut items = batch.into_iter().peekable();
+        while let Some((index, ptr, entry)) = items.next() {
+            let shard = &self.shards[index];
+            let mut tracked = shard.write();
+            tracked.insert(ptr, entry);
+            let mut count = 1;
+            while let Some((_, ptr, entry)) = items.next_if(|item| item.0 == index) {
+                tracked.insert(ptr, entry);
+                count += 1;
+            }
+            shard.stats.tracked(count);
+        }
+    }
+
+    /// Free a batch of pointers, locking each shard at most once
+    ///
+    /// Drop functions run after all locks are released, as in `free()`.
+    /// NULL pointers are skipped. Returns the pointers that were not tracked
+    /// (invalid or double-free, including repeats within the batch); they
+    /// are not counted as invalid frees, since an arena or pool may own them.
+    pub fn free_many(&self, ptrs: &[usize]) -> Vec<usize> {
+        let mut batch: Vec<(usize, usize)> = ptrs
+            .iter()
+            .filter(|&&ptr| ptr != 0)
+            .map(|&ptr| (self.shard_index(ptr), ptr))
+            .collect();
+        batch.sort_unstable_by_key(|item| item.0);
+
+        // (ptr, drop function, length word) to run once the locks are released
+        let mut drops: Vec<(usize, DropFn, usize)> = Vec::with_capacity(batch.len());
+        let mut invalid = Vec::new();
+        let mut items = batch.into_iter().peekable();
+        while let Some((index, ptr)) = items.next() {
+            let shard = &self.shards[index];
+            let mut freed = 0;
+            let mut tracked = shard.write();
+            let mut remove = |ptr: usize| {
+                if let Some(shared) = tracked.get(&ptr).and_then(|entry| entry.shared.as_ref()) {
+                    if shared.c_refs.load(Ordering::Acquire) > 1 {
+                        shared.c_refs.fetch_sub(1, Ordering::AcqRel);
+                        drops.push((ptr, shared.release_fn, 0));
+                        return;
+                    }
+                }
+                match tracked.remove(&ptr) {
+                    Some(entry) => {
+                        drops.push((ptr, entry.drop_fn, entry.len));
+                        freed += 1;
+                    }
+                    None => invalid.push(ptr),
+                }
+            };
+            remove(ptr);
+            while let Some((_, ptr)) = items.next_if(|item| item.0 == index) {
+                remove(ptr);
+            }
+            drop(tracked);
+            shard.stats.freed(freed);
+        } // Locks are released before running drop functions
+
+        for (ptr, drop_fn, len) in drops {
+            unsafe { drop_fn(ptr, len) };
+        }
+        invalid
+    }
+
+    /// Number of pointers currently tracked across all shards
+    pub fn len(&self) -> usize {
+        self.shards.iter().map(|shard| shard.read().len()).sum()
+    }
+
+    /// Counts a validation that every owner (registry, arena, pool) rejected
+    pub(crate) fn count_failed_validation(&self, ptr: usize) {
+        self.shard(ptr).stats.failed_validation();
+    }
+
+    /// Counts a free of a pointer that no owner knew (invalid or double-free)
+    pub(crate) fn count_invalid_free(&self, ptr: usize) {
+        self.shard(ptr).stats.invalid_frees(1);
+    }
+
+    /// Totals of the per-shard counters, plus the live object count
+    pub fn stats(&self) -> CimplRegistryStats {
+        let mut stats = CimplRegistryStats {
+            live: self.len() as u64,
+            ..Default::default()
+        };
+        for shard in self.shards.iter() {
+            shard.stats.add_to(&mut stats);
+        }
+        stats
+    }
+
+    /// Live objects per type name, sorted by name
+    ///
+    /// Objects tracked with the untyped `track()` are counted as "unknown".
+    /// Walks every entry, so call it for reporting rather than per operation.
+    pub fn live_by_type(&self) -> Vec<(&'static str, u64)> {
+        let mut counts: HashMap<&'static str, u64> = HashMap::new();
+        for shard in self.shards.iter() {
+            for entry in shard.read().values() {
+                *counts.entry(entry.display_name()).or_default() += 1;
+            }
+        }
+        let mut counts: Vec<_> = counts.into_iter().collect();
+        counts.sort_unstable();
+        counts
+    }
+
+    /// Every live object with its type and allocation site, sorted by type
+    ///
+    /// Sites are only known with the `leak-trace` feature. Shard locks are
+    /// held only while copying entries out; backtraces are shared, not
+    /// formatted.
+    pub fn live_objects(&self) -> Vec<LiveObject> {
+        let mut objects = Vec::new();
+        for shard in self.shards.iter() {
+            objects.extend(shard.read().iter().map(|(&ptr, entry)| LiveObject {
+                ptr,
+                type_name: entry.display_name(),
+                location: entry.site.location(),
+                backtrace: entry.site.backtrace(),
+            }));
+        }
+        objects.sort_unstable_by(|a, b| (a.type_name, a.ptr).cmp(&(b.type_name, b.ptr)));
+        objects
+    }
+
+    /// Returns true if no pointers are currently tracked
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+impl Default for PointerRegistry {
+    fn default() -> Self {
+        Self::new()
+    }
 }
 
 impl Drop for PointerRegistry {
     fn drop(&mut self) {
-        let tracked = self.tracked.lock().unwrap();
-        if !tracked.is_empty() {
+        let leaked = self.len();
+        if leaked > 0 {
             eprintln!(
                 "\n⚠️  WARNING: {} pointer(s) were not freed at shutdown!",
-                tracked.len()
+                leaked
             );
             eprintln!("This indicates C code did not properly free all allocated pointers.");
-            eprintln!("Each pointer should be freed exactly once with cimpl_free().\n");
+            eprintln!("Each pointer should be freed exactly once with cimpl_free().");
+            for line in crate::trace::leak_summary(&self.live_objects(), 20) {
+                eprintln!("  {line}");
+            }
+            eprintln!();
         }
     }
 }
@@ -116,41 +616,219 @@ pub(crate) fn get_registry() -> &'static PointerRegistry {
 ///
 /// Use this when you allocate with `Box::into_raw()`.
 /// The pointer will be freed with `Box::from_raw()` when `cimpl_free()` is called.
+#[track_caller]
 pub fn track_box<T: 'static>(ptr: *mut T) {
-    let ptr_val = ptr as usize; // Store as usize to make it Send
-    let cleanup = move || unsafe {
-        drop(Box::from_raw(ptr_val as *mut T));
-    };
-    get_registry().track(ptr as usize, TypeId::of::<T>(), Box::new(cleanup));
+    get_registry().track_as::<T>(ptr as usize, drop_box::<T>, 0);
 }
 
 /// Track an Arc-wrapped pointer
 ///
 /// Use this when you allocate with `Arc::into_raw()`.
 /// The pointer will be freed with `Arc::from_raw()` when `cimpl_free()` is called.
+#[track_caller]
 pub fn track_arc<T: 'static>(ptr: *mut T) {
-    let ptr_val = ptr as usize; // Store as usize to make it Send
-    let cleanup = move || unsafe {
-        drop(Arc::from_raw(ptr_val as *const T));
-    };
-    get_registry().track(ptr as usize, TypeId::of::<T>(), Box::new(cleanup));
+    get_registry().track_shared::<T>(ptr as usize, drop_arc::<T>, retain_arc::<T>);
 }
 
 /// Track an Arc<Mutex<T>>-wrapped pointer
 ///
 /// Use this when you allocate with `Arc::into_raw(Arc::new(Mutex::new(value)))`.
 /// The pointer will be freed with `Arc::from_raw()` when `cimpl_free()` is called.
+#[track_caller]
 pub fn track_arc_mutex<T: 'static>(ptr: *mut Mutex<T>) {
-    let ptr_val = ptr as usize; // Store as usize to make it Send
-    let cleanup = move || unsafe {
-        drop(Arc::from_raw(ptr_val as *const Mutex<T>));
-    };
-    get_registry().track(ptr as usize, TypeId::of::<Mutex<T>>(), Box::new(cleanup));
+    get_registry().track_shared::<Mutex<T>>(
+        ptr as usize,
+        drop_arc::<Mutex<T>>,
+        retain_arc::<Mutex<T>>,
+    );
+}
+
+/// Allocate a value and track it, as `box_tracked!` does
+///
+/// Boxes the value and tracks it in the registry, or allocates it in the
+/// current thread's arena if one is set.
+#[track_caller]
+pub fn alloc_tracked<T: 'static>(value: T) -> *mut T {
+    let mut value = Some(value);
+    if let Some(ptr) = crate::arena::with_current(|arena| arena.alloc_value(value.take().unwrap()))
+    {
+        return ptr;
+    }
+    #[cfg(feature = "object-header")]
+    return crate::header::alloc_box(value.take().unwrap());
+
+    #[cfg(not(feature = "object-header"))]
+    {
+        let ptr = Box::into_raw(Box::new(value.take().unwrap()));
+        track_box(ptr);
+        ptr
+    }
+}
+
+/// Allocate a reference-counted value and track it, as `arc_tracked!` does
+#[track_caller]
+pub fn alloc_shared<T: 'static>(value: T) -> *mut T {
+    #[cfg(feature = "object-header")]
+    return crate::header::alloc_arc(value);
+
+    #[cfg(not(feature = "object-header"))]
+    {
+        let ptr = Arc::into_raw(Arc::new(value)) as *mut T;
+        track_arc(ptr);
+        ptr
+    }
+}
+
+/// Track a batch of Box-wrapped pointers with one lock per registry shard
+///
+/// Equivalent to calling `track_box()` on each pointer.
+#[track_caller]
+pub fn track_many<T: 'static>(ptrs: &[*mut T]) {
+    get_registry().track_many::<T, _>(
+        ptrs.iter()
+            .map(|&ptr| (ptr as usize, drop_box::<T> as DropFn, 0)),
+    );
 }
 
 /// Validate that a pointer is tracked and has the expected type
+///
+/// Pointers owned by a live arena (see `arena`) or a pool (see `pool`) are
+/// validated against their owner when the registry doesn't know them. With the
+/// `object-header` feature, `box_tracked!` and `arc_tracked!` objects are
+/// validated by their header (see `header`) without a registry lookup.
 pub fn validate_pointer<T: 'static>(ptr: *mut T) -> Result<(), CimplError> {
-    get_registry().validate(ptr as usize, TypeId::of::<T>())
+    validate_owned(ptr, false)
+}
+
+/// Validate a pointer that is about to be borrowed mutably
+///
+/// Like `validate_pointer()`, but rejects shared (`arc_tracked!`) objects,
+/// which only hand out shared references; keep their mutable state behind a
+/// `Mutex` or `RwLock` and use `deref_or_return!` instead.
+pub fn validate_pointer_mut<T: 'static>(ptr: *mut T) -> Result<(), CimplError> {
+    validate_owned(ptr, true)
+}
+
+fn validate_owned<T: 'static>(ptr: *mut T, exclusive: bool) -> Result<(), CimplError> {
+    #[cfg(feature = "object-header")]
+    if crate::header::is_live::<T>(ptr as usize, exclusive) {
+        return Ok(());
+    }
+    validate_in(get_registry(), ptr as usize, TypeId::of::<T>(), exclusive)
+}
+
+/// Validates against `registry`, then the arenas and pools, and counts a
+/// failure only if all of them reject the pointer
+pub(crate) fn validate_in(
+    registry: &PointerRegistry,
+    ptr: usize,
+    expected_type: TypeId,
+    exclusive: bool,
+) -> Result<(), CimplError> {
+    let result = if exclusive {
+        registry.validate_exclusive(ptr, expected_type)
+    } else {
+        registry.validate(ptr, expected_type)
+    };
+    let result = match result {
+        Err(e) if ptr == 0 => return Err(e),
+        Err(e) => crate::arena::validate(ptr, expected_type)
+            .or_else(|| crate::pool::validate(ptr, expected_type))
+            .unwrap_or(Err(e)),
+        ok => ok,
+    };
+    if result.is_err() {
+        registry.count_failed_validation(ptr);
+    }
+    result
+}
+
+/// Validate a pointer from a trusted caller
+///
+/// Only checks for NULL in release builds; debug builds still run the full
+/// `validate_pointer()` check so type confusion is caught in testing.
+/// Tracking is unaffected, so `cimpl_free()` still rejects double-frees
+/// and leaks are still reported.
+#[inline]
+pub fn validate_trusted<T: 'static>(ptr: *mut T) -> Result<(), CimplError> {
+    if cfg!(debug_assertions) {
+        return validate_pointer(ptr);
+    }
+    if ptr.is_null() {
+        return Err(CimplError::null_parameter_static("pointer"));
+    }
+    Ok(())
+}
+
+/// Validate a pointer from a trusted caller for a mutable borrow
+///
+/// Like `validate_trusted()`, but debug builds run `validate_pointer_mut()`,
+/// so a `&mut` into a shared object is still caught in testing.
+#[inline]
+pub fn validate_trusted_mut<T: 'static>(ptr: *mut T) -> Result<(), CimplError> {
+    if cfg!(debug_assertions) {
+        return validate_pointer_mut(ptr);
+    }
+    if ptr.is_null() {
+        return Err(CimplError::null_parameter_static("pointer"));
+    }
+    Ok(())
+}
+
+/// Validation used by the `deref_*` macros
+///
+/// `validate_pointer()`, or `validate_trusted()` when the crate is built
+/// with the `unchecked-handles` feature.
+#[doc(hidden)]
+#[inline]
+pub fn validate_deref<T: 'static>(ptr: *mut T) -> Result<(), CimplError> {
+    if cfg!(feature = "unchecked-handles") {
+        validate_trusted(ptr)
+    } else {
+        validate_pointer(ptr)
+    }
+}
+
+/// Validation used by the `deref_mut_*` macros
+///
+/// `validate_pointer_mut()`, or `validate_trusted_mut()` when the crate is
+/// built with the `unchecked-handles` feature.
+#[doc(hidden)]
+#[inline]
+pub fn validate_deref_mut<T: 'static>(ptr: *mut T) -> Result<(), CimplError> {
+    if cfg!(feature = "unchecked-handles") {
+        validate_trusted_mut(ptr)
+    } else {
+        validate_pointer_mut(ptr)
+    }
+}
+
+/// Frees a tracked pointer, falling back to the arena that owns it
+///
+/// Pooled pointers go straight back to their pool without touching the
+/// registry.
+fn free_pointer(ptr: usize) -> Result<(), CimplError> {
+    free_in(get_registry(), ptr, PointerRegistry::free)
+}
+
+/// Frees through the pools, `free` on `registry`, then the arenas, and
+/// counts an invalid free only if none of them owned the pointer
+pub(crate) fn free_in(
+    registry: &PointerRegistry,
+    ptr: usize,
+    free: fn(&PointerRegistry, usize) -> Result<(), CimplError>,
+) -> Result<(), CimplError> {
+    let result = match crate::pool::free(ptr) {
+        Some(result) => result,
+        None => match free(registry, ptr) {
+            Err(_) if crate::arena::free(ptr) => Ok(()),
+            result => result,
+        },
+    };
+    if result.is_err() {
+        registry.count_invalid_free(ptr);
+    }
+    result
 }
 
 /// Universal free function for any tracked pointer
@@ -178,7 +856,60 @@ pub fn validate_pointer<T: 'static>(ptr: *mut T) -> Result<(), CimplError> {
 /// ```
 #[no_mangle]
 pub extern "C" fn cimpl_free(ptr: *mut std::ffi::c_void) -> i32 {
-    match get_registry().free(ptr as usize) {
+    match free_pointer(ptr as usize) {
+        Ok(()) => 0,
+        Err(e) => {
+            e.set_last();
+            -1
+        }
+    }
+}
+
+/// Adds a reference to a pointer created with `arc_tracked!`
+///
+/// Each reference is released with `cimpl_release()` (or `cimpl_free()`);
+/// the object is dropped when the last one is released. Retaining only
+/// takes a shared registry lock, so threads can cheaply fan out one
+/// immutable object, such as a settings context, instead of copying it.
+///
+/// # Returns
+/// - `ptr` on success, so the result can be handed straight to a new owner
+/// - NULL if `ptr` is NULL, not tracked, or not reference counted
+///
+/// # Example (C)
+/// ```c
+/// Context* ctx = context_new();
+/// for (int i = 0; i < n; i++) {
+///     start_worker(cimpl_retain(ctx)); // worker calls cimpl_release(ctx)
+/// }
+/// cimpl_release(ctx);
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_retain(ptr: *mut std::ffi::c_void) -> *mut std::ffi::c_void {
+    match get_registry().share(ptr as usize) {
+        Ok(()) => ptr,
+        Err(e) => {
+            e.set_last();
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Releases one reference to a tracked pointer
+///
+/// Works like `cimpl_free()` for any tracked pointer. For pointers shared
+/// with `cimpl_retain()`, only the last release frees the object, and the
+/// others don't take the registry's exclusive lock.
+///
+/// # Returns
+/// - 0 on success (or if ptr is NULL)
+/// - -1 if the pointer was not tracked (invalid or already released)
+#[no_mangle]
+pub extern "C" fn cimpl_release(ptr: *mut std::ffi::c_void) -> i32 {
+    if ptr.is_null() {
+        return 0;
+    }
+    match free_in(get_registry(), ptr as usize, PointerRegistry::release) {
         Ok(()) => 0,
         Err(e) => {
             e.set_last();
@@ -187,6 +918,55 @@ pub extern "C" fn cimpl_free(ptr: *mut std::ffi::c_void) -> i32 {
     }
 }
 
+/// Frees a batch of tracked pointers in one call
+///
+/// Equivalent to calling `cimpl_free()` on each element, but crosses the FFI
+/// boundary once and takes each registry lock at most once. NULL elements are
+/// skipped. Useful for releasing whole result sets (e.g. arrays of strings).
+///
+/// # Returns
+/// - Number of pointers that were not tracked (0 means all were freed)
+/// - -1 if `ptrs` is NULL and `n` is not 0
+///
+/// If any pointer is invalid, the last error is set for the first of them.
+///
+/// # Example (C)
+/// ```c
+/// char* names[3] = { thing_name(a), thing_name(b), thing_name(c) };
+/// if (cimpl_free_many((void**)names, 3) != 0) {
+///     fprintf(stderr, "some pointers were invalid\n");
+/// }
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_free_many(ptrs: *const *mut std::ffi::c_void, n: usize) -> isize {
+    if n == 0 {
+        return 0;
+    }
+    crate::ptr_or_return!(ptrs, -1);
+
+    // SAFETY: caller guarantees `ptrs` points to `n` readable pointers
+    let ptrs = unsafe { std::slice::from_raw_parts(ptrs as *const usize, n) };
+    let invalid = free_many_in(get_registry(), ptrs);
+    if let Some(&ptr) = invalid.first() {
+        CimplError::invalid_handle(ptr as u64).set_last();
+    }
+    invalid.len() as isize
+}
+
+/// Frees a batch through `registry`, then the arenas and pools, and returns
+/// (and counts as invalid frees) the pointers none of them owned
+pub(crate) fn free_many_in(registry: &PointerRegistry, ptrs: &[usize]) -> Vec<usize> {
+    let mut invalid = registry.free_many(ptrs);
+    invalid.retain(|&ptr| {
+        let pooled = matches!(crate::pool::free(ptr), Some(Ok(())));
+        !pooled && !crate::arena::free(ptr)
+    });
+    for &ptr in &invalid {
+        registry.count_invalid_free(ptr);
+    }
+    invalid
+}
+
 // ============================================================================
 // Buffer Safety Utilities
 // ============================================================================
@@ -240,19 +1020,39 @@ pub unsafe fn is_safe_buffer_size(size: usize, ptr: *const c_uchar) -> bool {
 /// - The memory remains valid for the lifetime of the returned slice
 /// - The memory is not mutated while the slice exists
 /// - `len` does not exceed the actual size of the allocated memory
-pub unsafe fn safe_slice_from_raw_parts(
+pub unsafe fn safe_slice_from_raw_parts<'a>(
     ptr: *const c_uchar,
     len: usize,
     param_name: &str,
-) -> Result<&[u8], CimplError> {
+) -> Result<&'a [u8], CimplError> {
     if ptr.is_null() {
-        return Err(CimplError::null_parameter(param_name.to_string()));
+        return Err(CimplError::null_parameter(param_name));
     }
 
     if !is_safe_buffer_size(len, ptr) {
-        return Err(CimplError::other(format!(
-            "Buffer size {len} is invalid for parameter '{param_name}'",
-        )));
+        return Err(CimplError::invalid_buffer_size(param_name, len));
+    }
+
+    Ok(std::slice::from_raw_parts(ptr, len))
+}
+
+/// `safe_slice_from_raw_parts()` for a `&'static str` parameter name, which
+/// a NULL-pointer error stores without allocating
+///
+/// # Safety
+/// Same as `safe_slice_from_raw_parts()`.
+#[doc(hidden)]
+pub unsafe fn safe_slice_from_raw_parts_static<'a>(
+    ptr: *const c_uchar,
+    len: usize,
+    param_name: &'static str,
+) -> Result<&'a [u8], CimplError> {
+    if ptr.is_null() {
+        return Err(CimplError::null_parameter_static(param_name));
+    }
+
+    if !is_safe_buffer_size(len, ptr) {
+        return Err(CimplError::invalid_buffer_size(param_name, len));
     }
 
     Ok(std::slice::from_raw_parts(ptr, len))
@@ -262,6 +1062,8 @@ pub unsafe fn safe_slice_from_raw_parts(
 ///
 /// The returned pointer is tracked for allocation safety and MUST be freed
 /// by calling the appropriate free function (e.g., `c2pa_string_free`).
+/// If the thread has a current arena, the string is copied into the arena
+/// and released by `cimpl_arena_reset()` instead.
 ///
 /// # Arguments
 /// * `s` - The Rust String to convert
@@ -271,29 +1073,126 @@ pub unsafe fn safe_slice_from_raw_parts(
 ///
 /// # Safety
 /// The returned pointer must be freed exactly once by C code
+#[track_caller]
 pub fn to_c_string(s: String) -> *mut std::os::raw::c_char {
     use std::ffi::CString;
+    if let Some(ptr) = crate::arena::with_current(|arena| arena.alloc_c_string(&s)) {
+        return ptr;
+    }
     match CString::new(s) {
         Ok(c_str) => {
             let ptr = c_str.into_raw();
-            let ptr_val = ptr as usize;
-            get_registry().track(
-                ptr_val,
-                TypeId::of::<CString>(),
-                Box::new(move || unsafe {
-                    drop(CString::from_raw(ptr_val as *mut std::os::raw::c_char))
-                }),
-            );
+            get_registry().track_as::<CString>(ptr as usize, drop_c_string, 0);
             ptr
         }
         Err(_) => std::ptr::null_mut(),
     }
 }
 
+/// Converts a batch of Rust Strings to tracked C strings
+///
+/// Like calling `to_c_string` on each element, but registers the whole batch
+/// with one lock per registry shard. Strings containing interior NUL bytes
+/// become null pointers. Free the results with `cimpl_free_many()`.
+#[track_caller]
+pub fn to_c_strings(strings: Vec<String>) -> Vec<*mut std::os::raw::c_char> {
+    use std::ffi::CString;
+    let ptrs: Vec<_> = strings
+        .into_iter()
+        .map(|s| match CString::new(s) {
+            Ok(c_str) => c_str.into_raw(),
+            Err(_) => std::ptr::null_mut(),
+        })
+        .collect();
+    get_registry().track_many::<CString, _>(
+        ptrs.iter()
+            .map(|&ptr| (ptr as usize, drop_c_string as DropFn, 0)),
+    );
+    ptrs
+}
+
+/// Writes a string into a caller-provided buffer with `snprintf` semantics
+///
+/// Copies as much of `s` as fits in `cap - 1` bytes (never splitting a UTF-8
+/// character) and always nul-terminates when `cap > 0`. Nothing is allocated
+/// or tracked, so the caller owns the buffer and frees nothing.
+///
+/// # Arguments
+/// * `s` - The string to write
+/// * `buf` - Destination buffer; may be null only when `cap` is 0
+/// * `cap` - Size of `buf` in bytes, including room for the nul
+/// * `out_len` - Optional; receives the number of bytes written, excluding the nul
+///
+/// # Returns
+/// * The length of `s` in bytes, excluding the nul. If this is `>= cap` the
+///   output was truncated; call again with a buffer of at least `len + 1` bytes.
+/// * `-1` if `buf` is null with a non-zero `cap`, or `s` contains a nul byte
+///
+/// # Example (C)
+/// ```c
+/// char buf[64];
+/// intptr_t len = thing_name_into(thing, buf, sizeof buf, NULL);
+/// if (len >= (intptr_t)sizeof buf) {
+///     char* big = malloc(len + 1);
+///     thing_name_into(thing, big, len + 1, NULL);
+/// }
+/// ```
+///
+/// # Safety
+/// `buf` must be valid for writes of `cap` bytes, and `out_len` must be null
+/// or valid for a write.
+pub unsafe fn write_c_string_into(
+    s: &str,
+    buf: *mut std::os::raw::c_char,
+    cap: usize,
+    out_len: *mut usize,
+) -> isize {
+    if buf.is_null() && cap > 0 {
+        CimplError::null_parameter_static("buf").set_last();
+        return -1;
+    }
+    if s.as_bytes().contains(&0) {
+        CimplError::other_static("String contains a nul byte").set_last();
+        return -1;
+    }
+
+    let written = copy_c_string_into(s, buf, cap);
+    if !out_len.is_null() {
+        *out_len = written;
+    }
+    s.len() as isize
+}
+
+/// Copies as much of `s` as fits in `cap - 1` bytes of `buf`, never splitting
+/// a UTF-8 character, and nul-terminates when `cap > 0`
+///
+/// Returns the number of bytes written, excluding the nul. Does not validate
+/// its arguments or set the last error.
+///
+/// # Safety
+/// `buf` must be valid for writes of `cap` bytes.
+pub(crate) unsafe fn copy_c_string_into(
+    s: &str,
+    buf: *mut std::os::raw::c_char,
+    cap: usize,
+) -> usize {
+    if cap == 0 {
+        return 0;
+    }
+    let mut written = s.len().min(cap - 1);
+    while !s.is_char_boundary(written) {
+        written -= 1;
+    }
+    std::ptr::copy_nonoverlapping(s.as_ptr(), buf as *mut u8, written);
+    *buf.add(written) = 0;
+    written
+}
+
 /// Converts a `Vec <u8>` to a tracked C byte array pointer
 ///
 /// The returned pointer is tracked for allocation safety and MUST be freed
-/// by calling `free_c_bytes`.
+/// by calling `free_c_bytes`. If the thread has a current arena, the bytes
+/// are copied into the arena and released by `cimpl_arena_reset()` instead.
 ///
 /// # Arguments
 /// * `bytes` - The byte vector to convert
@@ -303,29 +1202,110 @@ pub fn to_c_string(s: String) -> *mut std::os::raw::c_char {
 ///
 /// # Safety
 /// The returned pointer must be freed exactly once by calling `free_c_bytes`
+#[track_caller]
 pub fn to_c_bytes(bytes: Vec<u8>) -> *const c_uchar {
+    if let Some(ptr) = crate::arena::with_current(|arena| arena.alloc_bytes(&bytes)) {
+        return ptr;
+    }
     let len = bytes.len();
     let ptr = Box::into_raw(bytes.into_boxed_slice()) as *const c_uchar;
-    let ptr_val = ptr as usize;
-    get_registry().track(
-        ptr_val,
-        TypeId::of::<Box<[u8]>>(),
-        Box::new(move || {
-            unsafe {
-                // Reconstruct the slice with the original length
-                drop(Box::from_raw(std::slice::from_raw_parts_mut(
-                    ptr_val as *mut u8,
-                    len,
-                )))
-            }
-        }),
-    );
+    get_registry().track_as::<Box<[u8]>>(ptr as usize, drop_bytes, len);
     ptr
 }
 
 #[cfg(test)]
-mod tests {
+pub(crate) mod tests {
     use super::*;
+    use std::alloc::{GlobalAlloc, Layout, System};
+    use std::cell::Cell;
+
+    // Counts allocations made by the current thread, so tests running in
+    // parallel don't disturb each other's numbers.
+    struct CountingAlloc;
+
+    thread_local! {
+        static ALLOCATIONS: Cell<usize> = const { Cell::new(0) };
+    }
+
+    fn note_allocation() {
+        let _ = ALLOCATIONS.try_with(|count| count.set(count.get() + 1));
+    }
+
+    unsafe impl GlobalAlloc for CountingAlloc {
+        unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+            note_allocation();
+            System.alloc(layout)
+        }
+
+        unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+            System.dealloc(ptr, layout)
+        }
+
+        unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+            note_allocation();
+            System.realloc(ptr, layout, new_size)
+        }
+    }
+
+    #[global_allocator]
+    static GLOBAL: CountingAlloc = CountingAlloc;
+
+    /// Number of heap allocations the current thread makes while running `f`
+    pub(crate) fn count_allocations<F: FnOnce()>(f: F) -> usize {
+        let before = ALLOCATIONS.with(Cell::get);
+        f();
+        ALLOCATIONS.with(Cell::get) - before
+    }
+
+    unsafe fn noop_drop(_ptr: usize, _len: usize) {}
+
+    /// Tracks `count` boxed values in `registry`, returning their addresses
+    fn track_boxes(registry: &PointerRegistry, addrs: &mut Vec<usize>, count: usize) {
+        for i in 0..count {
+            let ptr = Box::into_raw(Box::new(i as u64)) as usize;
+            registry.track(ptr, TypeId::of::<u64>(), drop_box::<u64>, 0);
+            addrs.push(ptr);
+        }
+    }
+
+    #[test]
+    fn test_tracking_allocates_once_per_object() {
+        const COUNT: usize = 1000;
+        let registry = PointerRegistry::new();
+        let mut addrs = Vec::with_capacity(4 * COUNT);
+
+        // Grow the shard maps first so the measurement excludes rehashing
+        track_boxes(&registry, &mut addrs, 4 * COUNT);
+        for ptr in addrs.drain(..) {
+            registry.free(ptr).unwrap();
+        }
+
+        // Only the Box itself allocates; the entry needs no cleanup closure
+        let allocations = count_allocations(|| track_boxes(&registry, &mut addrs, COUNT));
+        assert_eq!(allocations, COUNT);
+
+        for ptr in addrs.drain(..) {
+            registry.free(ptr).unwrap();
+        }
+        assert!(registry.is_empty());
+    }
+
+    #[test]
+    fn test_tracking_bytes_adds_no_allocation() {
+        // One shard, pre-grown, so the map insert itself cannot allocate
+        let registry = PointerRegistry::with_shards(1);
+        registry.track(0x10, TypeId::of::<u8>(), noop_drop, 0);
+        registry.free(0x10).unwrap();
+
+        let bytes = vec![7u8; 64];
+        let allocations = count_allocations(|| {
+            let len = bytes.len();
+            let ptr = Box::into_raw(bytes.into_boxed_slice()) as *mut u8 as usize;
+            registry.track(ptr, TypeId::of::<Box<[u8]>>(), drop_bytes, len);
+            registry.free(ptr).unwrap();
+        });
+        assert_eq!(allocations, 0);
+    }
 
     #[test]
     fn test_allocation_tracking_double_free_string() {
@@ -367,6 +1347,304 @@ mod tests {
         cimpl_free(ptr as *mut std::ffi::c_void);
     }
 
+    #[test]
+    fn test_registry_shards_round_to_power_of_two() {
+        assert_eq!(PointerRegistry::with_shards(0).shards.len(), 1);
+        assert_eq!(PointerRegistry::with_shards(1).shards.len(), 1);
+        assert_eq!(PointerRegistry::with_shards(48).shards.len(), 64);
+    }
+
+    #[test]
+    fn test_registry_concurrent_track_validate_free() {
+        use std::sync::atomic::{AtomicUsize, Ordering};
+
+        static FREED: AtomicUsize = AtomicUsize::new(0);
+        unsafe fn count_free(_ptr: usize, _len: usize) {
+            FREED.fetch_add(1, Ordering::Relaxed);
+        }
+
+        // Each thread tracks its own fake addresses; drops count frees
+        let registry = PointerRegistry::with_shards(8);
+        std::thread::scope(|scope| {
+            for thread in 0..8usize {
+                let registry = &registry;
+                scope.spawn(move || {
+                    for i in 1..=500usize {
+                        let ptr = (thread << 32 | i) * 16;
+                        registry.track(ptr, TypeId::of::<u32>(), count_free, 0);
+                        assert!(registry.validate(ptr, TypeId::of::<u32>()).is_ok());
+                        assert!(registry.validate(ptr, TypeId::of::<u64>()).is_err());
+                        assert!(registry.free(ptr).is_ok());
+                        assert!(registry.free(ptr).is_err()); // double free detected
+                    }
+                });
+            }
+        });
+        assert_eq!(FREED.load(Ordering::Relaxed), 8 * 500);
+        assert!(registry.is_empty());
+    }
+
+    #[test]
+    fn test_registry_concurrent_validate_same_pointer() {
+        // Readers share one handle while a writer churns the same shard set
+        let registry = PointerRegistry::with_shards(1);
+        let shared = 0x1000usize;
+        registry.track(shared, TypeId::of::<u32>(), noop_drop, 0);
+        std::thread::scope(|scope| {
+            for _ in 0..4 {
+                let registry = &registry;
+                scope.spawn(move || {
+                    for _ in 0..2000 {
+                        assert!(registry.validate(shared, TypeId::of::<u32>()).is_ok());
+                    }
+                });
+            }
+            let registry = &registry;
+            scope.spawn(move || {
+                for i in 1..=2000usize {
+                    let ptr = 0x10_0000 + i * 16;
+                    registry.track(ptr, TypeId::of::<u8>(), noop_drop, 0);
+                    assert!(registry.free(ptr).is_ok());
+                }
+            });
+        });
+        assert!(registry.free(shared).is_ok());
+        assert!(registry.is_empty());
+    }
+
+    #[test]
+    fn test_lock_contention_is_counted() {
+        let registry = PointerRegistry::with_shards(1);
+        registry.track(0x10, TypeId::of::<u8>(), noop_drop, 0);
+        // The waiter can't report that it is blocked, so retry until one of
+        // its reads lands while the write lock is held
+        let barrier = std::sync::Barrier::new(2);
+        for _ in 0..1000 {
+            std::thread::scope(|scope| {
+                let held = registry.shards[0].write();
+                let waiter = scope.spawn(|| {
+                    barrier.wait();
+                    registry.validate(0x10, TypeId::of::<u8>()).is_ok()
+                });
+                barrier.wait();
+                std::thread::yield_now();
+                drop(held);
+                assert!(waiter.join().unwrap());
+            });
+            if registry.stats().lock_contentions > 0 {
+                break;
+            }
+        }
+        let stats = registry.stats();
+        assert!(stats.lock_contentions > 0);
+        assert!(stats.lock_wait_ns > 0);
+        registry.free(0x10).unwrap();
+    }
+
+    #[test]
+    fn test_free_many_counts_invalid_pointers() {
+        let strings = (0..100).map(|i| format!("field {i}")).collect();
+        let mut ptrs: Vec<*mut std::ffi::c_void> = to_c_strings(strings)
+            .into_iter()
+            .map(|p| p.cast())
+            .collect();
+        assert!(ptrs.iter().all(|p| !p.is_null()));
+
+        // A repeat, a NULL and a bogus pointer in the same batch
+        ptrs.push(ptrs[0]);
+        ptrs.push(std::ptr::null_mut());
+        ptrs.push(0xdead0 as *mut std::ffi::c_void);
+
+        assert_eq!(cimpl_free_many(ptrs.as_ptr(), ptrs.len()), 2);
+        assert_eq!(crate::CimplError::last_code(), 3);
+        assert_eq!(cimpl_free_many(std::ptr::null(), 0), 0);
+        assert_eq!(cimpl_free_many(std::ptr::null(), 1), -1);
+    }
+
+    #[test]
+    fn test_track_many_boxes() {
+        let ptrs: Vec<*mut u32> = (0..50).map(|i| Box::into_raw(Box::new(i))).collect();
+        track_many(&ptrs);
+        assert!(ptrs.iter().all(|&p| validate_pointer(p).is_ok()));
+        let raw: Vec<usize> = ptrs.iter().map(|&p| p as usize).collect();
+        assert!(get_registry().free_many(&raw).is_empty());
+    }
+
+    #[test]
+    fn test_retain_release_shared() {
+        static DROPS: AtomicUsize = AtomicUsize::new(0);
+        struct Context;
+        impl Drop for Context {
+            fn drop(&mut self) {
+                DROPS.fetch_add(1, Ordering::SeqCst);
+            }
+        }
+
+        let ctx = crate::arc_tracked!(Context) as *mut std::ffi::c_void;
+        std::thread::scope(|scope| {
+            for _ in 0..8 {
+                let shared = cimpl_retain(ctx) as usize;
+                scope.spawn(move || {
+                    assert!(validate_pointer(shared as *mut Context).is_ok());
+                    assert_eq!(cimpl_release(shared as *mut _), 0);
+                });
+            }
+        });
+        assert_eq!(DROPS.load(Ordering::SeqCst), 0);
+
+        // cimpl_free() releases one reference too
+        assert_eq!(cimpl_retain(ctx), ctx);
+        assert_eq!(cimpl_free(ctx), 0);
+        assert!(validate_pointer(ctx as *mut Context).is_ok());
+        assert_eq!(cimpl_release(ctx), 0);
+        assert_eq!(DROPS.load(Ordering::SeqCst), 1);
+        assert_eq!(cimpl_release(ctx), -1);
+        assert!(cimpl_retain(ctx).is_null());
+
+        let boxed = crate::box_tracked!(1u8) as *mut std::ffi::c_void;
+        assert!(cimpl_retain(boxed).is_null());
+        assert_eq!(cimpl_release(boxed), 0);
+    }
+
+    #[test]
+    fn test_shared_objects_reject_mutable_borrows() {
+        fn bump(ptr: *mut u32) -> i32 {
+            let value = crate::deref_mut_or_return_neg!(ptr, u32);
+            *value += 1;
+            *value as i32
+        }
+        let shared = crate::arc_tracked!(1u32);
+        assert!(validate_pointer(shared).is_ok());
+        assert!(validate_pointer_mut(shared).is_err());
+        if !cfg!(feature = "unchecked-handles") {
+            assert_eq!(bump(shared), -1);
+        }
+
+        let boxed = crate::box_tracked!(1u32);
+        assert!(validate_pointer_mut(boxed).is_ok());
+        assert_eq!(bump(boxed), 2);
+        assert_eq!(cimpl_free(shared as *mut _), 0);
+        assert_eq!(cimpl_free(boxed as *mut _), 0);
+    }
+
+    #[test]
+    fn test_trusted_deref() {
+        fn get(ptr: *mut u32) -> i32 {
+            *crate::deref_trusted_or_return_neg!(ptr, u32) as i32
+        }
+
+        let ptr = crate::box_tracked!(7u32);
+        assert_eq!(get(ptr), 7);
+        assert_eq!(get(std::ptr::null_mut()), -1);
+        assert_eq!(crate::CimplError::last_code(), 1);
+        // Debug builds keep the full registry check
+        if cfg!(debug_assertions) {
+            assert!(validate_trusted(0xdead0 as *mut u32).is_err());
+            assert!(validate_trusted(ptr as *mut u64).is_err());
+        }
+        assert_eq!(cimpl_free(ptr as *mut _), 0);
+    }
+
+    #[test]
+    fn test_trusted_mut_deref_rejects_shared_in_debug() {
+        fn bump(ptr: *mut u32) -> i32 {
+            let value = crate::deref_trusted_mut_or_return_neg!(ptr, u32);
+            *value += 1;
+            *value as i32
+        }
+
+        let shared = crate::arc_tracked!(1u32);
+        if cfg!(debug_assertions) {
+            assert_eq!(bump(shared), -1);
+            assert!(validate_trusted_mut(shared).is_err());
+        }
+        let boxed = crate::box_tracked!(1u32);
+        assert_eq!(bump(boxed), 2);
+        assert_eq!(cimpl_free(shared as *mut _), 0);
+        assert_eq!(cimpl_free(boxed as *mut _), 0);
+    }
+
+    #[test]
+    fn test_cstr_borrow_does_not_allocate() {
+        use std::borrow::Cow;
+        use std::os::raw::c_char;
+        fn count(input: *const c_char) -> usize {
+            let text = crate::cstr_borrow_or_return!(input, 0);
+            assert!(matches!(text, Cow::Borrowed(_)));
+            text.len()
+        }
+        fn count_len(input: *const c_char, len: usize) -> usize {
+            crate::cstr_borrow_len_or_return!(input, len, usize::MAX).len()
+        }
+
+        // Sized so the bounded scan never reads past the buffer
+        let mut buf = vec![0u8; crate::macros::MAX_CSTRING_LEN];
+        buf[..5].copy_from_slice(b"hello");
+        let ptr = buf.as_ptr() as *const c_char;
+        assert_eq!(count_allocations(|| assert_eq!(count(ptr), 5)), 0);
+        assert_eq!(count_allocations(|| assert_eq!(count_len(ptr, 3), 3)), 0);
+
+        assert_eq!(count(std::ptr::null()), 0);
+        assert_eq!(CimplError::last_code(), 1);
+        assert_eq!(count_len(std::ptr::null(), 3), usize::MAX);
+
+        // Zero length is the empty string, even with a NULL pointer
+        assert_eq!(count_allocations(|| assert_eq!(count_len(ptr, 0), 0)), 0);
+        assert_eq!(count_len(std::ptr::null(), 0), 0);
+    }
+
+    #[test]
+    fn test_infrastructure_errors_do_not_allocate() {
+        fn check(ptr: *mut u32) -> i32 {
+            *crate::deref_or_return_neg!(ptr, u32) as i32
+        }
+        let tracked = crate::box_tracked!(7u32);
+        let bogus = 0x1230usize as *mut u32;
+        assert_eq!(check(tracked), 7); // registry is initialized
+
+        let allocations = count_allocations(|| {
+            assert_eq!(check(std::ptr::null_mut()), -1);
+            #[cfg(not(feature = "unchecked-handles"))]
+            assert_eq!(check(bogus), -1);
+            // unchecked-handles release builds would dereference the pointer
+            #[cfg(feature = "unchecked-handles")]
+            validate_pointer(bogus).unwrap_err().set_last();
+            CimplError::other_static("static message").set_last();
+            CimplError::wrong_handle_type(9).set_last();
+        });
+        assert_eq!(allocations, 0);
+        assert_eq!(CimplError::last_code(), 4);
+        assert_eq!(cimpl_free(tracked as *mut _), 0);
+    }
+
+    #[test]
+    fn test_write_c_string_into() {
+        use std::ffi::CStr;
+        use std::os::raw::c_char;
+        let mut buf = [0x7f as c_char; 8];
+        let mut len = usize::MAX;
+
+        // Size query without a buffer
+        let needed = unsafe { write_c_string_into("héllo", std::ptr::null_mut(), 0, &mut len) };
+        assert_eq!((needed, len), (6, 0));
+
+        let n = unsafe { write_c_string_into("héllo", buf.as_mut_ptr(), 8, &mut len) };
+        assert_eq!((n, len), (6, 6));
+        assert_eq!(
+            unsafe { CStr::from_ptr(buf.as_ptr()) }.to_str(),
+            Ok("héllo")
+        );
+
+        // Truncation keeps whole characters: "h" + 2-byte "é" does not fit in 2
+        let n = unsafe { write_c_string_into("héllo", buf.as_mut_ptr(), 3, &mut len) };
+        assert_eq!((n, len), (6, 1));
+        assert_eq!(unsafe { CStr::from_ptr(buf.as_ptr()) }.to_str(), Ok("h"));
+
+        let n = unsafe { write_c_string_into("a", std::ptr::null_mut(), 4, std::ptr::null_mut()) };
+        assert_eq!(n, -1);
+        assert_eq!(CimplError::last_code(), 1);
+    }
+
     #[test]
     fn test_to_c_string_with_null_byte() {
         // Test that strings with embedded nulls return null
@@ -0,0 +1,131 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Zero-Copy Byte Views
+//!
+//! `to_c_bytes` hands C a fresh copy. A `CimplBytesView` instead points C
+//! at bytes that already live inside a tracked parent object, and holds a
+//! reference on the parent so the bytes stay valid for as long as the view
+//! does, even after C frees the parent.
+//!
+//! The parent must be reference counted (created with `arc_tracked!`), and
+//! the viewed bytes must not be modified while views of them exist.
+//!
+//! # Example (C)
+//! ```c
+//! CimplBytesView* view = message_content_view(msg);
+//! fwrite(view->data, 1, view->len, out);   // no copy
+//! cimpl_free(view);                        // releases msg's reference
+//! ```
+
+use std::{any::TypeId, os::raw::c_uchar};
+
+use crate::{
+    cimpl_error::CimplError,
+    utils::{get_registry, DropFn},
+};
+
+/// Read-only `(data, len)` view of bytes owned by a tracked parent object
+///
+/// Returned to C as a tracked pointer; free it with `cimpl_free()`.
+#[repr(C)]
+pub struct CimplBytesView {
+    /// First byte of the view
+    pub data: *const c_uchar,
+    /// Number of bytes in the view
+    pub len: usize,
+    owner: usize,
+    release: DropFn,
+}
+
+// SAFETY: the view only reads its bytes, and the owner it releases on drop
+// was tracked by `arc_tracked!`, whose contents are shared across threads.
+unsafe impl Send for CimplBytesView {}
+unsafe impl Sync for CimplBytesView {}
+
+impl CimplBytesView {
+    /// The viewed bytes
+    pub fn as_slice(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.data, self.len) }
+    }
+}
+
+impl Drop for CimplBytesView {
+    fn drop(&mut self) {
+        unsafe { (self.release)(self.owner, 0) };
+    }
+}
+
+/// Creates a tracked view of bytes inside an `arc_tracked!` parent
+///
+/// `bytes` selects the bytes to expose; it must return a slice borrowed from
+/// the parent itself. The parent gets one more reference, released when the
+/// view is freed.
+///
+/// Use `bytes_view_or_return!` rather than calling this directly.
+pub fn bytes_view<T: 'static>(
+    parent: *mut T,
+    bytes: impl FnOnce(&T) -> &[u8],
+) -> Result<*mut CimplBytesView, CimplError> {
+    let release = get_registry().retain(parent as usize, TypeId::of::<T>())?;
+
+    // SAFETY: validated above, and the reference we now hold keeps it alive
+    let slice = bytes(unsafe { &*parent });
+    let view = CimplBytesView {
+        data: slice.as_ptr(),
+        len: slice.len(),
+        owner: parent as usize,
+        release,
+    };
+    Ok(crate::alloc_tracked(view))
+}
+
+#[cfg(test)]
+mod tests {
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    use super::*;
+
+    static DROPS: AtomicUsize = AtomicUsize::new(0);
+
+    struct Blob(Vec<u8>);
+
+    impl Drop for Blob {
+        fn drop(&mut self) {
+            DROPS.fetch_add(1, Ordering::SeqCst);
+        }
+    }
+
+    #[test]
+    fn test_view_keeps_parent_alive() {
+        let parent = crate::arc_tracked!(Blob(b"manifest bytes".to_vec()));
+        let view = bytes_view(parent, |blob: &Blob| &blob.0[..8]).unwrap();
+
+        // Freeing the parent only drops C's reference to it
+        assert_eq!(crate::cimpl_free(parent as *mut _), 0);
+        assert_eq!(DROPS.load(Ordering::SeqCst), 0);
+        assert!(crate::validate_pointer(parent).is_err());
+        assert_eq!(unsafe { &*view }.as_slice(), b"manifest");
+
+        assert_eq!(crate::cimpl_free(view as *mut _), 0);
+        assert_eq!(DROPS.load(Ordering::SeqCst), 1);
+    }
+
+    #[test]
+    fn test_view_requires_shared_parent() {
+        let boxed = crate::box_tracked!(vec![1u8, 2, 3]);
+        assert!(bytes_view(boxed, |v: &Vec<u8>| v.as_slice()).is_err());
+        assert!(bytes_view(std::ptr::null_mut::<Vec<u8>>(), |v| v.as_slice()).is_err());
+        assert_eq!(crate::cimpl_free(boxed as *mut _), 0);
+    }
+}
@@ -0,0 +1,250 @@
+// C-side benchmark for CimplStream
+//
+// Measures what a C host actually pays per call into the Rust library:
+// object create/free round trips, small reads and writes through C
+// callbacks (unbuffered and buffered), memory-stream reads, and the error
+// path. Each benchmark runs RUNS times and reports the median, so numbers
+// are stable enough to compare across commits.
+//
+// Usage: make bench   (or ./bench-harness [runs])
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/cimpl_stream.h"
+
+// Provided by the base cimpl library (statically linked into libcimpl_stream)
+extern int32_t cimpl_free(void* ptr);
+extern bool cimpl_last_error_view(const char** msg, size_t* len, int32_t* code);
+
+#define DEFAULT_RUNS 15
+#define MAX_RUNS 101
+#define PAYLOAD (256 * 1024)
+
+// ============================================================================
+// Memory Stream Context
+// ============================================================================
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t capacity;
+    size_t position;
+} MemoryContext;
+
+intptr_t memory_read_callback(CimplStreamContext* ctx, uint8_t* data, size_t len) {
+    MemoryContext* mem = (MemoryContext*)ctx;
+    size_t available = mem->len > mem->position ? mem->len - mem->position : 0;
+    size_t n = len < available ? len : available;
+    memcpy(data, mem->data + mem->position, n);
+    mem->position += n;
+    return (intptr_t)n;
+}
+
+int64_t memory_seek_callback(CimplStreamContext* ctx, int64_t offset, CimplSeekMode mode) {
+    MemoryContext* mem = (MemoryContext*)ctx;
+    int64_t base;
+    switch (mode) {
+        case CIMPL_SEEK_MODE_START:
+            base = 0;
+            break;
+        case CIMPL_SEEK_MODE_CURRENT:
+            base = (int64_t)mem->position;
+            break;
+        case CIMPL_SEEK_MODE_END:
+            base = (int64_t)mem->len;
+            break;
+        default:
+            return -1;
+    }
+    if (base + offset < 0) {
+        return -1;
+    }
+    mem->position = (size_t)(base + offset);
+    return (int64_t)mem->position;
+}
+
+intptr_t memory_write_callback(CimplStreamContext* ctx, const uint8_t* data, size_t len) {
+    MemoryContext* mem = (MemoryContext*)ctx;
+    if (mem->position + len > mem->capacity) {
+        return -1;
+    }
+    memcpy(mem->data + mem->position, data, len);
+    mem->position += len;
+    if (mem->position > mem->len) {
+        mem->len = mem->position;
+    }
+    return (intptr_t)len;
+}
+
+int32_t memory_flush_callback(CimplStreamContext* ctx) {
+    (void)ctx;
+    return 0;
+}
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+typedef void (*BenchFn)(void* arg);
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Runs `fn` (which performs `ops` operations of `bytes` each) `runs` times
+// and prints the median time per operation
+static void run(const char* name, BenchFn fn, void* arg, int runs, long ops, size_t bytes) {
+    double samples[MAX_RUNS];
+    fn(arg); // warm up
+    for (int i = 0; i < runs; i++) {
+        double start = now_ns();
+        fn(arg);
+        samples[i] = (now_ns() - start) / (double)ops;
+    }
+    qsort(samples, runs, sizeof(double), compare_doubles);
+    double median = samples[runs / 2];
+    if (bytes > 0) {
+        double mb_per_s = (double)bytes / median * 1e9 / (1024.0 * 1024.0);
+        printf("%-32s %10.1f ns/op %10.1f MB/s\n", name, median, mb_per_s);
+    } else {
+        printf("%-32s %10.1f ns/op\n", name, median);
+    }
+}
+
+// ============================================================================
+// Benchmarks
+// ============================================================================
+
+#define LIFECYCLE_OPS 100000
+#define CALL_OPS 1000000
+
+typedef struct {
+    CimplStream* stream;
+    uint8_t* chunk;
+    size_t chunk_len;
+} StreamArgs;
+
+static uint8_t source[PAYLOAD];
+
+static void bench_lifecycle(void* arg) {
+    (void)arg;
+    for (long i = 0; i < LIFECYCLE_OPS; i++) {
+        CimplStream* stream = cimpl_stream_from_memory(source, sizeof(source));
+        cimpl_free(stream);
+    }
+}
+
+static void bench_seek(void* arg) {
+    StreamArgs* args = arg;
+    for (long i = 0; i < CALL_OPS; i++) {
+        cimpl_stream_seek(args->stream, 0, CIMPL_SEEK_MODE_START);
+    }
+}
+
+static void bench_write(void* arg) {
+    StreamArgs* args = arg;
+    cimpl_stream_seek(args->stream, 0, CIMPL_SEEK_MODE_START);
+    for (size_t done = 0; done < PAYLOAD; done += args->chunk_len) {
+        if (cimpl_stream_write(args->stream, args->chunk, args->chunk_len) < 0) {
+            abort();
+        }
+    }
+    cimpl_stream_flush(args->stream);
+}
+
+static void bench_read(void* arg) {
+    StreamArgs* args = arg;
+    cimpl_stream_seek(args->stream, 0, CIMPL_SEEK_MODE_START);
+    for (size_t done = 0; done < PAYLOAD;) {
+        intptr_t n = cimpl_stream_read(args->stream, args->chunk, args->chunk_len);
+        if (n <= 0) {
+            abort();
+        }
+        done += (size_t)n;
+    }
+}
+
+static void bench_error(void* arg) {
+    (void)arg;
+    const char* msg;
+    size_t len;
+    int32_t code;
+    for (long i = 0; i < CALL_OPS; i++) {
+        cimpl_stream_seek(NULL, 0, CIMPL_SEEK_MODE_START);
+        cimpl_last_error_view(&msg, &len, &code);
+    }
+}
+
+static CimplStream* open_memory_callbacks(MemoryContext* ctx, size_t capacity) {
+    if (capacity == 0) {
+        return cimpl_stream_new((CimplStreamContext*)ctx, memory_read_callback,
+                                memory_seek_callback, memory_write_callback,
+                                memory_flush_callback);
+    }
+    return cimpl_stream_new_buffered((CimplStreamContext*)ctx, memory_read_callback,
+                                     memory_seek_callback, memory_write_callback,
+                                     memory_flush_callback, capacity);
+}
+
+int main(int argc, char** argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : DEFAULT_RUNS;
+    if (runs < 1 || runs > MAX_RUNS) {
+        fprintf(stderr, "runs must be between 1 and %d\n", MAX_RUNS);
+        return 1;
+    }
+    memset(source, 0x5A, sizeof(source));
+
+    printf("=== CimplStream C benchmark (median of %d runs) ===\n\n", runs);
+    run("from_memory + cimpl_free", bench_lifecycle, NULL, runs, LIFECYCLE_OPS, 0);
+
+    MemoryContext ctx = {malloc(PAYLOAD), 0, PAYLOAD, 0};
+    uint8_t chunk[4096];
+    memset(chunk, 0xA5, sizeof(chunk));
+
+    CimplStream* plain = open_memory_callbacks(&ctx, 0);
+    StreamArgs seek_args = {plain, chunk, 0};
+    run("seek (callback round trip)", bench_seek, &seek_args, runs, CALL_OPS, 0);
+    run("error set + view", bench_error, NULL, runs, CALL_OPS, 0);
+
+    const size_t chunk_lens[] = {64, 4096};
+    const struct {
+        const char* name;
+        size_t capacity;
+    } streams[] = {{"unbuffered", 0}, {"buffered", 64 * 1024}};
+
+    char name[64];
+    for (size_t c = 0; c < 2; c++) {
+        for (size_t s = 0; s < 2; s++) {
+            CimplStream* stream = s == 0 ? plain : open_memory_callbacks(&ctx, streams[s].capacity);
+            StreamArgs args = {stream, chunk, chunk_lens[c]};
+            long ops = PAYLOAD / (long)chunk_lens[c];
+
+            snprintf(name, sizeof(name), "write %s/%zu", streams[s].name, chunk_lens[c]);
+            run(name, bench_write, &args, runs, ops, chunk_lens[c]);
+            snprintf(name, sizeof(name), "read %s/%zu", streams[s].name, chunk_lens[c]);
+            run(name, bench_read, &args, runs, ops, chunk_lens[c]);
+            if (stream != plain) {
+                cimpl_free(stream);
+            }
+        }
+
+        CimplStream* memory = cimpl_stream_from_memory(source, sizeof(source));
+        StreamArgs args = {memory, chunk, chunk_lens[c]};
+        snprintf(name, sizeof(name), "read memory/%zu", chunk_lens[c]);
+        run(name, bench_read, &args, runs, PAYLOAD / (long)chunk_lens[c], chunk_lens[c]);
+        cimpl_free(memory);
+    }
+
+    cimpl_free(plain);
+    free(ctx.data);
+    return 0;
+}
@@ -0,0 +1,212 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Stream I/O benchmark
+//!
+//! Writes and reads a 256KB payload through `cimpl_stream_write` and
+//! `cimpl_stream_read` in chunks of several sizes, with a `MemoryBuffer`
+//! behind the callbacks like the one the unit tests use. Unbuffered and
+//! buffered streams are compared, along with a `cimpl_stream_from_memory`
+//! stream that needs no callbacks.
+//!
+//! ```bash
+//! cargo bench --bench stream_io -- --save-baseline main
+//! ```
+//!
+//! `make bench` measures the same calls made from C.
+
+use std::cell::RefCell;
+use std::ffi::c_void;
+use std::time::Duration;
+
+use cimpl::cimpl_free;
+use cimpl_stream::*;
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+
+/// Bytes moved per benchmark iteration
+const PAYLOAD: usize = 256 * 1024;
+
+/// Growable in-memory stream context
+#[derive(Default)]
+struct MemoryBuffer {
+    data: RefCell<Vec<u8>>,
+    position: RefCell<usize>,
+}
+
+impl MemoryBuffer {
+    unsafe extern "C" fn read_callback(
+        ctx: *mut CimplStreamContext,
+        data: *mut u8,
+        len: usize,
+    ) -> isize {
+        let buf = &*(ctx as *const MemoryBuffer);
+        let mut pos = buf.position.borrow_mut();
+        let buffer = buf.data.borrow();
+        let to_read = buffer.len().saturating_sub(*pos).min(len);
+        std::ptr::copy_nonoverlapping(buffer[*pos..].as_ptr(), data, to_read);
+        *pos += to_read;
+        to_read as isize
+    }
+
+    unsafe extern "C" fn seek_callback(
+        ctx: *mut CimplStreamContext,
+        offset: i64,
+        mode: CimplSeekMode,
+    ) -> i64 {
+        let buf = &*(ctx as *const MemoryBuffer);
+        let mut pos = buf.position.borrow_mut();
+        let base = match mode {
+            CimplSeekMode::Start => 0,
+            CimplSeekMode::Current => *pos as i64,
+            CimplSeekMode::End => buf.data.borrow().len() as i64,
+        };
+        *pos = (base + offset).max(0) as usize;
+        *pos as i64
+    }
+
+    unsafe extern "C" fn write_callback(
+        ctx: *mut CimplStreamContext,
+        data: *const u8,
+        len: usize,
+    ) -> isize {
+        let buf = &*(ctx as *const MemoryBuffer);
+        let mut pos = buf.position.borrow_mut();
+        let mut buffer = buf.data.borrow_mut();
+        if *pos + len > buffer.len() {
+            buffer.resize(*pos + len, 0);
+        }
+        buffer[*pos..*pos + len].copy_from_slice(std::slice::from_raw_parts(data, len));
+        *pos += len;
+        len as isize
+    }
+
+    unsafe extern "C" fn flush_callback(_ctx: *mut CimplStreamContext) -> i32 {
+        0
+    }
+}
+
+/// Creates a callback stream over `buffer`, buffered if `capacity` is not 0
+fn open(buffer: &MemoryBuffer, capacity: usize) -> *mut CimplStream {
+    let ctx = buffer as *const MemoryBuffer as *mut CimplStreamContext;
+    let stream = if capacity == 0 {
+        cimpl_stream_new(
+            ctx,
+            MemoryBuffer::read_callback,
+            MemoryBuffer::seek_callback,
+            MemoryBuffer::write_callback,
+            MemoryBuffer::flush_callback,
+        )
+    } else {
+        cimpl_stream_new_buffered(
+            ctx,
+            MemoryBuffer::read_callback,
+            MemoryBuffer::seek_callback,
+            MemoryBuffer::write_callback,
+            MemoryBuffer::flush_callback,
+            capacity,
+        )
+    };
+    assert!(!stream.is_null());
+    stream
+}
+
+fn write_all(stream: *mut CimplStream, chunk: &[u8]) {
+    for _ in 0..PAYLOAD / chunk.len() {
+        assert_eq!(
+            cimpl_stream_write(stream, chunk.as_ptr(), chunk.len()),
+            chunk.len() as isize
+        );
+    }
+    assert_eq!(cimpl_stream_flush(stream), 0);
+}
+
+fn read_all(stream: *mut CimplStream, chunk: &mut [u8]) {
+    let mut total = 0;
+    while total < PAYLOAD {
+        let n = cimpl_stream_read(stream, chunk.as_mut_ptr(), chunk.len());
+        assert!(n > 0);
+        total += n as usize;
+    }
+    black_box(chunk[0]);
+}
+
+const STREAMS: [(&str, usize); 2] = [("unbuffered", 0), ("buffered", 64 * 1024)];
+
+fn bench_write(c: &mut Criterion) {
+    let mut group = c.benchmark_group("stream_write");
+    group.throughput(Throughput::Bytes(PAYLOAD as u64));
+    for chunk_len in [64usize, 4096] {
+        let chunk = vec![0xA5u8; chunk_len];
+        for (name, capacity) in STREAMS {
+            let buffer = MemoryBuffer::default();
+            let stream = open(&buffer, capacity);
+            group.bench_with_input(BenchmarkId::new(name, chunk_len), &chunk, |b, chunk| {
+                b.iter(|| {
+                    assert_eq!(cimpl_stream_seek(stream, 0, CimplSeekMode::Start), 0);
+                    write_all(stream, chunk);
+                })
+            });
+            cimpl_free(stream as *mut c_void);
+        }
+    }
+    group.finish();
+}
+
+fn bench_read(c: &mut Criterion) {
+    let mut group = c.benchmark_group("stream_read");
+    group.throughput(Throughput::Bytes(PAYLOAD as u64));
+    let payload = vec![0x5Au8; PAYLOAD];
+    for chunk_len in [64usize, 4096] {
+        for (name, capacity) in STREAMS {
+            let buffer = MemoryBuffer {
+                data: RefCell::new(payload.clone()),
+                ..Default::default()
+            };
+            let stream = open(&buffer, capacity);
+            let mut chunk = vec![0u8; chunk_len];
+            group.bench_function(BenchmarkId::new(name, chunk_len), |b| {
+                b.iter(|| {
+                    assert_eq!(cimpl_stream_seek(stream, 0, CimplSeekMode::Start), 0);
+                    read_all(stream, &mut chunk);
+                })
+            });
+            cimpl_free(stream as *mut c_void);
+        }
+
+        let stream = cimpl_stream_from_memory(payload.as_ptr(), payload.len());
+        let mut chunk = vec![0u8; chunk_len];
+        group.bench_function(BenchmarkId::new("memory", chunk_len), |b| {
+            b.iter(|| {
+                assert_eq!(cimpl_stream_seek(stream, 0, CimplSeekMode::Start), 0);
+                read_all(stream, &mut chunk);
+            })
+        });
+        cimpl_free(stream as *mut c_void);
+    }
+    group.finish();
+}
+
+fn config() -> Criterion {
+    Criterion::default()
+        .sample_size(50)
+        .warm_up_time(Duration::from_secs(1))
+        .measurement_time(Duration::from_secs(3))
+        .configure_from_args()
+}
+
+criterion_group!(
+    name = benches;
+    config = config();
+    targets = bench_write, bench_read
+);
+criterion_main!(benches);
@@ -3,13 +3,18 @@ Python bindings for cimpl_stream - Callback-based I/O streams
 
 This module provides Pythonic wrappers around the cimpl_stream C library,
 allowing Python file-like objects to be used as streams in Rust/C code.
+
+Data is never copied on the Python side: callbacks hand Rust's buffer to the
+file object as a memoryview (`readinto` / `write`), and `Stream.readinto` /
+`Stream.write` pass the caller's buffer straight to Rust.
 """
 
 import ctypes
+import io
 import os
 import sys
 from typing import BinaryIO, Optional
-from ctypes import c_void_p, c_int32, c_int64, c_uint8, c_size_t, POINTER, CFUNCTYPE
+from ctypes import c_void_p, c_int32, c_int64, c_size_t, POINTER, CFUNCTYPE
 
 
 # Find the library
@@ -68,10 +73,36 @@ class ErrorCode:
     INVALID_BUFFER = 101        # CIMPL_STREAM_ERROR_INVALID_BUFFER
 
 # Callback type definitions
-ReadCallback = CFUNCTYPE(intptr_t, POINTER(CimplStreamContext), POINTER(c_uint8), c_size_t)
+# Buffers arrive as plain addresses (c_void_p -> int) so callbacks can wrap them
+# in a memoryview without building a ctypes pointer object first
+ReadCallback = CFUNCTYPE(intptr_t, POINTER(CimplStreamContext), c_void_p, c_size_t)
 SeekCallback = CFUNCTYPE(c_int64, POINTER(CimplStreamContext), c_int64, c_int32)
-WriteCallback = CFUNCTYPE(intptr_t, POINTER(CimplStreamContext), POINTER(c_uint8), c_size_t)
+WriteCallback = CFUNCTYPE(intptr_t, POINTER(CimplStreamContext), c_void_p, c_size_t)
 FlushCallback = CFUNCTYPE(c_int32, POINTER(CimplStreamContext))
+TransformCallback = CFUNCTYPE(intptr_t, c_void_p, c_void_p, c_size_t, c_size_t)
+
+
+class CopyOptions(ctypes.Structure):
+    _fields_ = [
+        ('buffers', c_size_t),
+        ('transform', TransformCallback),
+        ('transform_context', c_void_p),
+        ('transform_capacity', c_size_t),
+    ]
+
+
+class CopyStats(ctypes.Structure):
+    """Throughput report from copy(); stage times are in nanoseconds."""
+    _fields_ = [
+        ('bytes_read', ctypes.c_uint64),
+        ('bytes_written', ctypes.c_uint64),
+        ('chunks', ctypes.c_uint64),
+        ('elapsed_ns', ctypes.c_uint64),
+        ('read_ns', ctypes.c_uint64),
+        ('transform_ns', ctypes.c_uint64),
+        ('write_ns', ctypes.c_uint64),
+        ('bytes_per_second', ctypes.c_double),
+    ]
 
 # Function signatures
 _lib.cimpl_stream_new.argtypes = [
@@ -83,10 +114,20 @@ _lib.cimpl_stream_new.argtypes = [
 ]
 _lib.cimpl_stream_new.restype = POINTER(CimplStream)
 
-_lib.cimpl_stream_read.argtypes = [POINTER(CimplStream), POINTER(c_uint8), c_size_t]
+_lib.cimpl_stream_new_buffered.argtypes = [
+    POINTER(CimplStreamContext),
+    ReadCallback,
+    SeekCallback,
+    WriteCallback,
+    FlushCallback,
+    c_size_t
+]
+_lib.cimpl_stream_new_buffered.restype = POINTER(CimplStream)
+
+_lib.cimpl_stream_read.argtypes = [POINTER(CimplStream), c_void_p, c_size_t]
 _lib.cimpl_stream_read.restype = intptr_t
 
-_lib.cimpl_stream_write.argtypes = [POINTER(CimplStream), POINTER(c_uint8), c_size_t]
+_lib.cimpl_stream_write.argtypes = [POINTER(CimplStream), c_void_p, c_size_t]
 _lib.cimpl_stream_write.restype = intptr_t
 
 _lib.cimpl_stream_seek.argtypes = [POINTER(CimplStream), c_int64, c_int32]
@@ -95,6 +136,12 @@ _lib.cimpl_stream_seek.restype = c_int64
 _lib.cimpl_stream_flush.argtypes = [POINTER(CimplStream)]
 _lib.cimpl_stream_flush.restype = c_int32
 
+_lib.cimpl_stream_copy.argtypes = [
+    POINTER(CimplStream), POINTER(CimplStream), c_size_t,
+    POINTER(CopyOptions), POINTER(CopyStats),
+]
+_lib.cimpl_stream_copy.restype = c_int64
+
 _lib.cimpl_stream_last_error.argtypes = []
 _lib.cimpl_stream_last_error.restype = ctypes.c_char_p
 
@@ -108,6 +155,48 @@ _lib.cimpl_free.argtypes = [c_void_p]
 _lib.cimpl_free.restype = c_int32
 
 
+# ============================================================================
+# Zero-copy buffer helpers
+# ============================================================================
+
+_PyBUF_READ = 0x100
+_PyBUF_WRITE = 0x200
+
+try:
+    _memory_view = ctypes.pythonapi.PyMemoryView_FromMemory
+    _memory_view.argtypes = [c_void_p, ctypes.c_ssize_t, ctypes.c_int]
+    _memory_view.restype = ctypes.py_object
+
+    def _view(address: int, length: int, writable: bool) -> memoryview:
+        """Borrow `length` bytes at `address` as a memoryview (no copy)."""
+        return _memory_view(address, length, _PyBUF_WRITE if writable else _PyBUF_READ)
+except AttributeError:  # Not CPython: go through a ctypes array instead
+    def _view(address: int, length: int, writable: bool) -> memoryview:
+        """Borrow `length` bytes at `address` as a memoryview (no copy)."""
+        view = memoryview((ctypes.c_char * length).from_address(address)).cast('B')
+        return view if writable else view.toreadonly()
+
+
+def _address(buffer, writable: bool):
+    """Address and length of a bytes-like object, without copying it.
+
+    Returns (address, length, keepalive); keep `keepalive` referenced until the
+    address is no longer used.
+    """
+    if isinstance(buffer, bytes) and not writable:
+        # ctypes passes a bytes object's own storage for c_void_p arguments
+        return buffer, len(buffer), buffer
+    view = memoryview(buffer).cast('B')
+    if view.readonly:
+        if writable:
+            raise TypeError("readinto() needs a writable buffer")
+        # A read-only view of something other than bytes: one copy is unavoidable
+        data = view.tobytes()
+        return data, len(data), data
+    array = (ctypes.c_char * len(view)).from_buffer(view)
+    return ctypes.addressof(array), len(view), array
+
+
 # Exceptions
 class CimplStreamError(Exception):
     """Base exception for cimpl_stream errors."""
@@ -163,12 +252,16 @@ def _check_error(result, func_name: str):
     return result
 
 
-class Stream:
+class Stream(io.RawIOBase):
     """
     A stream that wraps a Python file-like object for use with cimpl_stream.
     
     This allows Rust/C code to read from and write to Python file objects
-    through a callback-based interface.
+    through a callback-based interface. It is also a raw Python stream itself,
+    so it can be wrapped in `io.BufferedReader` / `io.BufferedWriter`.
+    
+    Use `readinto()` with a reusable `bytearray` or `memoryview` for bulk
+    reads: Rust writes straight into it and nothing is allocated per call.
     
     Example:
         with open('test.txt', 'rb') as f:
@@ -178,20 +271,31 @@ class Stream:
             stream.write(b"Hello!")
     """
     
-    def __init__(self, file_obj: BinaryIO):
+    def __init__(self, file_obj: BinaryIO, buffer_size: int = 0):
         """
         Create a stream from a Python file-like object.
         
         Args:
             file_obj: A file-like object with read, write, seek, and flush methods.
+            buffer_size: If > 0, buffer reads and writes on the Rust side so the
+                Python callbacks run once per buffer_size bytes rather than once
+                per operation. The file object's own position runs ahead of (or
+                behind) the stream's until the stream is flushed or closed.
         """
+        super().__init__()
         self._file = file_obj
         self._handle: Optional[POINTER(CimplStream)] = None
+        file_readinto = getattr(file_obj, 'readinto', None)
         
         # Create callback functions that capture self
         @ReadCallback
         def read_cb(ctx, data, length):
             try:
+                if file_readinto is not None:
+                    # The file fills Rust's buffer directly
+                    with _view(data, length, True) as view:
+                        bytes_read = file_readinto(view)
+                    return bytes_read or 0
                 bytes_data = self._file.read(length)
                 if not bytes_data:
                     return 0
@@ -223,8 +327,10 @@ class Stream:
         @WriteCallback
         def write_cb(ctx, data, length):
             try:
-                bytes_data = ctypes.string_at(data, length)
-                bytes_written = self._file.write(bytes_data)
+                # Released on exit, so a file that keeps the view cannot read
+                # Rust's buffer after the callback returns
+                with _view(data, length, False) as view:
+                    bytes_written = self._file.write(view)
                 return bytes_written if bytes_written is not None else length
             except Exception as e:
                 print(f"Write callback error: {e}", file=sys.stderr)
@@ -244,45 +350,71 @@ class Stream:
         
         # Create the stream (use id(self) as context pointer)
         context = ctypes.cast(id(self), POINTER(CimplStreamContext))
-        self._handle = _lib.cimpl_stream_new(
-            context,
-            read_cb,
-            seek_cb,
-            write_cb,
-            flush_cb
-        )
+        if buffer_size > 0:
+            self._handle = _lib.cimpl_stream_new_buffered(
+                context,
+                read_cb,
+                seek_cb,
+                write_cb,
+                flush_cb,
+                buffer_size
+            )
+        else:
+            self._handle = _lib.cimpl_stream_new(
+                context,
+                read_cb,
+                seek_cb,
+                write_cb,
+                flush_cb
+            )
         
         if not self._handle:
             _check_error(None, "cimpl_stream_new")
     
-    def read(self, size: int = -1) -> bytes:
+    def readinto(self, buffer) -> int:
         """
-        Read data from the stream.
+        Read data from the stream straight into a writable buffer.
         
         Args:
-            size: Number of bytes to read. -1 reads until EOF.
+            buffer: A writable bytes-like object (`bytearray`, `memoryview`,
+                `array.array`, numpy array, ...). Nothing is copied.
             
         Returns:
-            Bytes read from the stream.
+            Number of bytes read (0 at EOF).
         """
         if not self._handle:
             raise CimplStreamError("Stream is closed", 0)
         
-        if size < 0:
-            size = 8192  # Default buffer size
+        address, length, keepalive = _address(buffer, writable=True)
+        bytes_read = _lib.cimpl_stream_read(self._handle, address, length)
+        del keepalive
+        return _check_error(bytes_read, "cimpl_stream_read")
+    
+    def read(self, size: int = -1) -> bytes:
+        """
+        Read data from the stream.
         
-        buffer = (c_uint8 * size)()
-        bytes_read = _lib.cimpl_stream_read(self._handle, buffer, size)
-        _check_error(bytes_read, "cimpl_stream_read")
+        Args:
+            size: Number of bytes to read. -1 (or None) reads to EOF.
+            
+        Returns:
+            Bytes read from the stream.
+        """
+        if size is None or size < 0:
+            return self.readall()
         
-        return bytes(buffer[:bytes_read])
+        buffer = bytearray(size)
+        bytes_read = self.readinto(buffer)
+        del buffer[bytes_read:]
+        return bytes(buffer)
     
-    def write(self, data: bytes) -> int:
+    def write(self, data) -> int:
         """
         Write data to the stream.
         
         Args:
-            data: Bytes to write.
+            data: A bytes-like object to write. `bytes` and writable buffers
+                are passed to Rust without copying.
             
         Returns:
             Number of bytes written.
@@ -290,8 +422,9 @@ class Stream:
         if not self._handle:
             raise CimplStreamError("Stream is closed", 0)
         
-        buffer = (c_uint8 * len(data)).from_buffer_copy(data)
-        bytes_written = _lib.cimpl_stream_write(self._handle, buffer, len(data))
+        address, length, keepalive = _address(data, writable=False)
+        bytes_written = _lib.cimpl_stream_write(self._handle, address, length)
+        del keepalive
         _check_error(bytes_written, "cimpl_stream_write")
         
         return bytes_written
@@ -336,8 +469,21 @@ class Stream:
         """Get the current stream position."""
         return self.seek(0, os.SEEK_CUR)
     
+    def readable(self) -> bool:
+        return True
+    
+    def writable(self) -> bool:
+        return True
+    
+    def seekable(self) -> bool:
+        return True
+    
+    @property
+    def closed(self) -> bool:
+        return self._handle is None
+    
     def close(self) -> None:
-        """Close the stream and free resources."""
+        """Close the stream and free resources (buffered data is flushed)."""
         if self._handle:
             _lib.cimpl_free(self._handle)
             self._handle = None
@@ -357,14 +503,61 @@ class Stream:
 
 
 # Convenience function
-def wrap_file(file_obj: BinaryIO) -> Stream:
+def wrap_file(file_obj: BinaryIO, buffer_size: int = 0) -> Stream:
     """
     Wrap a Python file-like object as a cimpl_stream.
     
     Args:
         file_obj: A file-like object with read, write, seek, and flush methods.
+        buffer_size: Rust-side buffer size in bytes (0 for unbuffered).
         
     Returns:
         A Stream object wrapping the file.
     """
-    return Stream(file_obj)
+    return Stream(file_obj, buffer_size)
+
+
+def copy(src: Stream, dst: Stream, chunk_size: int = 0, buffers: int = 0,
+         transform=None, transform_capacity: int = 0) -> CopyStats:
+    """
+    Copy the rest of `src` into `dst`, reading ahead on a background thread.
+
+    Reads and writes overlap, so a slow source and a slow destination cost
+    roughly the slower of the two rather than their sum. `src` is read from
+    another thread; the GIL is released while the copy runs.
+    
+    Args:
+        src: Stream to read from.
+        dst: Stream to write to (flushed at the end).
+        chunk_size: Bytes per source read (0 for 64 KiB).
+        buffers: Chunks in flight, 2 to 16 (0 for 3).
+        transform: Optional `transform(view, length) -> int`, called on a
+            third thread with each chunk. `view` is the whole writable buffer
+            with the chunk in `view[:length]`; rewrite it in place and return
+            the new length. It is called once more with length 0 at the end.
+        transform_capacity: Buffer size when the transform grows chunks.
+        
+    Returns:
+        CopyStats for the copy.
+    """
+    if not src._handle or not dst._handle:
+        raise CimplStreamError("Stream is closed", 0)
+    options = CopyOptions(buffers=buffers, transform_capacity=transform_capacity)
+    if transform is not None:
+        @TransformCallback
+        def transform_cb(ctx, data, length, capacity):
+            try:
+                with _view(data, capacity, True) as view:
+                    n = transform(view, length)
+                return length if n is None else n
+            except Exception as e:
+                print(f"Transform callback error: {e}", file=sys.stderr)
+                return -1
+        options.transform = transform_cb
+    stats = CopyStats()
+    _check_error(
+        _lib.cimpl_stream_copy(src._handle, dst._handle, chunk_size,
+                               ctypes.byref(options), ctypes.byref(stats)),
+        "cimpl_stream_copy",
+    )
+    return stats
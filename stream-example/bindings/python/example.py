@@ -9,7 +9,7 @@ cimpl_stream library.
 import io
 import os
 import sys
-from cimpl_stream import Stream, CimplStreamError
+from cimpl_stream import Stream, CimplStreamError, copy
 
 
 def example_file_stream():
@@ -115,6 +115,73 @@ def example_memory_stream():
     print("\n=== Memory stream example completed! ===\n")
 
 
+def example_zero_copy():
+    """Example reading into a reusable buffer and layering Python's io classes."""
+    print("=== Zero-Copy Example ===\n")
+    
+    payload = bytes(range(256)) * 4096  # 1 MiB
+    
+    print("1. Reading into a reusable buffer...")
+    stream = Stream(io.BytesIO(payload))
+    chunk = bytearray(64 * 1024)
+    view = memoryview(chunk)
+    total = 0
+    while True:
+        n = stream.readinto(view)
+        if n == 0:
+            break
+        total += n
+    view.release()
+    print(f"   Read {total} bytes with one 64 KiB buffer")
+    
+    print("\n2. Writing a slice of a larger buffer...")
+    target = io.BytesIO()
+    out = Stream(target)
+    written = out.write(memoryview(chunk)[:4096])
+    print(f"   Wrote {written} bytes without slicing a copy")
+    
+    print("\n3. Wrapping the stream in io.BufferedReader...")
+    stream.seek(0)
+    reader = io.BufferedReader(stream, buffer_size=16 * 1024)
+    first = reader.read(10)
+    print(f"   First bytes via BufferedReader: {list(first)}")
+    
+    out.close()
+    stream.close()
+    
+    print("\n=== Zero-copy example completed! ===\n")
+
+
+def example_copy():
+    """Example copying one stream into another with a transform stage."""
+    print("=== Pipelined Copy Example ===\n")
+    
+    payload = b"pipelined copy-through " * 50000
+    
+    print("1. Copying with read-ahead on a background thread...")
+    target = io.BytesIO()
+    with Stream(io.BytesIO(payload)) as src, Stream(target) as dst:
+        stats = copy(src, dst, chunk_size=64 * 1024)
+    assert target.getvalue() == payload
+    print(f"   Copied {stats.bytes_written} bytes in {stats.chunks} chunks "
+          f"({stats.bytes_per_second / 1e6:.1f} MB/s)")
+    
+    print("\n2. Uppercasing each chunk in place on the way through...")
+    def upper(view, length):
+        view[:length] = bytes(view[:length]).upper()
+        return length
+    
+    target = io.BytesIO()
+    with Stream(io.BytesIO(payload)) as src, Stream(target) as dst:
+        stats = copy(src, dst, chunk_size=32 * 1024, buffers=3, transform=upper)
+    assert target.getvalue() == payload.upper()
+    print(f"   Read {stats.read_ns / 1e6:.1f} ms, transform "
+          f"{stats.transform_ns / 1e6:.1f} ms, write {stats.write_ns / 1e6:.1f} ms, "
+          f"total {stats.elapsed_ns / 1e6:.1f} ms")
+    
+    print("\n=== Copy example completed! ===\n")
+
+
 def example_error_handling():
     """Example demonstrating error handling."""
     print("=== Error Handling Example ===\n")
@@ -153,6 +220,8 @@ def main():
     try:
         example_file_stream()
         example_memory_stream()
+        example_zero_copy()
+        example_copy()
         example_error_handling()
         
         print("="*60)
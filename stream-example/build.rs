@@ -21,5 +21,7 @@ fn main() {
         .write_to_file(&output_file);
 
     println!("cargo:rerun-if-changed=src/lib.rs");
+    println!("cargo:rerun-if-changed=src/async_stream.rs");
+    println!("cargo:rerun-if-changed=src/copy.rs");
     println!("cargo:rerun-if-changed=cbindgen.toml");
 }
@@ -0,0 +1,682 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Asynchronous (completion-based) streams
+//!
+//! A `CimplAsyncStream` never blocks a Rust thread on C. Each read, write or
+//! flush is handed to C as a request carrying a `CimplCompletion` token; the
+//! callback returns immediately, and C later reports the outcome from any
+//! thread with `cimpl_stream_complete(token, result)`. The Rust side sees the
+//! stream as `futures_io::AsyncRead` + `AsyncWrite`, so many streams can be
+//! driven by a small executor pool.
+//!
+//! The buffer passed to a read or write callback is owned by the token and
+//! stays valid until C completes it, even if Rust has dropped the stream.
+//!
+//! Only one request is in flight per stream at a time. Writes are
+//! write-behind: `poll_write` copies the bytes into the request and returns
+//! at once, and a write that C fails is reported by the next `poll_write` or
+//! `poll_flush`. Flush (or close) to learn the outcome of the last write.
+//!
+//! Enabled with the `async` cargo feature.
+
+use std::{
+    cell::UnsafeCell,
+    io::Error,
+    pin::Pin,
+    sync::{Arc, Mutex},
+    task::{Context, Poll, Waker},
+};
+
+use cimpl::{box_tracked, deref_or_return_neg, ptr_or_return_null, CimplError};
+use futures_io::{AsyncRead, AsyncWrite};
+
+use crate::{CimplStreamContext, CimplStreamError};
+
+/// Largest buffer handed to C in one async read or write
+pub const CIMPL_ASYNC_MAX_REQUEST: usize = 64 * 1024;
+
+/// Token for one outstanding async request.
+///
+/// Passed to an async callback and redeemed exactly once with
+/// `cimpl_stream_complete()`. Do not free it; completing it releases it.
+pub struct CimplCompletion {
+    /// Request buffer: C fills it for reads and reads from it for writes.
+    /// Rust only touches it before issuing the request and after `state`
+    /// records the result.
+    buffer: UnsafeCell<Box<[u8]>>,
+    len: usize,
+    state: Mutex<CompletionState>,
+}
+
+// SAFETY: access to `buffer` is ordered by the `state` lock, see above
+unsafe impl Send for CimplCompletion {}
+unsafe impl Sync for CimplCompletion {}
+
+#[derive(Default)]
+struct CompletionState {
+    result: Option<i64>,
+    waker: Option<Waker>,
+}
+
+impl CimplCompletion {
+    fn new(buffer: Box<[u8]>) -> Arc<Self> {
+        Arc::new(Self {
+            len: buffer.len(),
+            buffer: UnsafeCell::new(buffer),
+            state: Mutex::new(CompletionState::default()),
+        })
+    }
+
+    /// Hands C a tracked reference to this completion
+    fn token(self: &Arc<Self>) -> *mut CimplCompletion {
+        let token = Arc::into_raw(self.clone()) as *mut CimplCompletion;
+        cimpl::track_arc(token);
+        token
+    }
+
+    /// The request bytes; only valid while C is not using them
+    fn data(&self) -> &[u8] {
+        unsafe { &*self.buffer.get() }
+    }
+
+    /// The result if C has completed the request, without waiting for it
+    fn result(&self) -> Option<i64> {
+        self.state.lock().unwrap().result
+    }
+
+    fn complete(&self, result: i64) {
+        let waker = {
+            let mut state = self.state.lock().unwrap();
+            state.result = Some(result);
+            state.waker.take()
+        };
+        if let Some(waker) = waker {
+            waker.wake();
+        }
+    }
+
+    /// The result, or registers the task to be woken when it arrives
+    fn poll_result(&self, cx: &mut Context<'_>) -> Poll<i64> {
+        let mut state = self.state.lock().unwrap();
+        match state.result {
+            Some(result) => Poll::Ready(result),
+            None => {
+                state.waker = Some(cx.waker().clone());
+                Poll::Pending
+            }
+        }
+    }
+}
+
+/// Async read callback: start reading up to `len` bytes into `data`.
+///
+/// # Returns
+/// - 0 if the request was accepted; complete it with the number of bytes
+///   read (0 at end of stream) or -1
+/// - -1 if the request could not be started (the token must not be completed)
+pub type CimplAsyncReadCallback = unsafe extern "C" fn(
+    context: *mut CimplStreamContext,
+    data: *mut u8,
+    len: usize,
+    token: *mut CimplCompletion,
+) -> i32;
+
+/// Async write callback: start writing `len` bytes from `data`.
+///
+/// # Returns
+/// - 0 if the request was accepted; complete it with the number of bytes
+///   written or -1
+/// - -1 if the request could not be started (the token must not be completed)
+pub type CimplAsyncWriteCallback = unsafe extern "C" fn(
+    context: *mut CimplStreamContext,
+    data: *const u8,
+    len: usize,
+    token: *mut CimplCompletion,
+) -> i32;
+
+/// Async flush callback: start flushing; complete with 0 or -1.
+pub type CimplAsyncFlushCallback =
+    unsafe extern "C" fn(context: *mut CimplStreamContext, token: *mut CimplCompletion) -> i32;
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+enum Op {
+    Read,
+    Write,
+    Flush,
+}
+
+/// Non-blocking stream whose operations C completes asynchronously.
+///
+/// Implements `futures_io::AsyncRead` and `AsyncWrite`.
+pub struct CimplAsyncStream {
+    context: *mut CimplStreamContext,
+    reader: CimplAsyncReadCallback,
+    writer: CimplAsyncWriteCallback,
+    flusher: CimplAsyncFlushCallback,
+    pending: Option<(Op, Arc<CimplCompletion>)>,
+    /// Bytes C returned beyond what the last `poll_read` could take
+    leftover: Vec<u8>,
+    /// Failure of an accepted write, for the next `poll_write`/`poll_flush`
+    write_error: Option<Error>,
+}
+
+// SAFETY: the C caller promises that its callbacks may be called from any
+// thread, which is the point of an async stream
+unsafe impl Send for CimplAsyncStream {}
+
+impl CimplAsyncStream {
+    /// Issues `op` unless it is already in flight; errors if a different op is
+    ///
+    /// A pending request of the same `op` is resumed. Otherwise the caller
+    /// gave up on it, so it is settled if C has completed it, and its outcome
+    /// is dropped. Writes never reach here pending; `poll_write_behind()`
+    /// finishes them first.
+    fn begin(
+        &mut self,
+        op: Op,
+        buffer: impl FnOnce() -> Box<[u8]>,
+    ) -> std::io::Result<Arc<CimplCompletion>> {
+        if let Some((pending, completion)) = &self.pending {
+            if *pending == op {
+                return Ok(completion.clone());
+            }
+            if !self.settle() {
+                return Err(Error::other("Another stream operation is still in flight"));
+            }
+        }
+        let completion = CimplCompletion::new(buffer());
+        self.issue(&completion, op)?;
+        self.pending = Some((op, completion.clone()));
+        Ok(completion)
+    }
+
+    /// Clears an abandoned request if C has completed it
+    ///
+    /// Bytes an abandoned read returned are kept for the next `poll_read`,
+    /// since C has already consumed them from its source.
+    fn settle(&mut self) -> bool {
+        let Some((op, completion)) = &self.pending else {
+            return true;
+        };
+        let Some(result) = completion.result() else {
+            return false;
+        };
+        if *op == Op::Read && result > 0 {
+            let data = completion.data();
+            let n = (result as usize).min(data.len());
+            self.leftover.extend_from_slice(&data[..n]);
+        }
+        self.pending = None;
+        true
+    }
+
+    /// Waits for an accepted write to finish, reissuing what C left unwritten
+    ///
+    /// A failure is kept in `write_error` rather than returned, since the
+    /// bytes were already reported as written.
+    fn poll_write_behind(&mut self, cx: &mut Context<'_>) -> Poll<()> {
+        while let Some((Op::Write, completion)) = &self.pending {
+            let completion = completion.clone();
+            let result = std::task::ready!(completion.poll_result(cx));
+            self.pending = None;
+            let written = match usize::try_from(result) {
+                Ok(0) => Err(Error::from(std::io::ErrorKind::WriteZero)),
+                Ok(written) => Ok(written),
+                Err(_) => Err(Error::other("Async write completed with error")),
+            };
+            let rest = match written {
+                Ok(written) if written < completion.len => &completion.data()[written..],
+                Ok(_) => break,
+                Err(e) => {
+                    self.write_error = Some(e);
+                    break;
+                }
+            };
+            let next = CimplCompletion::new(rest.into());
+            match self.issue(&next, Op::Write) {
+                Ok(()) => self.pending = Some((Op::Write, next)),
+                Err(e) => self.write_error = Some(e),
+            }
+        }
+        Poll::Ready(())
+    }
+
+    /// Waits for the pending `op` and clears it once its result is in
+    fn poll_pending(
+        &mut self,
+        completion: &CimplCompletion,
+        cx: &mut Context<'_>,
+    ) -> Poll<std::io::Result<usize>> {
+        let result = std::task::ready!(completion.poll_result(cx));
+        self.pending = None;
+        if result < 0 {
+            return Poll::Ready(Err(Error::other("Async operation completed with error")));
+        }
+        Poll::Ready(Ok(result as usize))
+    }
+
+    /// Sends C a request, handing it a token it redeems exactly once
+    fn issue(&self, completion: &Arc<CimplCompletion>, op: Op) -> std::io::Result<()> {
+        let data = unsafe { (*completion.buffer.get()).as_mut_ptr() };
+        let len = completion.len;
+        let token = completion.token();
+        let rc = unsafe {
+            match op {
+                Op::Read => (self.reader)(self.context, data, len, token),
+                Op::Write => (self.writer)(self.context, data, len, token),
+                Op::Flush => (self.flusher)(self.context, token),
+            }
+        };
+        if rc != 0 {
+            // C did not accept the token, so release its reference here
+            cimpl::cimpl_free(token as *mut std::ffi::c_void);
+            return Err(Error::other("Async callback returned error"));
+        }
+        Ok(())
+    }
+}
+
+impl AsyncRead for CimplAsyncStream {
+    fn poll_read(
+        self: Pin<&mut Self>,
+        cx: &mut Context<'_>,
+        buf: &mut [u8],
+    ) -> Poll<std::io::Result<usize>> {
+        let this = self.get_mut();
+        // Reads see what earlier writes put in place
+        std::task::ready!(this.poll_write_behind(cx));
+        if !this.leftover.is_empty() {
+            let n = buf.len().min(this.leftover.len());
+            buf[..n].copy_from_slice(&this.leftover[..n]);
+            this.leftover.drain(..n);
+            return Poll::Ready(Ok(n));
+        }
+        if buf.is_empty() {
+            return Poll::Ready(Ok(0));
+        }
+
+        let len = buf.len().min(CIMPL_ASYNC_MAX_REQUEST);
+        let completion = match this.begin(Op::Read, || vec![0; len].into_boxed_slice()) {
+            Ok(completion) => completion,
+            Err(e) => return Poll::Ready(Err(e)),
+        };
+        let n = std::task::ready!(this.poll_pending(&completion, cx))?;
+
+        let data = completion.data();
+        let n = n.min(data.len());
+        let copied = n.min(buf.len());
+        buf[..copied].copy_from_slice(&data[..copied]);
+        this.leftover.extend_from_slice(&data[copied..n]);
+        Poll::Ready(Ok(copied))
+    }
+}
+
+impl AsyncWrite for CimplAsyncStream {
+    fn poll_write(
+        self: Pin<&mut Self>,
+        cx: &mut Context<'_>,
+        buf: &[u8],
+    ) -> Poll<std::io::Result<usize>> {
+        let this = self.get_mut();
+        // Pending means nothing was taken: wait for the previous write first
+        std::task::ready!(this.poll_write_behind(cx));
+        if let Some(e) = this.write_error.take() {
+            return Poll::Ready(Err(e));
+        }
+        if buf.is_empty() {
+            return Poll::Ready(Ok(0));
+        }
+
+        // The request owns a copy, so the bytes are accepted once it is issued
+        let len = buf.len().min(CIMPL_ASYNC_MAX_REQUEST);
+        match this.begin(Op::Write, || buf[..len].into()) {
+            Ok(_) => Poll::Ready(Ok(len)),
+            Err(e) => Poll::Ready(Err(e)),
+        }
+    }
+
+    fn poll_flush(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<std::io::Result<()>> {
+        let this = self.get_mut();
+        std::task::ready!(this.poll_write_behind(cx));
+        if let Some(e) = this.write_error.take() {
+            return Poll::Ready(Err(e));
+        }
+        let completion = match this.begin(Op::Flush, Box::default) {
+            Ok(completion) => completion,
+            Err(e) => return Poll::Ready(Err(e)),
+        };
+        this.poll_pending(&completion, cx).map_ok(|_| ())
+    }
+
+    fn poll_close(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<std::io::Result<()>> {
+        self.poll_flush(cx)
+    }
+}
+
+/// Creates an async stream from C completion-based callbacks.
+///
+/// # Parameters
+/// - `context`: Opaque pointer passed to every callback
+/// - `reader`, `writer`, `flusher`: Callbacks that start a request and return
+///   at once; C finishes each with `cimpl_stream_complete()`
+///
+/// # Returns
+/// - Pointer to the new stream on success
+/// - NULL if `context` is NULL
+///
+/// # Safety
+/// The callbacks may be called from any thread, and the context must stay
+/// valid until the stream is freed and every issued token is completed.
+///
+/// # Example
+/// ```c
+/// int32_t my_read(CimplStreamContext* ctx, uint8_t* data, size_t len,
+///                 CimplCompletion* token) {
+///     start_network_read(ctx, data, len, token);  // calls complete later
+///     return 0;
+/// }
+/// CimplAsyncStream* stream = cimpl_async_stream_new(ctx, my_read, my_write, my_flush);
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_async_stream_new(
+    context: *mut CimplStreamContext,
+    reader: CimplAsyncReadCallback,
+    writer: CimplAsyncWriteCallback,
+    flusher: CimplAsyncFlushCallback,
+) -> *mut CimplAsyncStream {
+    ptr_or_return_null!(context);
+
+    box_tracked!(CimplAsyncStream {
+        context,
+        reader,
+        writer,
+        flusher,
+        pending: None,
+        leftover: Vec::new(),
+        write_error: None,
+    })
+}
+
+/// Completes an async request, waking the Rust task waiting on it.
+///
+/// May be called from any thread, including from inside the callback that
+/// received the token. Each token must be completed exactly once.
+///
+/// # Parameters
+/// - `token`: The token passed to the callback
+/// - `result`: Bytes transferred for reads and writes, 0 for flush, or -1 on error
+///
+/// # Returns
+/// - 0 on success
+/// - -1 if the token is invalid or was already completed
+#[no_mangle]
+pub extern "C" fn cimpl_stream_complete(token: *mut CimplCompletion, result: i64) -> i32 {
+    let completion = deref_or_return_neg!(token, CimplCompletion);
+    if result > completion.len as i64 {
+        CimplError::new(
+            CimplStreamError::InvalidBuffer as i32,
+            "Completion result is larger than the request",
+        )
+        .set_last();
+        return -1;
+    }
+
+    completion.complete(result);
+    // Releases C's reference; the stream holds its own while it waits
+    cimpl::cimpl_free(token as *mut std::ffi::c_void)
+}
+
+#[cfg(test)]
+mod tests {
+    use std::collections::VecDeque;
+
+    use futures::{executor::block_on, AsyncReadExt, AsyncWriteExt};
+
+    use super::*;
+
+    /// Fake C host: queues requests so the test decides when they complete
+    #[derive(Default)]
+    struct Host {
+        data: Mutex<Vec<u8>>,
+        requests: Mutex<VecDeque<(Op, usize, usize, usize)>>,
+    }
+
+    impl Host {
+        unsafe extern "C" fn read(
+            ctx: *mut CimplStreamContext,
+            data: *mut u8,
+            len: usize,
+            token: *mut CimplCompletion,
+        ) -> i32 {
+            let host = &*(ctx as *const Host);
+            let request = (Op::Read, data as usize, len, token as usize);
+            host.requests.lock().unwrap().push_back(request);
+            0
+        }
+
+        unsafe extern "C" fn write(
+            ctx: *mut CimplStreamContext,
+            data: *const u8,
+            len: usize,
+            token: *mut CimplCompletion,
+        ) -> i32 {
+            let host = &*(ctx as *const Host);
+            let request = (Op::Write, data as usize, len, token as usize);
+            host.requests.lock().unwrap().push_back(request);
+            0
+        }
+
+        unsafe extern "C" fn flush(
+            ctx: *mut CimplStreamContext,
+            token: *mut CimplCompletion,
+        ) -> i32 {
+            // Completing from inside the callback is allowed
+            let _ = ctx;
+            assert_eq!(cimpl_stream_complete(token, 0), 0);
+            0
+        }
+
+        /// Completes the oldest request, as the C side would
+        fn complete_next(&self) -> bool {
+            let Some((op, data, len, token)) = self.requests.lock().unwrap().pop_front() else {
+                return false;
+            };
+            let mut stored = self.data.lock().unwrap();
+            let n = match op {
+                Op::Read => {
+                    let n = len.min(stored.len());
+                    let bytes: Vec<u8> = stored.drain(..n).collect();
+                    unsafe { std::ptr::copy_nonoverlapping(bytes.as_ptr(), data as *mut u8, n) };
+                    n
+                }
+                Op::Write => {
+                    let bytes = unsafe { std::slice::from_raw_parts(data as *const u8, len) };
+                    stored.extend_from_slice(bytes);
+                    len
+                }
+                Op::Flush => 0,
+            };
+            assert_eq!(
+                cimpl_stream_complete(token as *mut CimplCompletion, n as i64),
+                0
+            );
+            true
+        }
+    }
+
+    fn new_stream(host: &Host) -> *mut CimplAsyncStream {
+        let stream = cimpl_async_stream_new(
+            host as *const Host as *mut CimplStreamContext,
+            Host::read,
+            Host::write,
+            Host::flush,
+        );
+        assert!(!stream.is_null());
+        stream
+    }
+
+    #[test]
+    fn test_async_read_completes_from_another_thread() {
+        let host = Arc::new(Host::default());
+        host.data
+            .lock()
+            .unwrap()
+            .extend_from_slice(b"streamed bytes");
+        let stream = new_stream(&host);
+
+        let completer = {
+            let host = host.clone();
+            std::thread::spawn(move || {
+                let mut done = 0;
+                while done < 2 {
+                    if host.complete_next() {
+                        done += 1;
+                    }
+                    std::thread::yield_now();
+                }
+            })
+        };
+        let s = unsafe { &mut *stream };
+        let mut head = [0u8; 8];
+        block_on(s.read_exact(&mut head)).unwrap();
+        let mut tail = [0u8; 6];
+        block_on(s.read_exact(&mut tail)).unwrap();
+        completer.join().unwrap();
+
+        assert_eq!(&head, b"streamed");
+        assert_eq!(&tail, b" bytes");
+        cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+    }
+
+    #[test]
+    fn test_async_write_and_flush() {
+        let host = Host::default();
+        let stream = new_stream(&host);
+        let s = unsafe { &mut *stream };
+
+        // Poll by hand: a write is accepted at once, and the next one and
+        // flush wait until the host completes it
+        let waker = futures::task::noop_waker();
+        let mut cx = Context::from_waker(&waker);
+        let mut pinned = Pin::new(&mut *s);
+        assert!(matches!(
+            pinned.as_mut().poll_write(&mut cx, b"payload"),
+            Poll::Ready(Ok(7))
+        ));
+        assert!(pinned.as_mut().poll_write(&mut cx, b" more").is_pending());
+        assert!(pinned.as_mut().poll_flush(&mut cx).is_pending());
+        assert!(host.complete_next());
+        assert!(matches!(
+            pinned.as_mut().poll_write(&mut cx, b" more"),
+            Poll::Ready(Ok(5))
+        ));
+        assert!(host.complete_next());
+
+        block_on(s.flush()).unwrap();
+        assert_eq!(host.data.lock().unwrap().as_slice(), b"payload more");
+        cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+    }
+
+    #[test]
+    fn test_abandoned_requests_do_not_block_the_stream() {
+        let host = Host::default();
+        host.data.lock().unwrap().extend_from_slice(b"abc");
+        let stream = new_stream(&host);
+        let s = unsafe { &mut *stream };
+
+        let waker = futures::task::noop_waker();
+        let mut cx = Context::from_waker(&waker);
+        let mut pinned = Pin::new(&mut *s);
+        let mut buf = [0u8; 3];
+
+        // A read the caller stops polling keeps its bytes once C completes it
+        assert!(pinned.as_mut().poll_read(&mut cx, &mut buf).is_pending());
+        assert!(host.complete_next());
+        assert!(matches!(
+            pinned.as_mut().poll_write(&mut cx, b"one"),
+            Poll::Ready(Ok(3))
+        ));
+
+        // Pending takes nothing: "two" is only written once it is accepted
+        assert!(pinned.as_mut().poll_write(&mut cx, b"two").is_pending());
+        assert!(host.complete_next());
+        assert!(matches!(
+            pinned.as_mut().poll_write(&mut cx, b"six"),
+            Poll::Ready(Ok(3))
+        ));
+        assert!(host.complete_next());
+
+        assert_eq!(block_on(s.read(&mut buf)).unwrap(), 3);
+        assert_eq!(&buf, b"abc");
+        assert_eq!(host.data.lock().unwrap().as_slice(), b"onesix");
+        cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+    }
+
+    #[test]
+    fn test_write_behind_reports_failures_later() {
+        let host = Host::default();
+        let stream = new_stream(&host);
+        let s = unsafe { &mut *stream };
+
+        let waker = futures::task::noop_waker();
+        let mut cx = Context::from_waker(&waker);
+        let mut pinned = Pin::new(&mut *s);
+        let token = |host: &Host| {
+            let (_, _, _, token) = host.requests.lock().unwrap().pop_front().unwrap();
+            token as *mut CimplCompletion
+        };
+
+        // A short completion is reissued for the rest of the bytes
+        assert!(matches!(
+            pinned.as_mut().poll_write(&mut cx, b"abc"),
+            Poll::Ready(Ok(3))
+        ));
+        assert_eq!(cimpl_stream_complete(token(&host), 1), 0);
+        assert!(pinned.as_mut().poll_flush(&mut cx).is_pending());
+        let (_, _, len, _) = *host.requests.lock().unwrap().front().unwrap();
+        assert_eq!(len, 2);
+
+        // A failed write is reported once, by the next flush
+        assert_eq!(cimpl_stream_complete(token(&host), -1), 0);
+        assert!(matches!(
+            pinned.as_mut().poll_flush(&mut cx),
+            Poll::Ready(Err(_))
+        ));
+        assert!(matches!(
+            pinned.as_mut().poll_flush(&mut cx),
+            Poll::Ready(Ok(()))
+        ));
+        cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+    }
+
+    #[test]
+    fn test_complete_rejects_reused_token() {
+        let host = Host::default();
+        let stream = new_stream(&host);
+        let s = unsafe { &mut *stream };
+
+        let waker = futures::task::noop_waker();
+        let mut cx = Context::from_waker(&waker);
+        let mut buf = [0u8; 4];
+        assert!(Pin::new(&mut *s).poll_read(&mut cx, &mut buf).is_pending());
+        let (_, _, _, token) = *host.requests.lock().unwrap().front().unwrap();
+        let token = token as *mut CimplCompletion;
+
+        assert_eq!(cimpl_stream_complete(token, 5), -1); // more than requested
+        assert_eq!(cimpl_stream_complete(token, 0), 0);
+        assert_eq!(cimpl_stream_complete(token, 0), -1);
+        assert_eq!(block_on(s.read(&mut buf)).unwrap(), 0);
+        cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+    }
+}
@@ -0,0 +1,671 @@
+// Copyright 2024 Adobe. All rights reserved.
+// This file is licensed to you under the Apache License,
+// Version 2.0 (http://www.apache.org/licenses/LICENSE-2.0)
+// or the MIT license (http://opensource.org/licenses/MIT),
+// at your option.
+
+// Unless required by applicable law or agreed to in writing,
+// this software is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR REPRESENTATIONS OF ANY KIND, either express or
+// implied. See the LICENSE-MIT and LICENSE-APACHE files for the
+// specific language governing permissions and limitations under
+// each license.
+
+//! Pipelined copy between two streams.
+//!
+//! `cimpl_stream_copy()` reads the source on a background thread while the
+//! calling thread writes the previous chunk to the destination, so a slow
+//! source and a slow destination wait on each other only when the pipeline
+//! is full. An optional transform runs on a third thread in between.
+//!
+//! Chunks move through a fixed pool of buffers: the reader fills a free
+//! buffer, the transform (if any) rewrites it in place, and the writer hands
+//! it back to the pool once written. Nothing is copied between stages.
+
+use std::{
+    io::{ErrorKind, Read, Write},
+    os::raw::c_void,
+    sync::mpsc::{sync_channel, Receiver, SyncSender},
+    thread,
+    time::Instant,
+};
+
+use cimpl::{deref_mut_or_return_neg, ok_or_return, CimplError};
+
+use crate::{CimplStream, CimplStreamError, DEFAULT_STREAM_BUFFER};
+
+/// Largest number of buffers `cimpl_stream_copy()` keeps in flight
+pub const CIMPL_STREAM_COPY_MAX_BUFFERS: usize = 16;
+
+/// Buffers used when `CimplStreamCopyOptions::buffers` is 0
+const DEFAULT_COPY_BUFFERS: usize = 3;
+
+/// Transform callback: rewrites one chunk in place.
+///
+/// # Parameters
+/// - `context`: `CimplStreamCopyOptions::transform_context`
+/// - `data`: The chunk; the result is written back into the same buffer
+/// - `len`: Number of bytes read from the source (0 once, after the last chunk)
+/// - `capacity`: Size of `data`; the result may be up to this long
+///
+/// # Returns
+/// - Length of the transformed chunk (0 to `capacity`) on success
+/// - -1 on error, which stops the copy
+pub type CimplTransformCallback =
+    unsafe extern "C" fn(context: *mut c_void, data: *mut u8, len: usize, capacity: usize) -> isize;
+
+/// Options for `cimpl_stream_copy()`. Zeroed options select the defaults.
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct CimplStreamCopyOptions {
+    /// Buffers in flight: 2 (double) to `CIMPL_STREAM_COPY_MAX_BUFFERS`,
+    /// or 0 for 3 (triple buffering)
+    pub buffers: usize,
+    /// Optional transform applied to each chunk between read and write
+    pub transform: Option<CimplTransformCallback>,
+    /// Passed to every `transform` call
+    pub transform_context: *mut c_void,
+    /// Size of each buffer when a transform can grow a chunk; 0, or anything
+    /// smaller than `chunk_size`, means `chunk_size`
+    pub transform_capacity: usize,
+}
+
+impl Default for CimplStreamCopyOptions {
+    fn default() -> Self {
+        Self {
+            buffers: 0,
+            transform: None,
+            transform_context: std::ptr::null_mut(),
+            transform_capacity: 0,
+        }
+    }
+}
+
+/// Throughput report from `cimpl_stream_copy()`.
+///
+/// Stage times are the time spent inside the source reads, the transform and
+/// the destination writes. With a full pipeline, `elapsed_ns` approaches the
+/// slowest stage rather than their sum.
+#[repr(C)]
+#[derive(Debug, Default, Copy, Clone, PartialEq)]
+pub struct CimplStreamCopyStats {
+    /// Bytes read from the source
+    pub bytes_read: u64,
+    /// Bytes written to the destination
+    pub bytes_written: u64,
+    /// Number of chunks read from the source
+    pub chunks: u64,
+    /// Wall-clock time of the whole copy, including the final flush
+    pub elapsed_ns: u64,
+    /// Time spent in source reads
+    pub read_ns: u64,
+    /// Time spent in the transform callback
+    pub transform_ns: u64,
+    /// Time spent in destination writes and the final flush
+    pub write_ns: u64,
+    /// `bytes_written` per second of `elapsed_ns`
+    pub bytes_per_second: f64,
+}
+
+/// Copies everything left in `src` to `dst`, overlapping reads and writes.
+///
+/// The source is read on a background thread in chunks of `chunk_size`
+/// bytes while the calling thread writes earlier chunks to the destination.
+/// With a transform, each chunk is also passed to the transform on a third
+/// thread before it is written. `dst` is flushed at the end.
+///
+/// The source's callbacks and the transform must be safe to call from
+/// another thread; the destination's callbacks are only called from the
+/// calling thread. Neither stream may be used elsewhere until this returns.
+///
+/// # Parameters
+/// - `src`: The stream to read from
+/// - `dst`: The stream to write to (must not be `src`)
+/// - `chunk_size`: Bytes read per source call (0 selects a 64KB default)
+/// - `options`: Buffer count and transform, or NULL for the defaults
+/// - `stats`: Receives throughput statistics (may be NULL); filled in on
+///   failure too, with the progress made before the error
+///
+/// # Returns
+/// - Number of bytes written to `dst` on success
+/// - -1 on error (check `cimpl_stream_last_error()` for details)
+///
+/// # Example
+/// ```c
+/// CimplStreamCopyOptions options = { .buffers = 3, .transform = my_transform,
+///                                    .transform_context = my_state };
+/// CimplStreamCopyStats stats;
+/// if (cimpl_stream_copy(src, dst, 256 * 1024, &options, &stats) < 0) {
+///     fprintf(stderr, "Copy failed\n");
+/// }
+/// printf("%.1f MB/s\n", stats.bytes_per_second / 1e6);
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_stream_copy(
+    src: *mut CimplStream,
+    dst: *mut CimplStream,
+    chunk_size: usize,
+    options: *const CimplStreamCopyOptions,
+    stats: *mut CimplStreamCopyStats,
+) -> i64 {
+    if !src.is_null() && src == dst {
+        CimplError::new(
+            CimplStreamError::Other as i32,
+            "Source and destination are the same stream",
+        )
+        .set_last();
+        return -1;
+    }
+    let src = deref_mut_or_return_neg!(src, CimplStream);
+    let dst = deref_mut_or_return_neg!(dst, CimplStream);
+
+    let options = if options.is_null() {
+        CimplStreamCopyOptions::default()
+    } else {
+        unsafe { *options }
+    };
+    let buffers = match options.buffers {
+        0 => DEFAULT_COPY_BUFFERS,
+        n @ 2..=CIMPL_STREAM_COPY_MAX_BUFFERS => n,
+        n => {
+            CimplError::new(
+                CimplStreamError::InvalidBuffer as i32,
+                format!("Buffer count must be 2 to {CIMPL_STREAM_COPY_MAX_BUFFERS}, got {n}"),
+            )
+            .set_last();
+            return -1;
+        }
+    };
+    let chunk_size = if chunk_size == 0 {
+        DEFAULT_STREAM_BUFFER
+    } else {
+        chunk_size
+    };
+    let transform = options.transform.map(|callback| Transform {
+        callback,
+        context: options.transform_context,
+    });
+
+    let mut copy = Pipeline {
+        chunk_size,
+        capacity: match transform {
+            Some(_) => options.transform_capacity.max(chunk_size),
+            None => chunk_size,
+        },
+        buffers,
+        stats: CimplStreamCopyStats::default(),
+    };
+    let result = copy.run(src, dst, transform);
+
+    if !stats.is_null() {
+        unsafe { *stats = copy.stats };
+    }
+    ok_or_return!(result, |written| written as i64, -1)
+}
+
+/// One buffer of the pool; `data[..len]` is the chunk it currently holds
+struct Chunk {
+    data: Box<[u8]>,
+    len: usize,
+}
+
+/// Passed between stages: a chunk, or None after the last one. A stage that
+/// fails drops its sender without sending None, which stops the stages after it.
+type Message = Option<Chunk>;
+
+#[derive(Clone, Copy)]
+struct Transform {
+    callback: CimplTransformCallback,
+    context: *mut c_void,
+}
+
+/// Moves a value onto a pipeline thread.
+struct AssertSend<T>(T);
+
+// SAFETY: cimpl_stream_copy() documents that the source callbacks and the
+// transform may be called from another thread, and the calling thread does
+// not touch the source while the pipeline runs
+unsafe impl<T> Send for AssertSend<T> {}
+
+struct Pipeline {
+    chunk_size: usize,
+    capacity: usize,
+    buffers: usize,
+    stats: CimplStreamCopyStats,
+}
+
+impl Pipeline {
+    fn run(
+        &mut self,
+        src: &mut CimplStream,
+        dst: &mut CimplStream,
+        transform: Option<Transform>,
+    ) -> Result<u64, CimplError> {
+        let start = Instant::now();
+        let (free_tx, free_rx) = sync_channel::<Chunk>(self.buffers);
+        for _ in 0..self.buffers {
+            let data = vec![0u8; self.capacity].into_boxed_slice();
+            // Cannot fail: the channel holds exactly `buffers` chunks
+            let _ = free_tx.send(Chunk { data, len: 0 });
+        }
+        let (read_tx, read_rx) = sync_channel::<Message>(self.buffers + 1);
+
+        let (chunk_size, capacity) = (self.chunk_size, self.capacity);
+        let src = AssertSend(src);
+        // Each stage fills its own counters, which are kept even if it fails
+        let mut read_stats = CimplStreamCopyStats::default();
+        let mut transform_stats = CimplStreamCopyStats::default();
+        let result = thread::scope(|scope| {
+            let stats = &mut read_stats;
+            let reader = scope.spawn(move || {
+                // Rebind so the closure captures the wrapper, not its field
+                let src = src;
+                read_stage(src.0, chunk_size, free_rx, read_tx, stats)
+            });
+            let (write_rx, transformer) = match transform {
+                Some(transform) => {
+                    let (tx, rx) = sync_channel::<Message>(self.buffers + 1);
+                    let transform = AssertSend(transform);
+                    let stats = &mut transform_stats;
+                    let handle = scope.spawn(move || {
+                        let transform = transform;
+                        transform_stage(transform.0, capacity, read_rx, tx, stats)
+                    });
+                    (rx, Some(handle))
+                }
+                None => (read_rx, None),
+            };
+
+            // Dropping the receiver and the pool on return stops the threads
+            let written = write_stage(dst, write_rx, free_tx, &mut self.stats);
+
+            let read = join(reader);
+            let transformed = transformer.map_or(Ok(()), join);
+            // Report the earliest stage that failed: later ones only stopped
+            read.and(transformed).and(written)
+        });
+
+        self.stats.read_ns = read_stats.read_ns;
+        self.stats.bytes_read = read_stats.bytes_read;
+        self.stats.chunks = read_stats.chunks;
+        self.stats.transform_ns = transform_stats.transform_ns;
+        self.stats.elapsed_ns = elapsed_ns(start);
+        if self.stats.elapsed_ns > 0 {
+            self.stats.bytes_per_second =
+                self.stats.bytes_written as f64 * 1e9 / self.stats.elapsed_ns as f64;
+        }
+        result
+    }
+}
+
+fn elapsed_ns(start: Instant) -> u64 {
+    start.elapsed().as_nanos() as u64
+}
+
+fn join<T>(handle: thread::ScopedJoinHandle<'_, Result<T, CimplError>>) -> Result<T, CimplError> {
+    handle.join().unwrap_or_else(|_| {
+        Err(CimplError::new(
+            CimplStreamError::Other as i32,
+            "Copy thread panicked",
+        ))
+    })
+}
+
+/// Fills free buffers from the source, counting into the read stats.
+fn read_stage(
+    src: &mut CimplStream,
+    chunk_size: usize,
+    free: Receiver<Chunk>,
+    out: SyncSender<Message>,
+    stats: &mut CimplStreamCopyStats,
+) -> Result<(), CimplError> {
+    // recv() fails once the writer has stopped and dropped the pool
+    while let Ok(mut chunk) = free.recv() {
+        let start = Instant::now();
+        let n = loop {
+            match src.read(&mut chunk.data[..chunk_size]) {
+                Err(e) if e.kind() == ErrorKind::Interrupted => continue,
+                result => break result,
+            }
+        };
+        stats.read_ns += elapsed_ns(start);
+        let n = n.map_err(|e| stage_error("Source read", e))?;
+        if n == 0 {
+            let _ = out.send(None);
+            break;
+        }
+        stats.bytes_read += n as u64;
+        stats.chunks += 1;
+        chunk.len = n;
+        if out.send(Some(chunk)).is_err() {
+            break;
+        }
+    }
+    Ok(())
+}
+
+/// Rewrites each chunk in place and passes it on, counting transform_ns.
+fn transform_stage(
+    transform: Transform,
+    capacity: usize,
+    input: Receiver<Message>,
+    out: SyncSender<Message>,
+    stats: &mut CimplStreamCopyStats,
+) -> Result<(), CimplError> {
+    let mut apply = |chunk: &mut Chunk| {
+        let start = Instant::now();
+        let n = unsafe {
+            (transform.callback)(
+                transform.context,
+                chunk.data.as_mut_ptr(),
+                chunk.len,
+                capacity,
+            )
+        };
+        stats.transform_ns += elapsed_ns(start);
+        if n < 0 || n as usize > capacity {
+            return Err(CimplError::new(
+                CimplStreamError::IoOperation as i32,
+                format!("Transform returned {n} for a {capacity} byte buffer"),
+            ));
+        }
+        chunk.len = n as usize;
+        Ok(())
+    };
+
+    while let Ok(message) = input.recv() {
+        let Some(mut chunk) = message else {
+            // One last call with no input lets the transform emit what it held back
+            let mut tail = Chunk {
+                data: vec![0u8; capacity].into_boxed_slice(),
+                len: 0,
+            };
+            apply(&mut tail)?;
+            if tail.len > 0 {
+                let _ = out.send(Some(tail));
+            }
+            let _ = out.send(None);
+            break;
+        };
+        apply(&mut chunk)?;
+        if out.send(Some(chunk)).is_err() {
+            break;
+        }
+    }
+    Ok(())
+}
+
+/// Writes chunks to the destination and returns their buffers to the pool.
+fn write_stage(
+    dst: &mut CimplStream,
+    input: Receiver<Message>,
+    free: SyncSender<Chunk>,
+    stats: &mut CimplStreamCopyStats,
+) -> Result<u64, CimplError> {
+    loop {
+        let chunk = match input.recv() {
+            Ok(Some(chunk)) => chunk,
+            Ok(None) => break,
+            // An earlier stage failed and reports the error; skip the flush
+            Err(_) => return Ok(stats.bytes_written),
+        };
+        let start = Instant::now();
+        let result = dst.write_all(&chunk.data[..chunk.len]);
+        stats.write_ns += elapsed_ns(start);
+        result.map_err(|e| stage_error("Destination write", e))?;
+        stats.bytes_written += chunk.len as u64;
+        // Fails only if the reader has finished, which needs no more buffers
+        let _ = free.send(chunk);
+    }
+
+    let start = Instant::now();
+    let result = dst.flush();
+    stats.write_ns += elapsed_ns(start);
+    result.map_err(|e| stage_error("Destination flush", e))?;
+    Ok(stats.bytes_written)
+}
+
+fn stage_error(stage: &str, e: std::io::Error) -> CimplError {
+    CimplError::new(
+        CimplStreamError::IoOperation as i32,
+        format!("{stage} failed: {e}"),
+    )
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{
+        cimpl_stream_error_code, cimpl_stream_from_memory, cimpl_stream_last_error,
+        cimpl_stream_new, CimplSeekMode, CimplStreamContext,
+    };
+    use std::sync::Mutex;
+
+    /// Destination that appends everything written to it
+    struct Sink {
+        data: Mutex<Vec<u8>>,
+        flushes: Mutex<usize>,
+        /// Reads that succeed before they start failing
+        reads: Mutex<usize>,
+    }
+
+    impl Sink {
+        fn new() -> Box<Self> {
+            Box::new(Self {
+                data: Mutex::new(Vec::new()),
+                flushes: Mutex::new(0),
+                reads: Mutex::new(0),
+            })
+        }
+
+        /// A callback stream over this sink whose reads fail after `reads`
+        fn stream(&self) -> *mut CimplStream {
+            cimpl_stream_new(
+                self as *const Self as *mut CimplStreamContext,
+                Self::read,
+                Self::seek,
+                Self::write,
+                Self::flush,
+            )
+        }
+
+        unsafe extern "C" fn read(
+            ctx: *mut CimplStreamContext,
+            data: *mut u8,
+            len: usize,
+        ) -> isize {
+            let mut reads = (*(ctx as *const Self)).reads.lock().unwrap();
+            if *reads == 0 {
+                return -1;
+            }
+            *reads -= 1;
+            std::ptr::write_bytes(data, b'r', len);
+            len as isize
+        }
+
+        unsafe extern "C" fn seek(_: *mut CimplStreamContext, _: i64, _: CimplSeekMode) -> i64 {
+            -1
+        }
+
+        unsafe extern "C" fn write(
+            ctx: *mut CimplStreamContext,
+            data: *const u8,
+            len: usize,
+        ) -> isize {
+            let sink = &*(ctx as *const Self);
+            let bytes = std::slice::from_raw_parts(data, len);
+            sink.data.lock().unwrap().extend_from_slice(bytes);
+            len as isize
+        }
+
+        unsafe extern "C" fn flush(ctx: *mut CimplStreamContext) -> i32 {
+            *(*(ctx as *const Self)).flushes.lock().unwrap() += 1;
+            0
+        }
+    }
+
+    fn free(stream: *mut CimplStream) {
+        cimpl::cimpl_free(stream as *mut c_void);
+    }
+
+    fn pattern(len: usize) -> Vec<u8> {
+        (0..len).map(|i| (i * 7 % 251) as u8).collect()
+    }
+
+    #[test]
+    fn test_copy_all_chunks_in_order() {
+        let input = pattern(100_000);
+        for (chunk_size, buffers) in [(0, 0), (1000, 2), (4096, 3), (333, 16)] {
+            let sink = Sink::new();
+            let (src, dst) = (
+                cimpl_stream_from_memory(input.as_ptr(), input.len()),
+                sink.stream(),
+            );
+            let options = CimplStreamCopyOptions {
+                buffers,
+                ..Default::default()
+            };
+            let mut stats = CimplStreamCopyStats::default();
+
+            let copied = cimpl_stream_copy(src, dst, chunk_size, &options, &mut stats);
+            assert_eq!(copied, input.len() as i64);
+            assert_eq!(*sink.data.lock().unwrap(), input);
+            assert_eq!(*sink.flushes.lock().unwrap(), 1);
+            assert_eq!(stats.bytes_read, input.len() as u64);
+            assert_eq!(stats.bytes_written, input.len() as u64);
+            let chunk = if chunk_size == 0 {
+                DEFAULT_STREAM_BUFFER
+            } else {
+                chunk_size
+            };
+            assert_eq!(stats.chunks, input.len().div_ceil(chunk) as u64);
+            assert_eq!(stats.transform_ns, 0);
+            free(src);
+            free(dst);
+        }
+    }
+
+    /// Uppercases each chunk and appends one '!' per chunk at the end
+    unsafe extern "C" fn shout(
+        ctx: *mut c_void,
+        data: *mut u8,
+        len: usize,
+        capacity: usize,
+    ) -> isize {
+        let chunks = &mut *(ctx as *mut usize);
+        if len == 0 {
+            let tail = (*chunks).min(capacity);
+            std::ptr::write_bytes(data, b'!', tail);
+            return tail as isize;
+        }
+        *chunks += 1;
+        std::slice::from_raw_parts_mut(data, len).make_ascii_uppercase();
+        len as isize
+    }
+
+    #[test]
+    fn test_copy_with_transform() {
+        let input = b"the quick brown fox jumps over the lazy dog".repeat(50);
+        let sink = Sink::new();
+        let (src, dst) = (
+            cimpl_stream_from_memory(input.as_ptr(), input.len()),
+            sink.stream(),
+        );
+        let mut chunks = 0usize;
+        let options = CimplStreamCopyOptions {
+            buffers: 2,
+            transform: Some(shout),
+            transform_context: &mut chunks as *mut usize as *mut c_void,
+            transform_capacity: 0,
+        };
+        let mut stats = CimplStreamCopyStats::default();
+
+        let copied = cimpl_stream_copy(src, dst, 100, &options, &mut stats);
+        let mut expected = input.to_ascii_uppercase();
+        expected.extend(std::iter::repeat_n(b'!', chunks));
+        assert_eq!(chunks, 22);
+        assert_eq!(copied, expected.len() as i64);
+        assert_eq!(*sink.data.lock().unwrap(), expected);
+        assert_eq!(stats.bytes_read, input.len() as u64);
+        assert_eq!(stats.bytes_written, expected.len() as u64);
+        free(src);
+        free(dst);
+    }
+
+    #[test]
+    fn test_copy_reports_source_errors() {
+        for reads in [0, 3] {
+            let (reader, writer) = (Sink::new(), Sink::new());
+            *reader.reads.lock().unwrap() = reads;
+            let (src, dst) = (reader.stream(), writer.stream());
+            let mut stats = CimplStreamCopyStats::default();
+
+            assert_eq!(
+                cimpl_stream_copy(src, dst, 10, std::ptr::null(), &mut stats),
+                -1
+            );
+            assert_eq!(
+                cimpl_stream_error_code(),
+                CimplStreamError::IoOperation as i32
+            );
+            let message = cimpl_stream_last_error();
+            let text = unsafe { std::ffi::CStr::from_ptr(message) }
+                .to_str()
+                .unwrap()
+                .to_owned();
+            cimpl::cimpl_free(message as *mut c_void);
+            assert!(text.starts_with("Source read failed"), "{text}");
+            // The destination is not flushed after a failed read, but what
+            // was read before the failure is still written and counted
+            assert_eq!(*writer.flushes.lock().unwrap(), 0);
+            assert_eq!(stats.chunks, reads as u64);
+            assert_eq!(stats.bytes_read, reads as u64 * 10);
+            assert_eq!(stats.bytes_written, reads as u64 * 10);
+            assert_eq!(*writer.data.lock().unwrap(), vec![b'r'; reads * 10]);
+            free(src);
+            free(dst);
+        }
+    }
+
+    #[test]
+    fn test_copy_rejects_bad_arguments() {
+        let sink = Sink::new();
+        let dst = sink.stream();
+        assert_eq!(
+            cimpl_stream_copy(dst, dst, 0, std::ptr::null(), std::ptr::null_mut()),
+            -1
+        );
+        assert_eq!(
+            cimpl_stream_copy(
+                std::ptr::null_mut(),
+                dst,
+                0,
+                std::ptr::null(),
+                std::ptr::null_mut()
+            ),
+            -1
+        );
+        assert_eq!(
+            cimpl_stream_error_code(),
+            CimplStreamError::NullParameter as i32
+        );
+
+        let input = [1u8; 4];
+        let src = cimpl_stream_from_memory(input.as_ptr(), input.len());
+        let options = CimplStreamCopyOptions {
+            buffers: 1,
+            ..Default::default()
+        };
+        assert_eq!(
+            cimpl_stream_copy(src, dst, 0, &options, std::ptr::null_mut()),
+            -1
+        );
+        assert_eq!(
+            cimpl_stream_error_code(),
+            CimplStreamError::InvalidBuffer as i32
+        );
+        assert!(sink.data.lock().unwrap().is_empty());
+        free(src);
+        free(dst);
+    }
+}
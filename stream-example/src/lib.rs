@@ -20,6 +20,11 @@
 //! ## Key Features
 //!
 //! - Bridges C callback-based I/O to Rust's Read, Write, and Seek traits
+//! - Optional read-ahead/write-behind buffering to cut callback crossings
+//! - Optional vectored (`readv`/`writev`) and `read_exact` callbacks
+//! - Callback-free read-only streams over a file (memory-mapped) or a buffer
+//! - Non-blocking completion-based streams (`async` feature)
+//! - Pipelined stream-to-stream copy with an optional transform stage
 //! - Safe pointer validation using cimpl macros
 //! - Universal memory management with `cimpl_free()`
 //! - Standard error handling with error codes and messages
@@ -34,11 +39,28 @@
 //! - `target/release/libcimpl_stream.{a,so,dylib}` - The library
 //! - `include/cimpl_stream.h` - C header with full documentation
 
-use std::io::{Read, Seek, SeekFrom, Write};
+// The C API is made of safe `extern "C"` functions taking raw pointers: the
+// macros reject NULL and stale handles, and C is responsible for the rest.
+#![allow(clippy::not_unsafe_ptr_arg_deref)]
+
+#[cfg(feature = "async")]
+mod async_stream;
+#[cfg(feature = "async")]
+pub use async_stream::*;
+
+mod copy;
+pub use copy::*;
+
+use std::{
+    fs::File,
+    io::{BufRead, Cursor, IoSlice, IoSliceMut, Read, Seek, SeekFrom, Write},
+    os::raw::c_char,
+};
 
 use cimpl::{
-    box_tracked, deref_mut_or_return_neg, ok_or_return, option_to_c_string, ptr_or_return_int,
-    ptr_or_return_null, Error,
+    box_tracked, cstr_borrow_or_return_null, deref_mut_or_return, deref_mut_or_return_neg,
+    ok_or_return, ok_or_return_null, option_to_c_string, ptr_or_return, ptr_or_return_int,
+    ptr_or_return_null, some_or_return_null, CimplError,
 };
 
 // ============================================================================
@@ -74,9 +96,10 @@ pub enum CimplStreamError {
     InvalidBuffer = 101,
 }
 
-// Map std::io::Error to cimpl Error
-const ERROR_MAPPER: fn(&std::io::Error) -> (i32, &'static str) = 
-    |_e| (CimplStreamError::IoOperation as i32, "IoError");
+/// Maps std::io::Error to a CimplError with the IoOperation code
+fn io_error(e: std::io::Error) -> CimplError {
+    CimplError::new(CimplStreamError::IoOperation as i32, format!("IoError: {e}"))
+}
 
 // ============================================================================
 // Stream Context and Callbacks
@@ -162,21 +185,369 @@ pub type CimplWriteCallback = unsafe extern "C" fn(
 /// - -1 on error
 pub type CimplFlushCallback = unsafe extern "C" fn(context: *mut CimplStreamContext) -> i32;
 
+/// One destination buffer of a vectored read.
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct CimplIoVec {
+    /// Start of the buffer
+    pub data: *mut u8,
+    /// Length of the buffer in bytes
+    pub len: usize,
+}
+
+/// One source buffer of a vectored write.
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct CimplConstIoVec {
+    /// Start of the buffer
+    pub data: *const u8,
+    /// Length of the buffer in bytes
+    pub len: usize,
+}
+
+/// Largest number of buffers passed to one vectored callback
+pub const CIMPL_STREAM_MAX_IOV: usize = 64;
+
+/// Vectored read callback: fills the buffers in order, like `readv()`.
+///
+/// # Parameters
+/// - `context`: The stream context provided when creating the stream
+/// - `iov`: Array of `count` buffers to fill
+/// - `count`: Number of buffers (at most `CIMPL_STREAM_MAX_IOV`)
+///
+/// # Returns
+/// - Total number of bytes read (>= 0) on success
+/// - -1 on error
+pub type CimplReadvCallback = unsafe extern "C" fn(
+    context: *mut CimplStreamContext,
+    iov: *const CimplIoVec,
+    count: usize,
+) -> isize;
+
+/// Vectored write callback: writes the buffers in order, like `writev()`.
+///
+/// # Parameters
+/// - `context`: The stream context provided when creating the stream
+/// - `iov`: Array of `count` buffers to write
+/// - `count`: Number of buffers (at most `CIMPL_STREAM_MAX_IOV`)
+///
+/// # Returns
+/// - Total number of bytes written (>= 0) on success
+/// - -1 on error
+pub type CimplWritevCallback = unsafe extern "C" fn(
+    context: *mut CimplStreamContext,
+    iov: *const CimplConstIoVec,
+    count: usize,
+) -> isize;
+
+/// Read-exact callback: fills the whole buffer in one call.
+///
+/// # Parameters
+/// - `context`: The stream context provided when creating the stream
+/// - `data`: Buffer to fill
+/// - `len`: Number of bytes required
+///
+/// # Returns
+/// - `len` on success
+/// - Fewer than `len` bytes (>= 0) if the stream ended first
+/// - -1 on error
+pub type CimplReadExactCallback = unsafe extern "C" fn(
+    context: *mut CimplStreamContext,
+    data: *mut u8,
+    len: usize,
+) -> isize;
+
+/// Callback table for `cimpl_stream_new_ex()`.
+///
+/// `reader`, `seeker`, `writer` and `flusher` are required. The others are
+/// optional (NULL); when missing, the stream falls back to calling `reader`
+/// or `writer` once per buffer.
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct CimplStreamCallbacks {
+    pub reader: Option<CimplReadCallback>,
+    pub seeker: Option<CimplSeekCallback>,
+    pub writer: Option<CimplWriteCallback>,
+    pub flusher: Option<CimplFlushCallback>,
+    pub readv: Option<CimplReadvCallback>,
+    pub writev: Option<CimplWritevCallback>,
+    pub read_exact: Option<CimplReadExactCallback>,
+}
+
 // ============================================================================
 // Stream Structure
 // ============================================================================
 
-/// A stream that bridges C callbacks to Rust's Read/Write/Seek traits.
+/// The C callbacks and context behind a stream.
 ///
-/// This structure holds callback function pointers and a context pointer.
-/// It implements Rust's standard I/O traits, allowing it to be used anywhere
-/// a Read, Write, or Seek trait is required.
-pub struct CimplStream {
+/// Every Read/Write/Seek call on this goes straight to C.
+struct Callbacks {
     context: *mut CimplStreamContext,
     reader: CimplReadCallback,
     seeker: CimplSeekCallback,
     writer: CimplWriteCallback,
     flusher: CimplFlushCallback,
+    readv: Option<CimplReadvCallback>,
+    writev: Option<CimplWritevCallback>,
+    read_exact: Option<CimplReadExactCallback>,
+}
+
+/// A stream that bridges C callbacks to Rust's Read/Write/Seek traits.
+///
+/// This structure holds callback function pointers and a context pointer.
+/// It implements Rust's standard I/O traits, allowing it to be used anywhere
+/// a Read, Write, or Seek trait is required.
+///
+/// A buffered stream (`cimpl_stream_new_buffered()`) batches small reads and
+/// writes into calls of up to the buffer capacity. Streams created with
+/// `cimpl_stream_from_file()` or `cimpl_stream_from_memory()` make no
+/// callbacks at all and are read-only.
+///
+/// Every stream also implements `BufRead`, and `as_slice()` gives parsers
+/// direct access to the bytes of a memory-backed stream.
+pub struct CimplStream {
+    backend: Backend,
+}
+
+enum Backend {
+    /// Calls back into C for every operation (or every buffer fill)
+    Callbacks(CallbackStream),
+    /// Reads straight from bytes already in memory
+    Memory(MemoryStream),
+}
+
+/// C callbacks plus the optional buffer in front of them
+struct CallbackStream {
+    io: Callbacks,
+    buffer: Option<StreamBuffer>,
+    /// `buffer` was only created to serve a peek on an unbuffered stream
+    peek_only: bool,
+}
+
+/// Read-only stream over bytes in memory
+struct MemoryStream {
+    /// Points into `_storage` (or the caller's buffer), which it must not outlive
+    cursor: Cursor<&'static [u8]>,
+    _storage: Storage,
+}
+
+/// What keeps the bytes of a `MemoryStream` alive
+// Never read: the variants are only held for their Drop
+#[allow(dead_code)]
+enum Storage {
+    /// The caller's buffer; C keeps it valid until the stream is freed
+    Borrowed,
+    /// Read into memory, where the file could not be mapped
+    Owned(Vec<u8>),
+    /// A read-only private mapping of a file
+    #[cfg(unix)]
+    Mapped(Mapping),
+}
+
+#[cfg(unix)]
+struct Mapping {
+    addr: *mut libc::c_void,
+    len: usize,
+}
+
+#[cfg(unix)]
+impl Mapping {
+    /// Maps `len` bytes of `file` read-only, or returns None if the OS refuses
+    fn new(file: &File, len: usize) -> Option<Self> {
+        use std::os::unix::io::AsRawFd;
+
+        let addr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_PRIVATE,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if addr == libc::MAP_FAILED {
+            return None;
+        }
+        // Only a hint that the kernel should read ahead aggressively
+        unsafe { libc::madvise(addr, len, libc::MADV_SEQUENTIAL) };
+        Some(Self { addr, len })
+    }
+}
+
+#[cfg(unix)]
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.addr, self.len) };
+    }
+}
+
+impl MemoryStream {
+    /// # Safety
+    /// `data` must stay valid and unchanged for as long as the stream lives
+    unsafe fn new(data: *const u8, len: usize, storage: Storage) -> Self {
+        Self {
+            cursor: Cursor::new(std::slice::from_raw_parts(data, len)),
+            _storage: storage,
+        }
+    }
+
+    /// Maps `file` into memory, or reads it in if it cannot be mapped
+    fn from_file(mut file: File) -> std::io::Result<Self> {
+        let len = usize::try_from(file.metadata()?.len()).map_err(|_| {
+            std::io::Error::new(std::io::ErrorKind::InvalidInput, "File is too large to map")
+        })?;
+
+        // Zero-length mappings are an error; pipes and devices cannot be mapped
+        #[cfg(unix)]
+        if len > 0 {
+            if let Some(mapping) = Mapping::new(&file, len) {
+                let data = mapping.addr as *const u8;
+                return Ok(unsafe { Self::new(data, len, Storage::Mapped(mapping)) });
+            }
+        }
+
+        let mut bytes = Vec::with_capacity(len);
+        file.read_to_end(&mut bytes)?;
+        // Moving the Vec into Storage does not move its heap buffer
+        Ok(unsafe { Self::new(bytes.as_ptr(), bytes.len(), Storage::Owned(bytes)) })
+    }
+}
+
+impl CimplStream {
+    fn callbacks(io: Callbacks, buffer: Option<StreamBuffer>) -> Self {
+        Self {
+            backend: Backend::Callbacks(CallbackStream {
+                io,
+                buffer,
+                peek_only: false,
+            }),
+        }
+    }
+
+    /// All bytes of a memory-backed stream, regardless of the current position
+    ///
+    /// Returns None for callback streams, whose data is not in memory.
+    pub fn as_slice(&self) -> Option<&[u8]> {
+        match &self.backend {
+            Backend::Callbacks(_) => None,
+            Backend::Memory(m) => Some(m.cursor.get_ref()),
+        }
+    }
+}
+
+/// Default capacity for `cimpl_stream_new_buffered()` when 0 is passed
+pub const DEFAULT_STREAM_BUFFER: usize = 64 * 1024;
+
+/// Shared read-ahead / write-behind buffer of a buffered stream.
+///
+/// While reading, `data[start..end]` holds bytes fetched from C but not yet
+/// consumed. While writing, `data[..end]` holds bytes not yet passed to C.
+struct StreamBuffer {
+    data: Box<[u8]>,
+    start: usize,
+    end: usize,
+    writing: bool,
+    /// Position of the C stream, once a seek has told us
+    inner_pos: Option<u64>,
+}
+
+impl StreamBuffer {
+    fn new(capacity: usize) -> Self {
+        Self {
+            data: vec![0; capacity].into_boxed_slice(),
+            start: 0,
+            end: 0,
+            writing: false,
+            inner_pos: None,
+        }
+    }
+
+    /// Refills the empty read-ahead with one read from C
+    fn fill(&mut self, io: &mut Callbacks) -> std::io::Result<()> {
+        let n = io.read(&mut self.data)?;
+        self.start = 0;
+        self.end = n;
+        self.advance_inner(n);
+        Ok(())
+    }
+
+    /// Copies buffered bytes into `buf`, returning how many were copied
+    fn take(&mut self, buf: &mut [u8]) -> usize {
+        let n = buf.len().min(self.end - self.start);
+        buf[..n].copy_from_slice(&self.data[self.start..self.start + n]);
+        self.start += n;
+        n
+    }
+
+    /// Records that the C stream moved forward by `n` bytes
+    fn advance_inner(&mut self, n: usize) {
+        self.inner_pos = self.inner_pos.map(|pos| pos + n as u64);
+    }
+
+    /// Writes any pending bytes to C
+    fn flush_writes(&mut self, io: &mut Callbacks) -> std::io::Result<()> {
+        if self.writing {
+            let mut written = 0;
+            while written < self.end {
+                match io.write(&self.data[written..self.end]) {
+                    Ok(0) => {
+                        return Err(std::io::Error::new(
+                            std::io::ErrorKind::WriteZero,
+                            "Write callback accepted no data",
+                        ))
+                    }
+                    Ok(n) => {
+                        written += n;
+                        self.advance_inner(n);
+                    }
+                    Err(e) => {
+                        // Keep what C has not taken yet
+                        self.data.copy_within(written..self.end, 0);
+                        self.end -= written;
+                        return Err(e);
+                    }
+                }
+            }
+            self.end = 0;
+            self.writing = false;
+        }
+        Ok(())
+    }
+
+    /// Drops unread read-ahead, moving C back to the logical position
+    fn discard_read_ahead(&mut self, io: &mut Callbacks) -> std::io::Result<()> {
+        let unread = self.end - self.start;
+        if unread > 0 {
+            let pos = io.seek(SeekFrom::Current(-(unread as i64)))?;
+            self.inner_pos = Some(pos);
+        }
+        self.start = 0;
+        self.end = 0;
+        Ok(())
+    }
+
+    /// Moves within the read-ahead without calling C, if the target is buffered
+    fn seek_in_buffer(&mut self, from: SeekFrom) -> Option<u64> {
+        if self.writing {
+            return None;
+        }
+        // data[..end] holds the bytes just before inner_pos
+        let inner = self.inner_pos?;
+        let buffer_start = inner - self.end as u64;
+        let target = match from {
+            SeekFrom::Start(pos) => pos,
+            SeekFrom::Current(offset) => {
+                (inner - (self.end - self.start) as u64).checked_add_signed(offset)?
+            }
+            SeekFrom::End(_) => return None,
+        };
+        if target < buffer_start || target > inner {
+            return None;
+        }
+        self.start = (target - buffer_start) as usize;
+        Some(target)
+    }
 }
 
 // ============================================================================
@@ -227,17 +598,200 @@ pub extern "C" fn cimpl_stream_new(
 ) -> *mut CimplStream {
     ptr_or_return_null!(context);
 
-    let stream = CimplStream {
-        context,
-        reader,
-        seeker,
-        writer,
-        flusher,
+    let stream = CimplStream::callbacks(
+        Callbacks {
+            context,
+            reader,
+            seeker,
+            writer,
+            flusher,
+            readv: None,
+            writev: None,
+            read_exact: None,
+        },
+        None,
+    );
+
+    box_tracked!(stream)
+}
+
+/// Creates a new buffered stream from C callbacks.
+///
+/// Like `cimpl_stream_new()`, but small reads are served from a read-ahead
+/// buffer and small writes are collected in a write-behind buffer, so C is
+/// called once per `capacity` bytes instead of once per operation. Reads or
+/// writes of at least `capacity` bytes bypass the buffer.
+///
+/// Pending writes are passed to C on `cimpl_stream_flush()`, before any read
+/// or seek, and when the stream is freed. Free the stream before its context.
+///
+/// # Parameters
+/// - `context`, `reader`, `seeker`, `writer`, `flusher`: as for `cimpl_stream_new()`
+/// - `capacity`: Buffer size in bytes (0 selects a 64KB default)
+///
+/// # Returns
+/// - Pointer to the new stream on success
+/// - NULL on error (check `cimpl_stream_last_error()` for details)
+///
+/// # Example
+/// ```c
+/// CimplStream* stream = cimpl_stream_new_buffered(
+///     my_context, my_read, my_seek, my_write, my_flush, 64 * 1024
+/// );
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_stream_new_buffered(
+    context: *mut CimplStreamContext,
+    reader: CimplReadCallback,
+    seeker: CimplSeekCallback,
+    writer: CimplWriteCallback,
+    flusher: CimplFlushCallback,
+    capacity: usize,
+) -> *mut CimplStream {
+    ptr_or_return_null!(context);
+
+    let capacity = if capacity == 0 {
+        DEFAULT_STREAM_BUFFER
+    } else {
+        capacity
     };
+    let stream = CimplStream::callbacks(
+        Callbacks {
+            context,
+            reader,
+            seeker,
+            writer,
+            flusher,
+            readv: None,
+            writev: None,
+            read_exact: None,
+        },
+        Some(StreamBuffer::new(capacity)),
+    );
+
+    box_tracked!(stream)
+}
+
+/// Creates a new stream from a callback table, with optional extra callbacks.
+///
+/// Use this to provide `readv`/`writev` callbacks, so a vectored Rust read or
+/// write of many segments crosses into C once, or a `read_exact` callback
+/// that satisfies a whole request in one call.
+///
+/// # Parameters
+/// - `context`: Opaque pointer to caller's stream context (passed to all callbacks)
+/// - `callbacks`: Callback table; copied, so it need not outlive the call
+/// - `capacity`: Buffer size as for `cimpl_stream_new_buffered()`, or 0 for
+///   an unbuffered stream
+///
+/// # Returns
+/// - Pointer to the new stream on success
+/// - NULL if `context`, `callbacks` or a required callback is NULL
+///
+/// # Example
+/// ```c
+/// CimplStreamCallbacks callbacks = {
+///     .reader = my_read, .seeker = my_seek,
+///     .writer = my_write, .flusher = my_flush,
+///     .writev = my_writev,  // others may stay NULL
+/// };
+/// CimplStream* stream = cimpl_stream_new_ex(my_context, &callbacks, 0);
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_stream_new_ex(
+    context: *mut CimplStreamContext,
+    callbacks: *const CimplStreamCallbacks,
+    capacity: usize,
+) -> *mut CimplStream {
+    ptr_or_return_null!(context);
+    ptr_or_return_null!(callbacks);
+    let callbacks = unsafe { *callbacks };
+
+    let stream = CimplStream::callbacks(
+        Callbacks {
+            context,
+            reader: some_or_return_null!(callbacks.reader, CimplError::null_parameter("reader")),
+            seeker: some_or_return_null!(callbacks.seeker, CimplError::null_parameter("seeker")),
+            writer: some_or_return_null!(callbacks.writer, CimplError::null_parameter("writer")),
+            flusher: some_or_return_null!(callbacks.flusher, CimplError::null_parameter("flusher")),
+            readv: callbacks.readv,
+            writev: callbacks.writev,
+            read_exact: callbacks.read_exact,
+        },
+        (capacity > 0).then(|| StreamBuffer::new(capacity)),
+    );
 
     box_tracked!(stream)
 }
 
+/// Opens a file as a read-only stream that makes no callbacks.
+///
+/// Regular files are memory-mapped, so reads are plain memory copies and
+/// `cimpl_stream_peek()` can hand out the file contents without copying.
+/// Files that cannot be mapped (pipes, devices, empty files) are read into
+/// memory instead. Writes to the stream fail.
+///
+/// # Parameters
+/// - `path`: Path of the file to open (UTF-8, nul-terminated)
+///
+/// # Returns
+/// - Pointer to the new stream on success
+/// - NULL on error (check `cimpl_stream_last_error()` for details)
+///
+/// # Safety
+/// The file must not be truncated while the stream exists; reading a mapped
+/// page past the new end of file raises SIGBUS.
+///
+/// # Example
+/// ```c
+/// CimplStream* stream = cimpl_stream_from_file("video.mp4");
+/// if (!stream) {
+///     fprintf(stderr, "Open failed\n");
+/// }
+/// cimpl_free(stream);
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_stream_from_file(path: *const c_char) -> *mut CimplStream {
+    let path = cstr_borrow_or_return_null!(path);
+    let file = ok_or_return_null!(File::open(path.as_ref()).map_err(io_error));
+    let memory = ok_or_return_null!(MemoryStream::from_file(file).map_err(io_error));
+
+    box_tracked!(CimplStream {
+        backend: Backend::Memory(memory),
+    })
+}
+
+/// Creates a read-only stream over a caller-owned buffer, without copying it.
+///
+/// Reads and seeks never call into C. Writes to the stream fail.
+///
+/// # Parameters
+/// - `data`: Start of the buffer (must not be NULL)
+/// - `len`: Length of the buffer in bytes
+///
+/// # Returns
+/// - Pointer to the new stream on success
+/// - NULL if `data` is NULL
+///
+/// # Safety
+/// The buffer must stay valid and unchanged until the stream is freed.
+///
+/// # Example
+/// ```c
+/// CimplStream* stream = cimpl_stream_from_memory(bytes, size);
+/// // ... pass the stream to Rust code ...
+/// cimpl_free(stream);  // before freeing bytes
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_stream_from_memory(data: *const u8, len: usize) -> *mut CimplStream {
+    ptr_or_return_null!(data);
+
+    let memory = unsafe { MemoryStream::new(data, len, Storage::Borrowed) };
+    box_tracked!(CimplStream {
+        backend: Backend::Memory(memory),
+    })
+}
+
 // ============================================================================
 // Stream Operations
 // ============================================================================
@@ -273,7 +827,7 @@ pub extern "C" fn cimpl_stream_read(
     // Create a safe slice from the raw pointer
     let buf = unsafe { std::slice::from_raw_parts_mut(buffer, len) };
 
-    ok_or_return!(s.read(buf), |bytes_read| bytes_read as isize, -1)
+    ok_or_return!(s.read(buf).map_err(io_error), |bytes_read| bytes_read as isize, -1)
 }
 
 /// Seeks to a position in the stream.
@@ -312,143 +866,630 @@ pub extern "C" fn cimpl_stream_seek(
         CimplSeekMode::End => SeekFrom::End(offset),
     };
 
-    ok_or_return!(s.seek(seek_from), |pos| pos as i64, -1)
+    ok_or_return!(s.seek(seek_from).map_err(io_error), |pos| pos as i64, -1)
+}
+
+/// Writes data to the stream.
+///
+/// # Parameters
+/// - `stream`: The stream to write to
+/// - `data`: Buffer containing data to write (must not be NULL)
+/// - `len`: Number of bytes to write
+///
+/// # Returns
+/// - Number of bytes actually written (>= 0) on success
+/// - -1 on error
+///
+/// # Example
+/// ```c
+/// const char* message = "Hello, World!";
+/// isize bytes_written = cimpl_stream_write(stream, (const uint8_t*)message, strlen(message));
+/// if (bytes_written < 0) {
+///     fprintf(stderr, "Write error\n");
+/// }
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_stream_write(
+    stream: *mut CimplStream,
+    data: *const u8,
+    len: usize,
+) -> isize {
+    let s = deref_mut_or_return_neg!(stream, CimplStream);
+    ptr_or_return_int!(data);
+
+    let buf = unsafe { std::slice::from_raw_parts(data, len) };
+
+    ok_or_return!(s.write(buf).map_err(io_error), |bytes_written| bytes_written as isize, -1)
+}
+
+/// Flushes the stream, ensuring all buffered data is written.
+///
+/// # Parameters
+/// - `stream`: The stream to flush
+///
+/// # Returns
+/// - 0 on success
+/// - -1 on error
+///
+/// # Example
+/// ```c
+/// if (cimpl_stream_flush(stream) != 0) {
+///     fprintf(stderr, "Flush error\n");
+/// }
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_stream_flush(stream: *mut CimplStream) -> i32 {
+    let s = deref_mut_or_return_neg!(stream, CimplStream);
+
+    ok_or_return!(s.flush().map_err(io_error), |_| 0, -1)
+}
+
+/// Returns the next bytes of the stream without copying or consuming them.
+///
+/// For file and memory streams this is everything from the current position
+/// to the end. For callback streams it is the contents of the read-ahead
+/// buffer, which is filled (and created, for an unbuffered stream) if empty.
+/// Call `cimpl_stream_consume()` to advance past bytes you have used.
+///
+/// # Parameters
+/// - `stream`: The stream to peek into
+/// - `out_len`: Receives the number of bytes available (0 at end of stream)
+///
+/// # Returns
+/// - Pointer to the bytes, valid until the next operation on the stream
+/// - NULL on error
+///
+/// # Example
+/// ```c
+/// size_t len;
+/// const uint8_t* data;
+/// while ((data = cimpl_stream_peek(stream, &len)) && len > 0) {
+///     parse(data, len);
+///     cimpl_stream_consume(stream, len);
+/// }
+/// ```
+#[no_mangle]
+pub extern "C" fn cimpl_stream_peek(stream: *mut CimplStream, out_len: *mut usize) -> *const u8 {
+    let s = deref_mut_or_return!(stream, CimplStream, std::ptr::null());
+    ptr_or_return!(out_len, std::ptr::null());
+
+    let bytes = ok_or_return!(s.fill_buf().map_err(io_error), |b| b, std::ptr::null());
+    unsafe { *out_len = bytes.len() };
+    bytes.as_ptr()
+}
+
+/// Advances the stream past `len` bytes returned by `cimpl_stream_peek()`.
+///
+/// # Returns
+/// - 0 on success
+/// - -1 if `len` is more than the last peek returned
+#[no_mangle]
+pub extern "C" fn cimpl_stream_consume(stream: *mut CimplStream, len: usize) -> i32 {
+    let s = deref_mut_or_return_neg!(stream, CimplStream);
+
+    if len > s.buffered_len() {
+        CimplError::new(CimplStreamError::InvalidBuffer as i32, "Consumed more than was peeked")
+            .set_last();
+        return -1;
+    }
+    s.consume(len);
+    0
+}
+
+// ============================================================================
+// Trait Implementations
+// ============================================================================
+
+impl Read for Callbacks {
+    fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+        if buf.len() > isize::MAX as usize {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "Read buffer is too large",
+            ));
+        }
+
+        let bytes_read = unsafe { (self.reader)(self.context, buf.as_mut_ptr(), buf.len()) };
+
+        if bytes_read < 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::Other,
+                "Read callback returned error",
+            ));
+        }
+        // Callers slice `buf` by the count, so a count past it must not escape
+        if bytes_read as usize > buf.len() {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidData,
+                "Read callback returned more bytes than requested",
+            ));
+        }
+
+        Ok(bytes_read as usize)
+    }
+
+    fn read_vectored(&mut self, bufs: &mut [IoSliceMut<'_>]) -> std::io::Result<usize> {
+        let Some(readv) = self.readv else {
+            // Same as the default: read into the first non-empty buffer
+            return match bufs.iter_mut().find(|buf| !buf.is_empty()) {
+                Some(buf) => self.read(buf),
+                None => Ok(0),
+            };
+        };
+
+        let mut iov = [CimplIoVec {
+            data: std::ptr::null_mut(),
+            len: 0,
+        }; CIMPL_STREAM_MAX_IOV];
+        let count = bufs.len().min(CIMPL_STREAM_MAX_IOV);
+        for (vec, buf) in iov.iter_mut().zip(bufs.iter_mut()) {
+            *vec = CimplIoVec {
+                data: buf.as_mut_ptr(),
+                len: buf.len(),
+            };
+        }
+
+        let bytes_read = unsafe { readv(self.context, iov.as_ptr(), count) };
+
+        if bytes_read < 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::Other,
+                "Readv callback returned error",
+            ));
+        }
+        if bytes_read as usize > iov[..count].iter().map(|vec| vec.len).sum() {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidData,
+                "Readv callback returned more bytes than requested",
+            ));
+        }
+
+        Ok(bytes_read as usize)
+    }
+
+    fn read_exact(&mut self, mut buf: &mut [u8]) -> std::io::Result<()> {
+        let Some(read_exact) = self.read_exact else {
+            while !buf.is_empty() {
+                match self.read(buf) {
+                    Ok(0) => return Err(std::io::ErrorKind::UnexpectedEof.into()),
+                    Ok(n) => buf = &mut buf[n..],
+                    Err(e) if e.kind() == std::io::ErrorKind::Interrupted => {}
+                    Err(e) => return Err(e),
+                }
+            }
+            return Ok(());
+        };
+
+        let bytes_read = unsafe { read_exact(self.context, buf.as_mut_ptr(), buf.len()) };
+
+        if bytes_read < 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::Other,
+                "Read-exact callback returned error",
+            ));
+        }
+        if (bytes_read as usize) < buf.len() {
+            return Err(std::io::ErrorKind::UnexpectedEof.into());
+        }
+
+        Ok(())
+    }
+}
+
+impl Seek for Callbacks {
+    fn seek(&mut self, from: SeekFrom) -> std::io::Result<u64> {
+        let (offset, mode) = match from {
+            SeekFrom::Start(pos) => (pos as i64, CimplSeekMode::Start),
+            SeekFrom::Current(pos) => (pos, CimplSeekMode::Current),
+            SeekFrom::End(pos) => (pos, CimplSeekMode::End),
+        };
+
+        let new_pos = unsafe { (self.seeker)(self.context, offset, mode) };
+
+        if new_pos < 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::Other,
+                "Seek callback returned error",
+            ));
+        }
+
+        Ok(new_pos as u64)
+    }
+}
+
+impl Write for Callbacks {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        if buf.len() > isize::MAX as usize {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "Write buffer is too large",
+            ));
+        }
+
+        let bytes_written = unsafe { (self.writer)(self.context, buf.as_ptr(), buf.len()) };
+
+        if bytes_written < 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::Other,
+                "Write callback returned error",
+            ));
+        }
+        if bytes_written as usize > buf.len() {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidData,
+                "Write callback returned more bytes than requested",
+            ));
+        }
+
+        Ok(bytes_written as usize)
+    }
+
+    fn write_vectored(&mut self, bufs: &[IoSlice<'_>]) -> std::io::Result<usize> {
+        let Some(writev) = self.writev else {
+            return match bufs.iter().find(|buf| !buf.is_empty()) {
+                Some(buf) => self.write(buf),
+                None => Ok(0),
+            };
+        };
+
+        let mut iov = [CimplConstIoVec {
+            data: std::ptr::null(),
+            len: 0,
+        }; CIMPL_STREAM_MAX_IOV];
+        let count = bufs.len().min(CIMPL_STREAM_MAX_IOV);
+        for (vec, buf) in iov.iter_mut().zip(bufs) {
+            *vec = CimplConstIoVec {
+                data: buf.as_ptr(),
+                len: buf.len(),
+            };
+        }
+
+        let bytes_written = unsafe { writev(self.context, iov.as_ptr(), count) };
+
+        if bytes_written < 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::Other,
+                "Writev callback returned error",
+            ));
+        }
+        if bytes_written as usize > iov[..count].iter().map(|vec| vec.len).sum() {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidData,
+                "Writev callback returned more bytes than requested",
+            ));
+        }
+
+        Ok(bytes_written as usize)
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        let result = unsafe { (self.flusher)(self.context) };
+
+        if result != 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::Other,
+                "Flush callback returned error",
+            ));
+        }
+
+        Ok(())
+    }
+}
+
+impl CallbackStream {
+    /// Drops a peek-only buffer once its bytes are read, so an unbuffered
+    /// stream goes back to calling C for every operation
+    fn release_peek(&mut self) {
+        if self.peek_only && self.buffer.as_ref().is_some_and(|b| b.start == b.end) {
+            self.buffer = None;
+            self.peek_only = false;
+        }
+    }
+
+    /// Drops a peek-only buffer before a write, moving C back over any
+    /// unread bytes, so writes on an unbuffered stream reach C at once
+    fn end_peek(&mut self) -> std::io::Result<()> {
+        if self.peek_only {
+            if let Some(b) = self.buffer.as_mut() {
+                b.discard_read_ahead(&mut self.io)?;
+            }
+            self.buffer = None;
+            self.peek_only = false;
+        }
+        Ok(())
+    }
+}
+
+impl Read for CallbackStream {
+    fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+        self.release_peek();
+        let Some(b) = self.buffer.as_mut() else {
+            return self.io.read(buf);
+        };
+        b.flush_writes(&mut self.io)?;
+
+        if b.start == b.end {
+            if buf.len() >= b.data.len() {
+                let n = self.io.read(buf)?;
+                b.start = 0;
+                b.end = 0;
+                b.advance_inner(n);
+                return Ok(n);
+            }
+            b.fill(&mut self.io)?;
+        }
+        Ok(b.take(buf))
+    }
+
+    fn read_vectored(&mut self, bufs: &mut [IoSliceMut<'_>]) -> std::io::Result<usize> {
+        self.release_peek();
+        let Some(b) = self.buffer.as_mut() else {
+            return self.io.read_vectored(bufs);
+        };
+        b.flush_writes(&mut self.io)?;
+
+        if b.start == b.end {
+            let total: usize = bufs.iter().map(|buf| buf.len()).sum();
+            if total >= b.data.len() {
+                let n = self.io.read_vectored(bufs)?;
+                b.start = 0;
+                b.end = 0;
+                b.advance_inner(n);
+                return Ok(n);
+            }
+            b.fill(&mut self.io)?;
+        }
+
+        let mut n = 0;
+        for buf in bufs {
+            n += b.take(buf);
+            if b.start == b.end {
+                break;
+            }
+        }
+        Ok(n)
+    }
+
+    fn read_exact(&mut self, mut buf: &mut [u8]) -> std::io::Result<()> {
+        self.release_peek();
+        let Some(b) = self.buffer.as_mut() else {
+            return self.io.read_exact(buf);
+        };
+        b.flush_writes(&mut self.io)?;
+
+        let n = b.take(buf);
+        buf = &mut buf[n..];
+        if buf.len() >= b.data.len() {
+            // Too big to buffer: hand the rest to C in one request
+            b.start = 0;
+            b.end = 0;
+            let result = self.io.read_exact(buf);
+            match result {
+                Ok(()) => b.advance_inner(buf.len()),
+                Err(_) => b.inner_pos = None,
+            }
+            return result;
+        }
+        while !buf.is_empty() {
+            b.fill(&mut self.io)?;
+            if b.end == 0 {
+                return Err(std::io::ErrorKind::UnexpectedEof.into());
+            }
+            let n = b.take(buf);
+            buf = &mut buf[n..];
+        }
+        Ok(())
+    }
+}
+
+impl Seek for CallbackStream {
+    fn seek(&mut self, from: SeekFrom) -> std::io::Result<u64> {
+        self.release_peek();
+        let Some(b) = self.buffer.as_mut() else {
+            return self.io.seek(from);
+        };
+        b.flush_writes(&mut self.io)?;
+        if let Some(pos) = b.seek_in_buffer(from) {
+            return Ok(pos);
+        }
+
+        // C is ahead of the logical position by the unread bytes
+        let from = match from {
+            SeekFrom::Current(offset) => {
+                let unread = (b.end - b.start) as i64;
+                SeekFrom::Current(offset.checked_sub(unread).ok_or_else(|| {
+                    std::io::Error::new(std::io::ErrorKind::InvalidInput, "Seek offset overflow")
+                })?)
+            }
+            other => other,
+        };
+        b.start = 0;
+        b.end = 0;
+        let pos = self.io.seek(from)?;
+        b.inner_pos = Some(pos);
+        Ok(pos)
+    }
+}
+
+impl Write for CallbackStream {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        self.end_peek()?;
+        let Some(b) = self.buffer.as_mut() else {
+            return self.io.write(buf);
+        };
+        if !b.writing {
+            b.discard_read_ahead(&mut self.io)?;
+            b.writing = true;
+        }
+
+        if b.end + buf.len() > b.data.len() {
+            b.flush_writes(&mut self.io)?;
+        }
+        if buf.len() >= b.data.len() {
+            let n = self.io.write(buf)?;
+            b.advance_inner(n);
+            return Ok(n);
+        }
+
+        b.writing = true;
+        b.data[b.end..b.end + buf.len()].copy_from_slice(buf);
+        b.end += buf.len();
+        Ok(buf.len())
+    }
+
+    fn write_vectored(&mut self, bufs: &[IoSlice<'_>]) -> std::io::Result<usize> {
+        self.end_peek()?;
+        let Some(b) = self.buffer.as_mut() else {
+            return self.io.write_vectored(bufs);
+        };
+        if !b.writing {
+            b.discard_read_ahead(&mut self.io)?;
+            b.writing = true;
+        }
+
+        let total: usize = bufs.iter().map(|buf| buf.len()).sum();
+        if b.end + total > b.data.len() {
+            b.flush_writes(&mut self.io)?;
+        }
+        if total >= b.data.len() {
+            let n = self.io.write_vectored(bufs)?;
+            b.advance_inner(n);
+            return Ok(n);
+        }
+
+        b.writing = true;
+        for buf in bufs {
+            b.data[b.end..b.end + buf.len()].copy_from_slice(buf);
+            b.end += buf.len();
+        }
+        Ok(total)
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        if let Some(b) = self.buffer.as_mut() {
+            b.flush_writes(&mut self.io)?;
+        }
+        self.io.flush()
+    }
 }
 
-/// Writes data to the stream.
-///
-/// # Parameters
-/// - `stream`: The stream to write to
-/// - `data`: Buffer containing data to write (must not be NULL)
-/// - `len`: Number of bytes to write
-///
-/// # Returns
-/// - Number of bytes actually written (>= 0) on success
-/// - -1 on error
-///
-/// # Example
-/// ```c
-/// const char* message = "Hello, World!";
-/// isize bytes_written = cimpl_stream_write(stream, (const uint8_t*)message, strlen(message));
-/// if (bytes_written < 0) {
-///     fprintf(stderr, "Write error\n");
-/// }
-/// ```
-#[no_mangle]
-pub extern "C" fn cimpl_stream_write(
-    stream: *mut CimplStream,
-    data: *const u8,
-    len: usize,
-) -> isize {
-    let s = deref_mut_or_return_neg!(stream, CimplStream);
-    ptr_or_return_int!(data);
+impl Drop for CallbackStream {
+    fn drop(&mut self) {
+        // Like BufWriter, errors writing out the buffer on drop are ignored
+        if let Some(b) = self.buffer.as_mut() {
+            let _ = b.flush_writes(&mut self.io);
+        }
+    }
+}
 
-    let buf = unsafe { std::slice::from_raw_parts(data, len) };
+impl BufRead for CallbackStream {
+    fn fill_buf(&mut self) -> std::io::Result<&[u8]> {
+        // Unbuffered streams get a buffer only until the peeked bytes are read
+        if self.buffer.is_none() {
+            self.peek_only = true;
+        }
+        let b = self
+            .buffer
+            .get_or_insert_with(|| StreamBuffer::new(DEFAULT_STREAM_BUFFER));
+        b.flush_writes(&mut self.io)?;
+        if b.start == b.end {
+            b.fill(&mut self.io)?;
+        }
+        Ok(&b.data[b.start..b.end])
+    }
 
-    ok_or_return!(s.write(buf), |bytes_written| bytes_written as isize, -1)
+    fn consume(&mut self, amt: usize) {
+        if let Some(b) = self.buffer.as_mut() {
+            b.start = (b.start + amt).min(b.end);
+        }
+    }
 }
 
-/// Flushes the stream, ensuring all buffered data is written.
-///
-/// # Parameters
-/// - `stream`: The stream to flush
-///
-/// # Returns
-/// - 0 on success
-/// - -1 on error
-///
-/// # Example
-/// ```c
-/// if (cimpl_stream_flush(stream) != 0) {
-///     fprintf(stderr, "Flush error\n");
-/// }
-/// ```
-#[no_mangle]
-pub extern "C" fn cimpl_stream_flush(stream: *mut CimplStream) -> i32 {
-    let s = deref_mut_or_return_neg!(stream, CimplStream);
-
-    ok_or_return!(s.flush(), |_| 0, -1)
+impl CimplStream {
+    /// Bytes the last `fill_buf()` made available that are still unconsumed
+    fn buffered_len(&self) -> usize {
+        match &self.backend {
+            Backend::Callbacks(c) => c.buffer.as_ref().map_or(0, |b| b.end - b.start),
+            Backend::Memory(m) => {
+                let len = m.cursor.get_ref().len() as u64;
+                len.saturating_sub(m.cursor.position()) as usize
+            }
+        }
+    }
 }
 
-// ============================================================================
-// Trait Implementations
-// ============================================================================
+fn read_only() -> std::io::Error {
+    std::io::Error::new(std::io::ErrorKind::PermissionDenied, "Stream is read-only")
+}
 
 impl Read for CimplStream {
     fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
-        if buf.len() > isize::MAX as usize {
-            return Err(std::io::Error::new(
-                std::io::ErrorKind::InvalidInput,
-                "Read buffer is too large",
-            ));
+        match &mut self.backend {
+            Backend::Callbacks(c) => c.read(buf),
+            Backend::Memory(m) => m.cursor.read(buf),
         }
+    }
 
-        let bytes_read = unsafe { (self.reader)(self.context, buf.as_mut_ptr(), buf.len()) };
+    fn read_vectored(&mut self, bufs: &mut [IoSliceMut<'_>]) -> std::io::Result<usize> {
+        match &mut self.backend {
+            Backend::Callbacks(c) => c.read_vectored(bufs),
+            Backend::Memory(m) => m.cursor.read_vectored(bufs),
+        }
+    }
 
-        if bytes_read < 0 {
-            return Err(std::io::Error::new(
-                std::io::ErrorKind::Other,
-                "Read callback returned error",
-            ));
+    fn read_exact(&mut self, buf: &mut [u8]) -> std::io::Result<()> {
+        match &mut self.backend {
+            Backend::Callbacks(c) => c.read_exact(buf),
+            Backend::Memory(m) => m.cursor.read_exact(buf),
+        }
+    }
+}
+
+impl BufRead for CimplStream {
+    fn fill_buf(&mut self) -> std::io::Result<&[u8]> {
+        match &mut self.backend {
+            Backend::Callbacks(c) => c.fill_buf(),
+            Backend::Memory(m) => m.cursor.fill_buf(),
         }
+    }
 
-        Ok(bytes_read as usize)
+    fn consume(&mut self, amt: usize) {
+        match &mut self.backend {
+            Backend::Callbacks(c) => c.consume(amt),
+            Backend::Memory(m) => m.cursor.consume(amt),
+        }
     }
 }
 
 impl Seek for CimplStream {
     fn seek(&mut self, from: SeekFrom) -> std::io::Result<u64> {
-        let (offset, mode) = match from {
-            SeekFrom::Start(pos) => (pos as i64, CimplSeekMode::Start),
-            SeekFrom::Current(pos) => (pos, CimplSeekMode::Current),
-            SeekFrom::End(pos) => (pos, CimplSeekMode::End),
-        };
-
-        let new_pos = unsafe { (self.seeker)(self.context, offset, mode) };
-
-        if new_pos < 0 {
-            return Err(std::io::Error::new(
-                std::io::ErrorKind::Other,
-                "Seek callback returned error",
-            ));
+        match &mut self.backend {
+            Backend::Callbacks(c) => c.seek(from),
+            Backend::Memory(m) => m.cursor.seek(from),
         }
-
-        Ok(new_pos as u64)
     }
 }
 
 impl Write for CimplStream {
     fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
-        if buf.len() > isize::MAX as usize {
-            return Err(std::io::Error::new(
-                std::io::ErrorKind::InvalidInput,
-                "Write buffer is too large",
-            ));
+        match &mut self.backend {
+            Backend::Callbacks(c) => c.write(buf),
+            Backend::Memory(_) => Err(read_only()),
         }
+    }
 
-        let bytes_written = unsafe { (self.writer)(self.context, buf.as_ptr(), buf.len()) };
-
-        if bytes_written < 0 {
-            return Err(std::io::Error::new(
-                std::io::ErrorKind::Other,
-                "Write callback returned error",
-            ));
+    fn write_vectored(&mut self, bufs: &[IoSlice<'_>]) -> std::io::Result<usize> {
+        match &mut self.backend {
+            Backend::Callbacks(c) => c.write_vectored(bufs),
+            Backend::Memory(_) => Err(read_only()),
         }
-
-        Ok(bytes_written as usize)
     }
 
     fn flush(&mut self) -> std::io::Result<()> {
-        let result = unsafe { (self.flusher)(self.context) };
-
-        if result != 0 {
-            return Err(std::io::Error::new(
-                std::io::ErrorKind::Other,
-                "Flush callback returned error",
-            ));
+        match &mut self.backend {
+            Backend::Callbacks(c) => c.flush(),
+            Backend::Memory(_) => Ok(()),
         }
-
-        Ok(())
     }
 }
 
@@ -479,7 +1520,7 @@ impl Write for CimplStream {
 /// ```
 #[no_mangle]
 pub extern "C" fn cimpl_stream_last_error() -> *mut std::os::raw::c_char {
-    option_to_c_string!(Error::last_message())
+    option_to_c_string!(CimplError::last_message())
 }
 
 /// Gets the last error code.
@@ -497,7 +1538,7 @@ pub extern "C" fn cimpl_stream_last_error() -> *mut std::os::raw::c_char {
 /// ```
 #[no_mangle]
 pub extern "C" fn cimpl_stream_error_code() -> i32 {
-    Error::last_code() as i32
+    CimplError::last_code()
 }
 
 /// Clears the last error.
@@ -506,7 +1547,7 @@ pub extern "C" fn cimpl_stream_error_code() -> i32 {
 /// a series of calls where you want to check for new errors.
 #[no_mangle]
 pub extern "C" fn cimpl_stream_clear_error() {
-    Error::take_last();
+    CimplError::take_last();
 }
 
 // ============================================================================
@@ -516,12 +1557,15 @@ pub extern "C" fn cimpl_stream_clear_error() {
 #[cfg(test)]
 mod tests {
     use super::*;
+    use std::sync::atomic::{AtomicUsize, Ordering};
     use std::sync::Mutex;
 
     // Simple memory buffer for testing
     struct MemoryBuffer {
         data: Mutex<Vec<u8>>,
         position: Mutex<usize>,
+        // Number of read/write/seek callbacks made
+        calls: AtomicUsize,
     }
 
     impl MemoryBuffer {
@@ -529,6 +1573,7 @@ mod tests {
             Self {
                 data: Mutex::new(Vec::new()),
                 position: Mutex::new(0),
+                calls: AtomicUsize::new(0),
             }
         }
 
@@ -536,6 +1581,7 @@ mod tests {
             Self {
                 data: Mutex::new(data),
                 position: Mutex::new(0),
+                calls: AtomicUsize::new(0),
             }
         }
 
@@ -545,6 +1591,7 @@ mod tests {
             len: usize,
         ) -> isize {
             let buf = &*(ctx as *const MemoryBuffer);
+            buf.calls.fetch_add(1, Ordering::Relaxed);
             let mut pos = buf.position.lock().unwrap();
             let buffer = buf.data.lock().unwrap();
             
@@ -566,6 +1613,7 @@ mod tests {
             mode: CimplSeekMode,
         ) -> i64 {
             let buf = &*(ctx as *const MemoryBuffer);
+            buf.calls.fetch_add(1, Ordering::Relaxed);
             let mut pos = buf.position.lock().unwrap();
             let buffer = buf.data.lock().unwrap();
             
@@ -585,6 +1633,7 @@ mod tests {
             len: usize,
         ) -> isize {
             let buf = &*(ctx as *const MemoryBuffer);
+            buf.calls.fetch_add(1, Ordering::Relaxed);
             let mut pos = buf.position.lock().unwrap();
             let mut buffer = buf.data.lock().unwrap();
             
@@ -604,6 +1653,59 @@ mod tests {
         unsafe extern "C" fn flush_callback(_ctx: *mut CimplStreamContext) -> i32 {
             0 // Nothing to flush for memory buffer
         }
+
+        unsafe extern "C" fn readv_callback(
+            ctx: *mut CimplStreamContext,
+            iov: *const CimplIoVec,
+            count: usize,
+        ) -> isize {
+            let buf = &*(ctx as *const MemoryBuffer);
+            buf.calls.fetch_add(1, Ordering::Relaxed);
+            let mut pos = buf.position.lock().unwrap();
+            let buffer = buf.data.lock().unwrap();
+
+            let mut total = 0;
+            for vec in std::slice::from_raw_parts(iov, count) {
+                let to_read = buffer.len().saturating_sub(*pos).min(vec.len);
+                std::slice::from_raw_parts_mut(vec.data, to_read)
+                    .copy_from_slice(&buffer[*pos..*pos + to_read]);
+                *pos += to_read;
+                total += to_read;
+            }
+            total as isize
+        }
+
+        unsafe extern "C" fn writev_callback(
+            ctx: *mut CimplStreamContext,
+            iov: *const CimplConstIoVec,
+            count: usize,
+        ) -> isize {
+            let buf = &*(ctx as *const MemoryBuffer);
+            buf.calls.fetch_add(1, Ordering::Relaxed);
+            let mut pos = buf.position.lock().unwrap();
+            let mut buffer = buf.data.lock().unwrap();
+
+            let mut total = 0;
+            for vec in std::slice::from_raw_parts(iov, count) {
+                if *pos + vec.len > buffer.len() {
+                    buffer.resize(*pos + vec.len, 0);
+                }
+                buffer[*pos..*pos + vec.len]
+                    .copy_from_slice(std::slice::from_raw_parts(vec.data, vec.len));
+                *pos += vec.len;
+                total += vec.len;
+            }
+            total as isize
+        }
+
+        unsafe extern "C" fn read_exact_callback(
+            ctx: *mut CimplStreamContext,
+            data: *mut u8,
+            len: usize,
+        ) -> isize {
+            // A memory buffer always satisfies a read in one call
+            Self::read_callback(ctx, data, len)
+        }
     }
 
     #[test]
@@ -793,5 +1895,319 @@ mod tests {
         cimpl_stream_clear_error();
         assert_eq!(cimpl_stream_error_code(), 0);
     }
-}
 
+    fn new_buffered(buffer: MemoryBuffer, capacity: usize) -> (*mut CimplStream, *mut MemoryBuffer) {
+        let ctx = Box::into_raw(Box::new(buffer));
+        let stream = cimpl_stream_new_buffered(
+            ctx as *mut CimplStreamContext,
+            MemoryBuffer::read_callback,
+            MemoryBuffer::seek_callback,
+            MemoryBuffer::write_callback,
+            MemoryBuffer::flush_callback,
+            capacity,
+        );
+        assert!(!stream.is_null());
+        (stream, ctx)
+    }
+
+    #[test]
+    fn test_buffered_small_reads_batch_callbacks() {
+        let data: Vec<u8> = (0..=255).collect();
+        let (stream, ctx) = new_buffered(MemoryBuffer::with_data(data.clone()), 64);
+
+        let mut out = Vec::new();
+        let mut byte = [0u8; 1];
+        while cimpl_stream_read(stream, byte.as_mut_ptr(), 1) == 1 {
+            out.push(byte[0]);
+        }
+        assert_eq!(out, data);
+        // 4 full buffers plus the read that hits EOF, not 257 callbacks
+        assert_eq!(unsafe { &*ctx }.calls.load(Ordering::Relaxed), 5);
+
+        unsafe {
+            cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+            let _ = Box::from_raw(ctx);
+        }
+    }
+
+    #[test]
+    fn test_overlong_callback_results_are_errors() {
+        unsafe extern "C" fn lying_read(
+            _: *mut CimplStreamContext,
+            _: *mut u8,
+            len: usize,
+        ) -> isize {
+            len as isize + 1
+        }
+        unsafe extern "C" fn lying_write(
+            _: *mut CimplStreamContext,
+            _: *const u8,
+            len: usize,
+        ) -> isize {
+            len as isize + 1
+        }
+
+        let ctx = Box::into_raw(Box::new(MemoryBuffer::new()));
+        let stream = cimpl_stream_new_buffered(
+            ctx as *mut CimplStreamContext,
+            lying_read,
+            MemoryBuffer::seek_callback,
+            lying_write,
+            MemoryBuffer::flush_callback,
+            16,
+        );
+        let mut buf = [0u8; 4];
+        assert_eq!(cimpl_stream_read(stream, buf.as_mut_ptr(), buf.len()), -1);
+        assert_eq!(cimpl_stream_write(stream, [0u8; 32].as_ptr(), 32), -1);
+
+        unsafe {
+            cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+            let _ = Box::from_raw(ctx);
+        }
+    }
+
+    #[test]
+    fn test_buffered_seek_invalidates_read_ahead() {
+        let (stream, ctx) = new_buffered(MemoryBuffer::with_data(b"0123456789".to_vec()), 8);
+        let mut buf = [0u8; 3];
+
+        assert_eq!(cimpl_stream_seek(stream, 2, CimplSeekMode::Start), 2);
+        assert_eq!(cimpl_stream_read(stream, buf.as_mut_ptr(), 3), 3);
+        assert_eq!(&buf, b"234");
+
+        // Relative seek inside the read-ahead needs no callback
+        let calls = unsafe { &*ctx }.calls.load(Ordering::Relaxed);
+        assert_eq!(cimpl_stream_seek(stream, -2, CimplSeekMode::Current), 3);
+        assert_eq!(cimpl_stream_seek(stream, 0, CimplSeekMode::Current), 3);
+        assert_eq!(unsafe { &*ctx }.calls.load(Ordering::Relaxed), calls);
+        assert_eq!(cimpl_stream_read(stream, buf.as_mut_ptr(), 3), 3);
+        assert_eq!(&buf, b"345");
+
+        // Seeking outside it goes to C, accounting for the unread bytes
+        assert_eq!(cimpl_stream_seek(stream, -2, CimplSeekMode::End), 8);
+        assert_eq!(cimpl_stream_read(stream, buf.as_mut_ptr(), 3), 2);
+        assert_eq!(&buf[..2], b"89");
+
+        unsafe {
+            cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+            let _ = Box::from_raw(ctx);
+        }
+    }
+
+    #[test]
+    fn test_buffered_write_behind() {
+        let (stream, ctx) = new_buffered(MemoryBuffer::with_data(b"0123456789".to_vec()), 16);
+        let mut buf = [0u8; 10];
+
+        // Overwrite after a read: the write lands at the logical position
+        assert_eq!(cimpl_stream_read(stream, buf.as_mut_ptr(), 2), 2);
+        assert_eq!(cimpl_stream_write(stream, b"ab".as_ptr(), 2), 2);
+        assert_eq!(cimpl_stream_write(stream, b"cd".as_ptr(), 2), 2);
+        assert_eq!(unsafe { &*ctx }.data.lock().unwrap().as_slice(), b"0123456789");
+
+        assert_eq!(cimpl_stream_seek(stream, 0, CimplSeekMode::Start), 0);
+        assert_eq!(cimpl_stream_read(stream, buf.as_mut_ptr(), 10), 10);
+        assert_eq!(&buf, b"01abcd6789");
+
+        // Pending writes reach C when the stream is freed
+        assert_eq!(cimpl_stream_write(stream, b"!".as_ptr(), 1), 1);
+        unsafe {
+            cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+            let ctx = Box::from_raw(ctx);
+            assert_eq!(ctx.data.lock().unwrap().as_slice(), b"01abcd6789!");
+        }
+    }
+
+    fn new_vectored(buffer: MemoryBuffer, capacity: usize) -> (*mut CimplStream, *mut MemoryBuffer) {
+        let ctx = Box::into_raw(Box::new(buffer));
+        let callbacks = CimplStreamCallbacks {
+            reader: Some(MemoryBuffer::read_callback),
+            seeker: Some(MemoryBuffer::seek_callback),
+            writer: Some(MemoryBuffer::write_callback),
+            flusher: Some(MemoryBuffer::flush_callback),
+            readv: Some(MemoryBuffer::readv_callback),
+            writev: Some(MemoryBuffer::writev_callback),
+            read_exact: Some(MemoryBuffer::read_exact_callback),
+        };
+        let stream = cimpl_stream_new_ex(ctx as *mut CimplStreamContext, &callbacks, capacity);
+        assert!(!stream.is_null());
+        (stream, ctx)
+    }
+
+    #[test]
+    fn test_new_ex_requires_core_callbacks() {
+        let ctx = Box::into_raw(Box::new(MemoryBuffer::new()));
+        let callbacks = CimplStreamCallbacks {
+            reader: Some(MemoryBuffer::read_callback),
+            seeker: None,
+            writer: Some(MemoryBuffer::write_callback),
+            flusher: Some(MemoryBuffer::flush_callback),
+            readv: None,
+            writev: None,
+            read_exact: None,
+        };
+        let stream = cimpl_stream_new_ex(ctx as *mut CimplStreamContext, &callbacks, 0);
+        assert!(stream.is_null());
+        assert_eq!(CimplError::last_code(), 1);
+        assert!(cimpl_stream_new_ex(ctx as *mut CimplStreamContext, std::ptr::null(), 0).is_null());
+        unsafe {
+            let _ = Box::from_raw(ctx);
+        }
+    }
+
+    #[test]
+    fn test_vectored_callbacks_cross_once() {
+        let (stream, ctx) = new_vectored(MemoryBuffer::new(), 0);
+        let s = unsafe { &mut *stream };
+
+        let parts = [IoSlice::new(b"head"), IoSlice::new(b"-"), IoSlice::new(b"tail")];
+        assert_eq!(s.write_vectored(&parts).unwrap(), 9);
+        assert_eq!(unsafe { &*ctx }.calls.load(Ordering::Relaxed), 1);
+
+        s.seek(SeekFrom::Start(0)).unwrap();
+        let (mut a, mut b) = ([0u8; 4], [0u8; 5]);
+        let mut bufs = [IoSliceMut::new(&mut a), IoSliceMut::new(&mut b)];
+        assert_eq!(s.read_vectored(&mut bufs).unwrap(), 9);
+        assert_eq!((&a, &b), (b"head", b"-tail"));
+        assert_eq!(unsafe { &*ctx }.calls.load(Ordering::Relaxed), 3);
+
+        // read_exact is one call, and a short count is an EOF error
+        s.seek(SeekFrom::Start(5)).unwrap();
+        let mut exact = [0u8; 4];
+        s.read_exact(&mut exact).unwrap();
+        assert_eq!(&exact, b"tail");
+        assert_eq!(unsafe { &*ctx }.calls.load(Ordering::Relaxed), 5);
+        s.seek(SeekFrom::Start(7)).unwrap();
+        let err = s.read_exact(&mut exact).unwrap_err();
+        assert_eq!(err.kind(), std::io::ErrorKind::UnexpectedEof);
+
+        unsafe {
+            cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+            let _ = Box::from_raw(ctx);
+        }
+    }
+
+    #[test]
+    fn test_buffered_vectored_io() {
+        let (stream, ctx) = new_vectored(MemoryBuffer::new(), 16);
+        let s = unsafe { &mut *stream };
+
+        // Small vectored writes are coalesced in the buffer
+        let parts = [IoSlice::new(b"ab"), IoSlice::new(b"cd")];
+        assert_eq!(s.write_vectored(&parts).unwrap(), 4);
+        assert_eq!(s.write_vectored(&parts).unwrap(), 4);
+        assert_eq!(unsafe { &*ctx }.calls.load(Ordering::Relaxed), 0);
+
+        // Large ones bypass it in a single writev after the pending bytes
+        let big = [0x55u8; 20];
+        assert_eq!(s.write_vectored(&[IoSlice::new(&big)]).unwrap(), 20);
+        assert_eq!(unsafe { &*ctx }.calls.load(Ordering::Relaxed), 2);
+        assert_eq!(unsafe { &*ctx }.data.lock().unwrap().len(), 28);
+
+        // read_exact larger than the buffer goes straight to C
+        s.seek(SeekFrom::Start(0)).unwrap();
+        let mut head = [0u8; 2];
+        s.read_exact(&mut head).unwrap();
+        let mut rest = [0u8; 26];
+        s.read_exact(&mut rest).unwrap();
+        assert_eq!(&head, b"ab");
+        assert_eq!(&rest[..6], b"cdabcd");
+        assert_eq!(s.stream_position().unwrap(), 28);
+
+        unsafe {
+            cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+            let _ = Box::from_raw(ctx);
+        }
+    }
+
+    #[test]
+    fn test_memory_stream_makes_no_callbacks() {
+        let data = b"header:payload".to_vec();
+        let stream = cimpl_stream_from_memory(data.as_ptr(), data.len());
+        assert!(!stream.is_null());
+        let mut buf = [0u8; 7];
+
+        assert_eq!(cimpl_stream_read(stream, buf.as_mut_ptr(), 7), 7);
+        assert_eq!(&buf, b"header:");
+        assert_eq!(unsafe { &*stream }.as_slice(), Some(data.as_slice()));
+
+        // Peek hands out the caller's own bytes
+        let mut len = 0;
+        let peeked = cimpl_stream_peek(stream, &mut len);
+        assert_eq!(peeked, unsafe { data.as_ptr().add(7) });
+        assert_eq!(len, 7);
+        assert_eq!(cimpl_stream_consume(stream, 8), -1);
+        assert_eq!(cimpl_stream_consume(stream, 3), 0);
+        assert_eq!(cimpl_stream_seek(stream, 0, CimplSeekMode::Current), 10);
+
+        assert_eq!(cimpl_stream_write(stream, b"x".as_ptr(), 1), -1);
+        assert_eq!(cimpl_stream_error_code(), CimplStreamError::IoOperation as i32);
+        assert!(cimpl_stream_from_memory(std::ptr::null(), 0).is_null());
+
+        cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+    }
+
+    #[test]
+    fn test_file_stream() {
+        let path = std::env::temp_dir().join(format!("cimpl_stream_{}.bin", std::process::id()));
+        let contents: Vec<u8> = (0..=255u8).cycle().take(10_000).collect();
+        std::fs::write(&path, &contents).unwrap();
+        let c_path = std::ffi::CString::new(path.to_str().unwrap()).unwrap();
+
+        let stream = cimpl_stream_from_file(c_path.as_ptr());
+        assert!(!stream.is_null());
+        let s = unsafe { &mut *stream };
+        assert_eq!(s.as_slice(), Some(contents.as_slice()));
+        s.seek(SeekFrom::End(-10)).unwrap();
+        let mut tail = Vec::new();
+        s.read_to_end(&mut tail).unwrap();
+        assert_eq!(tail, &contents[contents.len() - 10..]);
+        cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+
+        // Empty files cannot be mapped and are read instead
+        std::fs::write(&path, b"").unwrap();
+        let stream = cimpl_stream_from_file(c_path.as_ptr());
+        assert_eq!(unsafe { &*stream }.as_slice(), Some(&[][..]));
+        cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+
+        std::fs::remove_file(&path).unwrap();
+        assert!(cimpl_stream_from_file(c_path.as_ptr()).is_null());
+        assert_eq!(cimpl_stream_error_code(), CimplStreamError::IoOperation as i32);
+    }
+
+    #[test]
+    fn test_peek_on_callback_stream() {
+        let ctx = Box::into_raw(Box::new(MemoryBuffer::with_data(b"abcdef".to_vec())));
+        let stream = cimpl_stream_new(
+            ctx as *mut CimplStreamContext,
+            MemoryBuffer::read_callback,
+            MemoryBuffer::seek_callback,
+            MemoryBuffer::write_callback,
+            MemoryBuffer::flush_callback,
+        );
+        let mut len = 0;
+        let peeked = cimpl_stream_peek(stream, &mut len);
+        assert_eq!(unsafe { std::slice::from_raw_parts(peeked, len) }, b"abcdef");
+        assert_eq!(cimpl_stream_consume(stream, 4), 0);
+
+        let mut buf = [0u8; 4];
+        assert_eq!(cimpl_stream_read(stream, buf.as_mut_ptr(), 4), 2);
+        assert_eq!(&buf[..2], b"ef");
+
+        // A write after a peek still goes straight to C, at the logical position
+        assert_eq!(cimpl_stream_seek(stream, 0, CimplSeekMode::Start), 0);
+        assert!(!cimpl_stream_peek(stream, &mut len).is_null());
+        assert_eq!(cimpl_stream_consume(stream, 2), 0);
+        assert_eq!(cimpl_stream_write(stream, b"XY".as_ptr(), 2), 2);
+        assert_eq!(unsafe { &*ctx }.data.lock().unwrap().as_slice(), b"abXYef");
+        let calls = unsafe { &*ctx }.calls.load(Ordering::Relaxed);
+        assert_eq!(cimpl_stream_write(stream, b"Z".as_ptr(), 1), 1);
+        assert_eq!(unsafe { &*ctx }.calls.load(Ordering::Relaxed), calls + 1);
+        assert_eq!(unsafe { &*ctx }.data.lock().unwrap().as_slice(), b"abXYZf");
+
+        unsafe {
+            cimpl::cimpl_free(stream as *mut std::ffi::c_void);
+            let _ = Box::from_raw(ctx);
+        }
+    }
+}